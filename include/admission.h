@@ -0,0 +1,113 @@
+#ifndef ADMISSION_H
+#define ADMISSION_H
+
+#include <vector>
+#include <string>
+#include <cstdint>
+#include <functional>
+#include "pcb.h"
+#include "memory_manager.h"
+#include "scheduling_policy.h"
+
+class Scheduler;
+
+// which waiting job gets memory next
+enum class AdmissionPolicy {
+    FIFO,           // strictly in arrival order, the oldest job holds up everyone behind it
+    SMALLEST_FIT,   // smallest waiting job first, big jobs can wait for a long time
+    BACKFILL        // oldest job that fits, but the oldest one can only be passed max_bypass times
+};
+
+struct AdmissionConfig {
+    AdmissionPolicy policy = AdmissionPolicy::FIFO;
+    size_t batch_size = 64;   // arrivals collected before an admission pass, flush() sends the rest
+    int max_bypass = 32;      // backfill: younger jobs admitted ahead of the oldest one before it
+                              // gets a reservation and nobody else is admitted until it fits
+};
+
+struct AdmissionStats {
+    long long offered = 0;
+    long long admitted = 0;
+    long long rejected = 0;      // bigger than the memory can ever hold
+    long long batches = 0;       // admission passes started by arrivals
+    long long wakeups = 0;       // admission passes started by a memory release
+    long long idle_wakeups = 0;  // wakeups that admitted nothing (fragmentation)
+    long long probes = 0;        // jobs looked at, one per admission plus one per pass
+    long long bypasses = 0;      // backfill: jobs admitted ahead of an older one
+    long long total_wait = 0;    // ticks admitted jobs spent waiting for memory
+    long long max_wait = 0;
+    size_t peak_pending = 0;
+};
+
+// long-term scheduler: jobs that do not fit in memory wait here instead of being rejected.
+//
+// arrivals are collected and admitted in batches. waiting jobs sit in FIFO buckets by memory
+// size with a min-tree over the sequence number at the front of each bucket, so the oldest
+// job, the smallest job and the oldest job up to a size are each found in O(log buckets).
+// the queue tells the memory manager the size its next job needs (the wake threshold), and
+// the manager only calls back when a release gets there. an admission pass stops at the first
+// job that does not fit, so it costs O((admitted + 1) log buckets) and never rescans the queue
+//
+// admitted jobs go to Scheduler::submitProcess unless another handler is set. the time they
+// waited is part of their waiting and turnaround time. the queue is not part of a snapshot
+class AdmissionQueue {
+private:
+    struct Waiting {
+        uint64_t seq;
+        PCB* process;
+    };
+    static const uint64_t EMPTY = UINT64_MAX;
+    static const int MAX_BUCKETS = 1 << 16;
+
+    MemoryManager* memory;
+    Scheduler* scheduler;
+    AdmissionConfig config;
+    std::function<void(PCB*)> admitHandler;
+    long long capacity;
+    int granularity;                          // MB per bucket, 1 unless memory is very large
+    std::vector<RingBuffer<Waiting>> buckets;
+    std::vector<uint64_t> tree;               // min seq per subtree, leaves start at leaves
+    size_t leaves;
+    std::vector<PCB*> inbox;                  // arrivals of the current batch
+    uint64_t nextSeq;
+    size_t waiting;
+    uint64_t headSeq;                         // oldest job the last backfill pass saw
+    int headBypassed;                         // times it was passed since
+    bool attached;
+    AdmissionStats stats;
+
+    void insert(PCB* p);
+    void updateLeaf(int bucket);
+    int oldest(int lastBucket) const;         // bucket with the oldest front up to lastBucket
+    int smallest(int lastBucket) const;       // first non empty bucket up to lastBucket
+    int fittingBuckets(long long limit) const;
+    int pick(long long limit);
+    void admitPass();
+    void wake();
+    void updateThreshold();
+
+public:
+    AdmissionQueue(MemoryManager* memory, Scheduler* scheduler, const AdmissionConfig& config = AdmissionConfig());
+    ~AdmissionQueue();
+
+    // how an admitted job enters the system, instead of scheduler->submitProcess
+    void setAdmitHandler(std::function<void(PCB*)> handler);
+
+    // queue an arrival, a full batch is admitted at once. false when the job is bigger than
+    // the memory could ever hold, the caller keeps the PCB then
+    bool offer(PCB* p);
+
+    // admit the partial batch now (end of an arrival window)
+    void flush();
+
+    // stop waking up and hand back every job that never got memory, in arrival order
+    std::vector<PCB*> drain();
+
+    size_t pending() const;
+    const AdmissionStats& getStats() const;
+    const AdmissionConfig& getConfig() const;
+};
+
+std::string admissionPolicyName(AdmissionPolicy policy);
+
+#endif // ADMISSION_H
@@ -0,0 +1,190 @@
+#ifndef BATCH_SCHEDULER_H
+#define BATCH_SCHEDULER_H
+
+#include <vector>
+#include <string>
+#include <cstdint>
+#include <climits>
+#include "pcb.h"
+#include "metrics.h"
+
+const long long TIMELINE_END = LLONG_MAX;   // "until forever" for timeline ranges
+
+// free cores over time as a step function: a breakpoint at time t holds the free cores from t up
+// to the next breakpoint, the last one holds on forever. breakpoints live in a treap (index based,
+// recycled nodes) where every subtree knows its smallest and largest free count and carries a
+// pending add, so reserving or releasing cores over a time range is two splits, one add and two
+// merges, O(log n) expected for n breakpoints. breakpoints that no longer change the free count
+// are dropped right away
+class ReservationTimeline {
+private:
+    struct Node {
+        long long time;
+        int free;
+        int low;        // smallest free count in the subtree
+        int high;       // largest free count in the subtree
+        int pending;    // add not pushed to the children yet, already in free / low / high
+        uint32_t priority;
+        int left;
+        int right;
+    };
+
+    std::vector<Node> nodes;
+    std::vector<int> unused;   // recycled node slots
+    int root;
+    int cores;
+    uint32_t rng;
+    mutable uint64_t probes;   // gaps looked at by earliestStart, for the statistics
+
+    int newNode(long long time, int free);
+    void apply(int n, int delta);
+    void push(int n);
+    void update(int n);
+    void split(int n, long long time, int& left, int& right);   // left: time < time
+    int merge(int left, int right);
+    void recycle(int n);
+    void addRange(long long from, long long to, int delta);
+    void ensureBreak(long long time);
+    int edge(int n, bool last, int& value) const;
+    int rangeExtreme(long long from, long long to, bool highest) const;
+    int firstAtLeast(int n, long long after, int needed, int carry) const;
+    int firstBelow(int n, long long after, int needed, int carry) const;
+    int valueAt(int n, long long time, int carry) const;
+
+public:
+    ReservationTimeline(int cores, long long start = 0);
+
+    // take / give back cores over [start, start + duration)
+    void reserve(long long start, long long duration, int count);
+    void release(long long start, long long duration, int count);
+
+    int freeAt(long long time) const;
+
+    // smallest / largest free count over [from, to)
+    int minFree(long long from, long long to = TIMELINE_END) const;
+    int maxFree(long long from, long long to = TIMELINE_END) const;
+
+    // earliest start >= from where count cores stay free for duration ticks, -1 if count is more
+    // than the machine has or no start comes before `before`. every step is O(log n): find the
+    // next breakpoint with enough cores, then the first one after it without; if that is far
+    // enough away the window fits, otherwise the search goes on from there. the number of steps
+    // is the number of too short gaps skipped
+    long long earliestStart(long long from, int count, long long duration, long long before = TIMELINE_END) const;
+
+    // forget everything before time, breakpoints only pile up while they are in the future
+    void advance(long long time);
+
+    size_t size() const;          // breakpoints
+    int getCores() const;
+    uint64_t getProbes() const;
+};
+
+// how queued jobs may overtake each other
+enum class BackfillMode {
+    NONE,          // first come first served, the first job that does not fit holds up the queue
+    EASY,          // only the first waiting job gets a reservation, later jobs start early as long
+                   // as they do not delay it
+    CONSERVATIVE   // every job gets a reservation when it arrives, a job only starts early when it
+                   // delays none of them
+};
+
+// a parallel job: its tasks are started together on cores cores and stop together
+struct BatchJob {
+    int id = 0;
+    int cores = 1;                // requested cores, at least tasks.size()
+    long long submit_time = 0;
+    long long walltime = 1;       // the user's estimate, the job is killed when it runs longer
+    long long runtime = 1;        // what it really needs
+    std::vector<PCB*> tasks;      // processes of the job, may be empty for a job that only has numbers
+
+    // filled in by the scheduler
+    long long start_time = -1;
+    long long end_time = -1;
+    long long reserved_start = -1;   // conservative: current reservation
+    bool backfilled = false;         // started ahead of a job that was queued before it
+    bool killed = false;             // hit its walltime
+};
+
+struct BatchConfig {
+    int cores = 128;
+    BackfillMode backfill = BackfillMode::EASY;
+    // conservative: when a job ends early the first compress_depth waiting jobs look for an earlier
+    // start. later jobs keep their reservations, which are still valid, so no job ever starts later
+    // than it was promised. 0 = every waiting job
+    int compress_depth = 256;
+};
+
+struct BatchStats {
+    long long jobs = 0;
+    long long backfilled = 0;
+    long long killed = 0;
+    long long compressed = 0;       // conservative: reservations moved earlier
+    long long makespan = 0;
+    double utilization = 0;         // core ticks used / (cores * makespan)
+    double mean_slowdown = 0;       // bounded slowdown: (wait + run) / max(run, 10)
+    long long peak_queue = 0;
+    uint64_t timeline_probes = 0;
+    size_t peak_breakpoints = 0;
+};
+
+// batch queue of a cluster: jobs wait until cores cores are free at once, run to completion
+// (or their walltime) and never get preempted. events are arrivals, job ends and, in
+// conservative mode, reservation starts. waiting jobs are indexed by arrival order in a tree
+// that keeps the fewest cores and the shortest walltime of every subtree, so EASY finds the
+// first job that can backfill without scanning the queue
+class BatchScheduler {
+private:
+    struct Event {
+        long long time;
+        int type;        // 0 = job end, 1 = reservation start
+        int job;
+        uint32_t token;  // reservation starts that moved are stale
+    };
+    struct EventLater {
+        bool operator()(const Event& a, const Event& b) const {
+            if (a.time != b.time) return a.time > b.time;
+            return a.job > b.job;
+        }
+    };
+
+    BatchConfig config;
+    std::vector<BatchJob> jobs;          // in submit order after run() starts
+    std::vector<uint32_t> tokens;
+    ReservationTimeline timeline;
+    MetricsCollector metrics;
+    BatchStats stats;
+    long long now;
+    long long coreTicks;
+
+    // queue index over jobs in submit order, leaves of waiting jobs hold (cores, walltime)
+    std::vector<int> queueCores;
+    std::vector<long long> queueWalltime;
+    size_t queueLeaves;
+    long long queued;
+
+    void queuePut(int job, bool waiting);
+    int queueFirst(int after) const;                                  // next waiting job
+    int queueFind(int n, int limitNow, long long window, int limitAlways) const;
+    void start(int job, bool reserved, std::vector<Event>& heap);
+    bool finish(int job);
+    void schedule(std::vector<Event>& heap);
+    void compress(std::vector<Event>& heap);
+
+public:
+    BatchScheduler(const BatchConfig& config);
+
+    // throws invalid_argument when the job asks for more cores than the machine has
+    void submit(const BatchJob& job);
+
+    // simulate until every job has finished
+    void run();
+
+    const std::vector<BatchJob>& getJobs() const;
+    const MetricsCollector& getMetrics() const;   // per job: arrival = submit, burst = run time
+    const BatchStats& getStats() const;
+    const BatchConfig& getConfig() const;
+};
+
+std::string backfillModeName(BackfillMode mode);
+
+#endif // BATCH_SCHEDULER_H
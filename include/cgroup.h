@@ -0,0 +1,177 @@
+#ifndef CGROUP_H
+#define CGROUP_H
+
+#include <set>
+#include <queue>
+#include <vector>
+#include <string>
+#include <cstdint>
+#include <functional>
+#include <unordered_map>
+#include "pcb.h"
+#include "metrics.h"
+#include "scheduling_policy.h"
+
+// limits of one control group
+struct CGroupConfig {
+    int shares = 1024;             // CPU weight against its sibling groups
+    long long quota = 0;           // CPU ticks the group (and the groups below it) may use every
+    long long period = 100;        // period, 0 = no limit. once it is used up the group is throttled
+                                   // until the period ends, even when the CPU has nothing else to do
+    long long memory_limit = 0;    // MB for the group and the groups below it, 0 = no limit.
+                                   // paged memory: resident pages, the group reclaims its own pages.
+                                   // other models: allocated memory, over it the biggest process of
+                                   // the group is OOM-killed
+};
+
+// per group counters, a group counts everything the groups below it do
+struct CGroupStats {
+    long long cpu_time = 0;         // ticks its processes ran
+    long long dispatches = 0;
+    long long total_latency = 0;    // ticks between becoming ready and getting the CPU
+    long long max_latency = 0;
+    long long throttled = 0;        // periods it used up its quota in
+    long long throttled_time = 0;   // ticks it spent throttled
+    long long memory = 0;           // MB allocated by its processes right now
+    long long memory_peak = 0;
+    long long oom_kills = 0;        // processes killed because this group went over its limit
+    long long charge_failures = 0;  // allocations turned down by its limit
+};
+
+// tree of control groups, like cgroups in Linux. group 0 is the root, every process is in
+// the root until it is attached somewhere else (PCB::cgroup). the tree holds the settings,
+// the memory charges and the per group numbers, CGroupPolicy does the CPU side and
+// MemoryManager::set_control_groups the memory side. none of it is part of a snapshot
+class ControlGroups {
+private:
+    struct Group {
+        std::string name;
+        int parent;
+        std::vector<int> children;
+        CGroupConfig config;
+        CGroupStats stats;
+        MetricsCollector metrics;
+        std::set<std::pair<long long, int>> killable;   // (MB, pid) of its processes, biggest last
+    };
+    struct Member {
+        int group;
+        PCB* process;      // nullptr when it was only charged, never attached
+        long long charged;
+        bool dying;        // OOM-killed, its memory is not back yet
+    };
+
+    std::vector<Group> groups;
+    std::unordered_map<int, Member> members;
+    std::function<bool(PCB*)> oomHandler;
+
+    int overLimit(int group, long long mb) const;
+    void addCharge(int group, long long mb);
+    bool oomKill(int group);
+
+public:
+    ControlGroups();
+
+    // new group below parent, returns its id. throws invalid_argument for an unknown parent
+    int create(const std::string& name, int parent = 0, const CGroupConfig& config = CGroupConfig());
+    void setConfig(int group, const CGroupConfig& config);
+
+    // move a process into a group, the memory it already has moves with it
+    void attach(PCB* p, int group);
+    int groupOf(int pid) const;
+
+    // charge mb to the group of pid and every group above it. with enforce a charge over a
+    // limit OOM-kills the biggest process below the group that is over and tries once more,
+    // false when it still does not fit. the memory of a killed process only comes back when
+    // it has exited, which for a process waiting for the CPU is the next time it is picked
+    bool charge(int pid, long long mb, bool enforce = true);
+    void uncharge(int pid, long long mb);
+
+    // the process is gone: its memory is given back and it leaves its group
+    void detach(int pid);
+
+    // how the OOM killer kills, true when the process is on its way out
+    void setOomHandler(std::function<bool(PCB*)> handler);
+
+    // accounting, called by the scheduler and CGroupPolicy
+    void recordDispatch(const PCB* p, long long now);
+    void recordRun(const PCB* p, long long ticks);
+    void recordThrottle(int group, long long ticks);
+    void recordCompletion(const PCB* p, long long now);
+
+    size_t size() const;
+    int getParent(int group) const;
+    const std::string& getName(int group) const;
+    std::string path(int group) const;   // "/tenants/a"
+    const CGroupConfig& getConfig(int group) const;
+    const CGroupStats& getStats(int group) const;
+    const MetricsCollector& getMetrics(int group) const;   // completions, response and busy time
+    void print() const;
+};
+
+// fair share scheduling over the group tree, CFS at every level: each group keeps its ready
+// processes and its child groups with ready processes in a red-black tree (std::set) keyed by
+// virtual runtime. a pick walks down from the root taking the leftmost entry of every level,
+// O(log n) per level, and CPU time is charged to the process and every group above it scaled
+// by their weights (priority for processes, shares for groups).
+//
+// a group that used up its quota leaves its parent's tree until its period ends. when every
+// ready process is throttled pickNext returns nullptr and heldUntil says when to ask again.
+// the policy cannot be snapshotted
+class CGroupPolicy : public SchedulingPolicy {
+private:
+    struct Entry {
+        long long key;
+        uint64_t seq;
+        PCB* process;   // nullptr for a child group
+        int group;
+    };
+    struct CompareEntry {
+        bool operator()(const Entry& a, const Entry& b) const {
+            if (a.key != b.key) return a.key < b.key;
+            return a.seq < b.seq;
+        }
+    };
+    struct GroupState {
+        std::set<Entry, CompareEntry> queue;
+        long long minVruntime = 0;
+        long long queuedWeight = 0;
+        long long vruntime = 0;      // in its parent's queue
+        long long remainder = 0;     // of the last charge, in 1/shares ticks
+        bool queued = false;
+        Entry entry;                 // its entry in the parent's queue while queued
+        bool throttled = false;
+        long long throttledAt = 0;
+        long long used = 0;          // quota used in the current period
+        long long periodStart = 0;
+    };
+
+    ControlGroups* groups;
+    std::vector<GroupState> state;
+    std::priority_queue<std::pair<long long, int>, std::vector<std::pair<long long, int>>,
+                        std::greater<std::pair<long long, int>>> unthrottle;   // (period end, group)
+    uint64_t next_seq;
+    size_t count;
+    int latency;
+    int minGranularity;
+    long long pickedAt;   // when the running process was picked
+
+    int groupFor(const PCB* p);
+    void activate(int group);
+    void deactivate(int group);
+    void charge(int group, long long ticks);
+    void rollPeriod(int group, long long now);
+    void refill(long long now);
+
+public:
+    CGroupPolicy(ControlGroups* groups, const PolicyParams& params = PolicyParams());
+    void enqueue(PCB* p, long long now) override;
+    PCB* pickNext(long long now) override;
+    bool empty() const override;
+    size_t size() const override;
+    int timeSlice(const PCB* p) const override;
+    void onDescheduled(PCB* p, int ran, bool sliceExpired) override;
+    long long heldUntil() const override;
+    std::string name() const override;
+};
+
+#endif // CGROUP_H
@@ -0,0 +1,230 @@
+#ifndef CONTIGUOUS_ALLOCATOR_H
+#define CONTIGUOUS_ALLOCATOR_H
+
+#include <vector>
+#include <set>
+#include <map>
+#include <string>
+#include <memory>
+#include <cstdint>
+#include <unordered_map>
+
+class SnapshotWriter;
+class SnapshotReader;
+
+// numbers describing how well an allocator uses its address space
+struct AllocatorStats {
+    long long total;            // size of the address space
+    long long allocated;        // space handed out in blocks (incl. rounding)
+    long long requested;        // space callers actually asked for
+    long long free_space;       // space not in any block
+    long long largest_free;     // biggest single free block
+    size_t free_blocks;         // number of free blocks
+    size_t live_blocks;         // number of allocated blocks
+    double external_fragmentation;  // 1 - largest_free / free_space
+    double internal_fragmentation;  // (allocated - requested) / allocated
+    uint64_t allocations;
+    uint64_t failures;
+    uint64_t frees;
+    double avg_alloc_ns;        // mean real time spent inside allocate()
+};
+
+// base class for the contiguous allocators
+// allocate() wraps the real work so every allocator gets latency and count tracking
+class ContiguousAllocator {
+protected:
+    long long totalSize;
+    long long allocatedSize;
+    long long requestedSize;
+    uint64_t allocCount;
+    uint64_t failCount;
+    uint64_t freeCount;
+    double allocNanos;
+
+    // real work, returns the block address or -1, blockSize is set to what was handed out
+    virtual long long doAllocate(long long size, long long& blockSize) = 0;
+    // returns the size of the freed block and the size that was requested for it, or -1
+    virtual long long doRelease(long long address, long long& requested) = 0;
+
+    // counters of the base class, for the subclasses' saveState / loadState
+    void saveCounters(SnapshotWriter& out) const;
+    void loadCounters(SnapshotReader& in);
+
+public:
+    ContiguousAllocator(long long totalSize);
+    virtual ~ContiguousAllocator() {}
+
+    // returns start address of the block or -1 when nothing fits
+    long long allocate(long long size);
+    void release(long long address);
+
+    // usable address space, the biggest block an empty allocator can hand out. buddy: the
+    // power of two arena, the tail of totalSize beyond it is never used
+    long long capacity() const { return totalSize; }
+
+    virtual long long largestFree() const = 0;
+    virtual long long freeSpace() const = 0;
+    virtual size_t freeBlockCount() const = 0;
+    virtual size_t liveBlockCount() const = 0;
+    virtual std::string name() const = 0;
+
+    // slide live blocks together, moves gets (old address, new address) pairs
+    // returns how much memory was copied, 0 if the allocator cannot compact
+    virtual long long compact(std::vector<std::pair<long long, long long>>& moves) { return 0; }
+
+    AllocatorStats stats() const;
+
+    // loading expects an allocator built with the same configuration
+    virtual void saveState(SnapshotWriter& out) const = 0;
+    virtual void loadState(SnapshotReader& in) = 0;
+};
+
+// free blocks ordered by address, every node also knows the biggest block in its subtree.
+// that lets first fit / next fit find the lowest address block that is big enough in O(log n)
+// without scanning the free list. implemented as a treap.
+class AddressTree {
+private:
+    struct Node {
+        long long address;
+        long long size;
+        long long maxSize;   // max size in this subtree
+        uint32_t priority;
+        int left;
+        int right;
+    };
+
+    std::vector<Node> nodes;
+    std::vector<int> freeNodes;
+    int root;
+    uint32_t seed;
+
+    uint32_t nextPriority();
+    void update(int t);
+    void split(int t, long long address, int& left, int& right);   // left < address <= right
+    int merge(int a, int b);
+    int findFit(int t, long long size, long long from) const;
+
+public:
+    AddressTree();
+
+    void insert(long long address, long long size);
+    void erase(long long address);
+    void clear();
+
+    // block with the highest address below address, returns false if none
+    bool predecessor(long long address, long long& outAddress, long long& outSize) const;
+    // block starting exactly at address
+    bool find(long long address, long long& outSize) const;
+
+    // lowest address >= from whose block holds size, returns -1 if none
+    long long firstFit(long long size, long long from = 0) const;
+
+    void saveState(SnapshotWriter& out) const;
+    void loadState(SnapshotReader& in);
+};
+
+// first / best / worst / next fit strategies for the free list allocator
+enum class FitStrategy { FIRST_FIT, BEST_FIT, WORST_FIT, NEXT_FIT };
+
+// classic variable partition allocator
+// free blocks are indexed two ways: by address (AddressTree, for first/next fit and coalescing)
+// and by size (ordered set, for best/worst fit). all lookups are O(log n).
+class FreeListAllocator : public ContiguousAllocator {
+private:
+    struct Block {
+        long long size;
+        long long requested;
+    };
+
+    FitStrategy strategy;
+    AddressTree byAddress;
+    std::set<std::pair<long long, long long>> bySize;   // (size, address)
+    std::map<long long, Block> live;                    // address -> block
+    long long freeTotal;
+    long long nextFitCursor;
+
+    void addFree(long long address, long long size);
+    void removeFree(long long address, long long size);
+
+protected:
+    long long doAllocate(long long size, long long& blockSize) override;
+    long long doRelease(long long address, long long& requested) override;
+
+public:
+    FreeListAllocator(long long totalSize, FitStrategy strategy);
+
+    long long largestFree() const override;
+    long long freeSpace() const override;
+    size_t freeBlockCount() const override;
+    size_t liveBlockCount() const override;
+    std::string name() const override;
+    void saveState(SnapshotWriter& out) const override;
+    void loadState(SnapshotReader& in) override;
+    long long compact(std::vector<std::pair<long long, long long>>& moves) override;
+};
+
+// binary buddy allocator, blocks are powers of two times minBlock
+class BuddyAllocator : public ContiguousAllocator {
+private:
+    long long minBlock;
+    int maxOrder;
+    std::vector<std::set<long long>> freeLists;          // one per order
+    std::unordered_map<long long, std::pair<int, long long>> live;   // address -> (order, requested)
+    long long freeTotal;
+
+    int orderFor(long long size) const;
+
+protected:
+    long long doAllocate(long long size, long long& blockSize) override;
+    long long doRelease(long long address, long long& requested) override;
+
+public:
+    BuddyAllocator(long long totalSize, long long minBlock = 1);
+
+    long long largestFree() const override;
+    long long freeSpace() const override;
+    size_t freeBlockCount() const override;
+    size_t liveBlockCount() const override;
+    std::string name() const override;
+    void saveState(SnapshotWriter& out) const override;
+    void loadState(SnapshotReader& in) override;
+};
+
+// slab allocator for fixed size classes
+// every class carves slabs (objectsPerSlab objects) out of a best fit backing allocator,
+// requests bigger than the largest class go straight to the backing allocator
+class SlabAllocator : public ContiguousAllocator {
+private:
+    struct Slab {
+        long long base;
+        int sizeClass;
+        std::vector<int> freeObjects;   // stack of free object indexes
+        int used;
+    };
+
+    std::vector<long long> classSizes;
+    int objectsPerSlab;
+    FreeListAllocator backing;
+    std::vector<Slab> slabs;
+    std::vector<int> freeSlabIds;
+    std::vector<std::set<int>> partialSlabs;                   // per class, slabs with free objects
+    std::unordered_map<long long, std::pair<int, long long>> liveObjects;   // address -> (slab, requested), slab -1 = large
+    std::unordered_map<long long, long long> largeBlocks;      // address -> block size
+
+protected:
+    long long doAllocate(long long size, long long& blockSize) override;
+    long long doRelease(long long address, long long& requested) override;
+
+public:
+    SlabAllocator(long long totalSize, const std::vector<long long>& classSizes, int objectsPerSlab = 8);
+
+    long long largestFree() const override;
+    long long freeSpace() const override;
+    size_t freeBlockCount() const override;
+    size_t liveBlockCount() const override;
+    std::string name() const override;
+    void saveState(SnapshotWriter& out) const override;
+    void loadState(SnapshotReader& in) override;
+};
+
+#endif // CONTIGUOUS_ALLOCATOR_H
@@ -0,0 +1,160 @@
+#ifndef DEADLOCK_H
+#define DEADLOCK_H
+
+#include <vector>
+#include <set>
+#include <string>
+#include <cstdint>
+#include <unordered_map>
+#include <unordered_set>
+
+// how the multi resource manager deals with deadlocks
+enum class DeadlockMode {
+    NONE,     // grant whatever is free, deadlocks are never noticed
+    DETECT,   // incremental wait-for graph, deadlocked processes are picked as victims to abort
+    AVOID     // Banker's algorithm, a request is only granted if the state stays safe
+};
+
+enum class RequestResult { GRANTED, WAITING, DENIED };
+
+struct DeadlockStats {
+    long long requests = 0;
+    long long grants = 0;
+    long long waits = 0;
+    long long unsafe_delays = 0;    // avoid: instances were free but granting was unsafe
+    long long cycle_checks = 0;     // detect: wait-for graph searches
+    long long deadlocks = 0;        // detect: deadlocks confirmed
+    long long safety_checks = 0;    // avoid: full Banker's safety checks (fast path excluded)
+    long long fast_safe = 0;        // avoid: requests proven safe by the O(R) fast path
+    double safety_ns = 0;           // avoid: real time spent in full safety checks
+};
+
+// resources with several types and several instances per type (classic Banker's setting)
+//
+// processes register with their maximum claim per type, then request and release instances.
+// a request that cannot be granted makes the process wait, waiting requests are retried in
+// FIFO order whenever instances come back.
+//
+// detect: the wait-for graph (waiter -> every holder of the type it waits for) is updated on
+// each acquire, release and wait instead of being rebuilt. a new wait only searches from the
+// new waiter, and a cycle is confirmed with the multi-instance reduction algorithm, because
+// with several instances a cycle alone does not mean deadlock.
+//
+// avoid: the safety check keeps, per resource type, the processes ordered by remaining need.
+// work only grows during the check, so every index is walked once with a cursor and a
+// process can finish when all of its non zero needs have been passed: O(P*R) at worst
+// instead of the textbook O(P*P*R). requests that let the requester finish right away are
+// safe without any search.
+class MultiResourceManager {
+private:
+    struct ProcessEntry {
+        int pid = 0;
+        bool live = false;
+        std::vector<int> alloc;       // per type
+        std::vector<int> maxClaim;    // per type
+        std::vector<int> held;        // types with alloc > 0
+        int needNonZero = 0;          // types with maxClaim - alloc > 0
+        int waitResource = -1;        // type of the pending request, -1 = not waiting
+        int waitCount = 0;
+    };
+
+    DeadlockMode mode;
+    int resourceTypes;
+    std::vector<int> total;
+    std::vector<int> available;
+
+    std::vector<ProcessEntry> procs;
+    std::unordered_map<int, int> slotOf;   // pid -> slot
+    std::vector<int> freeSlots;
+    int liveCount;
+
+    std::vector<std::set<std::pair<int, int>>> needIndex;   // per type (need, slot), need > 0
+    std::vector<std::unordered_set<int>> holders;           // per type, slots holding instances
+    std::vector<std::vector<int>> waitersOn;                // per type, waiting slots
+    std::vector<int> waitQueue;                             // all waiting slots, FIFO
+    std::vector<std::unordered_set<int>> waitFor;           // detect: slot -> slots it waits for
+    std::vector<int> victims;
+    DeadlockStats counters;
+
+    // scratch space reused by the checks
+    std::vector<int> work;
+    std::vector<int> satisfied;
+    std::vector<int> ready;
+    std::vector<uint32_t> visitMark;
+    uint32_t visitStamp;
+
+    void setAlloc(int slot, int resource, int value);
+    bool tryGrant(int slot, int resource, int count);
+    bool safeAfterGrant(int slot);
+    void startWaiting(int slot, int resource, int count);
+    void stopWaiting(int slot);
+    bool reachable(int from, int target);
+    void checkDeadlock(int slot);
+    std::vector<int> reduce(const std::vector<int>& gone);
+    std::vector<int> wakeWaiters();
+
+public:
+    MultiResourceManager(const std::vector<int>& instances, DeadlockMode mode);
+
+    // maxClaim has one entry per type (missing entries count as 0), false if pid exists
+    bool addProcess(int pid, const std::vector<int>& maxClaim);
+
+    // GRANTED, WAITING (process must wait for a wake up) or DENIED (over its claim, unknown
+    // pid or type, already waiting)
+    RequestResult request(int pid, int resource, int count);
+
+    // give instances back, returns pids whose waiting request was granted because of it
+    std::vector<int> release(int pid, int resource, int count);
+
+    // process exits or is aborted: everything it holds goes back
+    std::vector<int> removeProcess(int pid);
+
+    // detect: deadlocked processes chosen for abort since the last call
+    std::vector<int> takeVictims();
+
+    // Banker's safety check of the current state
+    bool isSafe();
+
+    // multi-instance deadlock detection (reduction), returns the deadlocked pids
+    std::vector<int> findDeadlocked();
+
+    bool isWaiting(int pid) const;
+    int allocated(int pid, int resource) const;
+    int totalInstances(int resource) const;
+    int availableInstances(int resource) const;
+    int processCount() const;
+    int resourceCount() const;
+    DeadlockMode getMode() const;
+    const DeadlockStats& stats() const;
+};
+
+const char* deadlockModeName(DeadlockMode mode);
+
+// synthetic workload to compare the modes: every process claims a few resource types,
+// acquires them a few instances at a time, holds them and then releases everything
+struct DeadlockWorkload {
+    int processes = 300;
+    int concurrency = 16;        // processes active at the same time
+    int resources = 12;          // resource types
+    int max_instances = 4;       // instances per type are 1..max_instances
+    int claims_per_process = 3;  // types each process needs
+    int hold_ticks = 4;          // work done while holding everything
+    int stall_limit = 500;       // ticks without progress before a run counts as deadlocked
+    uint64_t seed = 7;
+};
+
+struct DeadlockRunResult {
+    DeadlockMode mode;
+    long long completed = 0;
+    long long ticks = 0;
+    long long aborts = 0;        // detect: victims restarted
+    bool stalled = false;        // none: the run deadlocked for good
+    double throughput = 0;       // completed per 100 ticks
+    double wall_seconds = 0;
+    DeadlockStats stats;
+};
+
+DeadlockRunResult runDeadlockWorkload(const DeadlockWorkload& workload, DeadlockMode mode);
+void printDeadlockTable(const std::vector<DeadlockRunResult>& results);
+
+#endif // DEADLOCK_H
@@ -0,0 +1,68 @@
+#ifndef EVENT_QUEUE_H
+#define EVENT_QUEUE_H
+
+#include <vector>
+#include "pcb.h"
+
+class SnapshotWriter;
+class SnapshotReader;
+
+// kinds of things that can happen in the simulation
+// the scheduler jumps from one event to the next instead of stepping every tick
+enum class EventType {
+    ARRIVAL,            // process enters the system
+    BURST_COMPLETE,     // running process finished its CPU burst
+    QUANTUM_EXPIRE,     // running process used up its time slice
+    RESOURCE_RELEASE,   // process gives back the resource it was holding
+    IO_COMPLETE,        // I/O request finished, process can run again
+    DEVICE_COMPLETE,    // I/O device finished a batch, token = device index
+    RELEASE,            // real-time task releases its next job
+    TIMER               // the policy held processes back (SchedulingPolicy::heldUntil), pick again
+};
+
+// a single scheduled event
+struct Event {
+    long long time;          // simulated time when event fires
+    EventType type;          // what kind of event it is
+    PCB* process;            // process the event belongs to
+    long long token;         // used to ignore stale completion events after preemption
+    unsigned long long seq;  // insertion order, keeps events at same time in FIFO order
+};
+
+// time ordered event queue (binary min-heap on time, then insertion order)
+// push and pop are O(log n), peeking the next event is O(1)
+class EventQueue {
+private:
+    std::vector<Event> heap;       // heap storage
+    unsigned long long next_seq;   // counter for tie breaking
+
+    // heap helpers
+    bool earlier(const Event& a, const Event& b) const;
+    void sift_up(size_t index);
+    void sift_down(size_t index);
+
+public:
+    EventQueue();
+
+    // schedule a new event
+    void push(long long time, EventType type, PCB* process, long long token = 0);
+
+    // look at / remove the earliest event
+    const Event& top() const;
+    Event pop();
+
+    bool empty() const;
+    size_t size() const;
+
+    // drop every pending event
+    void clear();
+
+    // reserve heap space up front when the number of events is known
+    void reserve(size_t n);
+
+    // heap layout and tie breaking counter, a restored queue pops in the same order
+    void save_state(SnapshotWriter& out) const;
+    void load_state(SnapshotReader& in);
+};
+
+#endif // EVENT_QUEUE_H
@@ -0,0 +1,117 @@
+#ifndef EVENT_TRACE_H
+#define EVENT_TRACE_H
+
+#include <string>
+#include <vector>
+#include <atomic>
+#include <cstdint>
+#include <iostream>
+
+// structured binary event log
+//
+// every state change is written as a fixed size record into a ring buffer owned by the
+// thread that made the change (single producer, single consumer, no locks), a background
+// writer thread drains all rings into one file. nothing is formatted or printed while the
+// simulation runs - decodeEventLog() turns the file into text or Chrome trace JSON afterwards.
+//
+// building with -DOS_SIM_NO_TRACE (make TRACE=0) removes every trace point completely
+
+// how much gets recorded, every level includes the ones above it
+enum class TraceLevel {
+    OFF = 0,
+    LIFECYCLE = 1,   // arrival, termination
+    SCHEDULING = 2,  // dispatch, preemption, quantum expiry, blocking, I/O, migration, starvation
+    DETAIL = 3       // ready queue inserts, resource grants and releases
+};
+
+enum class TraceEventKind : uint16_t {
+    ARRIVAL,
+    READY,
+    DISPATCH,
+    PREEMPT,
+    QUANTUM_EXPIRE,
+    BLOCK,
+    UNBLOCK,
+    RESOURCE_ACQUIRE,
+    RESOURCE_RELEASE,
+    IO_START,
+    IO_COMPLETE,
+    TERMINATE,
+    IDLE,
+    MIGRATE,
+    STEAL,
+    STARVATION,       // arg = ticks the process has been waiting
+    PRIORITY_BOOST,   // arg = processes that were waiting below the top level
+    FORK,             // pid = new child, arg = parent pid (0 = init)
+    REAP,             // pid = reaped child, arg = its exit code
+    KIND_COUNT
+};
+
+// one record on disk, 32 bytes
+struct TraceEventRecord {
+    int64_t time;       // simulated time
+    uint64_t wall_ns;   // real time since the tracer started
+    int32_t pid;
+    int32_t arg;        // kind specific: resource id, I/O ticks, source core ...
+    uint16_t kind;      // TraceEventKind
+    uint16_t core;      // simulated core, 0 for the single core scheduler
+    uint16_t thread;    // ring the record came from
+    uint16_t reserved;
+};
+
+struct TraceConfig {
+    std::string path = "os_simulator.evlog";
+    TraceLevel level = TraceLevel::SCHEDULING;
+    size_t ring_capacity = 1 << 16;   // records per thread, rounded up to a power of two
+    int flush_interval_ms = 2;        // writer sleeps this long when every ring is empty
+};
+
+// process wide tracer, the rings and the writer thread live in event_trace.cpp
+class EventTracer {
+private:
+    static std::atomic<int> currentLevel;
+
+public:
+    // opens the log file and starts the writer, false if the file cannot be created
+    static bool start(const TraceConfig& config);
+
+    // drains every ring, stops the writer and closes the file
+    static void stop();
+
+    static void setLevel(TraceLevel level);
+    static TraceLevel getLevel();
+
+    // cheap check done before building a record
+    static inline bool enabled(TraceLevel level) {
+        return (int)level <= currentLevel.load(std::memory_order_relaxed);
+    }
+
+    static void record(TraceEventKind kind, long long time, int pid, int arg, int core);
+
+    static uint64_t recordsWritten();
+    static const char* kindName(TraceEventKind kind);
+};
+
+#ifdef OS_SIM_NO_TRACE
+#define TRACE_EVENT(level, kind, time, pid, arg, core) ((void)0)
+#else
+#define TRACE_EVENT(level, kind, time, pid, arg, core)                               \
+    do {                                                                            \
+        if (EventTracer::enabled(level)) {                                          \
+            EventTracer::record((kind), (long long)(time), (int)(pid), (int)(arg), (int)(core)); \
+        }                                                                           \
+    } while (0)
+#endif
+
+// offline decoding of a log written by EventTracer
+enum class TraceOutput { TEXT, CHROME_JSON };
+
+// reads every record of a log file, false if it is not an event log
+bool readEventLog(const std::string& path, std::vector<TraceEventRecord>& records);
+
+// text: one line per event in real time order
+// chrome: trace event JSON for chrome://tracing or Perfetto, one track per simulated core,
+//         every time slice is a box named after the process
+bool decodeEventLog(const std::string& path, std::ostream& out, TraceOutput format);
+
+#endif // EVENT_TRACE_H
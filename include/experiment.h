@@ -0,0 +1,91 @@
+#ifndef EXPERIMENT_H
+#define EXPERIMENT_H
+
+#include <vector>
+#include <string>
+#include <functional>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <queue>
+#include "pcb.h"
+#include "metrics.h"
+#include "scheduling_policy.h"
+#include "memory_manager.h"
+
+// fixed size pool of worker threads
+class ThreadPool {
+private:
+    std::vector<std::thread> workers;
+    std::queue<std::function<void()>> tasks;
+    std::mutex lock;
+    std::condition_variable taskReady;
+    std::condition_variable allDone;
+    int running;     // tasks currently executing
+    bool stopping;
+
+    void workerLoop();
+
+public:
+    // threads <= 0 means one per hardware thread
+    ThreadPool(int threads = 0);
+    ~ThreadPool();
+
+    void submit(std::function<void()> task);
+
+    // block until every submitted task has finished
+    void wait();
+
+    int size() const;
+};
+
+// one scheduler configuration to try
+struct ExperimentConfig {
+    std::string label;    // name shown in the result table
+    std::string policy;   // name understood by createPolicy()
+    PolicyParams params;
+    MemoryConfig memory;  // memory model of this run
+};
+
+// outcome of one configuration
+struct ExperimentResult {
+    ExperimentConfig config;
+    MetricsSummary summary;
+    int rejected;          // processes that did not fit in memory
+    uint64_t page_faults;  // paged memory only
+    double wall_seconds;   // real time the run took
+};
+
+// runs every configuration on the same workload, each one completely isolated:
+// its own memory manager, process queues, scheduler and PCB copies.
+// runs execute in parallel on a thread pool, results come back in the order the
+// configurations were added, so the table is the same no matter how many threads run.
+class ExperimentRunner {
+private:
+    std::vector<ExperimentConfig> configs;
+    int threads;
+    MemoryConfig defaultMemory;   // used by configurations added by name
+
+    ExperimentResult runOne(const ExperimentConfig& config, const std::vector<PCB>& workload) const;
+
+public:
+    ExperimentRunner(int threads = 0, const MemoryConfig& memory = MemoryConfig());
+
+    void addConfig(const ExperimentConfig& config);
+    void addConfig(const std::string& label, const std::string& policy, const PolicyParams& params = PolicyParams());
+
+    // one configuration per value of a parameter
+    // parameter is one of: quantum, levels, base_quantum, latency, granularity,
+    // memory (physical MB, to measure overcommit)
+    void addSweep(const std::string& policy, const std::string& parameter,
+                  const std::vector<int>& values, const PolicyParams& base = PolicyParams());
+
+    size_t configCount() const;
+
+    std::vector<ExperimentResult> run(const std::vector<PCB>& workload) const;
+
+    // print all results as one comparison table
+    static void printTable(const std::vector<ExperimentResult>& results);
+};
+
+#endif // EXPERIMENT_H
@@ -0,0 +1,165 @@
+#ifndef IO_DEVICE_H
+#define IO_DEVICE_H
+
+#include <deque>
+#include <memory>
+#include <map>
+#include <vector>
+#include <string>
+#include <cstdint>
+#include <unordered_map>
+#include "pcb.h"
+#include "metrics.h"
+
+class SnapshotWriter;
+class SnapshotReader;
+
+// one I/O phase of a process sent to a device
+struct IoRequest {
+    PCB* process;
+    long long issued;   // time the request was made
+    long long block;    // first block touched
+    int blocks;         // size, the length of the I/O phase
+};
+
+struct IoDeviceStats {
+    uint64_t requests = 0;
+    uint64_t merged = 0;         // requests that joined an adjacent pending request
+    uint64_t services = 0;       // times the device started working (one batch each)
+    uint64_t batched = 0;        // requests served on top of the first one of a batch
+    long long busy_time = 0;     // ticks spent serving
+    long long seek_distance = 0; // disk: cylinders travelled by the head
+    size_t max_queue = 0;        // most requests pending at once
+    QuantileSketch response;     // ticks from issue to completion
+};
+
+// a device with its own request queue, serving one batch of requests at a time.
+// the scheduler submits requests, starts the device when it is idle and gets the
+// finished requests back when the completion event of the batch fires
+class IODevice {
+protected:
+    std::string name;
+    IoDeviceStats stats;
+    std::vector<IoRequest> inService;   // batch being served right now
+    bool serving;
+
+    // queue a request (may merge it into a pending one)
+    virtual void enqueue(const IoRequest& r) = 0;
+
+    // move the next batch into batch, returns how long serving it takes
+    virtual long long nextBatch(std::vector<IoRequest>& batch) = 0;
+
+    // name, stats and the batch in service, for the subclasses' saveState / loadState
+    void saveBase(SnapshotWriter& out) const;
+    void loadBase(SnapshotReader& in);
+
+public:
+    IODevice(const std::string& name);
+    virtual ~IODevice() {}
+
+    void submit(const IoRequest& r);
+
+    // starts the next batch if the device is idle and work is queued,
+    // returns the completion time or -1 when nothing was started
+    long long start(long long now);
+
+    // the batch in service finished, its requests are appended to done
+    void complete(long long now, std::vector<IoRequest>& done);
+
+    bool busy() const;
+    virtual size_t pending() const = 0;
+
+    // block a process starts at when it never did I/O on this device before
+    virtual long long homeBlock(int pid) const;
+
+    const std::string& getName() const;
+    const IoDeviceStats& getStats() const;
+    virtual std::string describe() const = 0;
+
+    // starts with a tag for loadDevice(), then the base and the device's own state
+    virtual void saveState(SnapshotWriter& out) const = 0;
+    virtual void loadState(SnapshotReader& in) = 0;
+};
+
+// terminal, network card ...: FCFS, fixed latency plus a cost per block
+class FixedLatencyDevice : public IODevice {
+private:
+    int latency;
+    double perBlock;
+    std::deque<IoRequest> queue;
+
+protected:
+    void enqueue(const IoRequest& r) override;
+    long long nextBatch(std::vector<IoRequest>& batch) override;
+
+public:
+    FixedLatencyDevice(const std::string& name, int latency, double perBlock);
+    size_t pending() const override;
+    std::string describe() const override;
+    void saveState(SnapshotWriter& out) const override;
+    void loadState(SnapshotReader& in) override;
+};
+
+enum class DiskScheduling { FCFS, SSTF, SCAN, C_SCAN, LOOK };
+
+struct DiskConfig {
+    int cylinders = 1000;
+    int blocks_per_cylinder = 64;
+    double seek_base = 1.0;          // ticks to start any seek
+    double seek_per_cylinder = 0.02; // ticks per cylinder travelled
+    double rotation = 2.0;           // average rotational delay per service
+    double transfer_per_block = 0.25;
+    DiskScheduling scheduling = DiskScheduling::SSTF;
+    bool merge = true;               // join requests for adjacent blocks into one
+    int max_batch = 8;               // requests on one cylinder served in a single visit
+};
+
+// moving head disk. pending requests are kept ordered by cylinder, so SSTF, SCAN, C-SCAN
+// and LOOK find their next request in O(log n); adjacent block ranges are found through
+// hash maps on their first and last block, so merging is O(1)
+class DiskDevice : public IODevice {
+private:
+    struct DiskRequest {
+        long long first;      // first block
+        long long end;        // one past the last block
+        int cylinder;
+        uint64_t seq;
+        std::vector<IoRequest> requests;
+    };
+    typedef std::pair<int, uint64_t> Key;   // (cylinder, arrival order)
+
+    DiskConfig config;
+    long long totalBlocks;
+    int head;
+    bool movingUp;
+    uint64_t nextSeq;
+    size_t queued;                          // requests pending, merged ones included
+    std::map<Key, DiskRequest> byCylinder;
+    std::deque<Key> fifo;                   // FCFS order, keys of served requests are skipped
+    std::unordered_map<long long, Key> byFirst;
+    std::unordered_map<long long, Key> byEnd;
+
+    std::map<Key, DiskRequest>::iterator pick(long long& distance);
+    int cylinderOf(long long block) const;
+    void unlink(std::map<Key, DiskRequest>::iterator it);
+
+protected:
+    void enqueue(const IoRequest& r) override;
+    long long nextBatch(std::vector<IoRequest>& batch) override;
+
+public:
+    DiskDevice(const std::string& name, const DiskConfig& config = DiskConfig());
+    size_t pending() const override;
+    long long homeBlock(int pid) const override;
+    int getHead() const;
+    std::string describe() const override;
+    void saveState(SnapshotWriter& out) const override;
+    void loadState(SnapshotReader& in) override;
+};
+
+const char* diskSchedulingName(DiskScheduling scheduling);
+
+// rebuilds a device written by IODevice::saveState
+std::unique_ptr<IODevice> loadDevice(SnapshotReader& in);
+
+#endif // IO_DEVICE_H
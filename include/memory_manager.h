@@ -2,29 +2,127 @@
 #define MEMORY_MANAGER_H
 
 #include <iostream>
+#include <memory>
+#include <vector>
+#include <unordered_map>
+#include <functional>
+#include "virtual_memory.h"
+#include "contiguous_allocator.h"
+
+class SnapshotWriter;
+class SnapshotReader;
+class ControlGroups;
+
+// how memory is modelled
+enum class MemoryModel {
+    COUNTER,   // just total / used counters, admission fails when full
+    PAGED,     // demand paging with a swap area, admission only fails when RAM + swap is full
+    // contiguous placement, every process gets one block of physical memory
+    FIRST_FIT,
+    BEST_FIT,
+    WORST_FIT,
+    NEXT_FIT,
+    BUDDY,
+    SLAB
+};
+
+// settings for the memory manager, sizes are in MB
+struct MemoryConfig {
+    MemoryModel model = MemoryModel::COUNTER;
+    int total = 1024;              // physical memory
+    int page_size = 4;             // paged: size of one page / frame
+    int swap_size = 4096;          // paged: size of the swap area
+    ReplacementPolicy replacement = ReplacementPolicy::LRU;
+    int ws_window = 50;            // paged: working set window in ticks
+    int references_per_dispatch = 8;  // paged: page references a process makes each time it runs
+    int fault_cost = 2;            // paged: ticks a process stalls for every page fault
+    bool compaction = false;       // fit models: compact when a request fails only because of fragmentation
+    int buddy_min_block = 1;       // buddy: smallest block size
+    std::vector<long long> slab_classes = {8, 16, 32, 64};  // slab: object size classes
+    int slab_objects = 8;          // slab: objects per slab
+};
 
 // Memory manager class to handle process memory allocation and deallocation
-// Simple implementation that tracks total and used memory
+// Simple implementation that tracks total and used memory, optionally backed by paged virtual memory
 class MemoryManager {
 private:
     int total_memory;  // total system memory available
     int used_memory;   // currently allocated memory
+    MemoryConfig config;
+    std::unique_ptr<VirtualMemory> vm;  // only in paged mode
+    std::unique_ptr<ContiguousAllocator> allocator;  // only in the contiguous models
+    std::unordered_map<int, long long> addresses;    // pid -> block address
+    int compactions;
+    long long compacted_memory;   // total MB moved by compaction
+    std::function<void()> release_handler;
+    long long wake_threshold;     // release_handler only runs once this much can be admitted
+    ControlGroups* groups;        // per group memory limits, nullptr = none
+
+    bool place_process(int pid, int mem_required);
 
 public:
     // Constructor - default total memory is 1024 MB
     MemoryManager(int total = 1024);
+    MemoryManager(const MemoryConfig& config);
 
     // try to allocate memory for process, returns true if successful
     bool allocate(int mem_required);
     
     // free memory when process terminates
     void deallocate(int mem);
+
+    // process aware versions, these work for every memory model
+    bool allocate_process(int pid, int mem_required);
+    void release_process(int pid, int mem);
+
+    // process is about to run, returns the number of page faults it takes
+    int access_memory(int pid, long long now);
+
+    // ticks a process stalls for each fault
+    int get_fault_cost() const;
     
     // get how much memory is still available
     int get_available_memory() const;
+    int get_used_memory() const;
     
     // print current memory usage for debugging
     void print_memory_status() const;
+
+    MemoryModel get_model() const;
+    const VirtualMemory* get_virtual_memory() const;
+    const ContiguousAllocator* get_allocator() const;
+
+    // block address of a process in the contiguous models, -1 otherwise
+    long long get_address(int pid) const;
+    int get_compactions() const;
+    const MemoryConfig& get_config() const;
+
+    // largest request that can be admitted right now. exact for the counter, paged and
+    // free list models, an upper bound for buddy (compaction: the total free space) and the
+    // whole memory for slab, where free objects inside slabs are not tracked
+    long long get_admission_limit() const;
+
+    // largest request that could ever be admitted, bigger ones would wait forever
+    long long get_admission_capacity() const;
+
+    // called after a deallocate when get_admission_limit() reaches the threshold, so a
+    // waiting admission queue only hears about releases that let its next job in.
+    // nullptr removes it. neither is part of a snapshot
+    void set_release_handler(std::function<void()> handler);
+    void set_wake_threshold(long long mb);
+
+    // charge every allocate_process to the control group of the process (nullptr = off).
+    // paged memory limits the resident pages of a group, a group at its limit pages out its
+    // own pages. the other models limit what the group allocates, see ControlGroups::charge.
+    // not part of a snapshot, the group of every paged process is
+    void set_control_groups(ControlGroups* groups);
+    long long get_group_resident(int group) const;   // paged: MB in frames, otherwise 0
+    uint64_t get_group_reclaims(int group) const;    // paged: pages the group paged out itself
+
+    // usage, addresses and the allocator / paging state. the configuration is not part of
+    // it, load_state expects a manager built with the same configuration
+    void save_state(SnapshotWriter& out) const;
+    void load_state(SnapshotReader& in);
 };
 
-#endif // MEMORY_MANAGER_H
\ No newline at end of file
+#endif // MEMORY_MANAGER_H
@@ -0,0 +1,132 @@
+#ifndef METRICS_H
+#define METRICS_H
+
+#include <vector>
+#include <string>
+#include <cstdint>
+#include "pcb.h"
+
+class SnapshotWriter;
+class SnapshotReader;
+
+// streaming quantile sketch with relative error guarantee (DDSketch style)
+// values go into logarithmic buckets, so memory depends on the value range
+// and not on how many values were added. two sketches can be merged.
+class QuantileSketch {
+private:
+    double gamma;                  // bucket growth factor
+    double log_gamma;              // cached log(gamma)
+    std::vector<uint64_t> buckets; // counts for bucket index offset + i
+    int offset;                    // bucket index of buckets[0]
+    uint64_t zero_count;           // values <= 0 are kept separately
+    uint64_t total;                // number of values added
+
+    int bucket_index(double value) const;
+
+public:
+    // relative_accuracy 0.01 means reported quantiles are within 1% of the true value
+    QuantileSketch(double relative_accuracy = 0.01);
+
+    void add(double value);
+    void merge(const QuantileSketch& other);
+
+    // q in [0, 1], returns 0 when empty
+    double quantile(double q) const;
+
+    uint64_t count() const;
+    void clear();
+
+    void save_state(SnapshotWriter& out) const;
+    void load_state(SnapshotReader& in);
+};
+
+// summary numbers for one simulation run
+struct MetricsSummary {
+    uint64_t completed;
+    double mean_turnaround;
+    double mean_waiting;
+    double mean_response;
+    double p50_turnaround, p95_turnaround, p99_turnaround;
+    double p50_waiting, p95_waiting, p99_waiting;
+    double p50_response, p95_response, p99_response;
+    double throughput;        // completed processes per tick
+    double cpu_utilization;   // busy time / elapsed time (0..1)
+    uint64_t context_switches;
+    long long elapsed;        // time from first arrival to last completion
+
+    // real-time jobs, counted on their own (not in completed or the times above)
+    uint64_t rt_jobs;
+    uint64_t deadline_misses;   // jobs that finished after their absolute deadline
+    double miss_ratio;
+    double mean_job_response;   // job completion - job release
+    double p99_job_response;
+    double p99_lateness;        // completion - deadline, 0 for jobs on time
+    long long max_lateness;     // worst completion - deadline (negative when every job was early)
+};
+
+// collects scheduling metrics while the simulation runs
+// everything is updated on state changes, nothing needs a second pass over the PCBs
+class MetricsCollector {
+private:
+    uint64_t completed;
+    long long sum_turnaround;
+    long long sum_waiting;
+    long long sum_response;
+    uint64_t responded;          // processes that got the CPU at least once
+    long long busy_time;         // ticks the CPU spent running something
+    uint64_t context_switches;
+    long long first_arrival;     // earliest arrival seen
+    long long last_completion;   // latest completion seen
+    bool seen_arrival;
+
+    QuantileSketch turnaround;
+    QuantileSketch waiting;
+    QuantileSketch response;
+
+    // real-time jobs
+    uint64_t rt_jobs;
+    uint64_t deadline_misses;
+    long long sum_job_response;
+    long long max_lateness;
+    QuantileSketch job_response;
+    QuantileSketch lateness;     // only the late part, on time jobs count as 0
+
+public:
+    MetricsCollector();
+
+    // process entered the system
+    void record_arrival(const PCB* p);
+
+    // process got the CPU, the first time this also records response time
+    // (best effort processes only, real-time jobs have their own numbers)
+    void record_dispatch(PCB* p, long long now);
+
+    // process finished, fills completion/turnaround/waiting time in the PCB
+    void record_completion(PCB* p, long long now);
+
+    // a job of a real-time task finished, checks it against its deadline
+    void record_job(PCB* p, long long now);
+
+    // same as above for callers that keep process fields outside of a PCB
+    void record_arrival_time(long long arrival);
+    void record_response(long long response);
+    void record_completion_times(long long arrival, long long burst, long long now);
+
+    // CPU ran a process for this many ticks
+    void record_busy(long long ticks);
+
+    // CPU switched from one process to another
+    void record_context_switch();
+
+    // combine numbers from another run (used when simulating many cores)
+    void merge(const MetricsCollector& other);
+
+    MetricsSummary summary() const;
+    void print(const std::string& title) const;
+    void clear();
+
+    void save_state(SnapshotWriter& out) const;
+    void load_state(SnapshotReader& in);
+};
+
+#endif // METRICS_H
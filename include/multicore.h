@@ -0,0 +1,118 @@
+#ifndef MULTICORE_H
+#define MULTICORE_H
+
+#include <vector>
+#include <atomic>
+#include <mutex>
+#include <condition_variable>
+#include <memory>
+#include <string>
+#include "pcb.h"
+#include "metrics.h"
+#include "steal_deque.h"
+#include "process_table.h"
+
+// how work is spread between the simulated cores
+enum class LoadBalanceMode {
+    NONE,        // processes stay on the core they were placed on
+    PUSH,        // at every epoch boundary overloaded cores push work to idle ones
+    WORK_STEAL   // cores that run dry pull work from the top of other cores' run queues
+};
+
+// settings for a multi core run
+struct MultiCoreConfig {
+    int cores = 4;                 // simulated CPU cores
+    int threads = 0;               // real threads, 0 = hardware concurrency
+    int quantum = 4;               // round robin slice on every core
+    int epoch = 64;                // simulated ticks between synchronization points
+    LoadBalanceMode balance = LoadBalanceMode::WORK_STEAL;
+    int migration_cost = 0;        // ticks added when a process runs on a different core than last time
+    bool affinity = false;         // thieves leave a victim's last queued process alone
+};
+
+// simple reusable barrier for the worker threads (C++17 has no std::barrier)
+class ThreadBarrier {
+private:
+    std::mutex lock;
+    std::condition_variable cv;
+    int parties;
+    int waiting;
+    unsigned long long generation;
+
+public:
+    ThreadBarrier(int parties);
+    void arrive_and_wait();
+};
+
+// one simulated core with its own local run queue and clock
+struct alignas(64) CoreState {
+    StealDeque<ProcessHandle> runQueue;
+    std::vector<ProcessHandle> retired;   // finished this epoch, slots freed at the barrier
+    long long clock = 0;
+    long long queuedWork = 0;      // remaining ticks of the processes in runQueue
+    int lastPid = 0;
+    long long steals = 0;
+    long long migrations = 0;
+    long long slices = 0;          // time slices dispatched
+    MetricsCollector metrics;
+};
+
+// N core simulation, every core runs round robin on its own run queue.
+// time advances in epochs: in the parallel phase every real thread simulates a subset of
+// the cores up to the end of the epoch, each core only touching its own queue. between
+// epochs arrivals are placed and work moves: push migration evens out queue lengths, work
+// stealing lets every core that would run dry during the epoch take the oldest processes of
+// the core that stays busy longest. a moved process never runs before it was ready on its
+// old core. nothing depends on thread timing, every thread count gives the same result
+class MultiCoreSimulator {
+private:
+    MultiCoreConfig config;
+    // compact arrival record, a table slot is only taken once the process arrives
+    struct PendingArrival {
+        int pid;
+        int arrival;
+        int burst;
+        int priority;
+    };
+
+    std::vector<std::unique_ptr<CoreState>> cores;
+    ProcessTable table;                 // live processes, queues hold handles into it
+    std::vector<PendingArrival> pending;  // processes sorted by arrival time
+    size_t nextArrival;                 // first process in pending not yet placed
+    size_t placeCursor;                 // round robin placement for arrivals
+    std::atomic<long long> completed;
+    long long epochStart;
+    long long epochEnd;
+    bool finished;
+
+    void placeArrivals();
+    void reapRetired();
+    void pushMigrate();
+    void stealWork();
+    void stepCore(int c);
+    void runCores(int threadIndex, int threadCount);
+    void workerLoop(int threadIndex, int threadCount, ThreadBarrier& barrier);
+
+public:
+    MultiCoreSimulator(const MultiCoreConfig& config);
+
+    // add a process before run(), arrival_time and burst_time must be set. throws
+    // invalid_argument for an arrival outside 0..INT32_MAX, times are kept in 32 bits
+    void addProcess(const PCB& p);
+
+    // simulate until every process has finished
+    void run();
+
+    // totals over all cores
+    MetricsCollector combinedMetrics() const;
+    long long totalSteals() const;
+    long long totalMigrations() const;
+    long long totalSlices() const;      // dispatch decisions over all cores
+    long long totalEvents() const;      // arrivals plus ends of time slices
+    long long finishTime() const;
+    size_t tableSlots() const;          // peak number of process slots used
+
+    void printReport(const std::string& title) const;
+};
+
+#endif // MULTICORE_H
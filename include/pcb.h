@@ -2,9 +2,11 @@
 #define PCB_H
 
 #include <string>
+#include <vector>
 
 // different states a process can be in during its lifetime
-enum class ProcessState { NEW, READY, RUNNING, BLOCKED, TERMINATED };
+// ZOMBIE: exited, but its parent has not collected the exit code with wait() yet
+enum class ProcessState { NEW, READY, RUNNING, BLOCKED, TERMINATED, ZOMBIE };
 
 // Process Control Block - stores all information about a process
 struct PCB {
@@ -13,15 +15,69 @@ struct PCB {
     int priority;                   // priority level (lower number = higher priority)
     std::string required_resource;  // resource this process needs
     bool has_resource;              // does process currently own the resource?
+    bool shared_access = false;     // only reads the resource, other readers may hold it too
+    // multi-type resources (Scheduler::setMultiResources), indexed by resource type
+    std::vector<int> resource_claim;   // instances it needs of each type before it can run
+    std::vector<int> resource_order;   // types in the order it asks for them, empty = by type
+    std::vector<int> resource_alloc;   // instances it holds, empty = not known to the manager yet
     int memory_required;            // how much memory this process needs
 
-    // For performance metrics calculation (not fully implemented yet)
-    int arrival_time;      // when process arrived
+    // For performance metrics calculation
+    long long arrival_time;      // when process arrived
     int burst_time;        // how long process needs CPU
     int remaining_time;    // time left for process
-    int completion_time;   // when process finished
-    int turnaround_time;   // total time from arrival to completion
-    int waiting_time;      // time spent waiting
+    long long completion_time;   // when process finished
+    long long turnaround_time;   // total time from arrival to completion
+    long long waiting_time;      // time spent waiting
+    long long first_run_time = -1;  // when process first got the CPU (-1 = not yet)
+    int response_time = 0;    // time from arrival to first run
+
+    // bookkeeping used by the scheduling policies
+    int queue_level = 0;      // current MLFQ level (0 = top)
+    int level_time = 0;       // MLFQ: CPU ticks used at the current level (demotion allotment)
+    int boost_epoch = 0;      // MLFQ: last priority boost this process has seen
+    long long ready_since = -1;  // MLFQ: time it became ready, -1 = not waiting or already reported starving
+    long long ready_time = -1;   // time it last went into the ready structure (dispatch latency)
+    long long vruntime = 0;   // weighted CPU time for fair share scheduling
+    int last_core = -1;       // core the process last ran on (multi core mode)
+    int cgroup = 0;           // control group it belongs to (ControlGroups), 0 = the root
+
+    // CPU / I/O phases (from a trace), alternating cpu, io, cpu, ... ticks
+    // empty means one CPU burst of burst_time and no I/O
+    std::vector<int> phases;
+    int phase_index = 0;      // current CPU phase in phases
+    int phase_remaining = 0;  // CPU ticks left before the next I/O phase
+    int io_time = 0;          // total ticks of I/O, not counted as waiting
+    std::string io_device;    // device the I/O phases go to, empty = fixed delay of the phase length
+    long long io_block = -1;  // next block the process touches on a disk, -1 = its home block
+
+    // real-time task, period 0 = best effort process. every period a new job of burst_time
+    // ticks is released and has to finish within relative_deadline ticks of its release
+    int period = 0;              // ticks between releases (sporadic: minimum inter-arrival time)
+    int relative_deadline = 0;   // 0 = implicit deadline (the period)
+    int wcet = 0;                // worst case execution time the schedulability tests use, 0 = burst_time
+    int jobs_left = 1;           // jobs still to run, including the current one
+    int sporadic_gap = 0;        // sporadic task: up to this many extra ticks between releases
+    long long release_time = -1; // release of the current job
+    long long deadline = -1;     // absolute deadline of the current job
+
+    // process tree (fork / exit / wait), parent nullptr = child of init, which reaps right away
+    PCB* parent = nullptr;
+    PCB* first_child = nullptr;    // children, zombies first so wait() finds one right away
+    PCB* next_sibling = nullptr;
+    PCB* prev_sibling = nullptr;
+    int family_slot = -1;          // index in the scheduler's list of tree members, -1 = none
+    int exit_code = 0;             // code it exits with, after exit the status its parent reaps
+    bool exit_pending = false;     // killed while off the CPU, exits the next time it is dispatched
+    int wait_pid = 0;              // blocked in wait(): -1 = any child, > 0 = that child, 0 = not waiting
+    int child_status = 0;          // exit code of the child reaped for the last wait()
+    bool pooled = false;           // PCB came from the scheduler's pool and goes back when reaped
+
+    // what it does after its last CPU burst: fork fork_children copies of itself (one level
+    // less deep each), then reap them one wait() at a time before exiting
+    int fork_children = 0;
+    int fork_depth = 0;            // levels below this one whose processes fork again
+    bool wait_children = true;     // false = exit at once, the children become orphans
 };
 
 #endif // PCB_H
\ No newline at end of file
@@ -2,33 +2,33 @@
 #define PROCESS_QUEUES_H
 
 #include <queue>
-#include <unordered_map>
-#include <list>
 #include <vector>
 #include "pcb.h"
+#include "resource_manager.h"
 
 // class to manage different process queues in the system
 // handles ready queue and blocked queues for resources
 class ProcessQueues {
 private:
     std::queue<PCB*> ready_queue;     // processes ready to run
-    std::unordered_map<std::string, std::list<PCB*>> blocked_queue;  // processes blocked on resources
+    ResourceManager resources;        // owners and blocked queues of every resource
 
 public:
     // add process to ready queue
     void add_to_ready(PCB* process);
     
-    // add process to blocked queue for specific resource
-    void add_to_blocked(const std::string& resource, PCB* process);
-    
     // get next process from ready queue
     PCB* pop_ready();
     
-    // release a resource and move blocked processes to ready
-    void release_resource(const std::string& resource);
+    // blocked queues, wake policies and contention stats of the resources
+    ResourceManager& get_resources();
+    const ResourceManager& get_resources() const;
     
     // print status of all queues
     void print_queues_status() const;
+
+    void save_state(SnapshotWriter& out) const;
+    void load_state(SnapshotReader& in);
 };
 
 #endif // PROCESS_QUEUES_H
\ No newline at end of file
@@ -0,0 +1,132 @@
+#ifndef PROCESS_TABLE_H
+#define PROCESS_TABLE_H
+
+#include <vector>
+#include <string>
+#include <memory>
+#include <cstdint>
+#include <unordered_map>
+#include "pcb.h"
+
+// index of a process slot in the ProcessTable, queues store these instead of PCB pointers
+typedef uint32_t ProcessHandle;
+const ProcessHandle INVALID_HANDLE = 0xFFFFFFFFu;
+
+// maps resource names to small integer ids, id 0 is "no resource"
+class ResourceInterner {
+private:
+    std::unordered_map<std::string, int> ids;
+    std::vector<std::string> names;
+
+public:
+    ResourceInterner();
+
+    // returns the existing id or creates a new one
+    int intern(const std::string& name);
+
+    // returns -1 if the name was never interned
+    int find(const std::string& name) const;
+
+    const std::string& name(int id) const;
+    int count() const;
+};
+
+// flag bits in ProcessHot::flags
+const uint8_t PROC_LIVE = 1;          // slot is in use
+const uint8_t PROC_HAS_RESOURCE = 2;  // process owns its required resource
+
+// fields the scheduler touches on every decision, packed into 20 bytes
+struct ProcessHot {
+    int32_t remaining_time;
+    int32_t ready_time;   // when it was queued last (arrival, end of its last slice), it may not run earlier
+    int32_t pid;
+    int16_t priority;
+    int16_t queue_level;
+    int16_t last_core;
+    uint8_t state;        // ProcessState
+    uint8_t flags;
+};
+
+// struct-of-arrays process store
+// hot fields live in one packed array, everything else in separate column arrays.
+// slots of retired processes go on a free list and are handed out again, so a run
+// that creates and retires millions of processes only needs as many slots as are alive at once.
+// only MultiCoreSimulator keeps its processes here, the single core Scheduler and the
+// SchedulingPolicy classes still work on PCB pointers
+class ProcessTable {
+private:
+    std::vector<ProcessHot> hotFields;
+    std::vector<int32_t> arrivalTimes;
+    std::vector<int32_t> burstTimes;
+    std::vector<int32_t> memoryRequired;
+    std::vector<uint32_t> resourceIds;
+    std::vector<int32_t> firstRunTimes;
+    std::vector<int32_t> completionTimes;
+    std::vector<int64_t> vruntimes;
+
+    std::vector<ProcessHandle> freeSlots;
+    size_t liveCount;
+    ResourceInterner resources;
+
+public:
+    ProcessTable();
+
+    // make room for n slots up front
+    void reserve(size_t n);
+
+    // take a slot (from the free list if possible) and fill it
+    ProcessHandle create(int pid, int priority, int memory, const std::string& resource,
+                         int arrival, int burst);
+    ProcessHandle createFrom(const PCB& pcb);
+
+    // give the slot back, handle must not be used afterwards
+    void release(ProcessHandle h);
+
+    // build a classic PCB from a slot (for printing / APIs that still take PCB*)
+    PCB toPCB(ProcessHandle h) const;
+
+    // field access
+    ProcessHot& hot(ProcessHandle h) { return hotFields[h]; }
+    const ProcessHot& hot(ProcessHandle h) const { return hotFields[h]; }
+    int32_t& arrivalTime(ProcessHandle h) { return arrivalTimes[h]; }
+    int32_t& burstTime(ProcessHandle h) { return burstTimes[h]; }
+    int32_t& memory(ProcessHandle h) { return memoryRequired[h]; }
+    uint32_t& resourceId(ProcessHandle h) { return resourceIds[h]; }
+    int32_t& firstRunTime(ProcessHandle h) { return firstRunTimes[h]; }
+    int32_t& completionTime(ProcessHandle h) { return completionTimes[h]; }
+    int64_t& vruntime(ProcessHandle h) { return vruntimes[h]; }
+
+    bool isLive(ProcessHandle h) const;
+    size_t size() const;       // live processes
+    size_t capacity() const;   // slots ever created
+
+    ResourceInterner& resourceNames();
+    const ResourceInterner& resourceNames() const;
+};
+
+// pooled storage for classic PCB objects
+// PCBs are carved out of big chunks and recycled through a free list instead of new/delete
+// per process. pointers stay valid until the PCB is released.
+class PCBPool {
+private:
+    std::vector<std::unique_ptr<PCB[]>> chunks;
+    std::vector<PCB*> freeList;
+    size_t chunkSize;
+    size_t inUse;
+
+    void addChunk();
+
+public:
+    PCBPool(size_t chunkSize = 4096);
+
+    // returns a default initialized PCB
+    PCB* acquire();
+
+    // give a PCB back to the pool
+    void release(PCB* p);
+
+    size_t liveCount() const;
+    size_t capacity() const;
+};
+
+#endif // PROCESS_TABLE_H
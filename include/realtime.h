@@ -0,0 +1,40 @@
+#ifndef REALTIME_H
+#define REALTIME_H
+
+#include <vector>
+#include "pcb.h"
+
+// one periodic or sporadic task as the schedulability tests see it
+struct RealTimeTask {
+    int period;     // ticks between releases (sporadic: minimum inter-arrival time)
+    int deadline;   // relative deadline, 0 = the period
+    int wcet;       // worst case execution time of one job
+};
+
+// task parameters of a real-time PCB, wcet falls back to burst_time
+RealTimeTask realTimeTask(const PCB& p);
+
+// sum of wcet / period
+double utilization(const std::vector<RealTimeTask>& tasks);
+
+// Liu & Layland: n tasks under Rate-Monotonic always meet implicit deadlines
+// when the utilization stays below n * (2^(1/n) - 1), about 0.69 for large n
+double liuLaylandBound(size_t n);
+
+// sufficient tests for Rate-Monotonic with implicit deadlines, a failed test
+// does not mean the set is unschedulable
+bool rmUtilizationTest(const std::vector<RealTimeTask>& tasks);
+bool rmHyperbolicTest(const std::vector<RealTimeTask>& tasks);   // product of (U_i + 1) <= 2
+
+// exact response time analysis for fixed priorities in Rate-Monotonic order (shorter
+// period = higher priority): R = C_i + sum over higher priority tasks of ceil(R / T_j) * C_j,
+// iterated until it settles. returns the worst case response time of every task in the order
+// given, -1 for a task whose iteration passes its deadline
+std::vector<long long> rmResponseTimes(const std::vector<RealTimeTask>& tasks);
+bool rmSchedulable(const std::vector<RealTimeTask>& tasks);
+
+// EDF: exact for implicit deadlines (utilization <= 1), with deadlines shorter than the
+// period it is the sufficient density test (sum of wcet / min(deadline, period) <= 1)
+bool edfSchedulable(const std::vector<RealTimeTask>& tasks);
+
+#endif // REALTIME_H
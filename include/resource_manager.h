@@ -0,0 +1,120 @@
+#ifndef RESOURCE_MANAGER_H
+#define RESOURCE_MANAGER_H
+
+#include <deque>
+#include <vector>
+#include <string>
+#include <cstdint>
+#include <unordered_map>
+#include "pcb.h"
+#include "metrics.h"
+
+class SnapshotWriter;
+class SnapshotReader;
+
+// who gets a resource when its holder lets go
+enum class WakePolicy {
+    FIFO,       // ownership goes straight to the longest waiting process
+    PRIORITY,   // ownership goes straight to the waiting process with the best priority
+    WAKE_ALL    // every waiter becomes ready and races for it again (thundering herd)
+};
+
+// how a process wants to hold a resource
+enum class AccessMode {
+    EXCLUSIVE,  // writer, nobody else may hold it
+    SHARED      // reader, other readers may hold it at the same time (shared resources only)
+};
+
+// contention numbers of one resource
+struct ResourceStats {
+    uint64_t acquisitions = 0;     // grants, directly or by handoff
+    uint64_t contended = 0;        // requests that had to wait
+    uint64_t handoffs = 0;         // grants passed straight from the releaser to a waiter
+    uint64_t wakeups = 0;          // waiters made ready by a release
+    uint64_t futile_wakeups = 0;   // wake all: made ready, but blocked again on the retry
+    size_t max_queue = 0;          // longest the wait queue ever was
+    long long total_hold = 0;      // ticks the resource was held, summed over holders
+    QuantileSketch hold_time;      // ticks per hold
+    QuantileSketch wait_time;      // ticks from first blocking to the grant
+};
+
+// the single blocked path of the simulator: ownership, wait queues and wakeups of named
+// resources. lookups never create entries by accident, a resource only comes into existence
+// through add_resource() or the first acquire() of it.
+//
+// with FIFO and PRIORITY a release hands the resource to the next waiter before it is
+// woken, so exactly the processes that can run are made ready and nobody can barge in.
+// a shared resource granted to a reader also lets the readers right behind it in.
+// WAKE_ALL is the old behaviour of ProcessQueues and is kept for comparison.
+class ResourceManager {
+private:
+    struct Waiter {
+        PCB* process;
+        AccessMode mode;
+        long long since;   // first time it blocked on this resource
+        uint64_t seq;      // arrival order, breaks priority ties FIFO
+    };
+
+    struct Resource {
+        std::string name;
+        WakePolicy wake = WakePolicy::FIFO;
+        bool shared = false;
+        int writer = 0;                  // pid holding it exclusively, 0 = none
+        int readers = 0;                 // processes holding it shared
+        std::deque<Waiter> queue;        // FIFO and WAKE_ALL
+        std::vector<Waiter> heap;        // PRIORITY, binary heap on (priority, seq)
+        std::unordered_map<int, long long> holdSince;   // holder pid -> grant time
+        std::unordered_map<int, long long> wokenSince;  // wake all: pid -> first block time
+        ResourceStats stats;
+    };
+
+    std::vector<Resource> resources;
+    std::unordered_map<std::string, int> ids;
+    WakePolicy defaultWake;
+    uint64_t nextSeq;
+
+    Resource* lookup(const std::string& name);
+    const Resource* lookup(const std::string& name) const;
+    size_t queue_length(const Resource& r) const;
+    void push_waiter(Resource& r, const Waiter& w);
+    const Waiter& front_waiter(const Resource& r) const;
+    void pop_waiter(Resource& r);
+    void grant(Resource& r, PCB* p, AccessMode mode, long long now);
+
+public:
+    ResourceManager(WakePolicy defaultWake = WakePolicy::FIFO);
+
+    // register a resource or change how it behaves, returns its id
+    int add_resource(const std::string& name, WakePolicy wake, bool shared = false);
+
+    // policy of resources that are first seen in acquire()
+    void set_default_policy(WakePolicy wake);
+
+    // true = granted, false = the process was queued and has to block
+    // SHARED on a resource that is not shared counts as EXCLUSIVE
+    bool acquire(PCB* p, const std::string& name, AccessMode mode, long long now);
+
+    // p gives up its hold, processes that may run now are appended to woken
+    // (already owning the resource unless the policy is WAKE_ALL). false if p held nothing
+    bool release(PCB* p, const std::string& name, long long now, std::vector<PCB*>& woken);
+
+    // exclusive holder, 0 if free or only held shared
+    int holder(const std::string& name) const;
+    size_t waiting(const std::string& name) const;
+    int resource_count() const;
+    const std::string& resource_name(int id) const;   // ids run from 0 to resource_count() - 1
+
+    // nullptr for names that were never used
+    const ResourceStats* get_stats(const std::string& name) const;
+
+    void print_waiters() const;
+    void print_stats() const;
+
+    // owners, wait queues and stats of every resource
+    void save_state(SnapshotWriter& out) const;
+    void load_state(SnapshotReader& in);
+};
+
+const char* wakePolicyName(WakePolicy wake);
+
+#endif // RESOURCE_MANAGER_H
@@ -0,0 +1,91 @@
+#ifndef RUN_CONFIG_H
+#define RUN_CONFIG_H
+
+#include <string>
+#include <vector>
+#include <cstdint>
+#include <iostream>
+#include "metrics.h"
+#include "multicore.h"
+#include "memory_manager.h"
+#include "scheduling_policy.h"
+#include "workload_generator.h"
+
+// everything a run of os_simulator can be told from outside. the defaults are the
+// numbers the demo always used (20 generated processes, paged 1024 MB, quantum 4 ...).
+//
+// mode demo is the full tour in main.cpp, fed with the seed, workload, memory, quantum and
+// cycles below. mode run is one simulation of the configured workload, policy and memory,
+// which is what parameter sweeps want: headless it prints nothing but the final metrics
+struct RunConfig {
+    std::string mode = "demo";      // demo or run
+    bool headless = false;          // no log, only the final metrics. implies mode run
+    uint64_t seed = 42;
+
+    std::string policy = "priority";   // createPolicy() name, single core runs
+    PolicyParams params;
+    int cores = 1;                  // run: more than 1 simulates that many round robin cores
+    MultiCoreConfig multicore;      // balance, epoch ... of multi-core runs and the demo
+    MemoryConfig memory;
+    WorkloadConfig workload;        // generated workload, seed comes from seed above
+    std::string trace;              // run: replay this trace file instead (csv, json or binary)
+
+    long long until = 0;            // run: stop at this tick, 0 = until every process finished
+    int cycles = 15;                // demo: ticks of the step by step priority scheduling
+
+    std::string metrics_path;       // final metrics are appended here, empty = stdout
+    std::string metrics_format = "text";   // text, json (one object per line) or csv
+    std::string event_log;          // run: binary event log, empty = off
+    std::string series_path;        // run: telemetry time series, empty = off
+    long long sample_interval = 100;
+
+    RunConfig();
+};
+
+// set one option by its key, the same keys work in a config file and on the command line:
+//   mode, headless, seed, policy, cores, trace, until, cycles
+//   policy.quantum, policy.levels, policy.base_quantum, policy.quanta (2,4,8), policy.allotment,
+//   policy.boost_interval, policy.aging_threshold, policy.starvation_threshold, policy.latency,
+//   policy.granularity, policy.preemptive, policy.rt_background, policy.rt_runtime, policy.rt_period
+//   memory.model, memory.total, memory.page_size, memory.swap, memory.replacement, memory.ws_window,
+//   memory.references, memory.fault_cost, memory.compaction, memory.buddy_min_block
+//   workload.count, workload.arrival_rate, workload.burst, workload.burst_min, workload.burst_max,
+//   workload.burst_mean, workload.pareto_shape, workload.priority_levels, workload.resources
+//   (disk,printer,none), workload.zipf, workload.small_fraction, workload.small_min, workload.small_max,
+//   workload.large_min, workload.large_max, workload.io_probability, workload.io_mean
+//   multicore.balance, multicore.threads, multicore.epoch, multicore.migration_cost, multicore.affinity
+//   output.metrics, output.format, output.event_log, output.series, output.sample_interval
+// throws invalid_argument for an unknown key or a value that does not parse
+void setRunOption(RunConfig& config, const std::string& key, const std::string& value);
+
+// key = value lines, '#' starts a comment, [section] puts "section." in front of the keys
+// below it. throws runtime_error when the file cannot be read, with the line for bad options
+void loadRunConfig(RunConfig& config, const std::string& path);
+
+// --config file is read first wherever it stands, then every --key=value or --key value in
+// the order given, so the command line wins over the file. --headless alone means
+// headless=true. false when --help was asked for, throws invalid_argument for bad arguments
+bool parseCommandLine(RunConfig& config, int argc, char** argv);
+std::string runUsage();
+
+// numbers of one configured run
+struct RunReport {
+    MetricsSummary summary;
+    long long submitted = 0;
+    long long rejected = 0;      // did not fit in memory
+    long long end_time = 0;
+    uint64_t events = 0;
+    uint64_t decisions = 0;
+    uint64_t page_faults = 0;
+    double wall_seconds = 0;
+};
+
+// mode run: build the workload, memory and scheduler from config and simulate. throws
+// invalid_argument for a combination that cannot run, runtime_error when a file cannot be
+// opened
+RunReport runConfigured(const RunConfig& config);
+
+// the report in config.metrics_format. csv writes its header only when header is true
+void writeRunReport(std::ostream& out, const RunConfig& config, const RunReport& report, bool header);
+
+#endif // RUN_CONFIG_H
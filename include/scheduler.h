@@ -11,39 +11,107 @@
 #include "pcb.h"
 #include "memory_manager.h"
 #include "process_queues.h"
+#include "event_queue.h"
+#include "metrics.h"
+#include "scheduling_policy.h"
+#include "io_device.h"
+#include "telemetry.h"
+#include <fstream>
+#include <chrono>
 
-// comparator function for checking process priority
-// this helps the priority queue know which process has higher priority
-struct CompareProcessPriority {
-    bool operator()(const PCB* a, const PCB* b) const {
-        // Lower number means higher priority - so if a has bigger priority number
-        // then b should come first, thats why we return true when a > b
-        return a->priority > b->priority;
-    }
+class SnapshotWriter;
+class SnapshotReader;
+class PCBPool;
+class ControlGroups;
+class MultiResourceManager;
+
+// exit code of a killed process (128 + SIGKILL, like a shell reports it)
+const int EXIT_KILLED = 137;
+
+// counts of the process lifecycle calls (fork / exit / wait / kill)
+struct LifecycleStats {
+    long long forks = 0;           // children created by fork or spawn
+    long long fork_failures = 0;   // no memory for the child
+    long long exits = 0;           // processes of a tree that exited
+    long long kills = 0;           // processes killed (each one of a cascade counts)
+    long long reaped = 0;          // exited processes collected by their parent or init
+    long long orphans = 0;         // children given to init because their parent exited first
+    long long zombies = 0;         // exited, not reaped yet
+    long long peak_zombies = 0;
 };
 
 class Scheduler {
 private:
-    // main ready queue that stores processes waiting to run
-    std::priority_queue<PCB*, std::vector<PCB*>, CompareProcessPriority> readyQueue;
-
-    std::queue<PCB*> fifoQueue; // queue for FCFS scheduling
-    
-    // map to store blocked processes for each resource
-    std::unordered_map<std::string, std::queue<PCB*>> blockedQueues;
-    
-    // table to track which process owns which resource (resource name -> PID)
-    std::unordered_map<std::string, int> resourceTable;
+    // ready structure of the active scheduling policy (FIFO ring, heap, tree ...)
+    std::unique_ptr<SchedulingPolicy> policy;
     
     PCB* runningProcess;           // pointer to currently running process
     MemoryManager* memoryManager;  // pointer to memory manager
     ProcessQueues* processQueues;  // pointer to process queues
+    ResourceManager* resources;    // resource owners and blocked queues, lives in processQueues
+    std::vector<PCB*> woken;       // processes a release made ready, reused between releases
+
+    // I/O devices processes send their I/O phases to (PCB::io_device)
+    std::vector<std::unique_ptr<IODevice>> devices;
+    std::vector<IoRequest> ioDone;   // finished requests of a device batch, reused
+
+    // discrete event engine - time jumps straight to the next pending event
+    EventQueue events;
+    long long sliceStart;   // time when the running process got the CPU
+    long long sliceToken;   // id of current time slice, older completion events are ignored
+    bool verbose;           // print every state change to the console
+
+    // variables for performance tracking, updated as processes finish
+    long long total_turnaround_time;
+    long long total_waiting_time;
+    long long total_processes_terminated;
+    long long simulation_time;   // current simulated time
 
-    // variables for performance tracking - not fully implemented yet
-    int total_turnaround_time;
-    int total_waiting_time;
-    int total_processes_terminated;
-    int simulation_time;
+    MetricsCollector metrics;    // means, percentiles, utilization, context switches
+    int lastRunPid;              // pid that had the CPU last, for counting context switches
+    uint64_t eventsHandled;      // events popped off the event queue (benchmarks)
+    uint64_t decisions;          // times the policy was asked for the next process
+
+    // live metrics in a MetricsRegistry, only allocated when telemetry is on. counters and
+    // the dispatch latency histogram are updated where things happen, queue lengths and
+    // memory are sampled every config.sample_interval simulated ticks
+    struct TelemetryHooks {
+        MetricsRegistry* registry;
+        TelemetryConfig config;
+        std::string labels;
+        TelemetryCounter* arrivals;
+        TelemetryCounter* dispatches;
+        TelemetryCounter* contextSwitches;
+        TelemetryCounter* completions;
+        TelemetryCounter* jobs;
+        TelemetryCounter* deadlineMisses;
+        TelemetryCounter* pageFaults;
+        TelemetryCounter* events;
+        TelemetryHistogram* dispatchLatency;
+        TelemetryGauge* readyLength;
+        TelemetryGauge* running;
+        TelemetryGauge* memoryUsed;
+        TelemetryGauge* clock;
+        std::vector<TelemetryGauge*> blocked;   // per resource id
+        uint64_t eventsSeen;                    // eventsHandled at the last sample
+        long long nextSample;
+        uint64_t samples;
+        std::unique_ptr<std::ofstream> series;
+        std::chrono::steady_clock::time_point lastExport;
+    };
+    std::unique_ptr<TelemetryHooks> telemetry;
+
+    // process lifecycle: forked PCBs come from processPool and go back to it when reaped.
+    // family holds every process linked into a tree that is not reaped yet (family_slot)
+    PCBPool* processPool;
+    std::vector<PCB*> family;
+    int nextPid;                 // above every pid seen so far, for forked children
+    LifecycleStats lifecycle;
+
+    ControlGroups* cgroups;      // per group numbers, memory limits and the OOM killer
+
+    MultiResourceManager* multiResources;        // multi-type resources (PCB::resource_claim)
+    std::unordered_map<int, PCB*> multiHolders;  // pid -> process registered with multiResources
 
 public:
     // Constructor to initialize scheduler
@@ -67,14 +135,121 @@ public:
     // CPU scheduling algorithms - different ways to schedule processes
 
     void simulateCPU(int cycles);
+    void runFIFOScheduling();
     void runPriorityScheduling();
     void runSJFScheduling();              // shortest job first
     void runRoundRobinScheduling(int timeQuantum);
+    void runMLFQScheduling(int levels);
+    void runFairShareScheduling();        // CFS style
+
+
+    // event driven simulation
+
+    // register a process, it becomes ready at its arrival_time
+    void submitProcess(PCB* p);
+
+    // process every event up to endTime and move the clock there
+    void runUntil(long long endTime);
+
+    // keep going until no events are left
+    void runToCompletion();
+
+    // choose the scheduling policy, waiting processes are moved to its ready structure.
+    // throws invalid_argument for nullptr
+    void setPolicy(std::unique_ptr<SchedulingPolicy> newPolicy);
+    const SchedulingPolicy& getPolicy() const;
+    void setVerbose(bool enabled);
+    long long getCurrentTime() const;
+    const MetricsCollector& getMetrics() const;
+    const ResourceManager& getResources() const;
+    uint64_t getEventsHandled() const;
+    uint64_t getDecisions() const;
+    const MemoryManager& getMemoryManager() const;
+    const ProcessQueues& getProcessQueues() const;
+
+    // policy, running process, pending events, devices, clock and metrics. memory and
+    // process queues are saved on their own (see SimulationSnapshot)
+    void saveState(SnapshotWriter& out) const;
+    void loadState(SnapshotReader& in);
+
+    // live telemetry: registers this scheduler's metrics in registry (nullptr turns it off)
+    // and samples it every config.sample_interval ticks, optionally appending a time series
+    // and rewriting an export file. throws runtime_error when series_path cannot be opened.
+    // telemetry is not part of a snapshot
+    void enableTelemetry(MetricsRegistry* registry, const TelemetryConfig& config = TelemetryConfig());
+    uint64_t getTelemetrySamples() const;
+
+    // process lifecycle, processes create processes while the simulation runs.
+    // the PCBs of forked children come from pool and go back to it once they are reaped,
+    // together with their memory, so a run with endless forking stays bounded
+    void setProcessPool(PCBPool* pool);
+
+    // fork: the child runs the same program as parent (priority, memory, bursts, resource,
+    // fork program) and arrives now. spawn: the child runs image instead. parent nullptr =
+    // child of init. nullptr when the child gets no memory, throws runtime_error without a pool
+    PCB* forkProcess(PCB* parent);
+    PCB* spawnProcess(PCB* parent, const PCB& image);
+
+    // the running process (or one blocked in wait) exits at once, any other one exits the
+    // next time it is dispatched. its children go to init, it stays a zombie until reaped
+    void exitProcess(PCB* p, int code);
+
+    // pid of a reaped zombie child (-1 = any child), its code in parent->child_status.
+    // 0 = parent blocks until such a child exits, -1 = no such child
+    int waitProcess(PCB* parent, int pid = -1);
+
+    // exitProcess with EXIT_KILLED, cascade kills the whole subtree. returns processes killed
+    int killProcess(PCB* p, bool cascade = false);
+
+    const LifecycleStats& getLifecycleStats() const;
+
+    // control groups: completions are counted per group, memory is charged to the group
+    // of a process and a group over its memory limit OOM-kills through killProcess.
+    // forked children start in the group of their parent. the CPU side is CGroupPolicy
+    void setControlGroups(ControlGroups* groups);
+
+    // multi-type resources with deadlock handling. a process with a resource_claim asks for
+    // one more type of it (resource_order) every time it is dispatched and only runs once
+    // it holds the whole claim, everything goes back when it exits. a request that can not
+    // be granted (or would be unsafe under AVOID) blocks it until a release grants it, the
+    // deadlocked processes DETECT picks as victims are killed. submitProcess throws
+    // invalid_argument for a claim the manager can never grant. not part of a snapshot
+    void setMultiResources(MultiResourceManager* manager);
+
+    // I/O phases of processes whose io_device matches the name go through this device
+    void addDevice(std::unique_ptr<IODevice> device);
+    IODevice* getDevice(const std::string& name) const;
+    void printDeviceStats() const;
 
 private:
     // helper functions used internally
     void dispatch();
     void handleTermination(PCB* p);
+
+    // event handlers
+    void processEvents(long long endTime);
+    void handleArrival(PCB* p);
+    void handleBurstComplete(const Event& e);
+    void finishJob(PCB* p);
+    void handleQuantumExpire(const Event& e);
+    void handleResourceRelease(PCB* p);
+    bool acquireMultiResources(PCB* p);
+    void releaseMultiResources(PCB* p);
+    void handleIOComplete(PCB* p);
+    void startIO(PCB* p);
+    void startDevice(size_t index);
+    void handleDeviceComplete(const Event& e);
+    void stopRunning(bool sliceExpired = false);
+    void recordJobTelemetry(const PCB* p);
+    void runProgram(PCB* p);
+    void exitNow(PCB* p);
+    void reap(PCB* p);
+    void wakeWaiter(PCB* parent, PCB* child);
+    void joinFamily(PCB* p);
+    void leaveFamily(PCB* p);
+    void unlinkChild(PCB* child);
+    void linkChild(PCB* parent, PCB* child, bool front);
+    void sampleTelemetry(bool final = false);
 };
 
-#endif // SCHEDULER_H
\ No newline at end of file
+#endif // SCHEDULER_H
@@ -0,0 +1,348 @@
+#ifndef SCHEDULING_POLICY_H
+#define SCHEDULING_POLICY_H
+
+#include <queue>
+#include <set>
+#include <vector>
+#include <string>
+#include <memory>
+#include <cstdint>
+#include <functional>
+#include "pcb.h"
+
+class SnapshotWriter;
+class SnapshotReader;
+
+// growable ring buffer used as a FIFO ready queue
+// push and pop are O(1), storage is one contiguous block
+template <typename T>
+class RingBuffer {
+private:
+    std::vector<T> data;  // capacity is always a power of two
+    size_t head;          // index of the first element
+    size_t count;         // number of stored elements
+
+    void grow() {
+        size_t capacity = data.empty() ? 16 : data.size() * 2;
+        std::vector<T> bigger(capacity);
+        for (size_t i = 0; i < count; i++) {
+            bigger[i] = data[(head + i) & (data.size() - 1)];
+        }
+        data.swap(bigger);
+        head = 0;
+    }
+
+public:
+    RingBuffer() : head(0), count(0) {}
+
+    void push_back(const T& item) {
+        if (count == data.size()) grow();
+        data[(head + count) & (data.size() - 1)] = item;
+        count = count + 1;
+    }
+
+    T pop_front() {
+        T item = data[head];
+        head = (head + 1) & (data.size() - 1);
+        count = count - 1;
+        return item;
+    }
+
+    const T& front() const { return data[head]; }
+    const T& at(size_t i) const { return data[(head + i) & (data.size() - 1)]; }
+    bool empty() const { return count == 0; }
+    size_t size() const { return count; }
+};
+
+// tuning knobs shared by the policies, each policy only reads what it needs
+struct PolicyParams {
+    int quantum = 4;            // RR time slice
+    int mlfq_levels = 3;        // number of MLFQ queues
+    int mlfq_base_quantum = 2;  // quantum of the top MLFQ level, doubles every level down
+    std::vector<int> mlfq_quanta;   // quantum per MLFQ level, overrides the doubling when not empty
+    int mlfq_allotment = 0;         // CPU ticks a process may use on a level before it is demoted,
+                                    // 0 = demoted whenever it uses up a whole quantum
+    int mlfq_boost_interval = 0;    // every this many ticks all processes go back to the top, 0 = never
+    int mlfq_aging_threshold = 0;   // promoted one level after waiting this long on a level, 0 = off
+    int mlfq_starvation_threshold = 0;  // starvation alarm after waiting this long for the CPU, 0 = off
+    int cfs_latency = 24;       // CFS target period in which every task should run once
+    int cfs_min_granularity = 3;  // smallest CFS slice
+    bool preemptive = true;     // priority/SJF: better arrivals take the CPU
+    std::string rt_background = "rr";   // best effort policy below the EDF / RM class
+    int rt_runtime = 0;         // real-time class may use this many ticks of every rt_period, 0 = no limit
+    int rt_period = 100;
+};
+
+// interface every scheduling policy implements
+// the Scheduler only talks to the ready structure through these calls
+class SchedulingPolicy {
+public:
+    virtual ~SchedulingPolicy() {}
+
+    // put a ready process into the ready structure
+    virtual void enqueue(PCB* p, long long now) = 0;
+
+    // remove and return the process that should run next (nullptr if empty)
+    virtual PCB* pickNext(long long now) = 0;
+
+    virtual bool empty() const = 0;
+    virtual size_t size() const = 0;
+
+    // how long p may run before a quantum expiry, 0 means until its burst is done
+    virtual int timeSlice(const PCB* p) const { return 0; }
+
+    // should candidate take the CPU from running, which has run ranSoFar ticks of its slice
+    virtual bool shouldPreempt(const PCB* running, int ranSoFar, const PCB* candidate) const { return false; }
+
+    // running process left the CPU after ran ticks, sliceExpired is true on quantum expiry
+    virtual void onDescheduled(PCB* p, int ran, bool sliceExpired) {}
+
+    // a policy may hold ready processes back (a throttled control group), pickNext returns
+    // nullptr then. the time it wants to be asked again, -1 = nothing is held back
+    virtual long long heldUntil() const { return -1; }
+
+    virtual std::string name() const = 0;
+
+    // snapshots: settings and ready structure, starting with the createPolicy() name so
+    // loadPolicy() knows what to build. policies that do not override this cannot be
+    // snapshotted and throw
+    virtual void saveState(SnapshotWriter& out) const;
+    virtual void loadState(SnapshotReader& in);
+};
+
+// ---------------- concrete policies ----------------
+
+// First Come First Served - plain FIFO ring
+class FCFSPolicy : public SchedulingPolicy {
+private:
+    RingBuffer<PCB*> queue;
+
+public:
+    void enqueue(PCB* p, long long now) override;
+    PCB* pickNext(long long now) override;
+    bool empty() const override;
+    size_t size() const override;
+    std::string name() const override;
+    void saveState(SnapshotWriter& out) const override;
+    void loadState(SnapshotReader& in) override;
+};
+
+// entry stored in the heap based policies, seq keeps equal keys in FIFO order
+struct HeapEntry {
+    long long key;
+    uint64_t seq;
+    PCB* process;
+};
+
+// max-heap comparator turned around so std::priority_queue gives the smallest key
+struct CompareHeapEntry {
+    bool operator()(const HeapEntry& a, const HeapEntry& b) const {
+        if (a.key != b.key) return a.key > b.key;
+        return a.seq > b.seq;
+    }
+};
+
+// ordering for tree based policies, smallest key first
+struct CompareTreeEntry {
+    bool operator()(const HeapEntry& a, const HeapEntry& b) const {
+        if (a.key != b.key) return a.key < b.key;
+        return a.seq < b.seq;
+    }
+};
+
+// static priority (lower number = higher priority), binary heap
+class PriorityPolicy : public SchedulingPolicy {
+private:
+    std::priority_queue<HeapEntry, std::vector<HeapEntry>, CompareHeapEntry> heap;
+    uint64_t next_seq;
+    bool preemptive;
+
+public:
+    PriorityPolicy(bool preemptive = true);
+    void enqueue(PCB* p, long long now) override;
+    PCB* pickNext(long long now) override;
+    bool empty() const override;
+    size_t size() const override;
+    bool shouldPreempt(const PCB* running, int ranSoFar, const PCB* candidate) const override;
+    std::string name() const override;
+    void saveState(SnapshotWriter& out) const override;
+    void loadState(SnapshotReader& in) override;
+};
+
+// Shortest Job First on remaining time, preemptive version is SRTF
+class SJFPolicy : public SchedulingPolicy {
+private:
+    std::priority_queue<HeapEntry, std::vector<HeapEntry>, CompareHeapEntry> heap;
+    uint64_t next_seq;
+    bool preemptive;
+
+public:
+    SJFPolicy(bool preemptive = false);
+    void enqueue(PCB* p, long long now) override;
+    PCB* pickNext(long long now) override;
+    bool empty() const override;
+    size_t size() const override;
+    bool shouldPreempt(const PCB* running, int ranSoFar, const PCB* candidate) const override;
+    std::string name() const override;
+    void saveState(SnapshotWriter& out) const override;
+    void loadState(SnapshotReader& in) override;
+};
+
+// Round Robin - FIFO ring plus a fixed quantum
+class RoundRobinPolicy : public SchedulingPolicy {
+private:
+    RingBuffer<PCB*> queue;
+    int quantum;
+
+public:
+    RoundRobinPolicy(int quantum);
+    void enqueue(PCB* p, long long now) override;
+    PCB* pickNext(long long now) override;
+    bool empty() const override;
+    size_t size() const override;
+    int timeSlice(const PCB* p) const override;
+    std::string name() const override;
+    void saveState(SnapshotWriter& out) const override;
+    void loadState(SnapshotReader& in) override;
+};
+
+// Multilevel feedback queue - one FIFO per level and a bitmap of non empty levels
+// picking the next process is a find-first-set on the bitmap, so it is O(1)
+//
+// boosts are lazy: a boost only bumps an epoch and marks the non empty levels as boosted,
+// their entries (all older than the boost) count as top level until they are picked.
+// every FIFO is ordered by time, so aging and starvation alarms only look at queue fronts.
+// the cost of a decision does not depend on how many processes are ready.
+struct MLFQEntry {
+    PCB* process;
+    long long since;   // time it was queued on this level
+    int epoch;         // boost epoch when it was queued
+};
+
+class MLFQPolicy : public SchedulingPolicy {
+private:
+    std::vector<RingBuffer<MLFQEntry>> levels;
+    std::vector<int> quanta;
+    uint64_t nonEmpty;     // bit i set when level i has processes
+    uint64_t boosted;      // bit i set when the front of level i was queued before the last boost
+    size_t count;
+
+    int allotment;
+    long long boostInterval;
+    long long nextBoost;
+    int boostEpoch;
+    long long agingThreshold;
+    long long starvationThreshold;
+    RingBuffer<MLFQEntry> readyOrder;   // every enqueue in time order, for starvation alarms
+
+    uint64_t boosts;
+    uint64_t promotions;
+    uint64_t alarms;
+    std::function<void(const PCB*, long long)> starvationHandler;
+
+    void push(int level, PCB* p, long long now);
+    void updateLevelBits(int level);
+    void maintain(long long now);
+
+public:
+    MLFQPolicy(const PolicyParams& params);
+    void enqueue(PCB* p, long long now) override;
+    PCB* pickNext(long long now) override;
+    bool empty() const override;
+    size_t size() const override;
+    int timeSlice(const PCB* p) const override;
+    bool shouldPreempt(const PCB* running, int ranSoFar, const PCB* candidate) const override;
+    void onDescheduled(PCB* p, int ran, bool sliceExpired) override;
+    std::string name() const override;
+    void saveState(SnapshotWriter& out) const override;
+    void loadState(SnapshotReader& in) override;
+
+    // called with the process and how long it has waited, once per starving wait
+    void setStarvationHandler(std::function<void(const PCB*, long long)> handler);
+
+    uint64_t getBoosts() const;
+    uint64_t getPromotions() const;
+    uint64_t getStarvationAlarms() const;
+};
+
+// Completely Fair Scheduler style fair share
+// ready processes sit in a red-black tree (std::set) keyed by virtual runtime
+class CFSPolicy : public SchedulingPolicy {
+private:
+    std::set<HeapEntry, CompareTreeEntry> tree;   // keyed by (vruntime, seq)
+    uint64_t next_seq;
+    long long minVruntime;
+    long long totalWeight;
+    int latency;
+    int minGranularity;
+
+public:
+    CFSPolicy(int latency, int minGranularity);
+    void enqueue(PCB* p, long long now) override;
+    PCB* pickNext(long long now) override;
+    bool empty() const override;
+    size_t size() const override;
+    int timeSlice(const PCB* p) const override;
+    bool shouldPreempt(const PCB* running, int ranSoFar, const PCB* candidate) const override;
+    void onDescheduled(PCB* p, int ran, bool sliceExpired) override;
+    std::string name() const override;
+    void saveState(SnapshotWriter& out) const override;
+    void loadState(SnapshotReader& in) override;
+
+    // load weight for a priority value (priority 0 gets the biggest share)
+    static int weightFor(int priority);
+};
+
+// real-time scheduling class on top of a best effort policy. processes with a period are
+// real-time tasks and always go before best effort ones; among themselves they are ordered
+// by absolute deadline (EDF) or by period (Rate-Monotonic) in a binary heap, O(log n).
+//
+// bandwidth reservation: with runtime > 0 the real-time class gets at most runtime ticks of
+// every period window, the rest is left to best effort processes when they want it. an idle
+// CPU is never wasted, a throttled job still runs when nothing else is ready. a job released
+// while its class is throttled waits for the end of the current best effort slice.
+enum class RealTimeMode { EDF, RATE_MONOTONIC };
+
+class RealTimePolicy : public SchedulingPolicy {
+private:
+    RealTimeMode mode;
+    std::priority_queue<HeapEntry, std::vector<HeapEntry>, CompareHeapEntry> heap;
+    uint64_t next_seq;
+    std::unique_ptr<SchedulingPolicy> background;
+
+    long long runtime;       // budget per window, 0 = no limit
+    long long period;        // window length
+    long long windowStart;
+    long long used;          // real-time ticks charged to the current window
+    long long clock;         // latest time seen in enqueue / pickNext
+    uint64_t throttled;      // best effort picks while real-time jobs were waiting
+
+    void refill(long long now);
+    long long budgetLeft() const;
+    long long windowLeft() const;
+
+public:
+    RealTimePolicy(RealTimeMode mode, std::unique_ptr<SchedulingPolicy> background, int runtime = 0, int period = 100);
+    void enqueue(PCB* p, long long now) override;
+    PCB* pickNext(long long now) override;
+    bool empty() const override;
+    size_t size() const override;
+    int timeSlice(const PCB* p) const override;
+    bool shouldPreempt(const PCB* running, int ranSoFar, const PCB* candidate) const override;
+    void onDescheduled(PCB* p, int ran, bool sliceExpired) override;
+    std::string name() const override;
+    void saveState(SnapshotWriter& out) const override;
+    void loadState(SnapshotReader& in) override;
+
+    uint64_t getThrottled() const;
+};
+
+// build a policy by name: fcfs, priority, sjf, srtf, rr, mlfq, cfs,
+// edf and rm (real-time class over params.rt_background)
+// throws invalid_argument for an unknown name or a real-time background of edf / rm
+std::unique_ptr<SchedulingPolicy> createPolicy(const std::string& name, const PolicyParams& params = PolicyParams());
+
+// rebuilds a policy written by SchedulingPolicy::saveState
+std::unique_ptr<SchedulingPolicy> loadPolicy(SnapshotReader& in);
+
+#endif // SCHEDULING_POLICY_H
@@ -0,0 +1,188 @@
+#ifndef SNAPSHOT_H
+#define SNAPSHOT_H
+
+#include <vector>
+#include <string>
+#include <memory>
+#include <cstdint>
+#include <cstring>
+#include <stdexcept>
+#include <type_traits>
+#include <unordered_map>
+#include "pcb.h"
+#include "scheduler.h"
+#include "workload_generator.h"
+#include "process_table.h"
+
+// writes simulator state into a flat byte buffer. PCBs are never written inline: a
+// pointer becomes an index into a process table that is stored once, in front of
+// everything else, so every structure that points to the same PCB points to the same
+// copy again after a restore
+class SnapshotWriter {
+private:
+    std::vector<char> body;
+    std::unordered_map<const PCB*, uint32_t> ids;
+    std::vector<const PCB*> processes;
+
+public:
+    void bytes(const void* data, size_t n);
+
+    // plain values and structs without pointers, written as they are in memory
+    template <typename T>
+    void put(const T& value) {
+        static_assert(std::is_trivially_copyable<T>::value, "only plain values can be written directly");
+        bytes(&value, sizeof(T));
+    }
+
+    template <typename A, typename B>
+    void put(const std::pair<A, B>& value) {
+        put(value.first);
+        put(value.second);
+    }
+
+    template <typename T>
+    void putVector(const std::vector<T>& values) {
+        static_assert(std::is_trivially_copyable<T>::value, "only plain values can be written directly");
+        put((uint64_t)values.size());
+        if (!values.empty()) bytes(values.data(), values.size() * sizeof(T));
+    }
+
+    // map, unordered_map, set: size, then every element in iteration order
+    template <typename Container>
+    void putAll(const Container& values) {
+        put((uint64_t)values.size());
+        for (auto it = values.begin(); it != values.end(); it++) put(*it);
+    }
+
+    void putString(const std::string& s);
+
+    // reference to a PCB (nullptr allowed), the PCB itself goes into the process table
+    void putProcess(const PCB* p);
+
+    size_t processCount() const;
+
+    // header, process table and body as one buffer
+    std::vector<char> finish() const;
+};
+
+// reads what SnapshotWriter wrote, throws runtime_error on truncated or foreign data
+class SnapshotReader {
+private:
+    const char* data;
+    size_t size;
+    size_t position;
+    std::vector<PCB*> processes;
+
+public:
+    SnapshotReader(const std::vector<char>& buffer);
+
+    void bytes(void* out, size_t n);
+
+    template <typename T>
+    T get() {
+        static_assert(std::is_trivially_copyable<T>::value, "only plain values can be read directly");
+        T value;
+        bytes(&value, sizeof(T));
+        return value;
+    }
+
+    template <typename T>
+    void get(T& value) {
+        value = get<T>();
+    }
+
+    template <typename A, typename B>
+    void get(std::pair<A, B>& value) {
+        get(value.first);
+        get(value.second);
+    }
+
+    // counterparts of putAll, elements are inserted in the order they were written
+    template <typename Container>
+    void getMap(Container& values) {
+        values.clear();
+        uint64_t n = get<uint64_t>();
+        for (uint64_t i = 0; i < n; i++) {
+            typename std::remove_const<typename Container::value_type::first_type>::type key;
+            typename Container::value_type::second_type value;
+            get(key);
+            get(value);
+            values.emplace_hint(values.end(), key, value);
+        }
+    }
+
+    template <typename Set>
+    void getSet(Set& values) {
+        values.clear();
+        uint64_t n = get<uint64_t>();
+        for (uint64_t i = 0; i < n; i++) {
+            typename Set::value_type value;
+            get(value);
+            values.insert(values.end(), value);
+        }
+    }
+
+    template <typename T>
+    void getVector(std::vector<T>& values) {
+        static_assert(std::is_trivially_copyable<T>::value, "only plain values can be read directly");
+        uint64_t n = get<uint64_t>();
+        if (n > (size - position) / (sizeof(T) > 0 ? sizeof(T) : 1)) {
+            throw std::runtime_error("snapshot is truncated");
+        }
+        values.resize(n);
+        if (n > 0) bytes(values.data(), n * sizeof(T));
+    }
+
+    std::string getString();
+    PCB* getProcess();
+
+    // checks the header and copies the process table into storage, which must not be
+    // resized afterwards (the restored structures point into it)
+    void loadProcesses(std::vector<PCB>& storage);
+};
+
+// a simulation rebuilt from a snapshot. it owns everything, including its own copy of
+// every PCB that was still referenced, so forks never share state with each other
+struct SimulationFork {
+    std::vector<PCB> processes;
+    PCBPool pool;   // children forked after the restore, see Scheduler::setProcessPool
+    std::unique_ptr<MemoryManager> memory;
+    std::unique_ptr<ProcessQueues> queues;
+    std::unique_ptr<Scheduler> scheduler;
+    std::vector<CounterRng> rngs;
+
+    // copy of the process with this pid, nullptr when it was not in the snapshot
+    PCB* process(int pid);
+};
+
+// compact binary image of a running simulation: the scheduler with its ready structure,
+// running process, pending events, devices and metrics, the resource table with its wait
+// queues, the memory manager (allocator, page tables, frames, replacement state), the
+// PCBs still referenced by any of them and optionally some workload RNGs.
+//
+// a snapshot is taken once and can be restored any number of times. a restore decodes the
+// buffer into fresh objects with all PCBs in one contiguous array, so branching many
+// experiments off one warm state costs one linear copy each instead of the warm up.
+// terminated processes nothing points to any more are not part of it, their numbers
+// already live in the metrics. MLFQ starvation handlers and the global event trace are
+// not captured. a snapshot is only meant to be read by the same build that wrote it.
+class SimulationSnapshot {
+private:
+    std::vector<char> buffer;
+
+public:
+    SimulationSnapshot();
+
+    // the scheduler brings its memory manager and process queues along
+    static SimulationSnapshot capture(const Scheduler& scheduler, const std::vector<const CounterRng*>& rngs = {});
+
+    std::unique_ptr<SimulationFork> restore() const;
+
+    size_t size() const;
+
+    // throws runtime_error when the file cannot be written or read
+    void save(const std::string& path) const;
+    static SimulationSnapshot load(const std::string& path);
+};
+
+#endif // SNAPSHOT_H
@@ -0,0 +1,441 @@
+#ifndef STATIC_SCHEDULER_H
+#define STATIC_SCHEDULER_H
+
+#include <vector>
+#include <string>
+#include <climits>
+#include <stdexcept>
+#include <algorithm>
+#include <cstdint>
+#include "pcb.h"
+#include "memory_manager.h"
+#include "process_queues.h"
+#include "event_queue.h"
+#include "metrics.h"
+#include "scheduling_policy.h"
+
+// compile time specialized scheduler
+//
+// Scheduler picks its policy at run time, so every decision goes through a few virtual calls
+// (enqueue, pickNext, timeSlice, shouldPreempt, onDescheduled), and every dispatch checks for
+// verbose output, telemetry, devices, real-time tasks and process trees.
+// StaticScheduler<Policy, ReadyQueue, Memory> fixes all of that at compile time:
+// - the policy is a struct of static functions whose parameters are template arguments
+//   (StaticRoundRobin<4>, StaticMLFQ<3, 2>)
+// - the ready structure is a template over the policy
+// - the memory model says whether a dispatch can fault
+// the compiler sees the whole dispatch path and inlines it.
+//
+// it runs the same event engine as Scheduler for arrivals, CPU bursts, quanta, I/O phases
+// (fixed delay) and resources, so the same workload gives the same metrics (os_bench checks
+// this). real-time tasks, process trees, I/O devices, telemetry, event tracing, snapshots and
+// verbose output need the runtime Scheduler; processes that use them are rejected at submit.
+
+// ---------------- policies ----------------
+// a static policy has the hooks of SchedulingPolicy as static functions:
+//   key(p)             order in a HeapReadyQueue, smallest first
+//   timeSlice(p)       0 = until the burst is done
+//   shouldPreempt(running, ranSoFar, candidate)
+//   onDescheduled(p, ran, sliceExpired)
+
+struct StaticFCFS {
+    static long long key(const PCB* p) { return 0; }
+    static int timeSlice(const PCB* p) { return 0; }
+    static bool shouldPreempt(const PCB* running, int ranSoFar, const PCB* candidate) { return false; }
+    static void onDescheduled(PCB* p, int ran, bool sliceExpired) {}
+    static std::string name() { return "FCFS"; }
+};
+
+template <int Quantum>
+struct StaticRoundRobin {
+    static_assert(Quantum > 0, "the quantum has to be positive");
+    static constexpr int quantum = Quantum;
+
+    static long long key(const PCB* p) { return 0; }
+    static int timeSlice(const PCB* p) { return Quantum; }
+    static bool shouldPreempt(const PCB* running, int ranSoFar, const PCB* candidate) { return false; }
+    static void onDescheduled(PCB* p, int ran, bool sliceExpired) {}
+    static std::string name() { return "Round Robin (q=" + std::to_string(Quantum) + ")"; }
+};
+
+// lower priority number first
+template <bool Preemptive>
+struct StaticPriority {
+    static long long key(const PCB* p) { return p->priority; }
+    static int timeSlice(const PCB* p) { return 0; }
+    static bool shouldPreempt(const PCB* running, int ranSoFar, const PCB* candidate) {
+        return Preemptive && candidate->priority < running->priority;
+    }
+    static void onDescheduled(PCB* p, int ran, bool sliceExpired) {}
+    static std::string name() { return Preemptive ? "Preemptive Priority" : "Priority"; }
+};
+
+// shortest remaining time first, the preemptive version is SRTF
+template <bool Preemptive>
+struct StaticSJF {
+    static long long key(const PCB* p) { return p->remaining_time; }
+    static int timeSlice(const PCB* p) { return 0; }
+    static bool shouldPreempt(const PCB* running, int ranSoFar, const PCB* candidate) {
+        return Preemptive && candidate->remaining_time < running->remaining_time - ranSoFar;
+    }
+    static void onDescheduled(PCB* p, int ran, bool sliceExpired) {}
+    static std::string name() { return Preemptive ? "SRTF" : "SJF"; }
+};
+
+// MLFQ without boosts, aging or an allotment: a used up quantum moves a process one level
+// down, the quantum doubles on every level. goes with LevelReadyQueue
+template <int Levels, int BaseQuantum>
+struct StaticMLFQ {
+    static_assert(Levels >= 1 && Levels <= 64, "one bit per level");
+    static_assert(BaseQuantum > 0, "the quantum has to be positive");
+    static constexpr int levels = Levels;
+
+    static constexpr int quantum(int level) { return BaseQuantum << (level < 20 ? level : 20); }
+
+    static long long key(const PCB* p) { return p->queue_level; }
+    static int timeSlice(const PCB* p) { return quantum(p->queue_level); }
+    static bool shouldPreempt(const PCB* running, int ranSoFar, const PCB* candidate) {
+        return candidate->queue_level < running->queue_level;
+    }
+    static void onDescheduled(PCB* p, int ran, bool sliceExpired) {
+        if (sliceExpired && p->queue_level + 1 < Levels) {
+            p->queue_level = p->queue_level + 1;
+            p->level_time = 0;
+        }
+    }
+    static std::string name() { return "MLFQ (" + std::to_string(Levels) + " levels)"; }
+};
+
+// ---------------- ready queues ----------------
+
+// arrival order, for FCFS and Round Robin
+template <class Policy>
+class FifoReadyQueue {
+private:
+    RingBuffer<PCB*> queue;
+
+public:
+    void push(PCB* p) { queue.push_back(p); }
+    PCB* pop() { return queue.pop_front(); }
+    bool empty() const { return queue.empty(); }
+    size_t size() const { return queue.size(); }
+};
+
+// binary heap on Policy::key, equal keys in FIFO order
+template <class Policy>
+class HeapReadyQueue {
+private:
+    std::vector<HeapEntry> heap;
+    uint64_t nextSeq = 0;
+
+public:
+    void push(PCB* p) {
+        HeapEntry e;
+        e.key = Policy::key(p);
+        e.seq = nextSeq;
+        e.process = p;
+        nextSeq = nextSeq + 1;
+        heap.push_back(e);
+        std::push_heap(heap.begin(), heap.end(), CompareHeapEntry());
+    }
+
+    PCB* pop() {
+        std::pop_heap(heap.begin(), heap.end(), CompareHeapEntry());
+        PCB* p = heap.back().process;
+        heap.pop_back();
+        return p;
+    }
+
+    bool empty() const { return heap.empty(); }
+    size_t size() const { return heap.size(); }
+};
+
+// one FIFO per PCB::queue_level and a bitmap of the non empty ones, needs Policy::levels
+template <class Policy>
+class LevelReadyQueue {
+private:
+    RingBuffer<PCB*> queues[Policy::levels];
+    uint64_t nonEmpty = 0;
+    size_t count = 0;
+
+public:
+    void push(PCB* p) {
+        int level = p->queue_level < 0 ? 0 : (p->queue_level >= Policy::levels ? Policy::levels - 1 : p->queue_level);
+        p->queue_level = level;
+        queues[level].push_back(p);
+        nonEmpty = nonEmpty | (1ULL << level);
+        count = count + 1;
+    }
+
+    PCB* pop() {
+        int level = __builtin_ctzll(nonEmpty);
+        PCB* p = queues[level].pop_front();
+        if (queues[level].empty()) nonEmpty = nonEmpty & ~(1ULL << level);
+        count = count - 1;
+        return p;
+    }
+
+    bool empty() const { return count == 0; }
+    size_t size() const { return count; }
+};
+
+// ---------------- memory models ----------------
+
+// contiguous allocators: memory is taken when a process is admitted, a dispatch never faults
+struct ContiguousMemory {
+    static int access(MemoryManager& memory, int pid, long long now) { return 0; }
+    static int faultCost(const MemoryManager& memory) { return 0; }
+    static bool accepts(const MemoryManager& memory) { return memory.get_config().model != MemoryModel::PAGED; }
+};
+
+// paged virtual memory: every dispatch touches the working set and may stall on faults
+struct PagedMemory {
+    static int access(MemoryManager& memory, int pid, long long now) { return memory.access_memory(pid, now); }
+    static int faultCost(const MemoryManager& memory) { return memory.get_fault_cost(); }
+    static bool accepts(const MemoryManager& memory) { return true; }
+};
+
+// ---------------- scheduler ----------------
+
+template <class Policy, template <class> class ReadyQueue, class Memory>
+class StaticScheduler {
+private:
+    ReadyQueue<Policy> ready;
+    PCB* runningProcess;
+    MemoryManager* memoryManager;
+    ResourceManager* resources;
+    std::vector<PCB*> woken;
+
+    EventQueue events;
+    long long sliceStart;
+    long long sliceToken;
+    long long simulation_time;
+
+    MetricsCollector metrics;
+    int lastRunPid;
+    uint64_t eventsHandled;
+    uint64_t decisions;
+
+public:
+    // throws runtime_error when the memory manager does not fit the memory model
+    StaticScheduler(MemoryManager* mm, ProcessQueues* pq) {
+        if (!Memory::accepts(*mm)) {
+            throw std::runtime_error("a paged memory manager needs the PagedMemory model");
+        }
+        memoryManager = mm;
+        resources = &pq->get_resources();
+        runningProcess = nullptr;
+        sliceStart = 0;
+        sliceToken = 0;
+        simulation_time = 0;
+        lastRunPid = 0;
+        eventsHandled = 0;
+        decisions = 0;
+    }
+
+    // same as Scheduler::submitProcess, throws runtime_error for what only Scheduler runs
+    void submitProcess(PCB* p) {
+        if (p->period > 0 || p->fork_children > 0) {
+            throw std::runtime_error("real-time tasks and fork programs need the runtime Scheduler");
+        }
+        p->state = ProcessState::NEW;
+        if (p->remaining_time <= 0) {
+            p->remaining_time = p->burst_time;
+        }
+        if (!p->phases.empty() && p->phase_remaining <= 0) {
+            p->phase_index = 0;
+            p->phase_remaining = p->phases[0];
+        }
+        events.push(std::max(p->arrival_time, simulation_time), EventType::ARRIVAL, p);
+    }
+
+    void runUntil(long long endTime) {
+        processEvents(endTime);
+        if (endTime > simulation_time) {
+            simulation_time = endTime;
+        }
+    }
+
+    void runToCompletion() {
+        processEvents(LLONG_MAX);
+    }
+
+    long long getCurrentTime() const { return simulation_time; }
+    const MetricsCollector& getMetrics() const { return metrics; }
+    uint64_t getEventsHandled() const { return eventsHandled; }
+    uint64_t getDecisions() const { return decisions; }
+    size_t readySize() const { return ready.size(); }
+    static std::string policyName() { return Policy::name(); }
+
+private:
+    void processEvents(long long endTime) {
+        if (runningProcess == nullptr) {
+            dispatch();
+        }
+        while (!events.empty() && events.top().time <= endTime) {
+            Event e = events.pop();
+            simulation_time = e.time;
+            eventsHandled = eventsHandled + 1;
+            switch (e.type) {
+                case EventType::ARRIVAL:
+                    handleArrival(e.process);
+                    break;
+                case EventType::BURST_COMPLETE:
+                    handleBurstComplete(e);
+                    break;
+                case EventType::QUANTUM_EXPIRE:
+                    handleQuantumExpire(e);
+                    break;
+                case EventType::RESOURCE_RELEASE:
+                    releaseResource(e.process);
+                    if (runningProcess == nullptr) dispatch();
+                    break;
+                case EventType::IO_COMPLETE:
+                    addToReadyQueue(e.process);
+                    if (runningProcess == nullptr) dispatch();
+                    break;
+                default:
+                    break;   // devices and real-time releases never get scheduled here
+            }
+        }
+    }
+
+    void addToReadyQueue(PCB* p) {
+        if (p->state == ProcessState::NEW) {
+            metrics.record_arrival(p);
+        }
+        p->state = ProcessState::READY;
+        p->ready_time = simulation_time;
+        ready.push(p);
+    }
+
+    void handleArrival(PCB* p) {
+        addToReadyQueue(p);
+        if (runningProcess == nullptr) {
+            dispatch();
+        } else if (Policy::shouldPreempt(runningProcess, (int)(simulation_time - sliceStart), p)) {
+            PCB* previous = runningProcess;
+            stopRunning(false);
+            addToReadyQueue(previous);
+            dispatch();
+        }
+    }
+
+    void handleBurstComplete(const Event& e) {
+        if (e.token != sliceToken || e.process != runningProcess) return;
+        PCB* p = e.process;
+        if (p->phase_index + 1 < (int)p->phases.size()) {
+            stopRunning(false);
+            startIO(p);
+        } else {
+            terminate(p);
+        }
+        dispatch();
+    }
+
+    void handleQuantumExpire(const Event& e) {
+        if (e.token != sliceToken || e.process != runningProcess) return;
+        PCB* p = runningProcess;
+        stopRunning(true);
+        addToReadyQueue(p);
+        dispatch();
+    }
+
+    void startIO(PCB* p) {
+        int io = p->phases[p->phase_index + 1];
+        p->phase_index = p->phase_index + 2;
+        p->phase_remaining = p->phase_index < (int)p->phases.size() ? p->phases[p->phase_index] : 0;
+        p->state = ProcessState::BLOCKED;
+        events.push(simulation_time + io, EventType::IO_COMPLETE, p);
+    }
+
+    void terminate(PCB* p) {
+        if (runningProcess == p) {
+            stopRunning(false);
+        }
+        p->state = ProcessState::TERMINATED;
+        p->remaining_time = 0;
+        memoryManager->release_process(p->pid, p->memory_required);
+        metrics.record_completion(p, simulation_time);
+        if (p->has_resource) {
+            events.push(simulation_time, EventType::RESOURCE_RELEASE, p);
+        }
+    }
+
+    void releaseResource(PCB* p) {
+        woken.clear();
+        if (!resources->release(p, p->required_resource, simulation_time, woken)) return;
+        for (size_t i = 0; i < woken.size(); i++) {
+            addToReadyQueue(woken[i]);
+        }
+    }
+
+    void stopRunning(bool sliceExpired) {
+        int used = (int)(simulation_time - sliceStart);
+        if (used < 0) {
+            used = 0;
+        }
+        metrics.record_busy(used);
+        Policy::onDescheduled(runningProcess, used, sliceExpired);
+        runningProcess->remaining_time = std::max(0, runningProcess->remaining_time - used);
+        if (!runningProcess->phases.empty()) {
+            runningProcess->phase_remaining = std::max(0, runningProcess->phase_remaining - used);
+        }
+        runningProcess = nullptr;
+        sliceToken = sliceToken + 1;
+    }
+
+    void dispatch() {
+        while (!ready.empty()) {
+            PCB* p = ready.pop();
+            decisions = decisions + 1;
+            runningProcess = p;
+            p->state = ProcessState::RUNNING;
+            sliceStart = simulation_time;
+
+            if (!p->has_resource && !p->required_resource.empty() && p->remaining_time > 0) {
+                AccessMode mode = p->shared_access ? AccessMode::SHARED : AccessMode::EXCLUSIVE;
+                if (!resources->acquire(p, p->required_resource, mode, simulation_time)) {
+                    p->state = ProcessState::BLOCKED;
+                    stopRunning(false);
+                    continue;
+                }
+            }
+
+            metrics.record_dispatch(p, simulation_time);
+            if (lastRunPid != 0 && lastRunPid != p->pid) {
+                metrics.record_context_switch();
+            }
+            lastRunPid = p->pid;
+
+            int faults = Memory::access(*memoryManager, p->pid, simulation_time);
+            sliceStart = simulation_time + (long long)faults * Memory::faultCost(*memoryManager);
+
+            sliceToken = sliceToken + 1;
+            int slice = p->remaining_time;
+            if (!p->phases.empty() && p->phase_remaining < slice) {
+                slice = p->phase_remaining;
+            }
+            EventType kind = EventType::BURST_COMPLETE;
+            int quantum = Policy::timeSlice(p);
+            if (quantum > 0 && quantum < slice) {
+                slice = quantum;
+                kind = EventType::QUANTUM_EXPIRE;
+            }
+            events.push(sliceStart + slice, kind, p, sliceToken);
+            return;
+        }
+        runningProcess = nullptr;
+    }
+};
+
+// configurations pinned for large runs, each behaves like createPolicy(name) with the
+// default PolicyParams on a contiguous memory manager
+typedef StaticScheduler<StaticFCFS, FifoReadyQueue, ContiguousMemory> StaticFCFSScheduler;
+typedef StaticScheduler<StaticRoundRobin<4>, FifoReadyQueue, ContiguousMemory> StaticRoundRobinScheduler;
+typedef StaticScheduler<StaticPriority<true>, HeapReadyQueue, ContiguousMemory> StaticPriorityScheduler;
+typedef StaticScheduler<StaticSJF<false>, HeapReadyQueue, ContiguousMemory> StaticSJFScheduler;
+typedef StaticScheduler<StaticSJF<true>, HeapReadyQueue, ContiguousMemory> StaticSRTFScheduler;
+typedef StaticScheduler<StaticMLFQ<3, 2>, LevelReadyQueue, ContiguousMemory> StaticMLFQScheduler;
+
+#endif // STATIC_SCHEDULER_H
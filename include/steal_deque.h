@@ -0,0 +1,110 @@
+#ifndef STEAL_DEQUE_H
+#define STEAL_DEQUE_H
+
+#include <atomic>
+#include <vector>
+#include <cstdint>
+
+// lock-free work stealing deque (Chase-Lev)
+// only the owning thread may push, any thread (owner included) may take from the top.
+// taking from the top keeps the local run queue in FIFO order for the owner as well.
+// when the array is full the owner doubles it, old arrays are kept until the deque
+// is destroyed so a thief that still reads an old array never touches freed memory.
+template <typename T>
+class StealDeque {
+private:
+    struct Array {
+        int64_t capacity;
+        std::atomic<T>* slots;
+
+        Array(int64_t cap) : capacity(cap), slots(new std::atomic<T>[cap]) {}
+        ~Array() { delete[] slots; }
+
+        T get(int64_t i) const { return slots[i & (capacity - 1)].load(std::memory_order_relaxed); }
+        void put(int64_t i, T item) { slots[i & (capacity - 1)].store(item, std::memory_order_relaxed); }
+    };
+
+    alignas(64) std::atomic<int64_t> top;      // next index to take
+    alignas(64) std::atomic<int64_t> bottom;   // next index to push
+    std::atomic<Array*> array;
+    std::vector<Array*> retired;               // old arrays, owner only
+
+    // copy live elements into an array twice as big
+    Array* grow(Array* old, int64_t b, int64_t t) {
+        Array* bigger = new Array(old->capacity * 2);
+        for (int64_t i = t; i < b; i++) {
+            bigger->put(i, old->get(i));
+        }
+        retired.push_back(old);
+        array.store(bigger, std::memory_order_release);
+        return bigger;
+    }
+
+public:
+    StealDeque(int64_t initial_capacity = 64) : top(0), bottom(0) {
+        int64_t cap = 1;
+        while (cap < initial_capacity) cap = cap * 2;
+        array.store(new Array(cap), std::memory_order_relaxed);
+    }
+
+    ~StealDeque() {
+        delete array.load(std::memory_order_relaxed);
+        for (size_t i = 0; i < retired.size(); i++) {
+            delete retired[i];
+        }
+    }
+
+    StealDeque(const StealDeque&) = delete;
+    StealDeque& operator=(const StealDeque&) = delete;
+
+    // owner only
+    void push(T item) {
+        int64_t b = bottom.load(std::memory_order_relaxed);
+        int64_t t = top.load(std::memory_order_acquire);
+        Array* a = array.load(std::memory_order_relaxed);
+        if (b - t >= a->capacity) {
+            a = grow(a, b, t);
+        }
+        a->put(b, item);
+        std::atomic_thread_fence(std::memory_order_release);
+        bottom.store(b + 1, std::memory_order_relaxed);
+    }
+
+    // any thread, returns false when empty or when another thread won the race
+    bool steal(T& out) {
+        int64_t t = top.load(std::memory_order_acquire);
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        int64_t b = bottom.load(std::memory_order_acquire);
+        if (t >= b) return false;
+
+        Array* a = array.load(std::memory_order_consume);
+        T item = a->get(t);
+        if (!top.compare_exchange_strong(t, t + 1, std::memory_order_seq_cst, std::memory_order_relaxed)) {
+            return false;  // lost the race
+        }
+        out = item;
+        return true;
+    }
+
+    // the element steal would take next, only while no other thread takes or pushes
+    bool peek(T& out) const {
+        int64_t t = top.load(std::memory_order_relaxed);
+        int64_t b = bottom.load(std::memory_order_relaxed);
+        if (t >= b) return false;
+        out = array.load(std::memory_order_relaxed)->get(t);
+        return true;
+    }
+
+    // approximate number of elements (exact when no other thread is active)
+    int64_t size() const {
+        int64_t b = bottom.load(std::memory_order_relaxed);
+        int64_t t = top.load(std::memory_order_relaxed);
+        return b > t ? b - t : 0;
+    }
+
+    bool empty() const {
+        return size() == 0;
+    }
+};
+
+#endif // STEAL_DEQUE_H
@@ -0,0 +1,177 @@
+#ifndef TELEMETRY_H
+#define TELEMETRY_H
+
+#include <string>
+#include <vector>
+#include <memory>
+#include <atomic>
+#include <mutex>
+#include <thread>
+#include <cstdint>
+#include <iostream>
+
+// live metrics of a running simulation
+//
+// the simulation thread updates counters, gauges and histograms with relaxed atomic
+// operations only: no locks, no allocation, no formatting on the hot path. readers (the
+// socket server, the file exporter) load the same atomics from another thread whenever
+// they want a picture. a value read in the middle of a run can be a few updates behind
+// its neighbours, totals are never lost. the registry lock is only taken when metrics are
+// created and when the whole registry is rendered.
+//
+// every metric lives as long as its registry and never moves, so the simulation keeps
+// plain pointers to the ones it updates.
+
+// monotonically increasing count
+class TelemetryCounter {
+private:
+    std::atomic<uint64_t> value;
+
+public:
+    TelemetryCounter() : value(0) {}
+    void add(uint64_t n = 1) { value.fetch_add(n, std::memory_order_relaxed); }
+    uint64_t get() const { return value.load(std::memory_order_relaxed); }
+};
+
+// value that goes up and down (queue length, memory in use)
+class TelemetryGauge {
+private:
+    std::atomic<int64_t> value;
+
+public:
+    TelemetryGauge() : value(0) {}
+    void set(int64_t v) { value.store(v, std::memory_order_relaxed); }
+    void add(int64_t n) { value.fetch_add(n, std::memory_order_relaxed); }
+    int64_t get() const { return value.load(std::memory_order_relaxed); }
+};
+
+// HDR style histogram over non negative integers: values below 128 get their own bucket,
+// above that every power of two is split into 64 buckets, so a recorded value is known to
+// within 1/64 (1.6%) over the whole 64 bit range. recording is one bucket index (a count
+// leading zeros) and three relaxed increments, the bucket array is fixed (about 30 KB)
+class TelemetryHistogram {
+public:
+    static const int SUB_BUCKET_BITS = 7;
+    static const int SUB_BUCKETS = 1 << SUB_BUCKET_BITS;
+    static const int HALF_BUCKETS = SUB_BUCKETS / 2;
+    static const int BUCKETS = SUB_BUCKETS + (64 - SUB_BUCKET_BITS) * HALF_BUCKETS;
+
+private:
+    std::atomic<uint64_t> counts[BUCKETS];
+    std::atomic<uint64_t> total;
+    std::atomic<uint64_t> sum;
+    std::atomic<uint64_t> maximum;
+
+public:
+    TelemetryHistogram();
+
+    static int bucketIndex(uint64_t value);
+    static uint64_t bucketLow(int index);    // smallest value of a bucket
+    static uint64_t bucketHigh(int index);   // largest value of a bucket
+
+    void record(int64_t value) {
+        uint64_t v = value > 0 ? (uint64_t)value : 0;
+        counts[bucketIndex(v)].fetch_add(1, std::memory_order_relaxed);
+        total.fetch_add(1, std::memory_order_relaxed);
+        sum.fetch_add(v, std::memory_order_relaxed);
+        uint64_t seen = maximum.load(std::memory_order_relaxed);
+        while (v > seen && !maximum.compare_exchange_weak(seen, v, std::memory_order_relaxed)) {
+        }
+    }
+
+    uint64_t count() const;
+    uint64_t getSum() const;
+    uint64_t getMax() const;
+
+    // q in [0, 1], middle of the bucket holding that rank, 0 when empty
+    double quantile(double q) const;
+
+    // several quantiles (ascending) in one pass over the buckets
+    void quantiles(const double* qs, double* out, int n) const;
+};
+
+enum class TelemetryKind { COUNTER, GAUGE, HISTOGRAM };
+
+// all metrics of a process, rendered in the Prometheus text exposition format.
+// a metric is a name plus a label set, asking for the same pair twice gives the same object
+class MetricsRegistry {
+private:
+    struct Series {
+        std::string labels;   // rendered label list without braces, e.g. resource="disk"
+        std::unique_ptr<TelemetryCounter> counter;
+        std::unique_ptr<TelemetryGauge> gauge;
+        std::unique_ptr<TelemetryHistogram> histogram;
+    };
+
+    struct Family {
+        std::string name;
+        std::string help;
+        TelemetryKind kind;
+        std::vector<std::unique_ptr<Series>> series;
+    };
+
+    mutable std::mutex lock;
+    std::vector<std::unique_ptr<Family>> families;
+
+    Series& find(const std::string& name, const std::string& help, TelemetryKind kind, const std::string& labels);
+
+public:
+    // throws runtime_error when the name is already used by another kind of metric
+    TelemetryCounter& counter(const std::string& name, const std::string& help, const std::string& labels = "");
+    TelemetryGauge& gauge(const std::string& name, const std::string& help, const std::string& labels = "");
+    TelemetryHistogram& histogram(const std::string& name, const std::string& help, const std::string& labels = "");
+
+    // key="value" with the value escaped, join several with a comma
+    static std::string label(const std::string& key, const std::string& value);
+
+    // every metric in text format, histograms as summaries (quantiles 0.5, 0.9, 0.99, 0.999,
+    // _sum, _count). with timestamp >= 0 every sample carries it, used for time series
+    void writePrometheus(std::ostream& out, long long timestamp = -1) const;
+    std::string prometheusText() const;
+
+    // writes to path.tmp and renames it over path, so a reader never sees half a file.
+    // throws runtime_error when the file cannot be written
+    void writeFile(const std::string& path) const;
+
+    size_t size() const;
+};
+
+// how a simulation feeds a registry (see Scheduler::enableTelemetry)
+struct TelemetryConfig {
+    long long sample_interval = 100;   // simulated ticks between samples of queue lengths, memory ...
+    std::string series_path;           // every sample appends the registry with the simulated time
+                                       // as timestamp, empty = no time series
+    std::string export_path;           // rewritten with the current registry, empty = off
+    int export_interval_ms = 1000;     // wall clock time between two rewrites of export_path
+    std::string instance;              // instance label on every metric, empty = none
+};
+
+// serves the registry on a local Unix socket, one scrape per connection. an HTTP GET gets an
+// HTTP answer (curl --unix-socket path http://localhost/metrics), any other client gets the
+// plain text (nc -U path, socat). the server runs on its own thread and only reads atomics
+class TelemetryServer {
+private:
+    const MetricsRegistry& registry;
+    std::string path;
+    int listenFd;
+    std::thread worker;
+    std::atomic<bool> running;
+    std::atomic<uint64_t> scrapes;
+
+    void serve();
+
+public:
+    TelemetryServer(const MetricsRegistry& registry);
+    ~TelemetryServer();
+
+    // false when the socket cannot be created (or on Windows, which has no Unix sockets here)
+    bool start(const std::string& path);
+    void stop();
+
+    uint64_t getScrapes() const;
+};
+
+// connects to a TelemetryServer and reads one scrape, false when nobody is listening
+bool scrapeTelemetrySocket(const std::string& path, std::string& text);
+
+#endif // TELEMETRY_H
@@ -0,0 +1,238 @@
+#ifndef TRACE_LOADER_H
+#define TRACE_LOADER_H
+
+#include <string>
+#include <vector>
+#include <memory>
+#include <fstream>
+#include <cstdint>
+#include <unordered_map>
+#include <algorithm>
+#include "pcb.h"
+#include "scheduler.h"
+#include "memory_manager.h"
+#include "metrics.h"
+#include "process_table.h"
+
+// one process from a workload trace
+struct TraceRecord {
+    int pid = 0;
+    long long arrival = 0;
+    int priority = 0;
+    int memory = 0;
+    std::string resource;        // "" = needs no resource
+    std::vector<int> phases;     // alternating cpu, io, cpu, ... ticks, starts with a CPU burst
+};
+
+// fill a PCB from a trace record, burst_time is the total CPU time of all phases
+void traceRecordToPCB(const TraceRecord& r, PCB* p);
+
+// reads trace records one at a time, records come out in the order they are stored
+// (traces are expected to be sorted by arrival time)
+class TraceSource {
+public:
+    virtual ~TraceSource() {}
+
+    // false when there are no more records
+    virtual bool next(TraceRecord& r) = 0;
+
+    // number of records if the format knows it up front, -1 otherwise
+    virtual long long size() const { return -1; }
+
+    virtual std::string format() const = 0;
+};
+
+// CSV, one process per line, read line by line:
+//   pid,arrival,priority,memory,resource,phases
+//   1,0,3,120,disk,5;2;3
+// phases are separated by ';', a header line and lines starting with '#' are skipped
+class CsvTraceSource : public TraceSource {
+private:
+    std::ifstream in;
+    long long lineNumber;
+
+public:
+    CsvTraceSource(const std::string& path);
+    bool next(TraceRecord& r) override;
+    std::string format() const override;
+};
+
+// JSON array of objects, for small hand written traces (the whole file is parsed up front):
+//   [ {"pid": 1, "arrival": 0, "priority": 3, "memory": 120, "resource": "disk", "phases": [5, 2, 3]} ]
+class JsonTraceSource : public TraceSource {
+private:
+    std::vector<TraceRecord> records;
+    size_t position;
+
+public:
+    JsonTraceSource(const std::string& path);
+    bool next(TraceRecord& r) override;
+    long long size() const override;
+    std::string format() const override;
+};
+
+// compact binary columnar format for very large traces
+//
+//   header   : magic "OSTRACE1", version, record count, block count, resource table offset
+//   blocks   : record count, phase count, then one column after the other:
+//              pid (int32), arrival (int64), priority (int32), memory (int32),
+//              resource id (int32), phase count per record (int32), phases (int32)
+//   resources: count, then (length, bytes) per name, id 0 is ""
+//
+// blocks hold up to TRACE_BLOCK_RECORDS records, so the writer never buffers more than
+// one block and the reader walks the file front to back through a memory mapping
+const uint32_t TRACE_BLOCK_RECORDS = 65536;
+
+class BinaryTraceWriter {
+private:
+    std::ofstream out;
+    std::vector<TraceRecord> block;
+    ResourceInterner resources;
+    uint64_t recordCount;
+    uint64_t blockCount;
+
+    void flushBlock();
+
+public:
+    BinaryTraceWriter(const std::string& path);
+    ~BinaryTraceWriter();
+
+    bool good() const;
+    void write(const TraceRecord& r);
+
+    // writes the last block, the resource table and the final header
+    void close();
+};
+
+class BinaryTraceSource : public TraceSource {
+private:
+    const unsigned char* data;   // mapped file
+    size_t length;               // end of the block area
+    size_t mappedLength;
+    std::vector<unsigned char> fallback;   // used where mmap is not available
+    int fd;
+
+    uint64_t recordCount;
+    std::vector<std::string> resources;
+
+    // current block
+    size_t blockOffset;          // start of the next block
+    uint32_t blockRecords;
+    uint32_t blockIndex;         // next record in the block
+    uint64_t blockPhasesLeft;    // phases of the block not handed out yet
+    const unsigned char* pidColumn;
+    const unsigned char* arrivalColumn;
+    const unsigned char* priorityColumn;
+    const unsigned char* memoryColumn;
+    const unsigned char* resourceColumn;
+    const unsigned char* phaseCountColumn;
+    const unsigned char* phaseColumn;
+
+    bool loadBlock();
+
+public:
+    BinaryTraceSource(const std::string& path);
+    ~BinaryTraceSource();
+
+    bool next(TraceRecord& r) override;
+    long long size() const override;
+    std::string format() const override;
+};
+
+// picks the reader from the file: binary if it starts with the magic, otherwise by extension
+// (.json or .csv). throws runtime_error when the file cannot be opened or parsed
+std::unique_ptr<TraceSource> openTrace(const std::string& path);
+
+// copy every record of a trace into a binary trace file, returns the record count
+long long convertTrace(TraceSource& source, const std::string& binaryPath);
+
+// result of a trace replay
+struct ReplayResult {
+    long long submitted;      // records handed to the scheduler
+    long long rejected;       // records that did not fit in memory
+    long long peak_live;      // most PCBs in use at the same time
+    MetricsSummary summary;
+};
+
+// feeds a trace into a scheduler lazily: only records that arrive within the next window
+// ticks are turned into PCBs, and PCBs of finished processes go straight back to the pool.
+// memory use depends on how many processes are alive at once, not on the trace length.
+class TraceReplayer {
+private:
+    Scheduler* scheduler;
+    MemoryManager* memory;
+    long long window;
+    long long endTime;   // 0 = run until every process finished
+    PCBPool pool;
+    std::vector<PCB*> live;
+    size_t reclaimAt;   // sweep live when it grows this big, keeps sweeping amortized O(1)
+
+    void reclaim();
+
+public:
+    // scheduler may be nullptr when only replayInto is used
+    TraceReplayer(Scheduler* scheduler, MemoryManager* memory, long long window = 1024);
+
+    // stop the replay at this time: later records are not read and the simulation is left
+    // where it is then, unfinished processes included. 0 = run until every process finished
+    void setEndTime(long long time);
+
+    ReplayResult replay(TraceSource& source);
+
+    // the same into any simulation with submitProcess, runUntil, runToCompletion,
+    // getCurrentTime and getMetrics, e.g. a StaticScheduler
+    template <class Simulation>
+    ReplayResult replayInto(Simulation& simulation, TraceSource& source);
+};
+
+// alternate between loading one window of arrivals and simulating up to the end of it
+template <class Simulation>
+ReplayResult TraceReplayer::replayInto(Simulation& simulation, TraceSource& source) {
+    ReplayResult result;
+    result.submitted = 0;
+    result.rejected = 0;
+    result.peak_live = 0;
+
+    TraceRecord r;
+    bool have = source.next(r);
+    while (have && (endTime <= 0 || r.arrival < endTime)) {
+        long long windowEnd = std::max(r.arrival, simulation.getCurrentTime()) + window;
+        if (endTime > 0 && windowEnd > endTime) {
+            windowEnd = endTime;
+        }
+
+        while (have && r.arrival < windowEnd) {
+            PCB* p = pool.acquire();
+            traceRecordToPCB(r, p);
+            if (memory->allocate_process(p->pid, p->memory_required)) {
+                simulation.submitProcess(p);
+                live.push_back(p);
+                result.submitted = result.submitted + 1;
+            } else {
+                result.rejected = result.rejected + 1;
+                pool.release(p);
+            }
+            have = source.next(r);
+        }
+        if ((long long)live.size() > result.peak_live) {
+            result.peak_live = (long long)live.size();
+        }
+
+        // everything before the next unread arrival can be simulated now
+        simulation.runUntil(windowEnd - 1);
+        if (live.size() >= reclaimAt) {
+            reclaim();
+        }
+    }
+
+    if (endTime > 0) {
+        simulation.runUntil(endTime);
+    } else {
+        simulation.runToCompletion();
+    }
+    reclaim();
+    result.summary = simulation.getMetrics().summary();
+    return result;
+}
+
+#endif // TRACE_LOADER_H
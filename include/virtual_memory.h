@@ -0,0 +1,149 @@
+#ifndef VIRTUAL_MEMORY_H
+#define VIRTUAL_MEMORY_H
+
+#include <vector>
+#include <set>
+#include <deque>
+#include <tuple>
+#include <string>
+#include <memory>
+#include <cstdint>
+#include <unordered_map>
+
+class SnapshotWriter;
+class SnapshotReader;
+
+// page replacement algorithms
+enum class ReplacementPolicy { FIFO, LRU, LFU, CLOCK, WORKING_SET };
+
+// one entry of a per process page table
+struct PageTableEntry {
+    int frame = -1;        // physical frame when present
+    int swap_slot = -1;    // slot in the swap area when swapped out
+    bool present = false;  // page is in a frame right now
+};
+
+// what is stored in a physical frame
+struct FrameInfo {
+    int pid = -1;               // owner, -1 = free frame
+    int page = -1;              // virtual page number of the owner
+    long long loaded_at = 0;    // time the page was brought in
+    long long last_use = 0;     // time of the last access
+    uint64_t use_count = 0;     // accesses since load (LFU)
+    uint64_t load_seq = 0;      // unique id of this load, lets FIFO skip freed frames
+    bool referenced = false;    // reference bit (Clock, Working-Set)
+    bool dirty = false;         // page was written, needs swap out on eviction
+};
+
+// interface for the replacement algorithms, they only see frame numbers
+class ReplacementStrategy {
+public:
+    virtual ~ReplacementStrategy() {}
+    virtual void onLoad(int frame, const std::vector<FrameInfo>& frames) = 0;
+    virtual void onAccess(int frame, const std::vector<FrameInfo>& frames) = 0;
+    virtual void onFree(int frame, const std::vector<FrameInfo>& frames) = 0;
+    // pick a frame to evict, every frame is in use when this is called
+    virtual int chooseVictim(std::vector<FrameInfo>& frames, long long now) = 0;
+    virtual std::string name() const = 0;
+
+    virtual void saveState(SnapshotWriter& out) const = 0;
+    virtual void loadState(SnapshotReader& in) = 0;
+};
+
+// per process counters
+struct PageStats {
+    uint64_t accesses = 0;
+    uint64_t faults = 0;
+};
+
+// totals for the whole memory system
+struct VirtualMemoryStats {
+    uint64_t accesses = 0;
+    uint64_t faults = 0;
+    uint64_t evictions = 0;
+    uint64_t swap_ins = 0;
+    uint64_t swap_outs = 0;
+};
+
+// demand paged virtual memory: page tables per process, a frame table, a swap area
+// and a pluggable replacement policy. a process only needs virtual pages to exist,
+// physical frames are taken on first touch and stolen from others when memory is full.
+class VirtualMemory {
+private:
+    struct ProcessPages {
+        std::vector<PageTableEntry> table;
+        PageStats stats;
+        uint64_t rng;   // drives this process' reference string
+        int group = -1; // charge group its frames count against, -1 = none
+    };
+
+    // charge groups (control groups): every frame counts against the group of its process
+    // and every group above it. a fault in a group at its limit replaces the oldest page
+    // loaded in that group instead of asking the replacement policy, so one group can not
+    // push the pages of another one out
+    struct ChargeGroup {
+        int parent = -1;
+        int limit = 0;        // resident pages, 0 = no limit
+        int resident = 0;
+        uint64_t reclaims = 0;
+    };
+
+    std::vector<FrameInfo> frames;
+    std::vector<int> freeFrames;
+    std::vector<int> freeSwapSlots;
+    int swapSlots;
+    int committedPages;          // virtual pages handed out to live processes
+    uint64_t nextLoadSeq;
+    std::unordered_map<int, ProcessPages> processes;
+    std::unique_ptr<ReplacementStrategy> strategy;
+    VirtualMemoryStats stats;
+    std::vector<ChargeGroup> groups;
+    // (frame, load_seq) of the pages loaded in each limited group, oldest first. entries of
+    // pages that are gone since are skipped when they come up
+    std::vector<std::deque<std::pair<int, uint64_t>>> groupLoads;
+
+    int takeFrame(long long now);
+    void evict(int frame);
+    void chargeFrame(int group, int frame, int delta);
+    int reclaimFrame(int group);
+
+public:
+    // frames and swapSlots are counted in pages, wsWindow is the working set window in ticks
+    VirtualMemory(int frames, int swapSlots, ReplacementPolicy policy, int wsWindow = 50);
+
+    // reserve virtual pages, fails only when frames + swap together cannot hold them
+    bool createProcess(int pid, int pages);
+
+    // free all frames and swap slots of a process
+    void destroyProcess(int pid);
+
+    // touch one page, returns true when it caused a page fault
+    bool access(int pid, int page, bool write, long long now);
+
+    // simulate count references of a process with 80/20 locality, returns number of faults
+    int touchWorkingSet(int pid, int count, long long now);
+
+    const PageStats* processStats(int pid) const;
+    const VirtualMemoryStats& totals() const;
+    int frameCount() const;
+    int freeFrameCount() const;
+    int uncommittedPages() const;   // frames + swap not promised to any process yet
+    int residentPages(int pid) const;
+    std::string policyName() const;
+
+    // charge groups, limit in pages (0 = none). a parent has to be set up before its
+    // children, a process is put in a group right after createProcess
+    void setChargeGroup(int group, int parent, int limit);
+    void setProcessGroup(int pid, int group);
+    int groupResident(int group) const;
+    uint64_t groupReclaims(int group) const;
+
+    // frames, page tables, swap slots and the replacement state. loading expects an
+    // instance built with the same frame count and replacement policy
+    void saveState(SnapshotWriter& out) const;
+    void loadState(SnapshotReader& in);
+};
+
+std::unique_ptr<ReplacementStrategy> createReplacementStrategy(ReplacementPolicy policy, int frames, int wsWindow);
+
+#endif // VIRTUAL_MEMORY_H
@@ -0,0 +1,153 @@
+#ifndef WORKLOAD_GENERATOR_H
+#define WORKLOAD_GENERATOR_H
+
+#include <vector>
+#include <string>
+#include <cstdint>
+#include "pcb.h"
+#include "trace_loader.h"
+
+class SnapshotWriter;
+class SnapshotReader;
+
+// Philox4x32-10 counter based random number generator (Salmon et al.)
+// output only depends on (key, counter), so any record can be generated on its own,
+// in any order, on any thread, and always gives the same numbers
+struct Philox4x32 {
+    static void generate(const uint32_t counter[4], const uint32_t key[2], uint32_t out[4]);
+};
+
+// sequential random stream on top of Philox, one per (seed, stream id)
+// two streams with different ids never overlap, no shared state like rand()
+class CounterRng {
+private:
+    uint32_t key[2];
+    uint32_t stream;
+    uint64_t position;   // next Philox block
+    uint32_t buffer[4];
+    int used;            // words of buffer already handed out
+
+public:
+    CounterRng(uint64_t seed, uint32_t stream = 0);
+
+    uint32_t nextU32();
+    double nextDouble();           // uniform in (0, 1]
+    int nextInt(int low, int high);  // uniform in [low, high]
+
+    // jump to a block, every block is 4 words
+    void seek(uint64_t block);
+
+    void saveState(SnapshotWriter& out) const;
+    void loadState(SnapshotReader& in);
+};
+
+// Zipf popularity over n items: item k (0 based) has weight 1 / (k+1)^s, s = 0 is uniform
+class ZipfTable {
+private:
+    std::vector<double> cdf;
+
+public:
+    ZipfTable(int n = 1, double s = 0);
+    int sample(double u) const;   // u uniform in (0, 1]
+    int size() const;
+};
+
+enum class BurstDistribution { UNIFORM, EXPONENTIAL, PARETO };
+
+// what the synthetic workload looks like
+struct WorkloadConfig {
+    uint64_t seed = 1;
+    long long count = 20;
+
+    // Poisson arrivals: mean arrivals per tick, 0 = everything arrives at time 0
+    double arrival_rate = 0;
+
+    // CPU burst: uniform in [burst_min, burst_max], exponential with burst_mean,
+    // or Pareto with scale burst_min and pareto_shape. always clamped to [burst_min, burst_max]
+    BurstDistribution burst = BurstDistribution::UNIFORM;
+    int burst_min = 1;
+    int burst_max = 10;
+    double burst_mean = 5;
+    double pareto_shape = 1.5;
+
+    int priority_levels = 10;     // priority uniform in [0, priority_levels)
+
+    // resource popularity follows Zipf(zipf_s) over this list ("" = no resource)
+    std::vector<std::string> resources = {"file1", "printer", "disk", ""};
+    double zipf_s = 0;
+
+    // bimodal memory: small_fraction of processes are small, the rest large
+    double small_fraction = 1.0;
+    int small_min = 100;
+    int small_max = 299;
+    int large_min = 512;
+    int large_max = 1024;
+
+    // with io_probability the burst is split around one I/O phase of mean io_mean ticks
+    double io_probability = 0;
+    double io_mean = 8;
+};
+
+// generated processes, one column per field
+struct WorkloadBatch {
+    std::vector<int> pid;
+    std::vector<long long> arrival;
+    std::vector<int> burst;
+    std::vector<int> priority;
+    std::vector<int> memory;
+    std::vector<int> resource;       // index into WorkloadConfig::resources
+    std::vector<int> io;             // I/O ticks, 0 = no I/O phase
+    std::vector<int> cpu_before_io;  // CPU ticks before the I/O phase
+
+    void resize(size_t n);
+    size_t size() const;
+};
+
+// deterministic synthetic workload generator
+// record i only depends on (seed, i): every field is drawn from its own Philox stream
+// with the record index as counter. arrival gaps are summed in fixed point integers, so
+// batches, threads and chunk sizes never change a single bit of the output
+class WorkloadGenerator {
+private:
+    WorkloadConfig config;
+    uint32_t key[2];
+    ZipfTable zipf;
+
+    // fields of records [first, first + n), arrival holds the fixed point running sum of
+    // the gaps inside this range only
+    void fill(uint64_t first, size_t n, WorkloadBatch& out, size_t offset) const;
+
+public:
+    WorkloadGenerator(const WorkloadConfig& config);
+
+    // the whole workload, generated in parallel (threads <= 0 = one per hardware thread)
+    WorkloadBatch generate(int threads = 0) const;
+
+    // records [first, first + n), arrivalBase is the fixed point arrival of record first - 1
+    // (0 for the first batch), returns the fixed point arrival of the last record
+    long long generateBatch(uint64_t first, size_t n, long long arrivalBase, WorkloadBatch& out) const;
+
+    void toPCB(const WorkloadBatch& batch, size_t i, PCB* p) const;
+    void toRecord(const WorkloadBatch& batch, size_t i, TraceRecord& r) const;
+
+    const WorkloadConfig& getConfig() const;
+};
+
+// streams a generated workload batch by batch, can be replayed or written as a binary trace
+class GeneratedTraceSource : public TraceSource {
+private:
+    WorkloadGenerator generator;
+    WorkloadBatch batch;
+    size_t batchPosition;
+    uint64_t nextRecord;
+    long long arrivalFixed;
+
+public:
+    GeneratedTraceSource(const WorkloadConfig& config);
+
+    bool next(TraceRecord& r) override;
+    long long size() const override;
+    std::string format() const override;
+};
+
+#endif // WORKLOAD_GENERATOR_H
@@ -1,157 +1,1159 @@
 #include <iostream>
 #include <vector>
 #include <cstdlib>
-#include <ctime>
+#include <cstdint>
 
 #include "memory_manager.h"
 #include "process_queues.h"
 #include "scheduler.h"
 #include "pcb.h"
+#include "multicore.h"
+#include "experiment.h"
+#include "process_table.h"
+#include "trace_loader.h"
+#include "workload_generator.h"
+#include "event_trace.h"
+#include "deadlock.h"
+#include "snapshot.h"
+#include "realtime.h"
+#include "telemetry.h"
+#include "admission.h"
+#include "batch_scheduler.h"
+#include "cgroup.h"
+#include "run_config.h"
+#include <filesystem>
+#include <fstream>
+#include <iomanip>
+#include <stdexcept>
+#include <chrono>
+#include <cmath>
 
 using namespace std;
 
-// function to make copies of processes for testing different algorithms
-// each algorithm needs its own copy so they dont interfere with each other
-vector<PCB*> cloneProcesses(vector<PCB*>& original) {
-    vector<PCB*> clones;
-    for (int i = 0; i < original.size(); i++) {  // traditional for loop instead of auto
-        PCB* p = original[i];
-        PCB* newP = new PCB(*p);  // create new PCB copy
-        newP->state = ProcessState::READY;
-        newP->has_resource = false;
-        clones.push_back(newP);
-    }
-    return clones;
-}
+int main(int argc, char** argv) {
+    // defaults, then the config file, then the command line (see run_config.h)
+    RunConfig config;
+    try {
+        if (!parseCommandLine(config, argc, argv)) {
+            cout << runUsage();
+            return 0;
+        }
+    } catch (const exception& e) {
+        cerr << e.what() << endl << "os_simulator --help lists the options" << endl;
+        return 2;
+    }
+
+    // one configured simulation instead of the demo, e.g. for parameter sweeps. headless
+    // nothing but the final metrics is printed
+    if (config.mode == "run" || config.headless) {
+        try {
+            RunReport report = runConfigured(config);
+            if (config.metrics_path.empty()) {
+                writeRunReport(cout, config, report, true);
+            } else {
+                // appended, so every run of a sweep adds its line. csv gets its header once
+                bool fresh = !filesystem::exists(config.metrics_path) || filesystem::file_size(config.metrics_path) == 0;
+                ofstream metricsFile(config.metrics_path, ios::app);
+                if (!metricsFile) {
+                    cerr << "cannot write " << config.metrics_path << endl;
+                    return 1;
+                }
+                writeRunReport(metricsFile, config, report, fresh);
+            }
+        } catch (const exception& e) {
+            cerr << e.what() << endl;
+            return 1;
+        }
+        return 0;
+    }
 
-int main() {
-    srand(static_cast<unsigned>(time(nullptr)));
+    // every random choice comes from this seed, so two runs print the same thing
+    const uint64_t seed = config.seed;
+    srand(static_cast<unsigned>(seed));
 
 
     // main memory going to be used throughout the program (for all schedulers)
-    MemoryManager memory;
+    // paged virtual memory with a swap area by default, so processes no longer get rejected when RAM is full
+    MemoryConfig memoryConfig = config.memory;
+    MemoryManager memory(memoryConfig);
 
     // queues going to be used by all schedulers (blocked and ready)
     ProcessQueues queues;
 
     
-    // created different schedulers for testing different algorithms
+    // scheduler used for the step by step preemptive priority demo
     Scheduler scheduler(&memory, &queues);
-    Scheduler priorityScheduler(&memory, &queues);
-    Scheduler sjfScheduler(&memory, &queues);
-    Scheduler rrScheduler(&memory, &queues);
 
 
 
     // created list for processes. currently taking 3 resources only + 1 for no resource required
+    // the workload generator has its own counter based random streams, the defaults give
+    // priority 0-9, memory 100-299 MB, burst 1-10 ticks and a uniformly picked resource
+    WorkloadConfig workloadConfig = config.workload;
+    workloadConfig.seed = seed;
+    WorkloadGenerator generator(workloadConfig);
+    WorkloadBatch generated = generator.generate();
 
+    // PCBs come from a pool (big chunks + free list) instead of one new per process
+    PCBPool pcbPool;
     vector<PCB*> allProcesses;
-    int numProcesses = 20;
-    vector<string> resources = {"file1", "printer", "disk", ""};
-
-    for (int i = 1; i <= numProcesses; ++i) {
-        PCB* p = new PCB();
-        p->pid = i;
-        p->priority = rand() % 10;
-        p->state = ProcessState::NEW;
-        p->has_resource = false;
-        p->memory_required = 100 + rand() % 200; // by this I am able to only get around 10 processes for 1024 mb memory
-        p->required_resource = resources[rand() % resources.size()];
+
+    // the whole batch goes through the admission queue, a process that does not fit yet
+    // waits there for memory and is admitted when a finished process frees enough
+    AdmissionConfig admissionConfig;
+    admissionConfig.batch_size = generated.size();
+    AdmissionQueue admission(&memory, &scheduler, admissionConfig);
+    admission.setAdmitHandler([&scheduler](PCB* p) {
+        scheduler.addToReadyQueue(p);
+        cout << "Memory allocated in the SYSTEM successfully for PID: " << p->pid << endl;
+    });
+
+    for (size_t i = 0; i < generated.size(); ++i) {
+        PCB* p = pcbPool.acquire();
+        generator.toPCB(generated, i, p);
 
         cout << "Creating Process with PID: " << p->pid
                   << ", Memory requirements: " << p->memory_required
                   << ", Resources required: " << p->required_resource << endl;
 
-        if (memory.allocate(p->memory_required)) {
-            scheduler.addToReadyQueue(p);
+        if (admission.offer(p)) {
             allProcesses.push_back(p);
-            cout << "Memory allocated in the SYSTEM successfully." << endl;
         } else {
-            cout << "Not enough memory for current process, PID: " << p->pid << endl;
-            delete p;
+            cout << "Process can never fit in memory, PID: " << p->pid << endl;
+            pcbPool.release(p);
         }
     }
+    admission.flush();
+    if (admission.pending() > 0) {
+        cout << admission.pending() << " processes wait for memory" << endl;
+    }
 
 
-    // adding 3 more job scheduling algorithms. ie. Priority, sjf and round robin
+    // comparing the scheduling algorithms. every configuration runs in isolation
+    // (own memory manager, queues and PCB copies) on a thread pool, so they dont interfere
+    // with each other and the table is the same no matter how many threads are used
 
-    // vector<PCB*> cloned1 = cloneProcesses(allProcesses);
-    // vector<PCB*> cloned2 = cloneProcesses(allProcesses);
-    // vector<PCB*> cloned3 = cloneProcesses(allProcesses);
+    cout << endl << endl << endl;
+    cout << "-------------------------- Policy Comparison --------------------------" << endl;
 
+    vector<PCB> workload;
+    for (size_t i = 0; i < allProcesses.size(); i++) {
+        workload.push_back(*allProcesses[i]);
+    }
 
-    // cout << endl << endl << endl;
-    // cout << "-------------------------- FCFS Scheduling --------------------------" << endl;
-    // cout << endl << endl << endl;
+    ExperimentRunner runner(0, memoryConfig);
+    runner.addConfig("FCFS", "fcfs");
+    PolicyParams nonPreemptive;
+    nonPreemptive.preemptive = false;
+    runner.addConfig("Priority", "priority", nonPreemptive);
+    runner.addConfig("SJF", "sjf");
+    runner.addConfig("SRTF", "srtf");
+    runner.addSweep("rr", "quantum", {2, 4, 8});
+    runner.addSweep("mlfq", "levels", {2, 3, 4});
+    runner.addConfig("CFS Fair Share", "cfs");
+    runner.addSweep("rr", "memory", {32, 128, 2048});   // overcommit -> more page faults
 
-    // for (auto& p : cloned1) scheduler.addToReadyQueue(p);
-    // scheduler.runFIFOScheduling();
-    // scheduler.evaluatePerformance("FCFS Scheduling");
+    vector<ExperimentResult> results = runner.run(workload);
+    ExperimentRunner::printTable(results);
 
 
-    
 
     cout << endl << endl << endl;
-    cout << "-------------------------- Priority Scheduling --------------------------" << endl;
+    cout << "-------------------------- Premptive Priority Scheduling --------------------------" << endl;
     cout << endl << endl << endl;
 
 
-    
-    for (int i = 0; i < allProcesses.size(); i++) {
-        priorityScheduler.addToReadyQueue(allProcesses[i]);
+
+    // every state change of the next two demos also goes to a binary event log,
+    // written by a background thread, decode it later with ./trace_decode
+    TraceConfig traceConfig;
+    traceConfig.path = (filesystem::temp_directory_path() / "os_simulator.evlog").string();
+    traceConfig.level = TraceLevel::DETAIL;
+    bool tracing = EventTracer::start(traceConfig);
+
+    // preemptive scheduling based on priority, driven by the event engine
+    // the clock jumps from event to event so cycles is now simulated ticks, not loop iterations
+    int cycles = config.cycles;
+    scheduler.simulateCPU(cycles);
+    scheduler.evaluatePerformance("Preemptive Priority Scheduling");
+    memory.print_memory_status();
+
+
+
+    cout << endl << endl << endl;
+    cout << "-------------------------- Multi-core Scheduling --------------------------" << endl;
+    cout << endl << endl << endl;
+
+    // 4 simulated cores by default, each with its own run queue, idle cores steal work
+    MultiCoreConfig coreConfig = config.multicore;
+    coreConfig.quantum = config.params.quantum;
+    MultiCoreSimulator multiCore(coreConfig);
+    for (size_t i = 0; i < allProcesses.size(); i++) {
+        multiCore.addProcess(*allProcesses[i]);
     }
-    priorityScheduler.runPriorityScheduling();
-    priorityScheduler.evaluatePerformance("Priority Scheduling");
+    multiCore.run();
+    multiCore.printReport("Multi-core Round Robin (" + to_string(coreConfig.cores) + " cores)");
 
+    if (tracing) {
+        EventTracer::stop();
+        cout << endl << "Event log: " << EventTracer::recordsWritten() << " events in " << traceConfig.path << endl;
+        cout << "Decode with: ./trace_decode " << traceConfig.path << " --chrome -o trace.json" << endl;
+    }
 
 
-    
     cout << endl << endl << endl;
-    cout << "-------------------------- SJF Scheduling --------------------------" << endl;
+    cout << "-------------------------- Contiguous Allocation --------------------------" << endl;
     cout << endl << endl << endl;
 
+    // same random churn (processes coming and going) on every contiguous allocator,
+    // shows how much each one fragments memory and how fast it places blocks
+    vector<pair<string, MemoryConfig>> allocatorConfigs;
+    MemoryModel models[] = {MemoryModel::FIRST_FIT, MemoryModel::BEST_FIT, MemoryModel::WORST_FIT,
+                            MemoryModel::NEXT_FIT, MemoryModel::BUDDY, MemoryModel::SLAB};
+    for (MemoryModel model : models) {
+        MemoryConfig c;
+        c.model = model;
+        allocatorConfigs.push_back(make_pair("Without compaction", c));
+    }
+    MemoryConfig compacting;
+    compacting.model = MemoryModel::FIRST_FIT;
+    compacting.compaction = true;
+    allocatorConfigs.push_back(make_pair("With compaction", compacting));
 
+    unsigned churnSeed = rand();
+    for (size_t c = 0; c < allocatorConfigs.size(); c++) {
+        MemoryManager contiguous(allocatorConfigs[c].second);
+        srand(churnSeed);   // every allocator sees the same requests
+        vector<pair<int, int>> residents;   // (pid, memory)
+        for (int op = 0; op < 2000; op++) {
+            if (!residents.empty() && rand() % 100 < 45) {
+                int victim = rand() % residents.size();
+                contiguous.release_process(residents[victim].first, residents[victim].second);
+                residents[victim] = residents.back();
+                residents.pop_back();
+            } else {
+                int mem = 1 + rand() % 150;
+                if (contiguous.allocate_process(op, mem)) {
+                    residents.push_back(make_pair(op, mem));
+                }
+            }
+        }
+        cout << allocatorConfigs[c].first << ":" << endl;
+        contiguous.print_memory_status();
+    }
 
 
-    for (int i = 0; i < allProcesses.size(); i++) {
-        sjfScheduler.addToReadyQueue(allProcesses[i]);
+    cout << endl << endl << endl;
+    cout << "-------------------------- Trace Replay --------------------------" << endl;
+    cout << endl << endl << endl;
+
+    // replay a recorded workload instead of a random one. the CSV trace is converted to the
+    // binary columnar format once, then streamed back through a memory mapping, so only
+    // processes inside the arrival window ever exist as PCBs
+    try {
+        unique_ptr<TraceSource> csv = openTrace("traces/sample.csv");
+        string binaryPath = (filesystem::temp_directory_path() / "os_simulator_sample.trace").string();
+        long long converted = convertTrace(*csv, binaryPath);
+        cout << "Converted " << converted << " records from traces/sample.csv to " << binaryPath << endl;
+
+        unique_ptr<TraceSource> trace = openTrace(binaryPath);
+        MemoryManager traceMemory;
+        ProcessQueues traceQueues;
+        Scheduler traceScheduler(&traceMemory, &traceQueues);
+        traceScheduler.setVerbose(false);
+        PolicyParams traceParams;
+        traceParams.quantum = config.params.quantum;
+        traceScheduler.setPolicy(createPolicy("rr", traceParams));
+
+        TraceReplayer replayer(&traceScheduler, &traceMemory, 16);
+        ReplayResult replayed = replayer.replay(*trace);
+        cout << "Replayed " << replayed.submitted << " processes from a " << trace->format() << " trace ("
+             << replayed.rejected << " rejected, at most " << replayed.peak_live << " PCBs alive)" << endl;
+        traceScheduler.evaluatePerformance("Trace Replay (Round Robin, CPU + I/O phases)");
+        filesystem::remove(binaryPath);
+    } catch (const exception& e) {
+        cout << "Trace replay skipped: " << e.what() << endl;
     }
-    sjfScheduler.runSJFScheduling();
-    sjfScheduler.evaluatePerformance("SJF Scheduling");
 
 
+    cout << endl << endl << endl;
+    cout << "-------------------------- MLFQ Starvation --------------------------" << endl;
+    cout << endl << endl << endl;
+
+    // three CPU bound jobs and a stream of short ones that keeps the top level busy on
+    // its own. the long jobs sink to the bottom and wait there until the stream dries up,
+    // boosting and aging bring them back up. an alarm fires when a wait passes 50 ticks
+    vector<PCB> mlfqWorkload;
+    for (int i = 0; i < 153; i++) {
+        PCB p;
+        p.pid = i + 1;
+        p.priority = 5;
+        p.memory_required = 1;
+        p.arrival_time = i < 3 ? 0 : (i - 3) * 2;
+        p.burst_time = i < 3 ? 12 : 2;
+        p.remaining_time = p.burst_time;
+        p.required_resource = "";
+        p.has_resource = false;
+        mlfqWorkload.push_back(p);
+    }
+
+    vector<pair<string, PolicyParams>> mlfqConfigs;
+    PolicyParams mlfqPlain;
+    mlfqPlain.mlfq_levels = 4;
+    mlfqPlain.mlfq_starvation_threshold = 50;
+    mlfqConfigs.push_back(make_pair("Plain", mlfqPlain));
+    PolicyParams mlfqBoost = mlfqPlain;
+    mlfqBoost.mlfq_boost_interval = 30;
+    mlfqConfigs.push_back(make_pair("Boost 30", mlfqBoost));
+    PolicyParams mlfqAging = mlfqPlain;
+    mlfqAging.mlfq_aging_threshold = 15;
+    mlfqConfigs.push_back(make_pair("Aging 15", mlfqAging));
+
+    cout << left << setw(12) << "MLFQ" << right << setw(8) << "Alarms" << setw(8) << "Boosts"
+         << setw(12) << "Promotions" << setw(16) << "Long jobs done" << setw(18) << "Short avg wait" << endl;
+    for (size_t c = 0; c < mlfqConfigs.size(); c++) {
+        MemoryManager mlfqMemory;
+        ProcessQueues mlfqQueues;
+        Scheduler mlfqScheduler(&mlfqMemory, &mlfqQueues);
+        mlfqScheduler.setVerbose(false);
+        MLFQPolicy* mlfq = new MLFQPolicy(mlfqConfigs[c].second);
+        mlfqScheduler.setPolicy(unique_ptr<SchedulingPolicy>(mlfq));
+
+        vector<PCB> mlfqProcesses(mlfqWorkload);
+        for (size_t i = 0; i < mlfqProcesses.size(); i++) {
+            mlfqScheduler.submitProcess(&mlfqProcesses[i]);
+        }
+        mlfqScheduler.runToCompletion();
+
+        long long longDone = 0;
+        double shortWait = 0;
+        for (size_t i = 0; i < mlfqProcesses.size(); i++) {
+            if (i < 3) {
+                longDone = max(longDone, mlfqProcesses[i].completion_time);
+            } else {
+                shortWait = shortWait + mlfqProcesses[i].waiting_time;
+            }
+        }
+        cout << left << setw(12) << mlfqConfigs[c].first << right << setw(8) << mlfq->getStarvationAlarms()
+             << setw(8) << mlfq->getBoosts() << setw(12) << mlfq->getPromotions() << setw(16) << longDone
+             << setw(18) << fixed << setprecision(1) << shortWait / (mlfqProcesses.size() - 3) << endl;
+        cout.unsetf(ios::fixed);
+        cout << setprecision(6);
+    }
 
 
     cout << endl << endl << endl;
-    cout << "-------------------------- Round Robin Scheduling --------------------------" << endl;
+    cout << "-------------------------- Real-time Scheduling --------------------------" << endl;
     cout << endl << endl << endl;
 
-    for (int i = 0; i < allProcesses.size(); i++) { 
-        rrScheduler.addToReadyQueue(allProcesses[i]);
+    // a node with some best effort load takes more and more periodic latency sensitive tasks
+    // (about 7% CPU each). the tests say what should fit, the runs show where deadlines
+    // and the tail of the best effort processes actually break
+    WorkloadConfig beConfig;
+    beConfig.seed = seed;
+    beConfig.count = 150;
+    beConfig.arrival_rate = 0.05;
+    beConfig.resources = {""};
+    WorkloadGenerator beGenerator(beConfig);
+    WorkloadBatch beBatch = beGenerator.generate();
+
+    CounterRng rtRng(seed, 13);
+    const int rtPeriods[] = {10, 20, 25, 40, 50, 100};
+    const int rtHorizon = 3000;
+    vector<PCB> rtTasks;
+    for (int i = 0; i < 16; i++) {
+        PCB p;
+        p.pid = 1000 + i;
+        p.priority = 0;
+        p.memory_required = 1;
+        p.arrival_time = rtRng.nextInt(0, 9);
+        p.period = rtPeriods[rtRng.nextInt(0, 5)];
+        p.burst_time = max(1, (int)(0.07 * p.period + 0.5));
+        p.remaining_time = p.burst_time;
+        p.jobs_left = rtHorizon / p.period;
+        p.sporadic_gap = i % 4 == 3 ? p.period / 5 : 0;   // every fourth task is sporadic
+        p.required_resource = "";
+        p.has_resource = false;
+        rtTasks.push_back(p);
     }
-    rrScheduler.runRoundRobinScheduling(4);
-    rrScheduler.evaluatePerformance("Round Robin");
 
+    cout << left << setw(6) << "Tasks" << right << setw(7) << "U" << setw(8) << "LL" << setw(6) << "RTA"
+         << setw(6) << "EDF" << setw(11) << "EDF miss%" << setw(10) << "EDF late" << setw(10) << "RM miss%"
+         << setw(9) << "RM late" << setw(13) << "BE p99 wait" << endl;
+    for (int k = 2; k <= 16; k = k + 2) {
+        vector<RealTimeTask> taskSet;
+        for (int i = 0; i < k; i++) taskSet.push_back(realTimeTask(rtTasks[i]));
+
+        MetricsSummary rtRuns[2];
+        const char* rtPolicies[] = {"edf", "rm"};
+        for (int r = 0; r < 2; r++) {
+            MemoryManager rtMemory;
+            ProcessQueues rtQueues;
+            Scheduler rtScheduler(&rtMemory, &rtQueues);
+            rtScheduler.setVerbose(false);
+            rtScheduler.setPolicy(createPolicy(rtPolicies[r]));
+
+            vector<PCB> rtProcesses(beBatch.size());
+            for (size_t i = 0; i < beBatch.size(); i++) beGenerator.toPCB(beBatch, i, &rtProcesses[i]);
+            rtProcesses.insert(rtProcesses.end(), rtTasks.begin(), rtTasks.begin() + k);
+            for (size_t i = 0; i < rtProcesses.size(); i++) rtScheduler.submitProcess(&rtProcesses[i]);
+            rtScheduler.runToCompletion();
+            rtRuns[r] = rtScheduler.getMetrics().summary();
+        }
+
+        cout << left << setw(6) << k << right << fixed << setprecision(2) << setw(7) << utilization(taskSet)
+             << setw(8) << liuLaylandBound(k) << setw(6) << (rmSchedulable(taskSet) ? "yes" : "no")
+             << setw(6) << (edfSchedulable(taskSet) ? "yes" : "no") << setprecision(1)
+             << setw(11) << rtRuns[0].miss_ratio * 100 << setw(10) << rtRuns[0].p99_lateness
+             << setw(10) << rtRuns[1].miss_ratio * 100 << setw(9) << rtRuns[1].p99_lateness
+             << setw(13) << rtRuns[0].p99_waiting << endl;
+        cout.unsetf(ios::fixed);
+        cout << setprecision(6);
+    }
+
+    // 12 tasks still fit, but leave little for best effort. the reservation limits the
+    // real-time class to a share of every 100 ticks and trades deadlines for best effort tail
+    cout << endl << left << setw(24) << "EDF, 12 tasks" << right << setw(11) << "EDF miss%" << setw(10)
+         << "EDF late" << setw(11) << "Throttled" << setw(13) << "BE p99 wait" << endl;
+    const int rtRuntimes[] = {0, 90, 75};
+    for (int runtime : rtRuntimes) {
+        MemoryManager rtMemory;
+        ProcessQueues rtQueues;
+        Scheduler rtScheduler(&rtMemory, &rtQueues);
+        rtScheduler.setVerbose(false);
+        PolicyParams rtParams;
+        rtParams.rt_runtime = runtime;
+        RealTimePolicy* edf = (RealTimePolicy*)createPolicy("edf", rtParams).release();
+        rtScheduler.setPolicy(unique_ptr<SchedulingPolicy>(edf));
+
+        vector<PCB> rtProcesses(beBatch.size());
+        for (size_t i = 0; i < beBatch.size(); i++) beGenerator.toPCB(beBatch, i, &rtProcesses[i]);
+        rtProcesses.insert(rtProcesses.end(), rtTasks.begin(), rtTasks.begin() + 12);
+        for (size_t i = 0; i < rtProcesses.size(); i++) rtScheduler.submitProcess(&rtProcesses[i]);
+        rtScheduler.runToCompletion();
+
+        MetricsSummary reserved = rtScheduler.getMetrics().summary();
+        string label = runtime > 0 ? "reserve " + to_string(runtime) + "/100" : "no reservation";
+        cout << left << setw(24) << label << right << fixed << setprecision(1)
+             << setw(11) << reserved.miss_ratio * 100 << setw(10) << reserved.p99_lateness
+             << setw(11) << edf->getThrottled() << setw(13) << reserved.p99_waiting << endl;
+        cout.unsetf(ios::fixed);
+        cout << setprecision(6);
+    }
 
 
     cout << endl << endl << endl;
-    cout << "-------------------------- Premptive Priority Scheduling --------------------------" << endl;
+    cout << "-------------------------- Resource Contention --------------------------" << endl;
     cout << endl << endl << endl;
 
+    // 200 processes fighting over two hot resources, once per wake policy.
+    // "disk" is a reader/writer resource and every other process only reads it
+    WorkloadConfig hotConfig;
+    hotConfig.seed = seed;
+    hotConfig.count = 200;
+    hotConfig.arrival_rate = 0.5;
+    hotConfig.resources = {"disk", "printer"};
+    hotConfig.small_min = 1;
+    hotConfig.small_max = 4;
+    WorkloadGenerator hotGenerator(hotConfig);
+    WorkloadBatch hotBatch = hotGenerator.generate();
 
+    WakePolicy wakePolicies[] = {WakePolicy::FIFO, WakePolicy::PRIORITY, WakePolicy::WAKE_ALL};
+    for (WakePolicy wake : wakePolicies) {
+        MemoryManager hotMemory;
+        ProcessQueues hotQueues;
+        hotQueues.get_resources().add_resource("disk", wake, true);
+        hotQueues.get_resources().add_resource("printer", wake);
+        Scheduler hotScheduler(&hotMemory, &hotQueues);
+        hotScheduler.setVerbose(false);
+        hotScheduler.setPolicy(createPolicy("rr"));
+
+        vector<PCB> hotProcesses(hotBatch.size());
+        for (size_t i = 0; i < hotBatch.size(); i++) {
+            hotGenerator.toPCB(hotBatch, i, &hotProcesses[i]);
+            hotProcesses[i].shared_access = (i % 2 == 0);
+            hotMemory.allocate_process(hotProcesses[i].pid, hotProcesses[i].memory_required);
+            hotScheduler.submitProcess(&hotProcesses[i]);
+        }
+        hotScheduler.runToCompletion();
+
+        MetricsSummary hot = hotScheduler.getMetrics().summary();
+        cout << "Wake policy " << wakePolicyName(wake) << ": mean waiting " << hot.mean_waiting
+             << ", p99 waiting " << hot.p99_waiting << ", context switches " << hot.context_switches << endl;
+        hotScheduler.getResources().print_stats();
+        cout << endl;
+    }
+
+
+    cout << endl << endl << endl;
+    cout << "-------------------------- I/O Devices --------------------------" << endl;
+    cout << endl << endl << endl;
+
+    // processes alternate CPU bursts with disk requests, while one waits for the disk
+    // another one uses the CPU. groups of four read the same file one after the other,
+    // so their requests are adjacent and can be merged. same processes for every algorithm
+    CounterRng ioRng(seed, 11);
+    vector<PCB> ioWorkload;
+    for (int i = 0; i < 80; i++) {
+        PCB p;
+        p.pid = i + 1;
+        p.priority = ioRng.nextInt(0, 9);
+        p.memory_required = 4;
+        p.arrival_time = i / 2;
+        p.phases.clear();
+        for (int phase = 0; phase < 4; phase++) {
+            p.phases.push_back(ioRng.nextInt(1, 4));    // CPU
+            p.phases.push_back(ioRng.nextInt(2, 8));    // blocks read from the disk
+        }
+        p.phases.push_back(ioRng.nextInt(1, 4));
+        p.burst_time = 0;
+        p.io_time = 0;
+        for (size_t k = 0; k < p.phases.size(); k++) {
+            if (k % 2 == 0) p.burst_time = p.burst_time + p.phases[k];
+            else p.io_time = p.io_time + p.phases[k];
+        }
+        p.remaining_time = p.burst_time;
+        p.required_resource = "";
+        p.has_resource = false;
+        p.io_device = "disk";
+        p.io_block = (long long)ioRng.nextInt(0, 19) * 3200 + (i % 4) * 8;   // 20 files spread over the disk
+        ioWorkload.push_back(p);
+    }
+
+    cout << left << setw(22) << "Disk scheduling" << right << setw(9) << "Elapsed" << setw(8) << "CPU%"
+         << setw(8) << "Disk%" << setw(10) << "Seek cyl" << setw(8) << "Merged" << setw(9) << "Batched"
+         << setw(10) << "Resp p50" << setw(10) << "Resp p99" << endl;
+    DiskScheduling diskAlgorithms[] = {DiskScheduling::FCFS, DiskScheduling::SSTF, DiskScheduling::SCAN,
+                                       DiskScheduling::C_SCAN, DiskScheduling::LOOK};
+    for (int run = 0; run < 6; run++) {
+        DiskConfig diskConfig;
+        diskConfig.scheduling = run < 5 ? diskAlgorithms[run] : DiskScheduling::LOOK;
+        diskConfig.merge = run < 5;   // last run: LOOK without merging or batching
+        if (run == 5) diskConfig.max_batch = 1;
+
+        MemoryManager ioMemory;
+        ProcessQueues ioQueues;
+        Scheduler ioScheduler(&ioMemory, &ioQueues);
+        ioScheduler.setVerbose(false);
+        ioScheduler.setPolicy(createPolicy("rr"));
+        ioScheduler.addDevice(unique_ptr<IODevice>(new DiskDevice("disk", diskConfig)));
+
+        vector<PCB> ioProcesses(ioWorkload);
+        for (size_t i = 0; i < ioProcesses.size(); i++) {
+            ioMemory.allocate_process(ioProcesses[i].pid, ioProcesses[i].memory_required);
+            ioScheduler.submitProcess(&ioProcesses[i]);
+        }
+        ioScheduler.runToCompletion();
+
+        MetricsSummary io = ioScheduler.getMetrics().summary();
+        const IoDeviceStats& disk = ioScheduler.getDevice("disk")->getStats();
+        string label = string(diskSchedulingName(diskConfig.scheduling)) + (diskConfig.merge ? "" : " (no merging)");
+        cout << left << setw(22) << label << right << fixed << setprecision(1)
+             << setw(9) << io.elapsed << setw(8) << io.cpu_utilization * 100
+             << setw(8) << 100.0 * disk.busy_time / max(1LL, io.elapsed) << setw(10) << disk.seek_distance
+             << setw(8) << disk.merged << setw(9) << disk.batched
+             << setw(10) << disk.response.quantile(0.5) << setw(10) << disk.response.quantile(0.99) << endl;
+        cout.unsetf(ios::fixed);
+        cout << setprecision(6);
+    }
+
+
+    cout << endl << endl << endl;
+    cout << "-------------------------- Deadlock Handling --------------------------" << endl;
+    cout << endl << endl << endl;
+
+    // processes holding and requesting several resource types with several instances each.
+    // same workload three times: nothing (deadlocks forever), detect + abort a victim,
+    // and Banker's avoidance which pays for safety checks and delayed grants instead
+    DeadlockWorkload deadlockWorkload;
+    deadlockWorkload.seed = seed;
+    vector<DeadlockRunResult> deadlockRuns;
+    deadlockRuns.push_back(runDeadlockWorkload(deadlockWorkload, DeadlockMode::NONE));
+    deadlockRuns.push_back(runDeadlockWorkload(deadlockWorkload, DeadlockMode::DETECT));
+    deadlockRuns.push_back(runDeadlockWorkload(deadlockWorkload, DeadlockMode::AVOID));
+    printDeadlockTable(deadlockRuns);
+
+    // the same modes inside the scheduler: round robin processes that each need two
+    // neighbouring types of four single instance ones, the left one first (dining philosophers)
+    cout << endl;
+    cout << left << setw(20) << "Scheduler" << right << setw(11) << "Completed" << setw(8) << "Stuck"
+         << setw(8) << "Killed" << setw(11) << "Deadlocks" << setw(8) << "Waits" << setw(10) << "End time" << endl;
+    DeadlockMode schedulerModes[] = {DeadlockMode::NONE, DeadlockMode::DETECT, DeadlockMode::AVOID};
+    for (int m = 0; m < 3; m++) {
+        MultiResourceManager claims(vector<int>(4, 1), schedulerModes[m]);
+        MemoryManager claimMemory;
+        ProcessQueues claimQueues;
+        Scheduler claimScheduler(&claimMemory, &claimQueues);
+        claimScheduler.setVerbose(false);
+        claimScheduler.setPolicy(createPolicy("rr"));
+        claimScheduler.setMultiResources(&claims);
+
+        vector<PCB> claimProcesses(12);
+        for (size_t i = 0; i < claimProcesses.size(); i++) {
+            PCB& p = claimProcesses[i];
+            p.pid = (int)i + 1;
+            p.priority = 5;
+            p.memory_required = 1;
+            p.arrival_time = 0;
+            p.burst_time = 6;
+            p.remaining_time = p.burst_time;
+            p.required_resource = "";
+            p.has_resource = false;
+            int first = (int)i % 4;
+            int second = ((int)i + 1) % 4;
+            p.resource_claim.assign(4, 0);
+            p.resource_claim[first] = 1;
+            p.resource_claim[second] = 1;
+            p.resource_order = {first, second};
+            claimScheduler.submitProcess(&p);
+        }
+        claimScheduler.runToCompletion();
+
+        int done = 0;
+        int stuck = 0;
+        for (size_t i = 0; i < claimProcesses.size(); i++) {
+            if (claimProcesses[i].state != ProcessState::TERMINATED) {
+                stuck = stuck + 1;
+            } else if (claimProcesses[i].exit_code != EXIT_KILLED) {
+                done = done + 1;
+            }
+        }
+        cout << left << setw(20) << deadlockModeName(schedulerModes[m]) << right << setw(11) << done
+             << setw(8) << stuck << setw(8) << claimScheduler.getLifecycleStats().kills
+             << setw(11) << claims.stats().deadlocks << setw(8) << claims.stats().waits
+             << setw(10) << claimScheduler.getCurrentTime() << endl;
+    }
 
-    // preemptive scheduling based on priority, usnig a single time slice need to change in future to 100s of iterations per cycle
-    int cycles = 15;
-    scheduler.simulateCPU(cycles);
 
+    cout << endl << endl << endl;
+    cout << "-------------------------- What-if Forking --------------------------" << endl;
+    cout << endl << endl << endl;
+
+    // warm up one paged simulation under memory pressure, snapshot it halfway through
+    // and let every policy finish the same state. the warm up is paid once
+    WorkloadConfig forkConfig;
+    forkConfig.seed = seed;
+    forkConfig.count = 400;
+    forkConfig.arrival_rate = 0.3;
+    forkConfig.small_min = 8;
+    forkConfig.small_max = 64;
+    WorkloadGenerator forkGenerator(forkConfig);
+    WorkloadBatch forkBatch = forkGenerator.generate();
+
+    MemoryConfig forkMemoryConfig;
+    forkMemoryConfig.model = MemoryModel::PAGED;
+    forkMemoryConfig.total = 512;
+    forkMemoryConfig.page_size = 16;
+    forkMemoryConfig.swap_size = 1 << 16;
+    forkMemoryConfig.replacement = ReplacementPolicy::CLOCK;
+    MemoryManager forkMemory(forkMemoryConfig);
+    ProcessQueues forkQueues;
+    Scheduler forkScheduler(&forkMemory, &forkQueues);
+    forkScheduler.setVerbose(false);
+    forkScheduler.setPolicy(createPolicy("rr"));
+
+    vector<PCB> forkProcesses(forkBatch.size());
+    for (size_t i = 0; i < forkBatch.size(); i++) {
+        forkGenerator.toPCB(forkBatch, i, &forkProcesses[i]);
+        if (forkMemory.allocate_process(forkProcesses[i].pid, forkProcesses[i].memory_required)) {
+            forkScheduler.submitProcess(&forkProcesses[i]);
+        }
+    }
+    forkScheduler.runUntil(600);
+
+    auto captureStart = chrono::steady_clock::now();
+    SimulationSnapshot snapshot = SimulationSnapshot::capture(forkScheduler);
+    double captureUs = chrono::duration<double, micro>(chrono::steady_clock::now() - captureStart).count();
+    cout << "Snapshot at t=600: " << snapshot.size() << " bytes, captured in " << fixed << setprecision(0)
+         << captureUs << " us" << endl << endl;
+
+    cout << left << setw(10) << "Policy" << right << setw(11) << "Restore us" << setw(11) << "Completed"
+         << setw(11) << "Mean wait" << setw(10) << "p99 wait" << setw(9) << "Faults" << endl;
+    const char* forkPolicies[] = {"fcfs", "sjf", "rr", "mlfq", "cfs"};
+    for (const char* name : forkPolicies) {
+        auto restoreStart = chrono::steady_clock::now();
+        unique_ptr<SimulationFork> fork = snapshot.restore();
+        double restoreUs = chrono::duration<double, micro>(chrono::steady_clock::now() - restoreStart).count();
+        fork->scheduler->setPolicy(createPolicy(name));
+        fork->scheduler->runToCompletion();
+
+        MetricsSummary what = fork->scheduler->getMetrics().summary();
+        cout << left << setw(10) << name << right << fixed << setprecision(0) << setw(11) << restoreUs
+             << setw(11) << what.completed << setprecision(1) << setw(11) << what.mean_waiting
+             << setw(10) << what.p99_waiting << setw(9) << fork->memory->get_virtual_memory()->totals().faults << endl;
+    }
+    cout.unsetf(ios::fixed);
+    cout << setprecision(6);
+
+
+    cout << endl << endl << endl;
+    cout << "-------------------------- Process Trees --------------------------" << endl;
+    cout << endl << endl << endl;
+
+    // every generated process is a little shell: after its burst it forks 2 children, they fork
+    // again 3 levels down and every parent reaps its children with wait() before it exits.
+    // forked PCBs come from a pool and go back to it when they are reaped, so the pool only
+    // grows to the number of processes alive at the same time
+    WorkloadConfig shellConfig;
+    shellConfig.seed = seed;
+    shellConfig.count = 200;
+    shellConfig.arrival_rate = 0.01;
+    shellConfig.burst_max = 6;
+    shellConfig.resources = {""};
+    shellConfig.small_min = 2;
+    shellConfig.small_max = 8;
+    WorkloadGenerator shellGenerator(shellConfig);
+    WorkloadBatch shellBatch = shellGenerator.generate();
+
+    MemoryManager treeMemory;
+    ProcessQueues treeQueues;
+    Scheduler treeScheduler(&treeMemory, &treeQueues);
+    treeScheduler.setVerbose(false);
+    treeScheduler.setPolicy(createPolicy("cfs"));
+    PCBPool treePool(64);
+    treeScheduler.setProcessPool(&treePool);
+
+    vector<PCB> shells(shellBatch.size());
+    for (size_t i = 0; i < shellBatch.size(); i++) {
+        shellGenerator.toPCB(shellBatch, i, &shells[i]);
+        shells[i].fork_children = 2;
+        shells[i].fork_depth = 3;
+        treeMemory.allocate_process(shells[i].pid, shells[i].memory_required);
+        treeScheduler.submitProcess(&shells[i]);
+    }
+
+    // the last shell gets killed while its tree is growing, with everything below it
+    PCB& victim = shells.back();
+    while (victim.fork_children > 0 && victim.state != ProcessState::TERMINATED) {
+        treeScheduler.runUntil(treeScheduler.getCurrentTime() + 1);
+    }
+    treeScheduler.runUntil(treeScheduler.getCurrentTime() + 8);
+    int killed = treeScheduler.killProcess(&victim, true);
+    treeScheduler.runToCompletion();
+
+    const LifecycleStats& lifecycle = treeScheduler.getLifecycleStats();
+    cout << "Shells: " << shells.size() << ", forked: " << lifecycle.forks
+         << ", fork failures (no memory): " << lifecycle.fork_failures << endl;
+    cout << "Exited: " << lifecycle.exits << ", reaped: " << lifecycle.reaped
+         << ", zombies left: " << lifecycle.zombies << " (peak " << lifecycle.peak_zombies << ")" << endl;
+    cout << "Cascade kill of PID " << victim.pid << ": " << killed << " processes, exit code " << victim.exit_code << endl;
+    cout << "PCB pool: " << treePool.capacity() << " slots for " << lifecycle.forks << " forked processes, "
+         << treePool.liveCount() << " still in use" << endl;
+    cout << "Memory in use after the run: " << treeMemory.get_used_memory() << " MB" << endl;
+    treeScheduler.evaluatePerformance("CFS with process trees");
 
-    // freeing up space from allprocesses vector
+
+    cout << endl << endl << endl;
+    cout << "-------------------------- Live Telemetry --------------------------" << endl;
+    cout << endl << endl << endl;
+
+    // a longer run publishes its metrics while it goes: a Unix socket anyone can scrape,
+    // an export file for a textfile collector and a time series sampled every 1000 ticks
+    WorkloadConfig liveConfig;
+    liveConfig.seed = seed;
+    liveConfig.count = 20000;
+    liveConfig.arrival_rate = 0.17;
+    liveConfig.resources = {"disk", "printer", "", ""};
+    liveConfig.small_min = 1;
+    liveConfig.small_max = 4;
+    WorkloadGenerator liveGenerator(liveConfig);
+    WorkloadBatch liveBatch = liveGenerator.generate();
+
+    MetricsRegistry registry;
+    TelemetryServer telemetryServer(registry);
+    string socketPath = (filesystem::temp_directory_path() / "os_simulator.sock").string();
+    bool serving = telemetryServer.start(socketPath);
+
+    TelemetryConfig telemetryConfig;
+    telemetryConfig.sample_interval = 1000;
+    telemetryConfig.series_path = (filesystem::temp_directory_path() / "os_simulator_series.prom").string();
+    telemetryConfig.export_path = (filesystem::temp_directory_path() / "os_simulator.prom").string();
+
+    MemoryManager liveMemory;
+    ProcessQueues liveQueues;
+    Scheduler liveScheduler(&liveMemory, &liveQueues);
+    liveScheduler.setVerbose(false);
+    liveScheduler.setPolicy(createPolicy("rr"));
+    liveScheduler.enableTelemetry(&registry, telemetryConfig);
+
+    vector<PCB> liveProcesses(liveBatch.size());
+    for (size_t i = 0; i < liveBatch.size(); i++) {
+        liveGenerator.toPCB(liveBatch, i, &liveProcesses[i]);
+        liveMemory.allocate_process(liveProcesses[i].pid, liveProcesses[i].memory_required);
+        liveScheduler.submitProcess(&liveProcesses[i]);
+    }
+    liveScheduler.runToCompletion();
+
+    cout << liveScheduler.getTelemetrySamples() << " samples, time series in " << telemetryConfig.series_path << endl;
+    cout << "Last export in " << telemetryConfig.export_path << endl;
+    string scraped;
+    if (serving && scrapeTelemetrySocket(socketPath, scraped)) {
+        cout << "Scraped from " << socketPath << ":" << endl << endl << scraped;
+    } else {
+        registry.writePrometheus(cout);
+    }
+    telemetryServer.stop();
+
+
+    cout << endl << endl << endl;
+    cout << "-------------------------- Admission Control --------------------------" << endl;
+    cout << endl << endl << endl;
+
+    // arrival storms: 8 waves of 250 processes, a quarter of them large, into 2 GB of plain
+    // counted memory. rejecting whatever does not fit on arrival (the old way) loses most of
+    // every wave, the admission queue keeps them waiting and lets them in as memory frees up
+    WorkloadConfig stormConfig;
+    stormConfig.seed = seed;
+    stormConfig.count = 2000;
+    stormConfig.burst_min = 2;
+    stormConfig.burst_max = 12;
+    stormConfig.resources = {""};
+    stormConfig.small_fraction = 0.75;
+    stormConfig.small_min = 16;
+    stormConfig.small_max = 96;
+    stormConfig.large_min = 512;
+    stormConfig.large_max = 1536;
+    WorkloadGenerator stormGenerator(stormConfig);
+    WorkloadBatch stormBatch = stormGenerator.generate();
+    const size_t waveSize = 250;
+    const long long waveGap = 2000;
+
+    cout << left << setw(14) << "Admission" << right << setw(10) << "Completed" << setw(10) << "Rejected"
+         << setw(13) << "Peak queued" << setw(14) << "Mean mem wait" << setw(13) << "Max mem wait"
+         << setw(11) << "Mean wait" << setw(10) << "Makespan" << setw(9) << "Wakeups" << setw(13) << "Probes/adm" << endl;
+    const char* admissionNames[] = {"reject", "fifo", "smallest-fit", "backfill"};
+    const AdmissionPolicy admissionPolicies[] = {AdmissionPolicy::FIFO, AdmissionPolicy::FIFO,
+                                                 AdmissionPolicy::SMALLEST_FIT, AdmissionPolicy::BACKFILL};
+    for (int run = 0; run < 4; run++) {
+        MemoryConfig stormMemoryConfig;
+        stormMemoryConfig.total = 2048;
+        MemoryManager stormMemory(stormMemoryConfig);
+        ProcessQueues stormQueues;
+        Scheduler stormScheduler(&stormMemory, &stormQueues);
+        stormScheduler.setVerbose(false);
+        stormScheduler.setPolicy(createPolicy("rr"));
+
+        AdmissionConfig stormAdmission;
+        stormAdmission.policy = admissionPolicies[run];
+        AdmissionQueue stormQueue(&stormMemory, &stormScheduler, stormAdmission);
+
+        vector<PCB> stormProcesses(stormBatch.size());
+        long long dropped = 0;
+        for (size_t i = 0; i < stormBatch.size(); i++) {
+            long long wave = (long long)(i / waveSize) * waveGap;
+            if (i % waveSize == 0) {
+                stormQueue.flush();
+                stormScheduler.runUntil(wave);
+            }
+            PCB& p = stormProcesses[i];
+            stormGenerator.toPCB(stormBatch, i, &p);
+            p.arrival_time = (int)wave;
+            if (run > 0) {
+                stormQueue.offer(&p);
+            } else if (stormMemory.allocate_process(p.pid, p.memory_required)) {
+                stormScheduler.submitProcess(&p);
+            } else {
+                dropped = dropped + 1;
+            }
+        }
+        stormQueue.flush();
+        stormScheduler.runToCompletion();
+
+        const AdmissionStats& a = stormQueue.getStats();
+        MetricsSummary what = stormScheduler.getMetrics().summary();
+        long long rejected = run > 0 ? a.rejected : dropped;
+        long long admitted = run > 0 ? a.admitted : (long long)stormBatch.size() - dropped;
+        cout << left << setw(14) << admissionNames[run] << right << setw(10) << what.completed << setw(10) << rejected
+             << setw(13) << a.peak_pending << fixed << setprecision(1)
+             << setw(14) << (admitted > 0 ? (double)a.total_wait / admitted : 0.0) << setw(13) << a.max_wait
+             << setw(11) << what.mean_waiting << setw(10) << stormScheduler.getCurrentTime()
+             << setw(9) << a.wakeups << setprecision(2)
+             << setw(13) << (a.admitted > 0 ? (double)a.probes / a.admitted : 0.0) << endl;
+    }
+    cout.unsetf(ios::fixed);
+    cout << setprecision(6);
+
+
+    cout << endl << endl << endl;
+    cout << "------------------------ Batch Jobs and Backfill ----------------------" << endl;
+    cout << endl << endl << endl;
+
+    // a gang of 4 tasks on an 8 core machine: they start together once 4 cores are free at
+    // the same time, the 2 core job behind it backfills into the gap while the gang waits
+    BatchConfig gangConfig;
+    gangConfig.cores = 8;
+    BatchScheduler gangScheduler(gangConfig);
+    vector<PCB> gangTasks(4);
+    BatchJob wide;
+    wide.id = 1;
+    wide.cores = 6;
+    wide.walltime = 40;
+    wide.runtime = 30;
+    gangScheduler.submit(wide);
+    BatchJob gang;
+    gang.id = 2;
+    gang.submit_time = 1;
+    gang.walltime = 20;
+    gang.runtime = 20;
+    for (int i = 0; i < 4; i++) {
+        gangTasks[i].pid = 100 + i;
+        gangTasks[i].burst_time = 20;
+        gangTasks[i].remaining_time = 20;
+        gang.tasks.push_back(&gangTasks[i]);
+    }
+    gangScheduler.submit(gang);
+    BatchJob small;
+    small.id = 3;
+    small.cores = 2;
+    small.submit_time = 2;
+    small.walltime = 25;
+    small.runtime = 25;
+    gangScheduler.submit(small);
+    gangScheduler.run();
+    const vector<BatchJob>& gangJobs = gangScheduler.getJobs();
+    for (size_t i = 0; i < gangJobs.size(); i++) {
+        const BatchJob& j = gangJobs[i];
+        cout << "Job " << j.id << ": " << j.cores << " cores, submitted " << j.submit_time << ", ran "
+             << j.start_time << "-" << j.end_time << (j.backfilled ? " (backfilled)" : "") << endl;
+    }
+    cout << "Gang tasks started at";
+    for (int i = 0; i < 4; i++) {
+        cout << " " << gangTasks[i].first_run_time;
+    }
+    cout << ", finished at";
+    for (int i = 0; i < 4; i++) {
+        cout << " " << gangTasks[i].completion_time;
+    }
+    cout << endl << endl;
+
+    // 10000 rigid jobs of 1 to 128 cores on 256 cores at about 90% load. walltimes are the
+    // usual user guesses: one to four times the real run time, and now and then too short
+    const long long batchCount = 10000;
+    cout << left << setw(14) << "Backfill" << right << setw(11) << "Mean wait" << setw(10) << "P99 wait"
+         << setw(11) << "Slowdown" << setw(13) << "Utilization" << setw(12) << "Backfilled"
+         << setw(8) << "Killed" << setw(12) << "Compressed" << setw(10) << "Wall ms" << endl;
+    const BackfillMode backfillModes[] = {BackfillMode::NONE, BackfillMode::EASY, BackfillMode::CONSERVATIVE};
+    for (int run = 0; run < 3; run++) {
+        BatchConfig batchConfig;
+        batchConfig.cores = 256;
+        batchConfig.backfill = backfillModes[run];
+        BatchScheduler batchScheduler(batchConfig);
+        CounterRng batchRng(seed, 23);
+        long long submitted = 0;
+        for (long long i = 0; i < batchCount; i++) {
+            BatchJob j;
+            j.id = (int)i;
+            j.cores = 1 << batchRng.nextInt(0, 7);
+            submitted = submitted + batchRng.nextInt(0, 80);
+            j.submit_time = submitted;
+            j.runtime = 1 + (long long)(-300.0 * log(batchRng.nextDouble()));
+            j.walltime = j.runtime * batchRng.nextInt(1, 4) + batchRng.nextInt(0, 50);
+            if (batchRng.nextInt(0, 20) == 0) {
+                j.walltime = j.runtime / 2 + 1;
+            }
+            batchScheduler.submit(j);
+        }
+        auto batchStart = chrono::steady_clock::now();
+        batchScheduler.run();
+        double batchMs = chrono::duration<double, milli>(chrono::steady_clock::now() - batchStart).count();
+
+        const BatchStats& b = batchScheduler.getStats();
+        MetricsSummary what = batchScheduler.getMetrics().summary();
+        cout << left << setw(14) << backfillModeName(batchConfig.backfill) << right << fixed << setprecision(1)
+             << setw(11) << what.mean_waiting << setw(10) << what.p99_waiting << setprecision(2)
+             << setw(11) << b.mean_slowdown << setw(13) << b.utilization << setw(12) << b.backfilled
+             << setw(8) << b.killed << setw(12) << b.compressed << setprecision(1) << setw(10) << batchMs << endl;
+    }
+    cout.unsetf(ios::fixed);
+    cout << setprecision(6);
+
+
+    cout << endl << endl << endl;
+    cout << "---------------------------- Control Groups ---------------------------" << endl;
+    cout << endl << endl << endl;
+
+    // noisy neighbour: two tenants with a stream of short interactive jobs share the CPU with
+    // a third that starts 20 CPU hogs at once. flat CFS weighs every process the same, so the
+    // hogs get 20 of every 21 ticks. with groups each tenant gets a third no matter how many
+    // processes it has, and a quota caps the noisy one at 30% even when the CPU is idle
+    CounterRng tenantRng(seed, 24);
+    vector<PCB> tenantWorkload;
+    for (int i = 0; i < 420; i++) {
+        PCB p;
+        p.pid = i + 1;
+        p.priority = 5;
+        p.memory_required = 16;
+        if (i < 20) {
+            p.arrival_time = 0;
+            p.burst_time = 1000;
+        } else {
+            p.arrival_time = (i - 20) / 2 * 20 + tenantRng.nextInt(0, 19);
+            p.burst_time = tenantRng.nextInt(1, 8);
+        }
+        p.remaining_time = p.burst_time;
+        p.required_resource = "";
+        p.has_resource = false;
+        tenantWorkload.push_back(p);
+    }
+    const long long tenantHorizon = 4000;
+
+    cout << left << setw(16) << "Setup" << right << setw(14) << "Web mean wait" << setw(9) << "Web P99"
+         << setw(14) << "API mean wait" << setw(9) << "API P99" << setw(15) << "Tenant jobs/1k"
+         << setw(12) << "Noisy CPU%" << setw(10) << "Makespan" << endl;
+    const char* groupSetups[] = {"flat cfs", "shares", "shares + quota"};
+    for (int run = 0; run < 3; run++) {
+        MemoryManager groupMemory(100000);
+        ProcessQueues groupQueues;
+        Scheduler groupScheduler(&groupMemory, &groupQueues);
+        groupScheduler.setVerbose(false);
+        ControlGroups groups;
+        groupScheduler.setControlGroups(&groups);
+        int tenants = groups.create("tenants");
+        int web = groups.create("web", tenants);
+        int api = groups.create("api", tenants);
+        CGroupConfig noisyConfig;
+        noisyConfig.shares = 512;
+        if (run == 2) {
+            noisyConfig.quota = 30;
+            noisyConfig.period = 100;
+        }
+        int noisy = groups.create("noisy", 0, noisyConfig);
+        if (run == 0) {
+            groupScheduler.setPolicy(createPolicy("cfs"));
+        } else {
+            groupScheduler.setPolicy(unique_ptr<SchedulingPolicy>(new CGroupPolicy(&groups)));
+        }
+
+        vector<PCB> groupProcesses(tenantWorkload);
+        for (size_t i = 0; i < groupProcesses.size(); i++) {
+            PCB& p = groupProcesses[i];
+            groups.attach(&p, i < 20 ? noisy : i % 2 == 0 ? web : api);
+            groupMemory.allocate_process(p.pid, p.memory_required);
+            groupScheduler.submitProcess(&p);
+        }
+        groupScheduler.runUntil(tenantHorizon);
+        long long noisyTicks = 0;
+        for (int i = 0; i < 20; i++) {
+            noisyTicks = noisyTicks + groupProcesses[i].burst_time - groupProcesses[i].remaining_time;
+        }
+        long long tenantDone = groups.getMetrics(tenants).summary().completed;
+        groupScheduler.runToCompletion();
+
+        MetricsSummary webSummary = groups.getMetrics(web).summary();
+        MetricsSummary apiSummary = groups.getMetrics(api).summary();
+        cout << left << setw(16) << groupSetups[run] << right << fixed << setprecision(1)
+             << setw(14) << webSummary.mean_waiting << setw(9) << webSummary.p99_waiting
+             << setw(14) << apiSummary.mean_waiting << setw(9) << apiSummary.p99_waiting
+             << setw(15) << tenantDone * 1000.0 / tenantHorizon
+             << setw(12) << 100.0 * noisyTicks / tenantHorizon << setw(10) << groupScheduler.getCurrentTime() << endl;
+        if (run == 2) {
+            cout.unsetf(ios::fixed);
+            cout << setprecision(6);
+            cout << endl;
+            groups.print();
+        }
+    }
+    cout.unsetf(ios::fixed);
+    cout << setprecision(6);
+    cout << endl;
+
+    // memory limits. counted memory: a group that goes over its limit loses its biggest
+    // process to the OOM killer, the other groups never notice
+    MemoryManager oomMemory(1024);
+    ProcessQueues oomQueues;
+    Scheduler oomScheduler(&oomMemory, &oomQueues);
+    oomScheduler.setVerbose(false);
+    ControlGroups oomGroups;
+    oomScheduler.setControlGroups(&oomGroups);
+    CGroupConfig batchLimit;
+    batchLimit.memory_limit = 256;
+    int batchGroup = oomGroups.create("batch", 0, batchLimit);
+    oomScheduler.setPolicy(unique_ptr<SchedulingPolicy>(new CGroupPolicy(&oomGroups)));
+    const int oomSizes[] = {96, 128, 24, 64};
+    vector<PCB> oomProcesses(4);
+    bool oomStarted[4] = {false, false, false, false};
+    for (int i = 0; i < 4; i++) {
+        PCB& p = oomProcesses[i];
+        p.pid = i + 1;
+        p.priority = 5;
+        p.memory_required = oomSizes[i];
+        p.burst_time = 50;
+        p.remaining_time = 50;
+        p.required_resource = "";
+        p.has_resource = false;
+        oomGroups.attach(&p, batchGroup);
+        if (oomMemory.allocate_process(p.pid, p.memory_required)) {
+            oomScheduler.submitProcess(&p);
+            oomStarted[i] = true;
+        }
+        cout << "Process " << p.pid << " asks for " << p.memory_required << " MB, group /batch holds "
+             << oomGroups.getStats(batchGroup).memory << " of " << batchLimit.memory_limit << " MB" << endl;
+    }
+    oomScheduler.runToCompletion();
+    for (int i = 0; i < 4; i++) {
+        if (oomStarted[i]) {
+            cout << "Process " << oomProcesses[i].pid << " exit code " << oomProcesses[i].exit_code << endl;
+        } else {
+            cout << "Process " << oomProcesses[i].pid << " never started, the killed process still held its memory" << endl;
+        }
+    }
+    cout << oomGroups.getStats(batchGroup).oom_kills << " OOM kill, " << oomGroups.getStats(batchGroup).charge_failures
+         << " allocation turned down" << endl << endl;
+
+    // paged memory: the limit is on resident pages, a group over it pages out its own oldest
+    // page instead of taking a frame from anybody else
+    MemoryManager pagedGroupMemory(memoryConfig);
+    ProcessQueues pagedGroupQueues;
+    Scheduler pagedGroupScheduler(&pagedGroupMemory, &pagedGroupQueues);
+    pagedGroupScheduler.setVerbose(false);
+    ControlGroups pagedGroups;
+    pagedGroupScheduler.setControlGroups(&pagedGroups);
+    CGroupConfig pagedLimit;
+    pagedLimit.memory_limit = 64;
+    int limitedGroup = pagedGroups.create("limited", 0, pagedLimit);
+    int freeGroup = pagedGroups.create("unlimited");
+    pagedGroupScheduler.setPolicy(unique_ptr<SchedulingPolicy>(new CGroupPolicy(&pagedGroups)));
+    vector<PCB> pagedProcesses(8);
+    for (int i = 0; i < 8; i++) {
+        PCB& p = pagedProcesses[i];
+        p.pid = i + 1;
+        p.priority = 5;
+        p.memory_required = 96;
+        p.burst_time = 300;
+        p.remaining_time = 300;
+        p.required_resource = "";
+        p.has_resource = false;
+        pagedGroups.attach(&p, i < 4 ? limitedGroup : freeGroup);
+        pagedGroupMemory.allocate_process(p.pid, p.memory_required);
+        pagedGroupScheduler.submitProcess(&p);
+    }
+    long long residentPeak[2] = {0, 0};
+    for (long long t = 10; t <= 4000; t = t + 10) {
+        pagedGroupScheduler.runUntil(t);
+        residentPeak[0] = max(residentPeak[0], pagedGroupMemory.get_group_resident(limitedGroup));
+        residentPeak[1] = max(residentPeak[1], pagedGroupMemory.get_group_resident(freeGroup));
+    }
+    pagedGroupScheduler.runToCompletion();
+    cout << left << setw(14) << "Paged group" << right << setw(8) << "Limit" << setw(14) << "Peak resident"
+         << setw(10) << "Reclaims" << endl;
+    cout << left << setw(14) << "/limited" << right << setw(8) << pagedLimit.memory_limit << setw(14) << residentPeak[0]
+         << setw(10) << pagedGroupMemory.get_group_reclaims(limitedGroup) << endl;
+    cout << left << setw(14) << "/unlimited" << right << setw(8) << "-" << setw(14) << residentPeak[1]
+         << setw(10) << pagedGroupMemory.get_group_reclaims(freeGroup) << endl;
+
+
+    // freeing up space from allprocesses vector. processes still waiting for memory never
+    // got any, the queue lets go of them first so the releases below dont admit them
+    vector<PCB*> neverAdmitted = admission.drain();
+    for (size_t i = 0; i < neverAdmitted.size(); i++) {
+        neverAdmitted[i]->state = ProcessState::TERMINATED;
+    }
     for (int i = 0; i < allProcesses.size(); i++) {
         PCB* p = allProcesses[i];
         if (p->state != ProcessState::TERMINATED) {
-            memory.deallocate(p->memory_required);
+            memory.release_process(p->pid, p->memory_required);
         }
-        delete p;
+        pcbPool.release(p);
     }
 
     cout << endl << "------------------------- Simulation Complete ------------------------- " << endl;
@@ -0,0 +1,276 @@
+#include "admission.h"
+#include "scheduler.h"
+#include <algorithm>
+#include <climits>
+
+using namespace std;
+
+const uint64_t AdmissionQueue::EMPTY;
+
+AdmissionQueue::AdmissionQueue(MemoryManager* memory, Scheduler* scheduler, const AdmissionConfig& config) {
+    this->memory = memory;
+    this->scheduler = scheduler;
+    this->config = config;
+    if (this->config.batch_size < 1) this->config.batch_size = 1;
+    if (scheduler != nullptr) {
+        admitHandler = [scheduler](PCB* p) { scheduler->submitProcess(p); };
+    }
+
+    // one bucket per MB, coarser when the memory is so big that this would be too many
+    capacity = memory->get_admission_capacity();
+    granularity = 1;
+    while (capacity / granularity + 1 > MAX_BUCKETS) {
+        granularity = granularity * 2;
+    }
+    size_t count = (size_t)(capacity / granularity + 1);
+    buckets.resize(count);
+    leaves = 1;
+    while (leaves < count) leaves = leaves * 2;
+    tree.assign(2 * leaves, EMPTY);
+
+    nextSeq = 0;
+    waiting = 0;
+    headSeq = EMPTY;
+    headBypassed = 0;
+    attached = true;
+    memory->set_release_handler([this]() { wake(); });
+    memory->set_wake_threshold(LLONG_MAX);
+}
+
+AdmissionQueue::~AdmissionQueue() {
+    if (attached) {
+        memory->set_release_handler(nullptr);
+        memory->set_wake_threshold(LLONG_MAX);
+    }
+}
+
+void AdmissionQueue::setAdmitHandler(function<void(PCB*)> handler) {
+    admitHandler = handler;
+}
+
+bool AdmissionQueue::offer(PCB* p) {
+    stats.offered = stats.offered + 1;
+    if (p->memory_required > capacity) {
+        stats.rejected = stats.rejected + 1;
+        return false;
+    }
+    inbox.push_back(p);
+    if (inbox.size() >= config.batch_size) {
+        flush();
+    }
+    return true;
+}
+
+void AdmissionQueue::flush() {
+    if (inbox.empty()) return;
+    stats.batches = stats.batches + 1;
+    for (size_t i = 0; i < inbox.size(); i++) {
+        insert(inbox[i]);
+    }
+    inbox.clear();
+    if (waiting > stats.peak_pending) {
+        stats.peak_pending = waiting;
+    }
+    admitPass();
+}
+
+vector<PCB*> AdmissionQueue::drain() {
+    if (attached) {
+        memory->set_release_handler(nullptr);
+        memory->set_wake_threshold(LLONG_MAX);
+        attached = false;
+    }
+    vector<Waiting> all;
+    for (size_t b = 0; b < buckets.size(); b++) {
+        while (!buckets[b].empty()) {
+            all.push_back(buckets[b].pop_front());
+        }
+    }
+    sort(all.begin(), all.end(), [](const Waiting& a, const Waiting& b) { return a.seq < b.seq; });
+    vector<PCB*> left;
+    for (size_t i = 0; i < all.size(); i++) {
+        left.push_back(all[i].process);
+    }
+    left.insert(left.end(), inbox.begin(), inbox.end());
+    inbox.clear();
+    tree.assign(2 * leaves, EMPTY);
+    waiting = 0;
+    return left;
+}
+
+size_t AdmissionQueue::pending() const {
+    return waiting + inbox.size();
+}
+
+const AdmissionStats& AdmissionQueue::getStats() const {
+    return stats;
+}
+
+const AdmissionConfig& AdmissionQueue::getConfig() const {
+    return config;
+}
+
+void AdmissionQueue::insert(PCB* p) {
+    int bucket = max(p->memory_required, 0) / granularity;
+    Waiting w;
+    w.seq = nextSeq;
+    w.process = p;
+    nextSeq = nextSeq + 1;
+    bool wasEmpty = buckets[bucket].empty();
+    buckets[bucket].push_back(w);
+    waiting = waiting + 1;
+    if (wasEmpty) updateLeaf(bucket);
+}
+
+// the leaf holds the seq at the front of its bucket, every parent the smaller of its children
+void AdmissionQueue::updateLeaf(int bucket) {
+    size_t i = leaves + bucket;
+    tree[i] = buckets[bucket].empty() ? EMPTY : buckets[bucket].front().seq;
+    for (i = i / 2; i >= 1; i = i / 2) {
+        tree[i] = min(tree[2 * i], tree[2 * i + 1]);
+    }
+}
+
+// cover [0, lastBucket] with O(log) subtrees, then walk down the one holding the smallest seq
+int AdmissionQueue::oldest(int lastBucket) const {
+    if (lastBucket < 0) return -1;
+    size_t lo = leaves;
+    size_t hi = leaves + lastBucket + 1;
+    size_t best = 0;
+    uint64_t bestSeq = EMPTY;
+    while (lo < hi) {
+        if (lo & 1) {
+            if (tree[lo] < bestSeq) {
+                bestSeq = tree[lo];
+                best = lo;
+            }
+            lo = lo + 1;
+        }
+        if (hi & 1) {
+            hi = hi - 1;
+            if (tree[hi] < bestSeq) {
+                bestSeq = tree[hi];
+                best = hi;
+            }
+        }
+        lo = lo / 2;
+        hi = hi / 2;
+    }
+    if (bestSeq == EMPTY) return -1;
+    while (best < leaves) {
+        best = tree[2 * best] == bestSeq ? 2 * best : 2 * best + 1;
+    }
+    return (int)(best - leaves);
+}
+
+int AdmissionQueue::smallest(int lastBucket) const {
+    if (lastBucket < 0 || tree[1] == EMPTY) return -1;
+    size_t node = 1;
+    while (node < leaves) {
+        node = tree[2 * node] != EMPTY ? 2 * node : 2 * node + 1;
+    }
+    int bucket = (int)(node - leaves);
+    return bucket <= lastBucket ? bucket : -1;
+}
+
+// buckets whose every job fits in limit, -1 = none
+int AdmissionQueue::fittingBuckets(long long limit) const {
+    if (limit < 0) return -1;
+    long long last = (limit + 1) / granularity - 1;
+    return (int)min(last, (long long)buckets.size() - 1);
+}
+
+// bucket whose front job is admitted next, -1 = nothing can go in now
+int AdmissionQueue::pick(long long limit) {
+    int head = oldest((int)buckets.size() - 1);
+    if (head < 0) return -1;
+    const Waiting& first = buckets[head].front();
+    if (config.policy == AdmissionPolicy::SMALLEST_FIT) {
+        return smallest(fittingBuckets(limit));
+    }
+    if (first.process->memory_required <= limit) {
+        return head;
+    }
+    if (config.policy == AdmissionPolicy::FIFO) {
+        return -1;
+    }
+
+    // backfill around the oldest job until it has been passed max_bypass times
+    if (first.seq != headSeq) {
+        headSeq = first.seq;
+        headBypassed = 0;
+    }
+    if (headBypassed >= config.max_bypass) {
+        return -1;
+    }
+    return oldest(fittingBuckets(limit));
+}
+
+// admit until the next job does not fit, then tell the memory manager what it is waiting for
+void AdmissionQueue::admitPass() {
+    while (waiting > 0) {
+        stats.probes = stats.probes + 1;
+        int bucket = pick(memory->get_admission_limit());
+        if (bucket < 0) break;
+        PCB* p = buckets[bucket].front().process;
+        if (!memory->allocate_process(p->pid, p->memory_required)) {
+            break;   // enough memory in total, but not in one piece
+        }
+        bool bypass = config.policy == AdmissionPolicy::BACKFILL && buckets[bucket].front().seq > tree[1];
+        buckets[bucket].pop_front();
+        updateLeaf(bucket);
+        waiting = waiting - 1;
+        if (bypass) {
+            headBypassed = headBypassed + 1;
+            stats.bypasses = stats.bypasses + 1;
+        }
+
+        stats.admitted = stats.admitted + 1;
+        long long waited = scheduler != nullptr ? scheduler->getCurrentTime() - p->arrival_time : 0;
+        if (waited > 0) {
+            stats.total_wait = stats.total_wait + waited;
+            if (waited > stats.max_wait) stats.max_wait = waited;
+        }
+        admitHandler(p);
+    }
+    updateThreshold();
+}
+
+void AdmissionQueue::wake() {
+    stats.wakeups = stats.wakeups + 1;
+    long long before = stats.admitted;
+    admitPass();
+    if (stats.admitted == before) {
+        stats.idle_wakeups = stats.idle_wakeups + 1;
+    }
+}
+
+// the smallest admission limit at which pick() would let the next job in
+void AdmissionQueue::updateThreshold() {
+    if (!attached) return;
+    long long threshold = LLONG_MAX;
+    if (waiting > 0) {
+        int head = oldest((int)buckets.size() - 1);
+        const Waiting& first = buckets[head].front();
+        bool reserved = config.policy == AdmissionPolicy::BACKFILL && first.seq == headSeq
+                        && headBypassed >= config.max_bypass;
+        if (config.policy == AdmissionPolicy::FIFO || reserved) {
+            threshold = first.process->memory_required;
+        } else {
+            threshold = (long long)(smallest((int)buckets.size() - 1) + 1) * granularity - 1;
+            if (config.policy == AdmissionPolicy::BACKFILL) {
+                threshold = min(threshold, (long long)first.process->memory_required);
+            }
+        }
+    }
+    memory->set_wake_threshold(threshold);
+}
+
+string admissionPolicyName(AdmissionPolicy policy) {
+    switch (policy) {
+        case AdmissionPolicy::FIFO: return "fifo";
+        case AdmissionPolicy::SMALLEST_FIT: return "smallest-fit";
+        case AdmissionPolicy::BACKFILL: return "backfill";
+    }
+    return "unknown";
+}
@@ -0,0 +1,669 @@
+#include "batch_scheduler.h"
+#include <algorithm>
+#include <stdexcept>
+
+using namespace std;
+
+// ---------------- ReservationTimeline ----------------
+
+static int pickExtreme(int a, int b, bool highest) {
+    return highest ? max(a, b) : min(a, b);
+}
+
+ReservationTimeline::ReservationTimeline(int cores, long long start) {
+    this->cores = cores;
+    rng = 0x9E3779B9u;
+    probes = 0;
+    root = newNode(start, cores);
+}
+
+int ReservationTimeline::newNode(long long time, int free) {
+    // xorshift priorities keep the treap balanced in expectation
+    rng ^= rng << 13;
+    rng ^= rng >> 17;
+    rng ^= rng << 5;
+    Node node;
+    node.time = time;
+    node.free = free;
+    node.low = free;
+    node.high = free;
+    node.pending = 0;
+    node.priority = rng;
+    node.left = -1;
+    node.right = -1;
+    if (!unused.empty()) {
+        int n = unused.back();
+        unused.pop_back();
+        nodes[n] = node;
+        return n;
+    }
+    nodes.push_back(node);
+    return (int)nodes.size() - 1;
+}
+
+void ReservationTimeline::apply(int n, int delta) {
+    if (n < 0) return;
+    nodes[n].free = nodes[n].free + delta;
+    nodes[n].low = nodes[n].low + delta;
+    nodes[n].high = nodes[n].high + delta;
+    nodes[n].pending = nodes[n].pending + delta;
+}
+
+void ReservationTimeline::push(int n) {
+    if (nodes[n].pending == 0) return;
+    apply(nodes[n].left, nodes[n].pending);
+    apply(nodes[n].right, nodes[n].pending);
+    nodes[n].pending = 0;
+}
+
+void ReservationTimeline::update(int n) {
+    Node& node = nodes[n];
+    node.low = node.free;
+    node.high = node.free;
+    if (node.left >= 0) {
+        node.low = min(node.low, nodes[node.left].low);
+        node.high = max(node.high, nodes[node.left].high);
+    }
+    if (node.right >= 0) {
+        node.low = min(node.low, nodes[node.right].low);
+        node.high = max(node.high, nodes[node.right].high);
+    }
+}
+
+void ReservationTimeline::split(int n, long long time, int& left, int& right) {
+    if (n < 0) {
+        left = -1;
+        right = -1;
+        return;
+    }
+    push(n);
+    if (nodes[n].time < time) {
+        split(nodes[n].right, time, nodes[n].right, right);
+        left = n;
+    } else {
+        split(nodes[n].left, time, left, nodes[n].left);
+        right = n;
+    }
+    update(n);
+}
+
+int ReservationTimeline::merge(int left, int right) {
+    if (left < 0) return right;
+    if (right < 0) return left;
+    if (nodes[left].priority > nodes[right].priority) {
+        push(left);
+        nodes[left].right = merge(nodes[left].right, right);
+        update(left);
+        return left;
+    }
+    push(right);
+    nodes[right].left = merge(left, nodes[right].left);
+    update(right);
+    return right;
+}
+
+void ReservationTimeline::recycle(int n) {
+    vector<int> stack;
+    if (n >= 0) stack.push_back(n);
+    while (!stack.empty()) {
+        int top = stack.back();
+        stack.pop_back();
+        if (nodes[top].left >= 0) stack.push_back(nodes[top].left);
+        if (nodes[top].right >= 0) stack.push_back(nodes[top].right);
+        unused.push_back(top);
+    }
+}
+
+// free count of the last breakpoint at or before time. carry is the sum of the adds the
+// ancestors have not pushed down yet
+int ReservationTimeline::valueAt(int n, long long time, int carry) const {
+    int value = cores;
+    while (n >= 0) {
+        if (nodes[n].time <= time) {
+            value = nodes[n].free + carry;
+            carry = carry + nodes[n].pending;
+            n = nodes[n].right;
+        } else {
+            carry = carry + nodes[n].pending;
+            n = nodes[n].left;
+        }
+    }
+    return value;
+}
+
+// a breakpoint at time with the value the step function already has there
+void ReservationTimeline::ensureBreak(long long time) {
+    if (time == TIMELINE_END) return;
+    int left, right;
+    split(root, time, left, right);
+    int first = right;
+    while (first >= 0 && nodes[first].left >= 0) first = nodes[first].left;
+    if (first < 0 || nodes[first].time != time) {
+        int node = newNode(time, valueAt(left, time, 0));
+        right = merge(node, right);
+    }
+    root = merge(left, right);
+}
+
+// first (or last) breakpoint of a subtree and its free count
+int ReservationTimeline::edge(int n, bool last, int& value) const {
+    int carry = 0;
+    while (true) {
+        int next = last ? nodes[n].right : nodes[n].left;
+        if (next < 0) break;
+        carry = carry + nodes[n].pending;
+        n = next;
+    }
+    value = nodes[n].free + carry;
+    return n;
+}
+
+// cut the timeline at from and to, make sure both have a breakpoint, add to the middle and
+// drop the end breakpoints again when they no longer change the free count (a release that
+// undoes a reserve). two splits and two merges, plus O(log n) walks along the cut edges
+void ReservationTimeline::addRange(long long from, long long to, int delta) {
+    if (to <= from) return;
+    int left, middle, right;
+    split(root, from, left, middle);
+    split(middle, to, middle, right);
+
+    int before = cores;
+    if (left >= 0) edge(left, true, before);
+    int atEnd = before;
+    if (middle >= 0) edge(middle, true, atEnd);
+    int value;
+    if (middle < 0 || nodes[edge(middle, false, value)].time != from) {
+        middle = merge(newNode(from, before), middle);
+    }
+    if (to != TIMELINE_END && (right < 0 || nodes[edge(right, false, value)].time != to)) {
+        right = merge(newNode(to, atEnd), right);
+    }
+    apply(middle, delta);
+
+    int first, rest;
+    if (left >= 0) {
+        edge(middle, false, value);
+        if (value == before) {
+            split(middle, from + 1, first, rest);
+            recycle(first);
+            middle = rest;
+        }
+    }
+    if (right >= 0) {
+        int last = before;
+        if (middle >= 0) edge(middle, true, last);
+        edge(right, false, value);
+        if (value == last) {
+            split(right, to + 1, first, rest);
+            recycle(first);
+            right = rest;
+        }
+    }
+    root = merge(merge(left, middle), right);
+}
+
+void ReservationTimeline::reserve(long long start, long long duration, int count) {
+    long long end = duration >= TIMELINE_END - start ? TIMELINE_END : start + duration;
+    addRange(start, end, -count);
+}
+
+void ReservationTimeline::release(long long start, long long duration, int count) {
+    long long end = duration >= TIMELINE_END - start ? TIMELINE_END : start + duration;
+    addRange(start, end, count);
+}
+
+int ReservationTimeline::freeAt(long long time) const {
+    return valueAt(root, time, 0);
+}
+
+// smallest (or largest) free count over [from, to). walks the breakpoints inside (from, to)
+// without touching the tree: down to the first one in range, then along the two boundary
+// paths, whole subtrees in between count by their low / high
+int ReservationTimeline::rangeExtreme(long long from, long long to, bool highest) const {
+    int result = valueAt(root, from, 0);
+    int n = root;
+    int carry = 0;
+    while (n >= 0) {
+        const Node& node = nodes[n];
+        int below = carry + node.pending;
+        if (node.time <= from) {
+            n = node.right;
+        } else if (node.time >= to) {
+            n = node.left;
+        } else {
+            result = pickExtreme(result, node.free + carry, highest);
+            // left side: keys > from
+            int l = node.left;
+            int c = below;
+            while (l >= 0) {
+                const Node& x = nodes[l];
+                int under = c + x.pending;
+                if (x.time <= from) {
+                    l = x.right;
+                } else {
+                    result = pickExtreme(result, x.free + c, highest);
+                    if (x.right >= 0) {
+                        const Node& y = nodes[x.right];
+                        result = pickExtreme(result, (highest ? y.high : y.low) + under, highest);
+                    }
+                    l = x.left;
+                }
+                c = under;
+            }
+            // right side: keys < to
+            int r = node.right;
+            c = below;
+            while (r >= 0) {
+                const Node& x = nodes[r];
+                int under = c + x.pending;
+                if (x.time >= to) {
+                    r = x.left;
+                } else {
+                    result = pickExtreme(result, x.free + c, highest);
+                    if (x.left >= 0) {
+                        const Node& y = nodes[x.left];
+                        result = pickExtreme(result, (highest ? y.high : y.low) + under, highest);
+                    }
+                    r = x.right;
+                }
+                c = under;
+            }
+            break;
+        }
+        carry = below;
+    }
+    return result;
+}
+
+int ReservationTimeline::minFree(long long from, long long to) const {
+    return rangeExtreme(from, to, false);
+}
+
+int ReservationTimeline::maxFree(long long from, long long to) const {
+    return rangeExtreme(from, to, true);
+}
+
+// leftmost breakpoint after `after` with at least needed free cores, -1 if none
+int ReservationTimeline::firstAtLeast(int n, long long after, int needed, int carry) const {
+    if (n < 0 || nodes[n].high + carry < needed) return -1;
+    int below = carry + nodes[n].pending;
+    if (nodes[n].time <= after) {
+        return firstAtLeast(nodes[n].right, after, needed, below);
+    }
+    int found = firstAtLeast(nodes[n].left, after, needed, below);
+    if (found >= 0) return found;
+    if (nodes[n].free + carry >= needed) return n;
+    return firstAtLeast(nodes[n].right, after, needed, below);
+}
+
+// leftmost breakpoint after `after` with fewer than needed free cores, -1 if none
+int ReservationTimeline::firstBelow(int n, long long after, int needed, int carry) const {
+    if (n < 0 || nodes[n].low + carry >= needed) return -1;
+    int below = carry + nodes[n].pending;
+    if (nodes[n].time <= after) {
+        return firstBelow(nodes[n].right, after, needed, below);
+    }
+    int found = firstBelow(nodes[n].left, after, needed, below);
+    if (found >= 0) return found;
+    if (nodes[n].free + carry < needed) return n;
+    return firstBelow(nodes[n].right, after, needed, below);
+}
+
+long long ReservationTimeline::earliestStart(long long from, int count, long long duration, long long before) const {
+    if (count > cores) return -1;
+    if (count <= 0) return from;
+    long long t = from;
+    while (true) {
+        probes = probes + 1;
+        long long start = t;
+        if (valueAt(root, t, 0) < count) {
+            int up = firstAtLeast(root, t, count, 0);
+            if (up < 0) return -1;
+            start = nodes[up].time;
+        }
+        if (start >= before) return -1;
+        int down = firstBelow(root, start, count, 0);
+        if (down < 0 || nodes[down].time - start >= duration) return start;
+        t = nodes[down].time;   // the gap is too short, look behind the dip
+    }
+}
+
+void ReservationTimeline::advance(long long time) {
+    ensureBreak(time);
+    int left, right;
+    split(root, time, left, right);
+    recycle(left);
+    root = right;
+}
+
+size_t ReservationTimeline::size() const {
+    return nodes.size() - unused.size();
+}
+
+int ReservationTimeline::getCores() const {
+    return cores;
+}
+
+uint64_t ReservationTimeline::getProbes() const {
+    return probes;
+}
+
+// ---------------- BatchScheduler ----------------
+
+static const int NOT_WAITING = INT_MAX;
+
+BatchScheduler::BatchScheduler(const BatchConfig& config) : timeline(config.cores > 0 ? config.cores : 1) {
+    this->config = config;
+    if (this->config.cores < 1) this->config.cores = 1;
+    if (this->config.compress_depth < 0) this->config.compress_depth = 0;
+    now = 0;
+    coreTicks = 0;
+    queueLeaves = 1;
+    queued = 0;
+}
+
+void BatchScheduler::submit(const BatchJob& job) {
+    BatchJob j = job;
+    if (j.cores < (int)j.tasks.size()) j.cores = (int)j.tasks.size();
+    if (j.cores < 1) j.cores = 1;
+    if (j.cores > config.cores) {
+        throw invalid_argument("job " + to_string(j.id) + " wants " + to_string(j.cores) + " cores, the machine has "
+                               + to_string(config.cores));
+    }
+    if (j.walltime < 1) j.walltime = 1;
+    if (j.runtime < 1) j.runtime = 1;
+    jobs.push_back(j);
+}
+
+// leaf of a waiting job holds its cores and walltime, every parent the smaller of each
+void BatchScheduler::queuePut(int job, bool waiting) {
+    size_t n = queueLeaves + job;
+    queueCores[n] = waiting ? jobs[job].cores : NOT_WAITING;
+    queueWalltime[n] = waiting ? jobs[job].walltime : LLONG_MAX;
+    for (n = n / 2; n >= 1; n = n / 2) {
+        queueCores[n] = min(queueCores[2 * n], queueCores[2 * n + 1]);
+        queueWalltime[n] = min(queueWalltime[2 * n], queueWalltime[2 * n + 1]);
+    }
+}
+
+// first waiting job with an index above after, -1 if none
+int BatchScheduler::queueFirst(int after) const {
+    size_t n = 1;
+    size_t low = 0;
+    size_t width = queueLeaves;
+    size_t from = (size_t)(after + 1);
+    if (from >= queueLeaves) return -1;
+    // go down towards from, on the way back up take the first waiting subtree to the right
+    vector<size_t> right;
+    while (n < queueLeaves) {
+        width = width / 2;
+        if (from < low + width) {
+            right.push_back(2 * n + 1);
+            n = 2 * n;
+        } else {
+            low = low + width;
+            n = 2 * n + 1;
+        }
+    }
+    if (queueCores[n] == NOT_WAITING) {
+        n = 0;
+        while (!right.empty()) {
+            if (queueCores[right.back()] != NOT_WAITING) {
+                n = right.back();
+                break;
+            }
+            right.pop_back();
+        }
+        if (n == 0) return -1;
+        while (n < queueLeaves) {
+            n = queueCores[2 * n] != NOT_WAITING ? 2 * n : 2 * n + 1;
+        }
+    }
+    return (int)(n - queueLeaves);
+}
+
+// first waiting job (in arrival order) that can start now: it fits in limitAlways cores, or in
+// limitNow cores and ends within window. subtrees whose fewest cores or shortest walltime
+// already rule them out are skipped
+int BatchScheduler::queueFind(int n, int limitNow, long long window, int limitAlways) const {
+    if (queueCores[n] > limitNow) return -1;
+    if (queueCores[n] > limitAlways && queueWalltime[n] > window) return -1;
+    if ((size_t)n >= queueLeaves) return n - (int)queueLeaves;
+    int found = queueFind(2 * n, limitNow, window, limitAlways);
+    if (found >= 0) return found;
+    return queueFind(2 * n + 1, limitNow, window, limitAlways);
+}
+
+// all tasks of the job get their cores at the same time
+void BatchScheduler::start(int job, bool reserved, vector<Event>& heap) {
+    BatchJob& j = jobs[job];
+    j.backfilled = queueFirst(-1) != job;
+    if (j.backfilled) stats.backfilled = stats.backfilled + 1;
+    queuePut(job, false);
+    queued = queued - 1;
+    if (!reserved) {
+        timeline.reserve(now, j.walltime, j.cores);
+    }
+    j.start_time = now;
+    j.killed = j.runtime > j.walltime;
+    metrics.record_response(now - j.submit_time);
+    for (size_t i = 0; i < j.tasks.size(); i++) {
+        PCB* p = j.tasks[i];
+        p->state = ProcessState::RUNNING;
+        p->first_run_time = now;
+        p->response_time = (int)(now - j.submit_time);
+    }
+
+    Event e;
+    e.time = now + min(j.runtime, j.walltime);
+    e.type = 0;
+    e.job = job;
+    e.token = 0;
+    heap.push_back(e);
+    push_heap(heap.begin(), heap.end(), EventLater());
+}
+
+// every task stops together, cores the job was promised but did not use go back.
+// true when it ended before its walltime, so there are such cores
+bool BatchScheduler::finish(int job) {
+    BatchJob& j = jobs[job];
+    j.end_time = now;
+    long long ran = now - j.start_time;
+    if (ran < j.walltime) {
+        timeline.release(now, j.walltime - ran, j.cores);
+    }
+    if (j.killed) stats.killed = stats.killed + 1;
+    coreTicks = coreTicks + ran * j.cores;
+    metrics.record_completion_times(j.submit_time, ran, now);
+    stats.mean_slowdown = stats.mean_slowdown + (double)(now - j.submit_time) / max(ran, 10LL);
+    for (size_t i = 0; i < j.tasks.size(); i++) {
+        PCB* p = j.tasks[i];
+        p->state = ProcessState::TERMINATED;
+        p->remaining_time = 0;
+        p->completion_time = now;
+        p->turnaround_time = now - j.submit_time;
+        p->waiting_time = j.start_time - j.submit_time;
+    }
+    return ran < j.walltime;
+}
+
+// FCFS and EASY: start from the front while jobs fit. EASY then reserves the first job that
+// does not fit at its earliest start (the shadow time) and backfills every later job that
+// fits now and either ends before the shadow time or leaves the reserved cores alone
+void BatchScheduler::schedule(vector<Event>& heap) {
+    int head = queueFirst(-1);
+    while (head >= 0 && timeline.freeAt(now) >= jobs[head].cores) {
+        start(head, false, heap);
+        head = queueFirst(-1);
+    }
+    if (head < 0 || config.backfill != BackfillMode::EASY) return;
+
+    const BatchJob& h = jobs[head];
+    long long shadow = timeline.earliestStart(now, h.cores, h.walltime);
+    timeline.reserve(shadow, h.walltime, h.cores);
+    while (true) {
+        int freeNow = timeline.freeAt(now);
+        int spare = timeline.minFree(now);
+        int job = queueFind(1, freeNow, shadow - now, spare);
+        if (job < 0) break;
+        start(job, false, heap);
+    }
+    timeline.release(shadow, h.walltime, h.cores);
+}
+
+// conservative: waiting jobs in arrival order give up their reservation and take the earliest
+// one they can get now, which is never later than the old one
+void BatchScheduler::compress(vector<Event>& heap) {
+    int job = queueFirst(-1);
+    int looked = 0;
+    while (job >= 0 && (config.compress_depth == 0 || looked < config.compress_depth)) {
+        int next = queueFirst(job);
+        BatchJob& j = jobs[job];
+        looked = looked + 1;
+        // it can only move if enough cores are free somewhere before its reservation
+        if (j.reserved_start <= now || timeline.maxFree(now, j.reserved_start) < j.cores) {
+            job = next;
+            continue;
+        }
+        // first with its own reservation in place, that is only a read. a window that overlaps
+        // the job's own reservation needs that one given back first
+        long long earliest = timeline.earliestStart(now, j.cores, j.walltime, j.reserved_start);
+        if (earliest < 0 && timeline.maxFree(max(now, j.reserved_start - j.walltime), j.reserved_start) >= j.cores) {
+            timeline.release(j.reserved_start, j.walltime, j.cores);
+            earliest = timeline.earliestStart(now, j.cores, j.walltime, j.reserved_start);
+            timeline.reserve(earliest >= 0 ? earliest : j.reserved_start, j.walltime, j.cores);
+        } else if (earliest >= 0) {
+            timeline.release(j.reserved_start, j.walltime, j.cores);
+            timeline.reserve(earliest, j.walltime, j.cores);
+        }
+        if (earliest < 0) earliest = j.reserved_start;
+        if (earliest < j.reserved_start) {
+            j.reserved_start = earliest;
+            tokens[job] = tokens[job] + 1;
+            stats.compressed = stats.compressed + 1;
+            if (earliest == now) {
+                start(job, true, heap);
+            } else {
+                Event e;
+                e.time = earliest;
+                e.type = 1;
+                e.job = job;
+                e.token = tokens[job];
+                heap.push_back(e);
+                push_heap(heap.begin(), heap.end(), EventLater());
+            }
+        }
+        job = next;
+    }
+}
+
+void BatchScheduler::run() {
+    stable_sort(jobs.begin(), jobs.end(), [](const BatchJob& a, const BatchJob& b) {
+        return a.submit_time < b.submit_time;
+    });
+    stats = BatchStats();
+    metrics.clear();
+    stats.jobs = (long long)jobs.size();
+    if (jobs.empty()) return;
+
+    queueLeaves = 1;
+    while (queueLeaves < jobs.size()) queueLeaves = queueLeaves * 2;
+    queueCores.assign(2 * queueLeaves, NOT_WAITING);
+    queueWalltime.assign(2 * queueLeaves, LLONG_MAX);
+    queued = 0;
+    tokens.assign(jobs.size(), 0);
+    long long first = jobs[0].submit_time;
+    timeline = ReservationTimeline(config.cores, first);
+    coreTicks = 0;
+
+    vector<Event> heap;
+    size_t nextArrival = 0;
+    while (nextArrival < jobs.size() || !heap.empty()) {
+        now = nextArrival < jobs.size() ? jobs[nextArrival].submit_time : LLONG_MAX;
+        if (!heap.empty() && heap.front().time < now) now = heap.front().time;
+        timeline.advance(now);
+
+        // job ends first, so the cores are free for everything else at this instant. only
+        // jobs that ended before their walltime leave room for compression
+        vector<Event> starts;
+        bool ended = false;
+        while (!heap.empty() && heap.front().time == now) {
+            pop_heap(heap.begin(), heap.end(), EventLater());
+            Event e = heap.back();
+            heap.pop_back();
+            if (e.type == 0) {
+                if (finish(e.job)) ended = true;
+            } else {
+                starts.push_back(e);
+            }
+        }
+        if (ended && config.backfill == BackfillMode::CONSERVATIVE) {
+            compress(heap);
+        }
+        for (size_t i = 0; i < starts.size(); i++) {
+            if (starts[i].token == tokens[starts[i].job] && jobs[starts[i].job].start_time < 0) {
+                start(starts[i].job, true, heap);
+            }
+        }
+
+        while (nextArrival < jobs.size() && jobs[nextArrival].submit_time == now) {
+            int job = (int)nextArrival;
+            nextArrival = nextArrival + 1;
+            metrics.record_arrival_time(now);
+            queuePut(job, true);
+            queued = queued + 1;
+            if (config.backfill == BackfillMode::CONSERVATIVE) {
+                BatchJob& j = jobs[job];
+                j.reserved_start = timeline.earliestStart(now, j.cores, j.walltime);
+                timeline.reserve(j.reserved_start, j.walltime, j.cores);
+                if (j.reserved_start == now) {
+                    start(job, true, heap);
+                } else {
+                    Event e;
+                    e.time = j.reserved_start;
+                    e.type = 1;
+                    e.job = job;
+                    e.token = tokens[job];
+                    heap.push_back(e);
+                    push_heap(heap.begin(), heap.end(), EventLater());
+                }
+            }
+        }
+        if (queued > stats.peak_queue) stats.peak_queue = queued;
+
+        if (config.backfill != BackfillMode::CONSERVATIVE) {
+            schedule(heap);
+        }
+        if (timeline.size() > stats.peak_breakpoints) stats.peak_breakpoints = timeline.size();
+    }
+
+    stats.makespan = now - first;
+    stats.utilization = stats.makespan > 0 ? (double)coreTicks / ((double)config.cores * stats.makespan) : 0;
+    stats.mean_slowdown = stats.mean_slowdown / jobs.size();
+    stats.timeline_probes = timeline.getProbes();
+}
+
+const vector<BatchJob>& BatchScheduler::getJobs() const {
+    return jobs;
+}
+
+const MetricsCollector& BatchScheduler::getMetrics() const {
+    return metrics;
+}
+
+const BatchStats& BatchScheduler::getStats() const {
+    return stats;
+}
+
+const BatchConfig& BatchScheduler::getConfig() const {
+    return config;
+}
+
+string backfillModeName(BackfillMode mode) {
+    switch (mode) {
+        case BackfillMode::NONE: return "fcfs";
+        case BackfillMode::EASY: return "easy";
+        case BackfillMode::CONSERVATIVE: return "conservative";
+    }
+    return "unknown";
+}
@@ -0,0 +1,474 @@
+#include "cgroup.h"
+#include <iostream>
+#include <iomanip>
+#include <stdexcept>
+
+using namespace std;
+
+// ---------------- ControlGroups ----------------
+
+ControlGroups::ControlGroups() {
+    Group root;
+    root.name = "";
+    root.parent = -1;
+    groups.push_back(root);
+}
+
+int ControlGroups::create(const string& name, int parent, const CGroupConfig& config) {
+    if (parent < 0 || parent >= (int)groups.size()) {
+        throw invalid_argument("no control group " + to_string(parent) + " to create " + name + " in");
+    }
+    Group g;
+    g.name = name;
+    g.parent = parent;
+    g.config = config;
+    groups.push_back(g);
+    int id = (int)groups.size() - 1;
+    groups[parent].children.push_back(id);
+    return id;
+}
+
+void ControlGroups::setConfig(int group, const CGroupConfig& config) {
+    groups.at(group).config = config;
+}
+
+void ControlGroups::attach(PCB* p, int group) {
+    if (group < 0 || group >= (int)groups.size()) {
+        throw invalid_argument("no control group " + to_string(group));
+    }
+    p->cgroup = group;
+    auto it = members.find(p->pid);
+    if (it == members.end()) {
+        Member m;
+        m.group = group;
+        m.process = p;
+        m.charged = 0;
+        m.dying = false;
+        members[p->pid] = m;
+        return;
+    }
+    Member& m = it->second;
+    m.process = p;
+    if (m.group == group) return;
+    // the memory moves along, without looking at the limits of the new group
+    long long charged = m.charged;
+    addCharge(m.group, -charged);
+    groups[m.group].killable.erase(make_pair(charged, p->pid));
+    m.group = group;
+    addCharge(group, charged);
+    if (!m.dying && charged > 0) groups[group].killable.insert(make_pair(charged, p->pid));
+}
+
+int ControlGroups::groupOf(int pid) const {
+    auto it = members.find(pid);
+    return it != members.end() ? it->second.group : 0;
+}
+
+// lowest group from group up that mb more would put over its limit, -1 = it fits
+int ControlGroups::overLimit(int group, long long mb) const {
+    for (int g = group; g >= 0; g = groups[g].parent) {
+        long long limit = groups[g].config.memory_limit;
+        if (limit > 0 && groups[g].stats.memory + mb > limit) return g;
+    }
+    return -1;
+}
+
+void ControlGroups::addCharge(int group, long long mb) {
+    for (int g = group; g >= 0; g = groups[g].parent) {
+        CGroupStats& s = groups[g].stats;
+        s.memory = s.memory + mb;
+        if (s.memory > s.memory_peak) s.memory_peak = s.memory;
+    }
+}
+
+// the biggest process below group that is not already dying
+bool ControlGroups::oomKill(int group) {
+    while (true) {
+        int best = -1;
+        pair<long long, int> victim(-1, -1);
+        vector<int> stack(1, group);
+        while (!stack.empty()) {
+            int g = stack.back();
+            stack.pop_back();
+            if (!groups[g].killable.empty() && *groups[g].killable.rbegin() > victim) {
+                victim = *groups[g].killable.rbegin();
+                best = g;
+            }
+            stack.insert(stack.end(), groups[g].children.begin(), groups[g].children.end());
+        }
+        if (best < 0) return false;
+        groups[best].killable.erase(victim);
+        Member& m = members[victim.second];
+        m.dying = true;
+        if (oomHandler && m.process != nullptr && oomHandler(m.process)) {
+            groups[group].stats.oom_kills = groups[group].stats.oom_kills + 1;
+            return true;
+        }
+    }
+}
+
+bool ControlGroups::charge(int pid, long long mb, bool enforce) {
+    auto it = members.find(pid);
+    if (it == members.end()) {
+        Member m;
+        m.group = 0;
+        m.process = nullptr;
+        m.charged = 0;
+        m.dying = false;
+        it = members.insert(make_pair(pid, m)).first;
+    }
+    int group = it->second.group;
+    int over = enforce ? overLimit(group, mb) : -1;
+    if (over >= 0 && oomKill(over)) {
+        over = overLimit(group, mb);   // only changed when the victim exited right away
+    }
+    if (over >= 0) {
+        groups[over].stats.charge_failures = groups[over].stats.charge_failures + 1;
+        return false;
+    }
+
+    it = members.find(pid);   // the OOM kill may have changed the map
+    if (it == members.end()) return false;   // it was its own victim
+    Member& m = it->second;
+    if (!m.dying && m.charged > 0) groups[group].killable.erase(make_pair(m.charged, pid));
+    m.charged = m.charged + mb;
+    addCharge(group, mb);
+    if (!m.dying && m.process != nullptr) groups[group].killable.insert(make_pair(m.charged, pid));
+    return true;
+}
+
+void ControlGroups::uncharge(int pid, long long mb) {
+    auto it = members.find(pid);
+    if (it == members.end()) return;
+    Member& m = it->second;
+    if (mb > m.charged) mb = m.charged;
+    if (!m.dying && m.charged > 0) groups[m.group].killable.erase(make_pair(m.charged, pid));
+    m.charged = m.charged - mb;
+    addCharge(m.group, -mb);
+    if (!m.dying && m.charged > 0 && m.process != nullptr) groups[m.group].killable.insert(make_pair(m.charged, pid));
+}
+
+void ControlGroups::detach(int pid) {
+    auto it = members.find(pid);
+    if (it == members.end()) return;
+    uncharge(pid, it->second.charged);
+    members.erase(pid);
+}
+
+void ControlGroups::setOomHandler(function<bool(PCB*)> handler) {
+    oomHandler = handler;
+}
+
+void ControlGroups::recordDispatch(const PCB* p, long long now) {
+    long long latency = p->ready_time >= 0 ? now - p->ready_time : 0;
+    for (int g = p->cgroup; g >= 0 && g < (int)groups.size(); g = groups[g].parent) {
+        CGroupStats& s = groups[g].stats;
+        s.dispatches = s.dispatches + 1;
+        s.total_latency = s.total_latency + latency;
+        if (latency > s.max_latency) s.max_latency = latency;
+        if (p->first_run_time < 0 && p->period == 0) {
+            groups[g].metrics.record_response(now - p->arrival_time);
+        }
+    }
+}
+
+void ControlGroups::recordRun(const PCB* p, long long ticks) {
+    for (int g = p->cgroup; g >= 0 && g < (int)groups.size(); g = groups[g].parent) {
+        groups[g].stats.cpu_time = groups[g].stats.cpu_time + ticks;
+        groups[g].metrics.record_busy(ticks);
+    }
+}
+
+void ControlGroups::recordThrottle(int group, long long ticks) {
+    CGroupStats& s = groups.at(group).stats;
+    s.throttled = s.throttled + 1;
+    s.throttled_time = s.throttled_time + ticks;
+}
+
+void ControlGroups::recordCompletion(const PCB* p, long long now) {
+    if (p->period > 0) return;
+    for (int g = p->cgroup; g >= 0 && g < (int)groups.size(); g = groups[g].parent) {
+        groups[g].metrics.record_arrival_time(p->arrival_time);
+        groups[g].metrics.record_completion_times(p->arrival_time, p->burst_time + p->io_time, now);
+    }
+}
+
+size_t ControlGroups::size() const {
+    return groups.size();
+}
+
+int ControlGroups::getParent(int group) const {
+    return groups.at(group).parent;
+}
+
+const string& ControlGroups::getName(int group) const {
+    return groups.at(group).name;
+}
+
+string ControlGroups::path(int group) const {
+    if (group == 0) return "/";
+    string result;
+    for (int g = group; g > 0; g = groups[g].parent) {
+        result = "/" + groups[g].name + result;
+    }
+    return result;
+}
+
+const CGroupConfig& ControlGroups::getConfig(int group) const {
+    return groups.at(group).config;
+}
+
+const CGroupStats& ControlGroups::getStats(int group) const {
+    return groups.at(group).stats;
+}
+
+const MetricsCollector& ControlGroups::getMetrics(int group) const {
+    return groups.at(group).metrics;
+}
+
+// one line per group, children below their parent
+void ControlGroups::print() const {
+    cout << left << setw(18) << "Group" << right << setw(8) << "Shares" << setw(10) << "Quota"
+         << setw(10) << "CPU" << setw(11) << "Throttled" << setw(10) << "Done" << setw(12) << "Mean wait"
+         << setw(11) << "P99 wait" << setw(10) << "Mem MB" << setw(10) << "Peak MB" << setw(6) << "OOM" << endl;
+    vector<int> stack(1, 0);
+    while (!stack.empty()) {
+        int g = stack.back();
+        stack.pop_back();
+        const Group& group = groups[g];
+        MetricsSummary m = group.metrics.summary();
+        string quota = group.config.quota > 0
+            ? to_string(group.config.quota) + "/" + to_string(group.config.period) : "-";
+        cout << left << setw(18) << path(g) << right << setw(8) << group.config.shares << setw(10) << quota
+             << setw(10) << group.stats.cpu_time << setw(11) << group.stats.throttled_time
+             << setw(10) << m.completed << fixed << setprecision(1) << setw(12) << m.mean_waiting
+             << setw(11) << m.p99_waiting << setw(10) << group.stats.memory << setw(10) << group.stats.memory_peak
+             << setw(6) << group.stats.oom_kills << endl;
+        for (size_t i = group.children.size(); i > 0; i--) {
+            stack.push_back(group.children[i - 1]);
+        }
+    }
+    cout.unsetf(ios::fixed);
+    cout << setprecision(6);
+}
+
+// ---------------- CGroupPolicy ----------------
+
+CGroupPolicy::CGroupPolicy(ControlGroups* groups, const PolicyParams& params) {
+    this->groups = groups;
+    latency = params.cfs_latency > 0 ? params.cfs_latency : 1;
+    minGranularity = params.cfs_min_granularity > 0 ? params.cfs_min_granularity : 1;
+    next_seq = 0;
+    count = 0;
+    pickedAt = 0;
+    state.resize(groups->size());
+}
+
+// groups made after the policy get their state on first use
+int CGroupPolicy::groupFor(const PCB* p) {
+    if (state.size() < groups->size()) {
+        state.resize(groups->size());
+    }
+    return p->cgroup > 0 && p->cgroup < (int)state.size() ? p->cgroup : 0;
+}
+
+// a group with ready processes goes into its parent's queue, and the parent into its own
+// parent's when it was not there yet. throttled groups stay out
+void CGroupPolicy::activate(int group) {
+    while (group != 0) {
+        GroupState& s = state[group];
+        if (s.queued || s.throttled || s.queue.empty()) return;
+        int parent = groups->getParent(group);
+        GroupState& up = state[parent];
+        // a group that sat idle gets at most half a period of credit, like a sleeping process
+        if (s.vruntime < up.minVruntime - latency / 2) {
+            s.vruntime = up.minVruntime - latency / 2;
+        }
+        s.entry.key = s.vruntime;
+        s.entry.seq = next_seq;
+        s.entry.process = nullptr;
+        s.entry.group = group;
+        next_seq = next_seq + 1;
+        up.queue.insert(s.entry);
+        up.queuedWeight = up.queuedWeight + groups->getConfig(group).shares;
+        s.queued = true;
+        group = parent;
+    }
+}
+
+// take the group out of its parent's queue, then every parent left empty out of its own
+void CGroupPolicy::deactivate(int group) {
+    while (group != 0 && state[group].queued) {
+        GroupState& s = state[group];
+        int parent = groups->getParent(group);
+        GroupState& up = state[parent];
+        up.queue.erase(s.entry);
+        up.queuedWeight = up.queuedWeight - groups->getConfig(group).shares;
+        s.queued = false;
+        if (!up.queue.empty()) return;
+        group = parent;
+    }
+}
+
+// a group's virtual runtime grows by the CPU time below it, scaled by its shares. the
+// remainder of the division is carried over, short slices of a heavy group would lose
+// most of their charge otherwise
+void CGroupPolicy::charge(int group, long long ticks) {
+    GroupState& s = state[group];
+    int shares = groups->getConfig(group).shares;
+    if (shares < 1) shares = 1;
+    long long scaled = ticks * 1024 + s.remainder;
+    long long delta = scaled / shares;
+    s.remainder = scaled % shares;
+    if (!s.queued) {
+        s.vruntime = s.vruntime + delta;
+        return;
+    }
+    GroupState& up = state[groups->getParent(group)];
+    up.queue.erase(s.entry);
+    s.vruntime = s.vruntime + delta;
+    s.entry.key = s.vruntime;
+    s.entry.seq = next_seq;
+    next_seq = next_seq + 1;
+    up.queue.insert(s.entry);
+}
+
+// start a new quota period when the current one is over
+void CGroupPolicy::rollPeriod(int group, long long now) {
+    const CGroupConfig& config = groups->getConfig(group);
+    GroupState& s = state[group];
+    if (config.quota <= 0 || s.throttled) return;
+    long long period = config.period > 0 ? config.period : 1;
+    if (now >= s.periodStart + period) {
+        s.periodStart = s.periodStart + (now - s.periodStart) / period * period;
+        s.used = 0;
+    }
+}
+
+// throttled groups whose period is over come back
+void CGroupPolicy::refill(long long now) {
+    while (!unthrottle.empty() && unthrottle.top().first <= now) {
+        pair<long long, int> next = unthrottle.top();
+        unthrottle.pop();
+        GroupState& s = state[next.second];
+        if (!s.throttled) continue;
+        s.throttled = false;
+        groups->recordThrottle(next.second, max(0LL, next.first - s.throttledAt));
+        s.periodStart = next.first;
+        s.used = 0;
+        rollPeriod(next.second, now);
+        activate(next.second);
+    }
+}
+
+// new processes start at their group's minimum, returning sleepers get at most half a
+// period of credit (same as CFSPolicy)
+void CGroupPolicy::enqueue(PCB* p, long long now) {
+    refill(now);
+    int group = groupFor(p);
+    GroupState& s = state[group];
+    if (p->first_run_time < 0 && p->vruntime == 0) {
+        p->vruntime = s.minVruntime;
+    } else if (p->vruntime < s.minVruntime - latency / 2) {
+        p->vruntime = s.minVruntime - latency / 2;
+    }
+
+    Entry e;
+    e.key = p->vruntime;
+    e.seq = next_seq;
+    e.process = p;
+    e.group = group;
+    next_seq = next_seq + 1;
+    s.queue.insert(e);
+    s.queuedWeight = s.queuedWeight + CFSPolicy::weightFor(p->priority);
+    count = count + 1;
+    activate(group);
+}
+
+// leftmost entry at every level, down from the root until it is a process
+PCB* CGroupPolicy::pickNext(long long now) {
+    refill(now);
+    if (state.size() < groups->size()) {
+        state.resize(groups->size());
+    }
+    int group = 0;
+    while (true) {
+        GroupState& s = state[group];
+        if (s.queue.empty()) return nullptr;   // everything that is ready is throttled
+        Entry e = *s.queue.begin();
+        if (e.key > s.minVruntime) {
+            s.minVruntime = e.key;
+        }
+        if (e.process == nullptr) {
+            group = e.group;
+            continue;
+        }
+
+        PCB* p = e.process;
+        s.queue.erase(s.queue.begin());
+        s.queuedWeight = s.queuedWeight - CFSPolicy::weightFor(p->priority);
+        count = count - 1;
+        if (s.queue.empty()) {
+            deactivate(group);
+        }
+        for (int g = group; g != 0; g = groups->getParent(g)) {
+            rollPeriod(g, now);
+        }
+        pickedAt = now;
+        groups->recordDispatch(p, now);
+        return p;
+    }
+}
+
+bool CGroupPolicy::empty() const {
+    return count == 0;
+}
+
+size_t CGroupPolicy::size() const {
+    return count;
+}
+
+// CFS share of the target latency inside the group, cut to what the quotas on the way up
+// have left in their current period, so a group never runs past its quota
+int CGroupPolicy::timeSlice(const PCB* p) const {
+    int group = p->cgroup > 0 && p->cgroup < (int)state.size() ? p->cgroup : 0;
+    long long weight = CFSPolicy::weightFor(p->priority);
+    long long slice = (long long)latency * weight / (state[group].queuedWeight + weight);
+    if (slice < minGranularity) slice = minGranularity;
+    for (int g = group; g != 0; g = groups->getParent(g)) {
+        const CGroupConfig& config = groups->getConfig(g);
+        if (config.quota <= 0) continue;
+        long long period = config.period > 0 ? config.period : 1;
+        long long left = min(config.quota - state[g].used, state[g].periodStart + period - pickedAt);
+        slice = min(slice, max(left, 1LL));
+    }
+    return (int)slice;
+}
+
+void CGroupPolicy::onDescheduled(PCB* p, int ran, bool sliceExpired) {
+    p->vruntime = p->vruntime + (long long)ran * 1024 / CFSPolicy::weightFor(p->priority);
+    int group = groupFor(p);
+    groups->recordRun(p, ran);
+    for (int g = group; g != 0; g = groups->getParent(g)) {
+        charge(g, ran);
+        const CGroupConfig& config = groups->getConfig(g);
+        GroupState& s = state[g];
+        if (config.quota <= 0) continue;
+        s.used = s.used + ran;
+        if (s.used >= config.quota && !s.throttled) {
+            long long period = config.period > 0 ? config.period : 1;
+            s.throttled = true;
+            s.throttledAt = pickedAt + ran;
+            deactivate(g);
+            unthrottle.push(make_pair(s.periodStart + period, g));
+        }
+    }
+}
+
+long long CGroupPolicy::heldUntil() const {
+    return unthrottle.empty() ? -1 : unthrottle.top().first;
+}
+
+string CGroupPolicy::name() const {
+    return "Hierarchical Fair Share";
+}
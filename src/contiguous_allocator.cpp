@@ -0,0 +1,673 @@
+#include "contiguous_allocator.h"
+#include "snapshot.h"
+#include <chrono>
+#include <algorithm>
+
+using namespace std;
+
+// ---------------- ContiguousAllocator ----------------
+
+ContiguousAllocator::ContiguousAllocator(long long totalSize) {
+    this->totalSize = totalSize;
+    allocatedSize = 0;
+    requestedSize = 0;
+    allocCount = 0;
+    failCount = 0;
+    freeCount = 0;
+    allocNanos = 0;
+}
+
+// time the real allocation and keep the counters up to date
+long long ContiguousAllocator::allocate(long long size) {
+    if (size < 1) size = 1;
+    auto start = chrono::steady_clock::now();
+    long long blockSize = 0;
+    long long address = doAllocate(size, blockSize);
+    allocNanos = allocNanos + chrono::duration<double, nano>(chrono::steady_clock::now() - start).count();
+
+    allocCount = allocCount + 1;
+    if (address < 0) {
+        failCount = failCount + 1;
+        return -1;
+    }
+    allocatedSize = allocatedSize + blockSize;
+    requestedSize = requestedSize + size;
+    return address;
+}
+
+void ContiguousAllocator::release(long long address) {
+    long long requested = 0;
+    long long blockSize = doRelease(address, requested);
+    if (blockSize < 0) return;  // unknown address
+    allocatedSize = allocatedSize - blockSize;
+    requestedSize = requestedSize - requested;
+    freeCount = freeCount + 1;
+}
+
+AllocatorStats ContiguousAllocator::stats() const {
+    AllocatorStats s;
+    s.total = totalSize;
+    s.allocated = allocatedSize;
+    s.requested = requestedSize;
+    s.free_space = freeSpace();
+    s.largest_free = largestFree();
+    s.free_blocks = freeBlockCount();
+    s.live_blocks = liveBlockCount();
+    s.external_fragmentation = s.free_space > 0 ? 1.0 - (double)s.largest_free / s.free_space : 0;
+    s.internal_fragmentation = s.allocated > 0 ? (double)(s.allocated - s.requested) / s.allocated : 0;
+    s.allocations = allocCount;
+    s.failures = failCount;
+    s.frees = freeCount;
+    s.avg_alloc_ns = allocCount > 0 ? allocNanos / allocCount : 0;
+    return s;
+}
+
+void ContiguousAllocator::saveCounters(SnapshotWriter& out) const {
+    out.put(totalSize);
+    out.put(allocatedSize);
+    out.put(requestedSize);
+    out.put(allocCount);
+    out.put(failCount);
+    out.put(freeCount);
+    out.put(allocNanos);
+}
+
+void ContiguousAllocator::loadCounters(SnapshotReader& in) {
+    in.get(totalSize);
+    in.get(allocatedSize);
+    in.get(requestedSize);
+    in.get(allocCount);
+    in.get(failCount);
+    in.get(freeCount);
+    in.get(allocNanos);
+}
+
+// ---------------- AddressTree ----------------
+
+AddressTree::AddressTree() {
+    root = -1;
+    seed = 2463534242u;
+}
+
+// xorshift32 for treap priorities
+uint32_t AddressTree::nextPriority() {
+    seed ^= seed << 13;
+    seed ^= seed >> 17;
+    seed ^= seed << 5;
+    return seed;
+}
+
+// recompute the subtree maximum
+void AddressTree::update(int t) {
+    Node& n = nodes[t];
+    n.maxSize = n.size;
+    if (n.left >= 0 && nodes[n.left].maxSize > n.maxSize) n.maxSize = nodes[n.left].maxSize;
+    if (n.right >= 0 && nodes[n.right].maxSize > n.maxSize) n.maxSize = nodes[n.right].maxSize;
+}
+
+void AddressTree::split(int t, long long address, int& left, int& right) {
+    if (t < 0) {
+        left = -1;
+        right = -1;
+        return;
+    }
+    if (nodes[t].address < address) {
+        split(nodes[t].right, address, nodes[t].right, right);
+        left = t;
+    } else {
+        split(nodes[t].left, address, left, nodes[t].left);
+        right = t;
+    }
+    update(t);
+}
+
+int AddressTree::merge(int a, int b) {
+    if (a < 0) return b;
+    if (b < 0) return a;
+    if (nodes[a].priority > nodes[b].priority) {
+        nodes[a].right = merge(nodes[a].right, b);
+        update(a);
+        return a;
+    }
+    nodes[b].left = merge(a, nodes[b].left);
+    update(b);
+    return b;
+}
+
+void AddressTree::insert(long long address, long long size) {
+    int t;
+    if (!freeNodes.empty()) {
+        t = freeNodes.back();
+        freeNodes.pop_back();
+    } else {
+        t = (int)nodes.size();
+        nodes.push_back(Node());
+    }
+    nodes[t].address = address;
+    nodes[t].size = size;
+    nodes[t].maxSize = size;
+    nodes[t].priority = nextPriority();
+    nodes[t].left = -1;
+    nodes[t].right = -1;
+
+    int left, right;
+    split(root, address, left, right);
+    root = merge(merge(left, t), right);
+}
+
+void AddressTree::erase(long long address) {
+    int left, middle, right;
+    split(root, address, left, middle);
+    split(middle, address + 1, middle, right);
+    if (middle >= 0) {
+        freeNodes.push_back(middle);   // only one node can start at this address
+    }
+    root = merge(left, right);
+}
+
+void AddressTree::clear() {
+    nodes.clear();
+    freeNodes.clear();
+    root = -1;
+}
+
+bool AddressTree::predecessor(long long address, long long& outAddress, long long& outSize) const {
+    int t = root;
+    bool found = false;
+    while (t >= 0) {
+        if (nodes[t].address < address) {
+            outAddress = nodes[t].address;
+            outSize = nodes[t].size;
+            found = true;
+            t = nodes[t].right;
+        } else {
+            t = nodes[t].left;
+        }
+    }
+    return found;
+}
+
+bool AddressTree::find(long long address, long long& outSize) const {
+    int t = root;
+    while (t >= 0) {
+        if (nodes[t].address == address) {
+            outSize = nodes[t].size;
+            return true;
+        }
+        t = address < nodes[t].address ? nodes[t].left : nodes[t].right;
+    }
+    return false;
+}
+
+// leftmost node with address >= from and size >= size, subtrees whose max is too small are skipped
+int AddressTree::findFit(int t, long long size, long long from) const {
+    if (t < 0 || nodes[t].maxSize < size) return -1;
+    if (nodes[t].address >= from) {
+        int left = findFit(nodes[t].left, size, from);
+        if (left >= 0) return left;
+        if (nodes[t].size >= size) return t;
+    }
+    return findFit(nodes[t].right, size, from);
+}
+
+long long AddressTree::firstFit(long long size, long long from) const {
+    int t = findFit(root, size, from);
+    return t >= 0 ? nodes[t].address : -1;
+}
+
+// node array as it is, the treap shape and the priority generator come back unchanged
+void AddressTree::saveState(SnapshotWriter& out) const {
+    out.putVector(nodes);
+    out.putVector(freeNodes);
+    out.put(root);
+    out.put(seed);
+}
+
+void AddressTree::loadState(SnapshotReader& in) {
+    in.getVector(nodes);
+    in.getVector(freeNodes);
+    in.get(root);
+    in.get(seed);
+}
+
+// ---------------- FreeListAllocator ----------------
+
+FreeListAllocator::FreeListAllocator(long long totalSize, FitStrategy strategy) : ContiguousAllocator(totalSize) {
+    this->strategy = strategy;
+    freeTotal = 0;
+    nextFitCursor = 0;
+    addFree(0, totalSize);
+}
+
+void FreeListAllocator::addFree(long long address, long long size) {
+    byAddress.insert(address, size);
+    bySize.insert(make_pair(size, address));
+    freeTotal = freeTotal + size;
+}
+
+void FreeListAllocator::removeFree(long long address, long long size) {
+    byAddress.erase(address);
+    bySize.erase(make_pair(size, address));
+    freeTotal = freeTotal - size;
+}
+
+long long FreeListAllocator::doAllocate(long long size, long long& blockSize) {
+    long long address = -1;
+    long long holeSize = 0;
+
+    if (strategy == FitStrategy::FIRST_FIT) {
+        address = byAddress.firstFit(size);
+    } else if (strategy == FitStrategy::NEXT_FIT) {
+        // continue from where the last search stopped, wrap around once
+        address = byAddress.firstFit(size, nextFitCursor);
+        if (address < 0) {
+            address = byAddress.firstFit(size, 0);
+        }
+    } else if (strategy == FitStrategy::BEST_FIT) {
+        auto it = bySize.lower_bound(make_pair(size, (long long)-1));
+        if (it != bySize.end()) address = it->second;
+    } else {
+        // worst fit - biggest hole
+        if (!bySize.empty() && bySize.rbegin()->first >= size) {
+            address = bySize.rbegin()->second;
+        }
+    }
+    if (address < 0) return -1;
+
+    byAddress.find(address, holeSize);
+    removeFree(address, holeSize);
+    if (holeSize > size) {
+        addFree(address + size, holeSize - size);  // leftover stays free
+    }
+    nextFitCursor = address + size;
+
+    Block b;
+    b.size = size;
+    b.requested = size;
+    live[address] = b;
+    blockSize = size;
+    return address;
+}
+
+// free the block and merge it with free neighbours
+long long FreeListAllocator::doRelease(long long address, long long& requested) {
+    auto it = live.find(address);
+    if (it == live.end()) return -1;
+    long long size = it->second.size;
+    requested = it->second.requested;
+    live.erase(it);
+
+    long long start = address;
+    long long length = size;
+
+    long long prevAddress = 0, prevSize = 0;
+    if (byAddress.predecessor(address, prevAddress, prevSize) && prevAddress + prevSize == address) {
+        removeFree(prevAddress, prevSize);
+        start = prevAddress;
+        length = length + prevSize;
+    }
+    long long nextSize;
+    if (byAddress.find(address + size, nextSize)) {
+        removeFree(address + size, nextSize);
+        length = length + nextSize;
+    }
+    addFree(start, length);
+    return size;
+}
+
+long long FreeListAllocator::largestFree() const {
+    return bySize.empty() ? 0 : bySize.rbegin()->first;
+}
+
+long long FreeListAllocator::freeSpace() const {
+    return freeTotal;
+}
+
+size_t FreeListAllocator::freeBlockCount() const {
+    return bySize.size();
+}
+
+size_t FreeListAllocator::liveBlockCount() const {
+    return live.size();
+}
+
+string FreeListAllocator::name() const {
+    switch (strategy) {
+        case FitStrategy::FIRST_FIT: return "First Fit";
+        case FitStrategy::BEST_FIT: return "Best Fit";
+        case FitStrategy::WORST_FIT: return "Worst Fit";
+        case FitStrategy::NEXT_FIT: return "Next Fit";
+    }
+    return "Free List";
+}
+
+void FreeListAllocator::saveState(SnapshotWriter& out) const {
+    saveCounters(out);
+    out.put(strategy);
+    byAddress.saveState(out);
+    out.putAll(bySize);
+    out.put((uint64_t)live.size());
+    for (auto it = live.begin(); it != live.end(); it++) {
+        out.put(it->first);
+        out.put(it->second.size);
+        out.put(it->second.requested);
+    }
+    out.put(freeTotal);
+    out.put(nextFitCursor);
+}
+
+void FreeListAllocator::loadState(SnapshotReader& in) {
+    loadCounters(in);
+    in.get(strategy);
+    byAddress.loadState(in);
+    in.getSet(bySize);
+    live.clear();
+    uint64_t n = in.get<uint64_t>();
+    for (uint64_t i = 0; i < n; i++) {
+        long long address = in.get<long long>();
+        Block b;
+        in.get(b.size);
+        in.get(b.requested);
+        live.emplace_hint(live.end(), address, b);
+    }
+    in.get(freeTotal);
+    in.get(nextFitCursor);
+}
+
+// move every live block down to the lowest free address, leaves one free block at the top
+long long FreeListAllocator::compact(vector<pair<long long, long long>>& moves) {
+    long long cursor = 0;
+    long long copied = 0;
+    map<long long, Block> moved;
+    for (auto it = live.begin(); it != live.end(); it++) {
+        if (it->first != cursor) {
+            moves.push_back(make_pair(it->first, cursor));
+            copied = copied + it->second.size;
+        }
+        moved[cursor] = it->second;
+        cursor = cursor + it->second.size;
+    }
+    live.swap(moved);
+
+    byAddress.clear();
+    bySize.clear();
+    freeTotal = 0;
+    if (cursor < totalSize) {
+        addFree(cursor, totalSize - cursor);
+    }
+    nextFitCursor = 0;
+    return copied;
+}
+
+// ---------------- BuddyAllocator ----------------
+
+BuddyAllocator::BuddyAllocator(long long totalSize, long long minBlock) : ContiguousAllocator(totalSize) {
+    this->minBlock = minBlock > 0 ? minBlock : 1;
+    // biggest power of two number of min blocks that fits
+    maxOrder = 0;
+    while ((this->minBlock << (maxOrder + 1)) <= totalSize) {
+        maxOrder = maxOrder + 1;
+    }
+    freeLists.resize(maxOrder + 1);
+    freeLists[maxOrder].insert(0);
+    freeTotal = this->minBlock << maxOrder;
+    this->totalSize = freeTotal;   // tail that is not a power of two is unusable
+}
+
+// smallest order whose block holds size
+int BuddyAllocator::orderFor(long long size) const {
+    int order = 0;
+    while ((minBlock << order) < size) {
+        order = order + 1;
+    }
+    return order;
+}
+
+long long BuddyAllocator::doAllocate(long long size, long long& blockSize) {
+    int order = orderFor(size);
+    if (order > maxOrder) return -1;
+
+    int available = order;
+    while (available <= maxOrder && freeLists[available].empty()) {
+        available = available + 1;
+    }
+    if (available > maxOrder) return -1;
+
+    long long address = *freeLists[available].begin();
+    freeLists[available].erase(freeLists[available].begin());
+
+    // split down, upper halves go back on the free lists
+    while (available > order) {
+        available = available - 1;
+        freeLists[available].insert(address + (minBlock << available));
+    }
+
+    blockSize = minBlock << order;
+    freeTotal = freeTotal - blockSize;
+    live[address] = make_pair(order, size);
+    return address;
+}
+
+// merge with the buddy as long as the buddy is free
+long long BuddyAllocator::doRelease(long long address, long long& requested) {
+    auto it = live.find(address);
+    if (it == live.end()) return -1;
+    int order = it->second.first;
+    requested = it->second.second;
+    live.erase(it);
+
+    long long blockSize = minBlock << order;
+    freeTotal = freeTotal + blockSize;
+
+    while (order < maxOrder) {
+        long long buddy = address ^ (minBlock << order);
+        auto b = freeLists[order].find(buddy);
+        if (b == freeLists[order].end()) break;
+        freeLists[order].erase(b);
+        address = min(address, buddy);
+        order = order + 1;
+    }
+    freeLists[order].insert(address);
+    return blockSize;
+}
+
+long long BuddyAllocator::largestFree() const {
+    for (int order = maxOrder; order >= 0; order--) {
+        if (!freeLists[order].empty()) return minBlock << order;
+    }
+    return 0;
+}
+
+long long BuddyAllocator::freeSpace() const {
+    return freeTotal;
+}
+
+size_t BuddyAllocator::freeBlockCount() const {
+    size_t count = 0;
+    for (size_t i = 0; i < freeLists.size(); i++) {
+        count = count + freeLists[i].size();
+    }
+    return count;
+}
+
+size_t BuddyAllocator::liveBlockCount() const {
+    return live.size();
+}
+
+string BuddyAllocator::name() const {
+    return "Buddy";
+}
+
+void BuddyAllocator::saveState(SnapshotWriter& out) const {
+    saveCounters(out);
+    out.put(minBlock);
+    out.put(maxOrder);
+    out.put((uint64_t)freeLists.size());
+    for (size_t i = 0; i < freeLists.size(); i++) out.putAll(freeLists[i]);
+    out.putAll(live);
+    out.put(freeTotal);
+}
+
+void BuddyAllocator::loadState(SnapshotReader& in) {
+    loadCounters(in);
+    in.get(minBlock);
+    in.get(maxOrder);
+    freeLists.resize(in.get<uint64_t>());
+    for (size_t i = 0; i < freeLists.size(); i++) in.getSet(freeLists[i]);
+    in.getMap(live);
+    in.get(freeTotal);
+}
+
+// ---------------- SlabAllocator ----------------
+
+SlabAllocator::SlabAllocator(long long totalSize, const vector<long long>& classSizes, int objectsPerSlab)
+    : ContiguousAllocator(totalSize), backing(totalSize, FitStrategy::BEST_FIT) {
+    this->classSizes = classSizes;
+    sort(this->classSizes.begin(), this->classSizes.end());
+    this->objectsPerSlab = objectsPerSlab > 0 ? objectsPerSlab : 1;
+    partialSlabs.resize(this->classSizes.size());
+}
+
+long long SlabAllocator::doAllocate(long long size, long long& blockSize) {
+    // smallest class that holds the request
+    auto cls = lower_bound(classSizes.begin(), classSizes.end(), size);
+    if (cls == classSizes.end()) {
+        // too big for any class, use the backing allocator directly
+        long long address = backing.allocate(size);
+        if (address < 0) return -1;
+        largeBlocks[address] = size;
+        liveObjects[address] = make_pair(-1, size);
+        blockSize = size;
+        return address;
+    }
+    int sizeClass = (int)(cls - classSizes.begin());
+    long long objectSize = *cls;
+
+    int slabId;
+    if (!partialSlabs[sizeClass].empty()) {
+        slabId = *partialSlabs[sizeClass].begin();
+    } else {
+        // grab a new slab
+        long long base = backing.allocate(objectSize * objectsPerSlab);
+        if (base < 0) return -1;
+        if (!freeSlabIds.empty()) {
+            slabId = freeSlabIds.back();
+            freeSlabIds.pop_back();
+        } else {
+            slabId = (int)slabs.size();
+            slabs.push_back(Slab());
+        }
+        Slab& slab = slabs[slabId];
+        slab.base = base;
+        slab.sizeClass = sizeClass;
+        slab.used = 0;
+        slab.freeObjects.clear();
+        for (int i = objectsPerSlab - 1; i >= 0; i--) {
+            slab.freeObjects.push_back(i);
+        }
+        partialSlabs[sizeClass].insert(slabId);
+    }
+
+    Slab& slab = slabs[slabId];
+    int index = slab.freeObjects.back();
+    slab.freeObjects.pop_back();
+    slab.used = slab.used + 1;
+    if (slab.freeObjects.empty()) {
+        partialSlabs[sizeClass].erase(slabId);
+    }
+
+    long long address = slab.base + index * objectSize;
+    liveObjects[address] = make_pair(slabId, size);
+    blockSize = objectSize;
+    return address;
+}
+
+long long SlabAllocator::doRelease(long long address, long long& requested) {
+    auto it = liveObjects.find(address);
+    if (it == liveObjects.end()) return -1;
+    int slabId = it->second.first;
+    requested = it->second.second;
+    liveObjects.erase(it);
+
+    if (slabId < 0) {
+        long long size = largeBlocks[address];
+        largeBlocks.erase(address);
+        backing.release(address);
+        return size;
+    }
+
+    Slab& slab = slabs[slabId];
+    long long objectSize = classSizes[slab.sizeClass];
+    int index = (int)((address - slab.base) / objectSize);
+    slab.freeObjects.push_back(index);
+    slab.used = slab.used - 1;
+
+    if (slab.used == 0) {
+        // empty slab goes back to the backing allocator
+        partialSlabs[slab.sizeClass].erase(slabId);
+        backing.release(slab.base);
+        freeSlabIds.push_back(slabId);
+    } else {
+        partialSlabs[slab.sizeClass].insert(slabId);
+    }
+    return objectSize;
+}
+
+long long SlabAllocator::largestFree() const {
+    return backing.largestFree();
+}
+
+// space not carved into slabs or large blocks, unused objects inside slabs do not count
+long long SlabAllocator::freeSpace() const {
+    return backing.freeSpace();
+}
+
+size_t SlabAllocator::freeBlockCount() const {
+    return backing.freeBlockCount();
+}
+
+size_t SlabAllocator::liveBlockCount() const {
+    return liveObjects.size();
+}
+
+string SlabAllocator::name() const {
+    return "Slab";
+}
+
+void SlabAllocator::saveState(SnapshotWriter& out) const {
+    saveCounters(out);
+    out.putVector(classSizes);
+    out.put(objectsPerSlab);
+    backing.saveState(out);
+    out.put((uint64_t)slabs.size());
+    for (size_t i = 0; i < slabs.size(); i++) {
+        out.put(slabs[i].base);
+        out.put(slabs[i].sizeClass);
+        out.putVector(slabs[i].freeObjects);
+        out.put(slabs[i].used);
+    }
+    out.putVector(freeSlabIds);
+    out.put((uint64_t)partialSlabs.size());
+    for (size_t i = 0; i < partialSlabs.size(); i++) out.putAll(partialSlabs[i]);
+    out.putAll(liveObjects);
+    out.putAll(largeBlocks);
+}
+
+void SlabAllocator::loadState(SnapshotReader& in) {
+    loadCounters(in);
+    in.getVector(classSizes);
+    in.get(objectsPerSlab);
+    backing.loadState(in);
+    slabs.resize(in.get<uint64_t>());
+    for (size_t i = 0; i < slabs.size(); i++) {
+        in.get(slabs[i].base);
+        in.get(slabs[i].sizeClass);
+        in.getVector(slabs[i].freeObjects);
+        in.get(slabs[i].used);
+    }
+    in.getVector(freeSlabIds);
+    partialSlabs.resize(in.get<uint64_t>());
+    for (size_t i = 0; i < partialSlabs.size(); i++) in.getSet(partialSlabs[i]);
+    in.getMap(liveObjects);
+    in.getMap(largeBlocks);
+}
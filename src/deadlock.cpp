@@ -0,0 +1,592 @@
+#include "deadlock.h"
+#include "workload_generator.h"
+#include <algorithm>
+#include <chrono>
+#include <iostream>
+#include <iomanip>
+
+using namespace std;
+
+MultiResourceManager::MultiResourceManager(const vector<int>& instances, DeadlockMode mode) {
+    this->mode = mode;
+    resourceTypes = (int)instances.size();
+    total = instances;
+    available = instances;
+    liveCount = 0;
+    visitStamp = 0;
+    needIndex.resize(resourceTypes);
+    holders.resize(resourceTypes);
+    waitersOn.resize(resourceTypes);
+    work.resize(resourceTypes);
+}
+
+bool MultiResourceManager::addProcess(int pid, const vector<int>& maxClaim) {
+    if (slotOf.count(pid)) return false;
+
+    int slot;
+    if (!freeSlots.empty()) {
+        slot = freeSlots.back();
+        freeSlots.pop_back();
+    } else {
+        slot = (int)procs.size();
+        procs.push_back(ProcessEntry());
+        waitFor.push_back(unordered_set<int>());
+        satisfied.push_back(0);
+        visitMark.push_back(0);
+    }
+    ProcessEntry& e = procs[slot];
+    e.pid = pid;
+    e.live = true;
+    e.alloc.assign(resourceTypes, 0);
+    e.maxClaim.assign(resourceTypes, 0);
+    e.held.clear();
+    e.needNonZero = 0;
+    e.waitResource = -1;
+    e.waitCount = 0;
+    for (int r = 0; r < resourceTypes && r < (int)maxClaim.size(); r++) {
+        e.maxClaim[r] = min(max(0, maxClaim[r]), total[r]);
+        if (e.maxClaim[r] > 0) {
+            e.needNonZero = e.needNonZero + 1;
+            needIndex[r].insert(make_pair(e.maxClaim[r], slot));
+        }
+    }
+    slotOf[pid] = slot;
+    liveCount = liveCount + 1;
+    return true;
+}
+
+// change one allocation and keep every index in sync
+void MultiResourceManager::setAlloc(int slot, int resource, int value) {
+    ProcessEntry& e = procs[slot];
+    int old = e.alloc[resource];
+    if (old == value) return;
+
+    int oldNeed = e.maxClaim[resource] - old;
+    int newNeed = e.maxClaim[resource] - value;
+    if (oldNeed > 0) needIndex[resource].erase(make_pair(oldNeed, slot));
+    if (newNeed > 0) needIndex[resource].insert(make_pair(newNeed, slot));
+    if (oldNeed > 0 && newNeed <= 0) e.needNonZero = e.needNonZero - 1;
+    if (oldNeed <= 0 && newNeed > 0) e.needNonZero = e.needNonZero + 1;
+
+    if (old == 0 && value > 0) {
+        e.held.push_back(resource);
+        holders[resource].insert(slot);
+        // everybody waiting on this type now also waits for us
+        if (mode == DeadlockMode::DETECT) {
+            for (size_t i = 0; i < waitersOn[resource].size(); i++) {
+                int w = waitersOn[resource][i];
+                if (w != slot) waitFor[w].insert(slot);
+            }
+        }
+    } else if (old > 0 && value == 0) {
+        e.held.erase(find(e.held.begin(), e.held.end(), resource));
+        holders[resource].erase(slot);
+        if (mode == DeadlockMode::DETECT) {
+            for (size_t i = 0; i < waitersOn[resource].size(); i++) {
+                waitFor[waitersOn[resource][i]].erase(slot);
+            }
+        }
+    }
+    e.alloc[resource] = value;
+}
+
+// grant if instances are free (and, when avoiding, the result is safe)
+bool MultiResourceManager::tryGrant(int slot, int resource, int count) {
+    if (count > available[resource]) return false;
+
+    available[resource] = available[resource] - count;
+    setAlloc(slot, resource, procs[slot].alloc[resource] + count);
+    if (mode == DeadlockMode::AVOID && !safeAfterGrant(slot)) {
+        setAlloc(slot, resource, procs[slot].alloc[resource] - count);
+        available[resource] = available[resource] + count;
+        counters.unsafe_delays = counters.unsafe_delays + 1;
+        return false;
+    }
+    counters.grants = counters.grants + 1;
+    return true;
+}
+
+// the state before the grant was safe. if the requester can now finish with what is free,
+// it returns everything and the old safe order still works, so no search is needed
+bool MultiResourceManager::safeAfterGrant(int slot) {
+    const ProcessEntry& e = procs[slot];
+    const int* claim = e.maxClaim.data();
+    const int* alloc = e.alloc.data();
+    const int* avail = available.data();
+    int blocked = 0;
+    for (int r = 0; r < resourceTypes; r++) {
+        blocked |= (claim[r] - alloc[r] > avail[r]);   // branch free, vectorizes
+    }
+    if (!blocked) {
+        counters.fast_safe = counters.fast_safe + 1;
+        return true;
+    }
+    return isSafe();
+}
+
+bool MultiResourceManager::isSafe() {
+    auto start = chrono::steady_clock::now();
+    counters.safety_checks = counters.safety_checks + 1;
+
+    work = available;
+    ready.clear();
+    for (size_t s = 0; s < procs.size(); s++) {
+        satisfied[s] = 0;
+        if (procs[s].live && procs[s].needNonZero == 0) ready.push_back((int)s);
+    }
+
+    // cursor per type over the processes sorted by need
+    vector<set<pair<int, int>>::const_iterator> cursor(resourceTypes);
+    auto advance = [&](int r) {
+        auto& it = cursor[r];
+        while (it != needIndex[r].end() && it->first <= work[r]) {
+            int s = it->second;
+            satisfied[s] = satisfied[s] + 1;
+            if (satisfied[s] == procs[s].needNonZero) ready.push_back(s);
+            ++it;
+        }
+    };
+    for (int r = 0; r < resourceTypes; r++) {
+        cursor[r] = needIndex[r].begin();
+        advance(r);
+    }
+
+    // let finishable processes return what they hold
+    int finished = 0;
+    while (!ready.empty()) {
+        int s = ready.back();
+        ready.pop_back();
+        finished = finished + 1;
+        const ProcessEntry& e = procs[s];
+        for (size_t i = 0; i < e.held.size(); i++) {
+            int r = e.held[i];
+            work[r] = work[r] + e.alloc[r];
+            advance(r);
+        }
+    }
+
+    counters.safety_ns = counters.safety_ns + chrono::duration<double, nano>(chrono::steady_clock::now() - start).count();
+    return finished == liveCount;
+}
+
+RequestResult MultiResourceManager::request(int pid, int resource, int count) {
+    counters.requests = counters.requests + 1;
+    auto found = slotOf.find(pid);
+    if (found == slotOf.end() || resource < 0 || resource >= resourceTypes || count <= 0) {
+        return RequestResult::DENIED;
+    }
+    int slot = found->second;
+    ProcessEntry& e = procs[slot];
+    if (e.waitResource >= 0) return RequestResult::DENIED;                 // still waiting
+    if (e.alloc[resource] + count > e.maxClaim[resource]) return RequestResult::DENIED;   // over claim
+
+    if (tryGrant(slot, resource, count)) {
+        return RequestResult::GRANTED;
+    }
+    startWaiting(slot, resource, count);
+    return RequestResult::WAITING;
+}
+
+void MultiResourceManager::startWaiting(int slot, int resource, int count) {
+    ProcessEntry& e = procs[slot];
+    e.waitResource = resource;
+    e.waitCount = count;
+    waitersOn[resource].push_back(slot);
+    waitQueue.push_back(slot);
+    counters.waits = counters.waits + 1;
+
+    if (mode == DeadlockMode::DETECT) {
+        for (int h : holders[resource]) {
+            if (h != slot) waitFor[slot].insert(h);
+        }
+        checkDeadlock(slot);
+    }
+}
+
+void MultiResourceManager::stopWaiting(int slot) {
+    ProcessEntry& e = procs[slot];
+    if (e.waitResource < 0) return;
+    vector<int>& list = waitersOn[e.waitResource];
+    list.erase(find(list.begin(), list.end(), slot));
+    waitQueue.erase(find(waitQueue.begin(), waitQueue.end(), slot));
+    waitFor[slot].clear();
+    e.waitResource = -1;
+    e.waitCount = 0;
+}
+
+// depth first search in the wait-for graph
+bool MultiResourceManager::reachable(int from, int target) {
+    visitStamp = visitStamp + 1;
+    vector<int> stack(1, from);
+    while (!stack.empty()) {
+        int s = stack.back();
+        stack.pop_back();
+        for (int next : waitFor[s]) {
+            if (next == target) return true;
+            if (visitMark[next] != visitStamp) {
+                visitMark[next] = visitStamp;
+                stack.push_back(next);
+            }
+        }
+    }
+    return false;
+}
+
+// only the new waiter can have closed a cycle, so the search starts there
+void MultiResourceManager::checkDeadlock(int slot) {
+    counters.cycle_checks = counters.cycle_checks + 1;
+    if (!reachable(slot, slot)) return;
+
+    // abort victims until the rest can finish, the reduction treats victims as gone
+    vector<int> chosen;
+    vector<int> stuck = reduce(chosen);
+    if (stuck.empty()) return;   // cycle, but enough instances to get out of it
+    counters.deadlocks = counters.deadlocks + 1;
+
+    while (!stuck.empty()) {
+        // victim = deadlocked process holding the fewest instances (least work lost). one
+        // that holds nothing frees nothing, it is only picked when no other one is left
+        int victim = -1;
+        int victimHeld = 0;
+        for (size_t i = 0; i < stuck.size(); i++) {
+            const ProcessEntry& e = procs[stuck[i]];
+            int held = 0;
+            for (size_t k = 0; k < e.held.size(); k++) held = held + e.alloc[e.held[k]];
+            bool better = victimHeld == 0 ? held > 0 || victim < 0 : held > 0 && held < victimHeld;
+            if (better || (victim >= 0 && held == victimHeld && e.pid > procs[victim].pid)) {
+                victim = stuck[i];
+                victimHeld = held;
+            }
+        }
+        chosen.push_back(victim);
+        if (find(victims.begin(), victims.end(), procs[victim].pid) == victims.end()) {
+            victims.push_back(procs[victim].pid);
+        }
+        stuck = reduce(chosen);
+    }
+}
+
+vector<int> MultiResourceManager::findDeadlocked() {
+    vector<int> stuck = reduce(vector<int>());
+    for (size_t i = 0; i < stuck.size(); i++) stuck[i] = procs[stuck[i]].pid;
+    return stuck;
+}
+
+// reduction: processes that are not waiting, or whose request fits into what would be
+// free, finish and return their instances. whoever is left can never continue.
+// slots in gone count as already finished, returns the stuck slots
+vector<int> MultiResourceManager::reduce(const vector<int>& gone) {
+    work = available;
+    ready.clear();
+
+    // waiting processes per type, smallest request first
+    vector<vector<pair<int, int>>> requests(resourceTypes);
+    vector<size_t> cursor(resourceTypes, 0);
+    vector<char> done(procs.size(), 0);
+    for (size_t s = 0; s < procs.size(); s++) {
+        if (!procs[s].live) continue;
+        if (procs[s].waitResource < 0 || find(gone.begin(), gone.end(), (int)s) != gone.end()) ready.push_back((int)s);
+        else requests[procs[s].waitResource].push_back(make_pair(procs[s].waitCount, (int)s));
+    }
+    auto advance = [&](int r) {
+        while (cursor[r] < requests[r].size() && requests[r][cursor[r]].first <= work[r]) {
+            ready.push_back(requests[r][cursor[r]].second);
+            cursor[r] = cursor[r] + 1;
+        }
+    };
+    for (int r = 0; r < resourceTypes; r++) {
+        sort(requests[r].begin(), requests[r].end());
+        advance(r);
+    }
+
+    while (!ready.empty()) {
+        int s = ready.back();
+        ready.pop_back();
+        done[s] = 1;
+        const ProcessEntry& e = procs[s];
+        for (size_t i = 0; i < e.held.size(); i++) {
+            int r = e.held[i];
+            work[r] = work[r] + e.alloc[r];
+            advance(r);
+        }
+    }
+
+    vector<int> stuck;
+    for (size_t s = 0; s < procs.size(); s++) {
+        if (procs[s].live && !done[s]) stuck.push_back((int)s);
+    }
+    return stuck;
+}
+
+// retry waiting requests in FIFO order after instances came back. a later request that
+// fits may overtake an earlier one that does not, otherwise the queue order itself could
+// block processes the detector considers able to run
+vector<int> MultiResourceManager::wakeWaiters() {
+    vector<int> woken;
+    vector<int> queue = waitQueue;
+    for (size_t i = 0; i < queue.size(); i++) {
+        int slot = queue[i];
+        ProcessEntry& e = procs[slot];
+        if (e.waitResource < 0) continue;
+        if (tryGrant(slot, e.waitResource, e.waitCount)) {
+            stopWaiting(slot);
+            woken.push_back(e.pid);
+        }
+    }
+    return woken;
+}
+
+vector<int> MultiResourceManager::release(int pid, int resource, int count) {
+    auto found = slotOf.find(pid);
+    if (found == slotOf.end() || resource < 0 || resource >= resourceTypes) return vector<int>();
+    int slot = found->second;
+    count = min(count, procs[slot].alloc[resource]);
+    if (count <= 0) return vector<int>();
+
+    available[resource] = available[resource] + count;
+    setAlloc(slot, resource, procs[slot].alloc[resource] - count);
+    return wakeWaiters();
+}
+
+vector<int> MultiResourceManager::removeProcess(int pid) {
+    auto found = slotOf.find(pid);
+    if (found == slotOf.end()) return vector<int>();
+    int slot = found->second;
+    ProcessEntry& e = procs[slot];
+
+    stopWaiting(slot);
+    vector<int> held = e.held;
+    for (size_t i = 0; i < held.size(); i++) {
+        int r = held[i];
+        available[r] = available[r] + e.alloc[r];
+        setAlloc(slot, r, 0);
+    }
+    for (int r = 0; r < resourceTypes; r++) {
+        if (e.maxClaim[r] > 0) needIndex[r].erase(make_pair(e.maxClaim[r], slot));
+    }
+    e.live = false;
+    slotOf.erase(found);
+    freeSlots.push_back(slot);
+    liveCount = liveCount - 1;
+    victims.erase(remove(victims.begin(), victims.end(), pid), victims.end());
+    return wakeWaiters();
+}
+
+vector<int> MultiResourceManager::takeVictims() {
+    vector<int> out;
+    out.swap(victims);
+    return out;
+}
+
+bool MultiResourceManager::isWaiting(int pid) const {
+    auto found = slotOf.find(pid);
+    return found != slotOf.end() && procs[found->second].waitResource >= 0;
+}
+
+int MultiResourceManager::allocated(int pid, int resource) const {
+    auto found = slotOf.find(pid);
+    if (found == slotOf.end() || resource < 0 || resource >= resourceTypes) return 0;
+    return procs[found->second].alloc[resource];
+}
+
+int MultiResourceManager::totalInstances(int resource) const {
+    return resource >= 0 && resource < resourceTypes ? total[resource] : 0;
+}
+
+int MultiResourceManager::availableInstances(int resource) const {
+    return resource >= 0 && resource < resourceTypes ? available[resource] : 0;
+}
+
+int MultiResourceManager::processCount() const {
+    return liveCount;
+}
+
+int MultiResourceManager::resourceCount() const {
+    return resourceTypes;
+}
+
+DeadlockMode MultiResourceManager::getMode() const {
+    return mode;
+}
+
+const DeadlockStats& MultiResourceManager::stats() const {
+    return counters;
+}
+
+const char* deadlockModeName(DeadlockMode mode) {
+    switch (mode) {
+        case DeadlockMode::NONE: return "None";
+        case DeadlockMode::DETECT: return "Detect + Recover";
+        case DeadlockMode::AVOID: return "Banker's Avoidance";
+    }
+    return "?";
+}
+
+// ---------------- workload ----------------
+
+namespace {
+
+struct DeadlockJob {
+    int pid;
+    vector<int> claim;                    // per type
+    vector<pair<int, int>> steps;         // (type, instances) requests in order
+    size_t step = 0;
+    int busy = 0;                         // ticks of work before the next step
+    int aborts = 0;
+    bool waiting = false;
+    bool active = false;
+};
+
+}
+
+DeadlockRunResult runDeadlockWorkload(const DeadlockWorkload& w, DeadlockMode mode) {
+    auto start = chrono::steady_clock::now();
+    DeadlockRunResult result;
+    result.mode = mode;
+
+    // same seed -> same resources and scripts for every mode
+    CounterRng rng(w.seed, 7);
+    vector<int> instances(w.resources);
+    for (int r = 0; r < w.resources; r++) {
+        instances[r] = rng.nextInt(1, max(1, w.max_instances));
+    }
+
+    vector<DeadlockJob> jobs(w.processes);
+    for (int i = 0; i < w.processes; i++) {
+        DeadlockJob& job = jobs[i];
+        job.pid = i + 1;
+        job.claim.assign(w.resources, 0);
+        int types = min(w.claims_per_process, w.resources);
+        vector<int> picked;
+        while ((int)picked.size() < types) {
+            int r = rng.nextInt(0, w.resources - 1);
+            if (find(picked.begin(), picked.end(), r) == picked.end()) picked.push_back(r);
+        }
+        // claim instances of every picked type, acquired one or two at a time in random order
+        for (size_t k = 0; k < picked.size(); k++) {
+            int r = picked[k];
+            job.claim[r] = rng.nextInt(1, instances[r]);
+            int left = job.claim[r];
+            while (left > 0) {
+                int take = min(left, rng.nextInt(1, 2));
+                job.steps.push_back(make_pair(r, take));
+                left = left - take;
+            }
+        }
+        for (size_t k = job.steps.size(); k > 1; k--) {
+            swap(job.steps[k - 1], job.steps[rng.nextInt(0, (int)k - 1)]);
+        }
+    }
+
+    MultiResourceManager manager(instances, mode);
+    unordered_map<int, int> indexOf;
+    for (int i = 0; i < w.processes; i++) indexOf[jobs[i].pid] = i;
+
+    auto wake = [&](const vector<int>& pids) {
+        for (size_t k = 0; k < pids.size(); k++) {
+            DeadlockJob& job = jobs[indexOf[pids[k]]];
+            job.waiting = false;
+            job.step = job.step + 1;
+            job.busy = 1;
+        }
+    };
+
+    int nextAdmit = 0;
+    int activeCount = 0;
+    long long lastProgress = 0;
+    long long tick = 0;
+    vector<int> active;
+
+    while (result.completed < w.processes) {
+        // keep the number of active processes at the concurrency limit
+        while (activeCount < w.concurrency && nextAdmit < w.processes) {
+            DeadlockJob& job = jobs[nextAdmit];
+            manager.addProcess(job.pid, job.claim);
+            job.active = true;
+            active.push_back(nextAdmit);
+            activeCount = activeCount + 1;
+            nextAdmit = nextAdmit + 1;
+        }
+
+        for (size_t a = 0; a < active.size(); a++) {
+            DeadlockJob& job = jobs[active[a]];
+            if (!job.active || job.waiting) continue;
+            if (job.busy > 0) {
+                job.busy = job.busy - 1;
+                continue;
+            }
+            if (job.step < job.steps.size()) {
+                RequestResult r = manager.request(job.pid, job.steps[job.step].first, job.steps[job.step].second);
+                if (r == RequestResult::GRANTED) {
+                    job.step = job.step + 1;
+                    job.busy = job.step == job.steps.size() ? w.hold_ticks : 1;
+                    lastProgress = tick;
+                } else if (r == RequestResult::WAITING) {
+                    job.waiting = true;
+                } else {
+                    job.step = job.step + 1;   // cannot happen with valid scripts
+                }
+
+                // detect: abort victims, they start over from the beginning
+                vector<int> victims = manager.takeVictims();
+                for (size_t v = 0; v < victims.size(); v++) {
+                    DeadlockJob& victim = jobs[indexOf[victims[v]]];
+                    wake(manager.removeProcess(victim.pid));
+                    manager.addProcess(victim.pid, victim.claim);
+                    // back off before starting over, otherwise the same processes
+                    // run into the same deadlock again and again
+                    victim.aborts = victim.aborts + 1;
+                    victim.step = 0;
+                    victim.busy = w.hold_ticks << min(victim.aborts, 6);
+                    victim.waiting = false;
+                    result.aborts = result.aborts + 1;
+                    lastProgress = tick;
+                }
+            } else {
+                // holding everything, done
+                wake(manager.removeProcess(job.pid));
+                job.active = false;
+                activeCount = activeCount - 1;
+                result.completed = result.completed + 1;
+                lastProgress = tick;
+            }
+        }
+
+        // drop finished processes from the active list now and then
+        if (active.size() > (size_t)w.concurrency * 2) {
+            active.erase(remove_if(active.begin(), active.end(), [&](int i) { return !jobs[i].active; }), active.end());
+        }
+
+        tick = tick + 1;
+        if (tick - lastProgress > w.stall_limit) {
+            result.stalled = true;   // everybody left is waiting forever
+            break;
+        }
+    }
+
+    result.ticks = tick;
+    result.throughput = tick > 0 ? 100.0 * result.completed / tick : 0;
+    result.stats = manager.stats();
+    result.wall_seconds = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+    return result;
+}
+
+void printDeadlockTable(const vector<DeadlockRunResult>& results) {
+    cout << left << setw(20) << "Mode" << right
+         << setw(10) << "Done" << setw(8) << "Ticks" << setw(12) << "Done/100t"
+         << setw(8) << "Waits" << setw(9) << "Unsafe" << setw(11) << "Deadlocks" << setw(8) << "Aborts"
+         << setw(12) << "Safety us" << setw(10) << "Wall ms" << endl;
+    cout << fixed << setprecision(2);
+    for (size_t i = 0; i < results.size(); i++) {
+        const DeadlockRunResult& r = results[i];
+        double safetyUs = r.stats.safety_checks > 0 ? r.stats.safety_ns / r.stats.safety_checks / 1000.0 : 0;
+        string done = to_string(r.completed) + (r.stalled ? " (stuck)" : "");
+        cout << left << setw(20) << deadlockModeName(r.mode) << right
+             << setw(10) << done << setw(8) << r.ticks << setw(12) << r.throughput
+             << setw(8) << r.stats.waits << setw(9) << r.stats.unsafe_delays
+             << setw(11) << r.stats.deadlocks << setw(8) << r.aborts
+             << setw(12) << safetyUs << setw(10) << r.wall_seconds * 1000 << endl;
+    }
+    cout.unsetf(ios::fixed);
+    cout << setprecision(6);
+}
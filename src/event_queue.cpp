@@ -0,0 +1,116 @@
+#include "event_queue.h"
+#include "snapshot.h"
+
+using namespace std;
+
+// start with an empty heap
+EventQueue::EventQueue() {
+    next_seq = 0;
+}
+
+// events are ordered by time, events at the same time keep insertion order
+bool EventQueue::earlier(const Event& a, const Event& b) const {
+    if (a.time != b.time) {
+        return a.time < b.time;
+    }
+    return a.seq < b.seq;
+}
+
+// move element up until heap order is fixed
+void EventQueue::sift_up(size_t index) {
+    Event item = heap[index];
+    while (index > 0) {
+        size_t parent = (index - 1) / 2;
+        if (!earlier(item, heap[parent])) break;
+        heap[index] = heap[parent];
+        index = parent;
+    }
+    heap[index] = item;
+}
+
+// move element down until heap order is fixed
+void EventQueue::sift_down(size_t index) {
+    size_t n = heap.size();
+    Event item = heap[index];
+    while (true) {
+        size_t child = 2 * index + 1;
+        if (child >= n) break;
+        // pick the earlier of the two children
+        if (child + 1 < n && earlier(heap[child + 1], heap[child])) {
+            child = child + 1;
+        }
+        if (!earlier(heap[child], item)) break;
+        heap[index] = heap[child];
+        index = child;
+    }
+    heap[index] = item;
+}
+
+// add an event to the queue
+void EventQueue::push(long long time, EventType type, PCB* process, long long token) {
+    Event e;
+    e.time = time;
+    e.type = type;
+    e.process = process;
+    e.token = token;
+    e.seq = next_seq;
+    next_seq = next_seq + 1;
+    heap.push_back(e);
+    sift_up(heap.size() - 1);
+}
+
+// earliest event (queue must not be empty)
+const Event& EventQueue::top() const {
+    return heap.front();
+}
+
+// remove and return the earliest event
+Event EventQueue::pop() {
+    Event first = heap.front();
+    heap.front() = heap.back();
+    heap.pop_back();
+    if (!heap.empty()) {
+        sift_down(0);
+    }
+    return first;
+}
+
+bool EventQueue::empty() const {
+    return heap.empty();
+}
+
+size_t EventQueue::size() const {
+    return heap.size();
+}
+
+void EventQueue::clear() {
+    heap.clear();
+}
+
+void EventQueue::reserve(size_t n) {
+    heap.reserve(n);
+}
+
+void EventQueue::save_state(SnapshotWriter& out) const {
+    out.put(next_seq);
+    out.put((uint64_t)heap.size());
+    for (size_t i = 0; i < heap.size(); i++) {
+        out.put(heap[i].time);
+        out.put(heap[i].type);
+        out.putProcess(heap[i].process);
+        out.put(heap[i].token);
+        out.put(heap[i].seq);
+    }
+}
+
+void EventQueue::load_state(SnapshotReader& in) {
+    in.get(next_seq);
+    heap.resize(in.get<uint64_t>());
+    for (size_t i = 0; i < heap.size(); i++) {
+        in.get(heap[i].time);
+        in.get(heap[i].type);
+        heap[i].process = in.getProcess();
+        in.get(heap[i].token);
+        in.get(heap[i].seq);
+    }
+}
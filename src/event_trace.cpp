@@ -0,0 +1,307 @@
+#include "event_trace.h"
+#include <cstdio>
+#include <cstring>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <chrono>
+#include <algorithm>
+#include <map>
+
+using namespace std;
+
+static const char EVENT_LOG_MAGIC[8] = {'O', 'S', 'E', 'V', 'L', 'O', 'G', '1'};
+static const uint32_t EVENT_LOG_VERSION = 1;
+
+// ---------------- rings ----------------
+
+// single producer (owning thread) / single consumer (writer) ring
+// head and tail only grow, slot = index & mask
+struct TraceRing {
+    alignas(64) atomic<uint64_t> head;   // next slot the producer writes
+    alignas(64) atomic<uint64_t> tail;   // next slot the writer reads
+    vector<TraceEventRecord> slots;
+    uint64_t mask;
+    uint16_t thread;
+
+    TraceRing(size_t capacity, uint16_t thread) : head(0), tail(0), slots(capacity), mask(capacity - 1), thread(thread) {}
+};
+
+namespace {
+
+// everything the tracer owns
+struct TracerState {
+    mutex lock;                              // guards rings (registration) and start / stop
+    vector<unique_ptr<TraceRing>> rings;     // never shrinks, threads keep pointers to their ring
+    size_t ringCapacity = 1 << 16;
+    FILE* file = nullptr;
+    thread writer;
+    atomic<bool> running{false};
+    atomic<uint64_t> written{0};
+    chrono::steady_clock::time_point startTime;
+    int flushIntervalMs = 2;
+};
+
+TracerState& state() {
+    static TracerState s;
+    return s;
+}
+
+thread_local TraceRing* localRing = nullptr;
+
+// ring of the calling thread, created on first use
+TraceRing* ringForThread() {
+    if (localRing != nullptr) return localRing;
+    TracerState& s = state();
+    lock_guard<mutex> guard(s.lock);
+    s.rings.push_back(unique_ptr<TraceRing>(new TraceRing(s.ringCapacity, (uint16_t)s.rings.size())));
+    localRing = s.rings.back().get();
+    return localRing;
+}
+
+// copy everything currently in the ring to the file, returns records written
+size_t drainRing(TraceRing& ring, FILE* file) {
+    uint64_t tail = ring.tail.load(memory_order_relaxed);
+    uint64_t head = ring.head.load(memory_order_acquire);
+    if (head == tail) return 0;
+
+    uint64_t count = head - tail;
+    uint64_t first = tail & ring.mask;
+    uint64_t untilEnd = min(count, (uint64_t)ring.slots.size() - first);
+    fwrite(&ring.slots[first], sizeof(TraceEventRecord), untilEnd, file);
+    if (count > untilEnd) {
+        fwrite(&ring.slots[0], sizeof(TraceEventRecord), count - untilEnd, file);
+    }
+    ring.tail.store(head, memory_order_release);   // slots can be reused now
+    return count;
+}
+
+// drain every ring once
+size_t drainAll(TracerState& s) {
+    vector<TraceRing*> rings;
+    {
+        lock_guard<mutex> guard(s.lock);
+        for (size_t i = 0; i < s.rings.size(); i++) {
+            rings.push_back(s.rings[i].get());
+        }
+    }
+    size_t total = 0;
+    for (size_t i = 0; i < rings.size(); i++) {
+        total = total + drainRing(*rings[i], s.file);
+    }
+    s.written.fetch_add(total, memory_order_relaxed);
+    return total;
+}
+
+void writerLoop() {
+    TracerState& s = state();
+    while (s.running.load(memory_order_acquire)) {
+        if (drainAll(s) == 0) {
+            this_thread::sleep_for(chrono::milliseconds(s.flushIntervalMs));
+        }
+    }
+    drainAll(s);   // whatever was recorded before stop()
+    fflush(s.file);
+}
+
+}
+
+// ---------------- EventTracer ----------------
+
+atomic<int> EventTracer::currentLevel{0};
+
+bool EventTracer::start(const TraceConfig& config) {
+    stop();
+    TracerState& s = state();
+    lock_guard<mutex> guard(s.lock);
+
+    s.file = fopen(config.path.c_str(), "wb");
+    if (s.file == nullptr) return false;
+    fwrite(EVENT_LOG_MAGIC, 1, sizeof(EVENT_LOG_MAGIC), s.file);
+    uint32_t header[2] = {EVENT_LOG_VERSION, (uint32_t)sizeof(TraceEventRecord)};
+    fwrite(header, sizeof(uint32_t), 2, s.file);
+
+    // rings created from now on get this size, a power of two so slot = index & mask
+    size_t capacity = 1;
+    while (capacity < config.ring_capacity) capacity = capacity * 2;
+    s.ringCapacity = capacity;
+    s.flushIntervalMs = config.flush_interval_ms > 0 ? config.flush_interval_ms : 1;
+    s.startTime = chrono::steady_clock::now();
+    s.written.store(0, memory_order_relaxed);
+    for (size_t i = 0; i < s.rings.size(); i++) {
+        // records left over from an earlier session are dropped
+        s.rings[i]->tail.store(s.rings[i]->head.load(memory_order_acquire), memory_order_release);
+    }
+
+    s.running.store(true, memory_order_release);
+    s.writer = thread(writerLoop);
+    currentLevel.store((int)config.level, memory_order_relaxed);
+    return true;
+}
+
+void EventTracer::stop() {
+    TracerState& s = state();
+    currentLevel.store(0, memory_order_relaxed);
+    if (!s.running.exchange(false)) return;
+    s.writer.join();
+
+    lock_guard<mutex> guard(s.lock);
+    fclose(s.file);
+    s.file = nullptr;
+}
+
+void EventTracer::setLevel(TraceLevel level) {
+    // levels above OFF only make sense while the writer runs
+    if (!state().running.load(memory_order_acquire)) level = TraceLevel::OFF;
+    currentLevel.store((int)level, memory_order_relaxed);
+}
+
+TraceLevel EventTracer::getLevel() {
+    return (TraceLevel)currentLevel.load(memory_order_relaxed);
+}
+
+// hot path: fill one slot of this thread's ring, no locks and no I/O
+void EventTracer::record(TraceEventKind kind, long long time, int pid, int arg, int core) {
+    TracerState& s = state();
+    if (!s.running.load(memory_order_relaxed)) return;
+    TraceRing* ring = ringForThread();
+
+    uint64_t head = ring->head.load(memory_order_relaxed);
+    // ring full: wait for the writer instead of losing events
+    while (head - ring->tail.load(memory_order_acquire) >= ring->slots.size()) {
+        if (!s.running.load(memory_order_relaxed)) return;
+        this_thread::yield();
+    }
+
+    TraceEventRecord& r = ring->slots[head & ring->mask];
+    r.time = time;
+    r.wall_ns = (uint64_t)chrono::duration_cast<chrono::nanoseconds>(chrono::steady_clock::now() - s.startTime).count();
+    r.pid = pid;
+    r.arg = arg;
+    r.kind = (uint16_t)kind;
+    r.core = (uint16_t)core;
+    r.thread = ring->thread;
+    r.reserved = 0;
+    ring->head.store(head + 1, memory_order_release);   // publish to the writer
+}
+
+uint64_t EventTracer::recordsWritten() {
+    return state().written.load(memory_order_relaxed);
+}
+
+const char* EventTracer::kindName(TraceEventKind kind) {
+    switch (kind) {
+        case TraceEventKind::ARRIVAL: return "ARRIVAL";
+        case TraceEventKind::READY: return "READY";
+        case TraceEventKind::DISPATCH: return "DISPATCH";
+        case TraceEventKind::PREEMPT: return "PREEMPT";
+        case TraceEventKind::QUANTUM_EXPIRE: return "QUANTUM_EXPIRE";
+        case TraceEventKind::BLOCK: return "BLOCK";
+        case TraceEventKind::UNBLOCK: return "UNBLOCK";
+        case TraceEventKind::RESOURCE_ACQUIRE: return "RESOURCE_ACQUIRE";
+        case TraceEventKind::RESOURCE_RELEASE: return "RESOURCE_RELEASE";
+        case TraceEventKind::IO_START: return "IO_START";
+        case TraceEventKind::IO_COMPLETE: return "IO_COMPLETE";
+        case TraceEventKind::TERMINATE: return "TERMINATE";
+        case TraceEventKind::IDLE: return "IDLE";
+        case TraceEventKind::MIGRATE: return "MIGRATE";
+        case TraceEventKind::STEAL: return "STEAL";
+        case TraceEventKind::STARVATION: return "STARVATION";
+        case TraceEventKind::PRIORITY_BOOST: return "PRIORITY_BOOST";
+        case TraceEventKind::FORK: return "FORK";
+        case TraceEventKind::REAP: return "REAP";
+        default: return "UNKNOWN";
+    }
+}
+
+// ---------------- decoding ----------------
+
+bool readEventLog(const string& path, vector<TraceEventRecord>& records) {
+    FILE* file = fopen(path.c_str(), "rb");
+    if (file == nullptr) return false;
+
+    char magic[sizeof(EVENT_LOG_MAGIC)];
+    uint32_t header[2];
+    bool ok = fread(magic, 1, sizeof(magic), file) == sizeof(magic)
+              && memcmp(magic, EVENT_LOG_MAGIC, sizeof(magic)) == 0
+              && fread(header, sizeof(uint32_t), 2, file) == 2
+              && header[0] == EVENT_LOG_VERSION && header[1] == sizeof(TraceEventRecord);
+    if (ok) {
+        TraceEventRecord buffer[4096];
+        size_t n;
+        while ((n = fread(buffer, sizeof(TraceEventRecord), 4096, file)) > 0) {
+            records.insert(records.end(), buffer, buffer + n);
+        }
+    }
+    fclose(file);
+    return ok;
+}
+
+// events after which a process is no longer on its core
+static bool leavesCore(TraceEventKind kind) {
+    return kind == TraceEventKind::PREEMPT || kind == TraceEventKind::QUANTUM_EXPIRE
+        || kind == TraceEventKind::BLOCK || kind == TraceEventKind::IO_START
+        || kind == TraceEventKind::TERMINATE;
+}
+
+bool decodeEventLog(const string& path, ostream& out, TraceOutput format) {
+    vector<TraceEventRecord> records;
+    if (!readEventLog(path, records)) return false;
+
+    // rings are written in chunks, put the events back into real time order
+    stable_sort(records.begin(), records.end(), [](const TraceEventRecord& a, const TraceEventRecord& b) {
+        return a.wall_ns < b.wall_ns;
+    });
+
+    if (format == TraceOutput::TEXT) {
+        for (size_t i = 0; i < records.size(); i++) {
+            const TraceEventRecord& r = records[i];
+            out << "[t=" << r.time << "] thread " << r.thread << " core " << r.core << " "
+                << EventTracer::kindName((TraceEventKind)r.kind);
+            if (r.pid != 0) out << " pid " << r.pid;
+            if (r.arg != 0) out << " arg " << r.arg;
+            out << '\n';
+        }
+        return true;
+    }
+
+    // chrome trace: pid = recording thread (one simulation), tid = simulated core,
+    // ts is simulated time (1 tick shown as 1 microsecond)
+    out << "{\"traceEvents\":[\n";
+    bool first = true;
+    map<pair<int, int>, int> onCore;   // (thread, core) -> pid running there
+    for (size_t i = 0; i < records.size(); i++) {
+        const TraceEventRecord& r = records[i];
+        TraceEventKind kind = (TraceEventKind)r.kind;
+        pair<int, int> track(r.thread, r.core);
+        auto running = onCore.find(track);
+
+        // close the current slice when its process leaves or another one is dispatched
+        if (running != onCore.end() && (kind == TraceEventKind::DISPATCH || (leavesCore(kind) && running->second == r.pid))) {
+            out << (first ? "" : ",\n") << "{\"name\":\"PID " << running->second << "\",\"ph\":\"E\",\"pid\":"
+                << r.thread << ",\"tid\":" << r.core << ",\"ts\":" << r.time << "}";
+            first = false;
+            onCore.erase(running);
+        }
+        if (kind == TraceEventKind::DISPATCH) {
+            out << (first ? "" : ",\n") << "{\"name\":\"PID " << r.pid << "\",\"ph\":\"B\",\"pid\":"
+                << r.thread << ",\"tid\":" << r.core << ",\"ts\":" << r.time << "}";
+            first = false;
+            onCore[track] = r.pid;
+        } else {
+            out << (first ? "" : ",\n") << "{\"name\":\"" << EventTracer::kindName(kind) << "\",\"ph\":\"i\",\"s\":\"t\",\"pid\":"
+                << r.thread << ",\"tid\":" << r.core << ",\"ts\":" << r.time
+                << ",\"args\":{\"pid\":" << r.pid << ",\"arg\":" << r.arg << "}}";
+            first = false;
+        }
+    }
+    // slices still open at the end of the log
+    for (auto it = onCore.begin(); it != onCore.end(); it++) {
+        long long last = records.empty() ? 0 : records.back().time;
+        out << (first ? "" : ",\n") << "{\"name\":\"PID " << it->second << "\",\"ph\":\"E\",\"pid\":"
+            << it->first.first << ",\"tid\":" << it->first.second << ",\"ts\":" << last << "}";
+        first = false;
+    }
+    out << "\n],\"displayTimeUnit\":\"ms\"}\n";
+    return true;
+}
@@ -0,0 +1,223 @@
+#include "experiment.h"
+#include "memory_manager.h"
+#include "process_queues.h"
+#include "scheduler.h"
+#include <chrono>
+#include <iostream>
+#include <iomanip>
+#include <stdexcept>
+
+using namespace std;
+
+// ---------------- ThreadPool ----------------
+
+ThreadPool::ThreadPool(int threads) {
+    if (threads <= 0) {
+        threads = (int)thread::hardware_concurrency();
+        if (threads <= 0) threads = 1;
+    }
+    running = 0;
+    stopping = false;
+    for (int i = 0; i < threads; i++) {
+        workers.push_back(thread(&ThreadPool::workerLoop, this));
+    }
+}
+
+ThreadPool::~ThreadPool() {
+    {
+        lock_guard<mutex> guard(lock);
+        stopping = true;
+    }
+    taskReady.notify_all();
+    for (size_t i = 0; i < workers.size(); i++) {
+        workers[i].join();
+    }
+}
+
+// take tasks until the pool shuts down
+void ThreadPool::workerLoop() {
+    while (true) {
+        function<void()> task;
+        {
+            unique_lock<mutex> guard(lock);
+            taskReady.wait(guard, [this] { return stopping || !tasks.empty(); });
+            if (stopping && tasks.empty()) return;
+            task = move(tasks.front());
+            tasks.pop();
+            running = running + 1;
+        }
+
+        task();
+
+        {
+            lock_guard<mutex> guard(lock);
+            running = running - 1;
+            if (running == 0 && tasks.empty()) {
+                allDone.notify_all();
+            }
+        }
+    }
+}
+
+void ThreadPool::submit(function<void()> task) {
+    {
+        lock_guard<mutex> guard(lock);
+        tasks.push(move(task));
+    }
+    taskReady.notify_one();
+}
+
+void ThreadPool::wait() {
+    unique_lock<mutex> guard(lock);
+    allDone.wait(guard, [this] { return running == 0 && tasks.empty(); });
+}
+
+int ThreadPool::size() const {
+    return (int)workers.size();
+}
+
+// ---------------- ExperimentRunner ----------------
+
+ExperimentRunner::ExperimentRunner(int threads, const MemoryConfig& memory) {
+    this->threads = threads;
+    defaultMemory = memory;
+}
+
+void ExperimentRunner::addConfig(const ExperimentConfig& config) {
+    configs.push_back(config);
+}
+
+void ExperimentRunner::addConfig(const string& label, const string& policy, const PolicyParams& params) {
+    ExperimentConfig config;
+    config.label = label;
+    config.policy = policy;
+    config.params = params;
+    config.memory = defaultMemory;
+    configs.push_back(config);
+}
+
+// expand a parameter sweep into separate configurations
+void ExperimentRunner::addSweep(const string& policy, const string& parameter,
+                                const vector<int>& values, const PolicyParams& base) {
+    for (size_t i = 0; i < values.size(); i++) {
+        PolicyParams params = base;
+        MemoryConfig memory = defaultMemory;
+        int value = values[i];
+        if (parameter == "quantum") {
+            params.quantum = value;
+        } else if (parameter == "levels") {
+            params.mlfq_levels = value;
+        } else if (parameter == "base_quantum") {
+            params.mlfq_base_quantum = value;
+        } else if (parameter == "latency") {
+            params.cfs_latency = value;
+        } else if (parameter == "granularity") {
+            params.cfs_min_granularity = value;
+        } else if (parameter == "memory") {
+            memory.total = value;
+        } else {
+            throw invalid_argument("unknown sweep parameter: " + parameter);
+        }
+        ExperimentConfig config;
+        config.label = policy + " " + parameter + "=" + to_string(value);
+        config.policy = policy;
+        config.params = params;
+        config.memory = memory;
+        configs.push_back(config);
+    }
+}
+
+size_t ExperimentRunner::configCount() const {
+    return configs.size();
+}
+
+// run one configuration with private copies of everything it touches
+ExperimentResult ExperimentRunner::runOne(const ExperimentConfig& config, const vector<PCB>& workload) const {
+    auto startWall = chrono::steady_clock::now();
+
+    MemoryManager memory(config.memory);
+    ProcessQueues queues;
+    Scheduler scheduler(&memory, &queues);
+    scheduler.setVerbose(false);
+
+    scheduler.setPolicy(createPolicy(config.policy, config.params));
+
+    // fresh PCB copies, nothing is shared with other runs
+    vector<PCB> processes(workload);
+    int rejected = 0;
+    for (size_t i = 0; i < processes.size(); i++) {
+        PCB& p = processes[i];
+        p.state = ProcessState::NEW;
+        p.has_resource = false;
+        p.remaining_time = p.burst_time;
+        p.first_run_time = -1;
+        p.queue_level = 0;
+        p.vruntime = 0;
+        p.last_core = -1;
+        if (memory.allocate_process(p.pid, p.memory_required)) {
+            scheduler.submitProcess(&p);
+        } else {
+            rejected = rejected + 1;
+        }
+    }
+    scheduler.runToCompletion();
+
+    ExperimentResult result;
+    result.config = config;
+    result.summary = scheduler.getMetrics().summary();
+    result.rejected = rejected;
+    result.page_faults = memory.get_virtual_memory() ? memory.get_virtual_memory()->totals().faults : 0;
+    result.wall_seconds = chrono::duration<double>(chrono::steady_clock::now() - startWall).count();
+    return result;
+}
+
+// run every configuration on the pool, each task writes only its own result slot
+vector<ExperimentResult> ExperimentRunner::run(const vector<PCB>& workload) const {
+    vector<ExperimentResult> results(configs.size());
+    vector<string> errors(configs.size());
+
+    ThreadPool pool(threads);
+    for (size_t i = 0; i < configs.size(); i++) {
+        pool.submit([this, i, &workload, &results, &errors] {
+            try {
+                results[i] = runOne(configs[i], workload);
+            } catch (const exception& e) {
+                errors[i] = e.what();
+            }
+        });
+    }
+    pool.wait();
+
+    for (size_t i = 0; i < errors.size(); i++) {
+        if (!errors[i].empty()) {
+            throw runtime_error("experiment '" + configs[i].label + "' failed: " + errors[i]);
+        }
+    }
+    return results;
+}
+
+// one row per configuration
+void ExperimentRunner::printTable(const vector<ExperimentResult>& results) {
+    cout << endl << left << setw(24) << "Configuration"
+         << right << setw(8) << "Done" << setw(8) << "Rej"
+         << setw(10) << "TAT avg" << setw(10) << "TAT p95"
+         << setw(10) << "Wait avg" << setw(10) << "Resp avg" << setw(10) << "Resp p99"
+         << setw(12) << "Thru/tick" << setw(8) << "CPU%" << setw(8) << "CtxSw" << setw(9) << "Faults" << endl;
+    cout << string(127, '-') << endl;
+
+    cout << fixed;
+    for (size_t i = 0; i < results.size(); i++) {
+        const ExperimentResult& r = results[i];
+        const MetricsSummary& s = r.summary;
+        cout << left << setw(24) << r.config.label << right
+             << setw(8) << s.completed << setw(8) << r.rejected
+             << setprecision(2)
+             << setw(10) << s.mean_turnaround << setw(10) << s.p95_turnaround
+             << setw(10) << s.mean_waiting << setw(10) << s.mean_response << setw(10) << s.p99_response
+             << setprecision(4) << setw(12) << s.throughput
+             << setprecision(1) << setw(8) << s.cpu_utilization * 100
+             << setw(8) << s.context_switches << setw(9) << r.page_faults << endl;
+    }
+    cout.unsetf(ios::fixed);
+    cout << setprecision(6);
+}
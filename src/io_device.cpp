@@ -0,0 +1,402 @@
+#include "io_device.h"
+#include "snapshot.h"
+#include <algorithm>
+#include <cmath>
+#include <climits>
+
+using namespace std;
+
+// ---------------- IODevice ----------------
+
+IODevice::IODevice(const string& name) {
+    this->name = name;
+    serving = false;
+}
+
+void IODevice::submit(const IoRequest& r) {
+    stats.requests = stats.requests + 1;
+    enqueue(r);
+    stats.max_queue = max(stats.max_queue, pending());
+}
+
+long long IODevice::start(long long now) {
+    if (serving || pending() == 0) return -1;
+    inService.clear();
+    long long serviceTime = nextBatch(inService);
+    serving = true;
+    stats.services = stats.services + 1;
+    stats.busy_time = stats.busy_time + serviceTime;
+    return now + serviceTime;
+}
+
+void IODevice::complete(long long now, vector<IoRequest>& done) {
+    for (size_t i = 0; i < inService.size(); i++) {
+        stats.response.add((double)(now - inService[i].issued));
+        done.push_back(inService[i]);
+    }
+    inService.clear();
+    serving = false;
+}
+
+bool IODevice::busy() const {
+    return serving;
+}
+
+long long IODevice::homeBlock(int pid) const {
+    return 0;
+}
+
+const string& IODevice::getName() const {
+    return name;
+}
+
+const IoDeviceStats& IODevice::getStats() const {
+    return stats;
+}
+
+static void saveRequest(SnapshotWriter& out, const IoRequest& r) {
+    out.putProcess(r.process);
+    out.put(r.issued);
+    out.put(r.block);
+    out.put(r.blocks);
+}
+
+static IoRequest loadRequest(SnapshotReader& in) {
+    IoRequest r;
+    r.process = in.getProcess();
+    in.get(r.issued);
+    in.get(r.block);
+    in.get(r.blocks);
+    return r;
+}
+
+void IODevice::saveBase(SnapshotWriter& out) const {
+    out.putString(name);
+    out.put(stats.requests);
+    out.put(stats.merged);
+    out.put(stats.services);
+    out.put(stats.batched);
+    out.put(stats.busy_time);
+    out.put(stats.seek_distance);
+    out.put(stats.max_queue);
+    stats.response.save_state(out);
+    out.put((uint64_t)inService.size());
+    for (size_t i = 0; i < inService.size(); i++) saveRequest(out, inService[i]);
+    out.put(serving);
+}
+
+void IODevice::loadBase(SnapshotReader& in) {
+    name = in.getString();
+    in.get(stats.requests);
+    in.get(stats.merged);
+    in.get(stats.services);
+    in.get(stats.batched);
+    in.get(stats.busy_time);
+    in.get(stats.seek_distance);
+    in.get(stats.max_queue);
+    stats.response.load_state(in);
+    inService.resize(in.get<uint64_t>());
+    for (size_t i = 0; i < inService.size(); i++) inService[i] = loadRequest(in);
+    in.get(serving);
+}
+
+// ---------------- FixedLatencyDevice ----------------
+
+FixedLatencyDevice::FixedLatencyDevice(const string& name, int latency, double perBlock) : IODevice(name) {
+    this->latency = latency;
+    this->perBlock = perBlock;
+}
+
+void FixedLatencyDevice::enqueue(const IoRequest& r) {
+    queue.push_back(r);
+}
+
+long long FixedLatencyDevice::nextBatch(vector<IoRequest>& batch) {
+    IoRequest r = queue.front();
+    queue.pop_front();
+    batch.push_back(r);
+    return max(1LL, latency + (long long)ceil(perBlock * r.blocks));
+}
+
+size_t FixedLatencyDevice::pending() const {
+    return queue.size();
+}
+
+string FixedLatencyDevice::describe() const {
+    return name + " (fixed latency " + to_string(latency) + ")";
+}
+
+void FixedLatencyDevice::saveState(SnapshotWriter& out) const {
+    out.putString("fixed");
+    saveBase(out);
+    out.put(latency);
+    out.put(perBlock);
+    out.put((uint64_t)queue.size());
+    for (size_t i = 0; i < queue.size(); i++) saveRequest(out, queue[i]);
+}
+
+void FixedLatencyDevice::loadState(SnapshotReader& in) {
+    loadBase(in);
+    in.get(latency);
+    in.get(perBlock);
+    queue.resize(in.get<uint64_t>());
+    for (size_t i = 0; i < queue.size(); i++) queue[i] = loadRequest(in);
+}
+
+// ---------------- DiskDevice ----------------
+
+DiskDevice::DiskDevice(const string& name, const DiskConfig& config) : IODevice(name) {
+    this->config = config;
+    if (this->config.cylinders < 1) this->config.cylinders = 1;
+    if (this->config.blocks_per_cylinder < 1) this->config.blocks_per_cylinder = 1;
+    if (this->config.max_batch < 1) this->config.max_batch = 1;
+    totalBlocks = (long long)this->config.cylinders * this->config.blocks_per_cylinder;
+    head = 0;
+    movingUp = true;
+    nextSeq = 0;
+    queued = 0;
+}
+
+int DiskDevice::cylinderOf(long long block) const {
+    return (int)(block / config.blocks_per_cylinder);
+}
+
+// processes start somewhere spread over the disk, the same pid always at the same place
+long long DiskDevice::homeBlock(int pid) const {
+    return (long long)(((uint64_t)(uint32_t)pid * 2654435761u) % (uint64_t)totalBlocks);
+}
+
+void DiskDevice::enqueue(const IoRequest& request) {
+    IoRequest r = request;
+    long long blocks = min((long long)max(1, r.blocks), totalBlocks);
+    r.block = ((r.block % totalBlocks) + totalBlocks) % totalBlocks;
+    if (r.block + blocks > totalBlocks) r.block = totalBlocks - blocks;
+    long long end = r.block + blocks;
+    queued = queued + 1;
+
+    if (config.merge) {
+        // back merge: a pending request ends where this one starts
+        auto before = byEnd.find(r.block);
+        if (before != byEnd.end()) {
+            Key key = before->second;
+            DiskRequest& d = byCylinder[key];
+            byEnd.erase(before);
+            d.end = end;
+            byEnd[end] = key;
+            d.requests.push_back(r);
+            stats.merged = stats.merged + 1;
+            return;
+        }
+        // front merge: a pending request starts where this one ends (same cylinder only,
+        // the key would change otherwise)
+        auto after = byFirst.find(end);
+        if (after != byFirst.end() && after->second.first == cylinderOf(r.block)) {
+            Key key = after->second;
+            DiskRequest& d = byCylinder[key];
+            byFirst.erase(after);
+            d.first = r.block;
+            byFirst[r.block] = key;
+            d.requests.push_back(r);
+            stats.merged = stats.merged + 1;
+            return;
+        }
+    }
+
+    DiskRequest d;
+    d.first = r.block;
+    d.end = end;
+    d.cylinder = cylinderOf(r.block);
+    d.seq = nextSeq;
+    nextSeq = nextSeq + 1;
+    d.requests.push_back(r);
+    Key key(d.cylinder, d.seq);
+    byCylinder[key] = d;
+    byFirst[d.first] = key;
+    byEnd[d.end] = key;
+    if (config.scheduling == DiskScheduling::FCFS) fifo.push_back(key);
+}
+
+void DiskDevice::unlink(map<Key, DiskRequest>::iterator it) {
+    auto first = byFirst.find(it->second.first);
+    if (first != byFirst.end() && first->second == it->first) byFirst.erase(first);
+    auto end = byEnd.find(it->second.end);
+    if (end != byEnd.end() && end->second == it->first) byEnd.erase(end);
+    byCylinder.erase(it);
+}
+
+// next request for the head, distance = cylinders the head travels to get there
+map<DiskDevice::Key, DiskDevice::DiskRequest>::iterator DiskDevice::pick(long long& distance) {
+    int last = config.cylinders - 1;
+    auto at = [&](map<Key, DiskRequest>::iterator it) { return it->first.first; };
+    auto above = byCylinder.lower_bound(Key(head, 0));            // first at or above head
+    auto below = byCylinder.upper_bound(Key(head, UINT64_MAX));   // one past the last at or below head
+    bool hasAbove = above != byCylinder.end();
+    bool hasBelow = below != byCylinder.begin();
+    if (hasBelow) --below;
+
+    switch (config.scheduling) {
+        case DiskScheduling::FCFS: {
+            while (byCylinder.find(fifo.front()) == byCylinder.end()) fifo.pop_front();
+            auto it = byCylinder.find(fifo.front());
+            fifo.pop_front();
+            distance = abs(at(it) - head);
+            return it;
+        }
+        case DiskScheduling::SSTF: {
+            if (hasAbove && (!hasBelow || at(above) - head <= head - at(below))) {
+                distance = at(above) - head;
+                return above;
+            }
+            distance = head - at(below);
+            return below;
+        }
+        case DiskScheduling::C_SCAN: {
+            // only serves on the way up, then flies back to cylinder 0
+            if (hasAbove) {
+                distance = at(above) - head;
+                return above;
+            }
+            auto first = byCylinder.begin();
+            distance = (last - head) + last + at(first);
+            return first;
+        }
+        case DiskScheduling::SCAN:
+        case DiskScheduling::LOOK: {
+            bool scan = config.scheduling == DiskScheduling::SCAN;
+            if (movingUp) {
+                if (hasAbove) {
+                    distance = at(above) - head;
+                    return above;
+                }
+                // SCAN goes all the way to the edge before turning, LOOK turns right here
+                movingUp = false;
+                distance = scan ? (last - head) + (last - at(below)) : head - at(below);
+                return below;
+            }
+            if (hasBelow) {
+                distance = head - at(below);
+                return below;
+            }
+            movingUp = true;
+            distance = scan ? head + at(above) : at(above) - head;
+            return above;
+        }
+    }
+    distance = 0;
+    return byCylinder.begin();
+}
+
+long long DiskDevice::nextBatch(vector<IoRequest>& batch) {
+    long long distance = 0;
+    auto it = pick(distance);
+    head = it->first.first;
+
+    // everything else waiting on this cylinder is served in the same visit
+    long long blocks = 0;
+    int taken = 0;
+    while (true) {
+        blocks = blocks + (it->second.end - it->second.first);
+        batch.insert(batch.end(), it->second.requests.begin(), it->second.requests.end());
+        if (taken > 0) stats.batched = stats.batched + it->second.requests.size();
+        unlink(it);
+        taken = taken + 1;
+        it = byCylinder.lower_bound(Key(head, 0));
+        if (taken >= config.max_batch || it == byCylinder.end() || it->first.first != head) break;
+    }
+    queued = queued - batch.size();
+    stats.seek_distance = stats.seek_distance + distance;
+
+    double serviceTime = config.rotation + blocks * config.transfer_per_block;
+    if (distance > 0) {
+        serviceTime = serviceTime + config.seek_base + distance * config.seek_per_cylinder;
+    }
+    return max(1LL, (long long)ceil(serviceTime));
+}
+
+size_t DiskDevice::pending() const {
+    return queued;
+}
+
+int DiskDevice::getHead() const {
+    return head;
+}
+
+string DiskDevice::describe() const {
+    return name + " (" + diskSchedulingName(config.scheduling) + ", " + to_string(config.cylinders) + " cylinders)";
+}
+
+void DiskDevice::saveState(SnapshotWriter& out) const {
+    out.putString("disk");
+    saveBase(out);
+    out.put(config);
+    out.put(totalBlocks);
+    out.put(head);
+    out.put(movingUp);
+    out.put(nextSeq);
+    out.put(queued);
+    out.put((uint64_t)byCylinder.size());
+    for (auto it = byCylinder.begin(); it != byCylinder.end(); it++) {
+        const DiskRequest& d = it->second;
+        out.put(d.first);
+        out.put(d.end);
+        out.put(d.cylinder);
+        out.put(d.seq);
+        out.put((uint64_t)d.requests.size());
+        for (size_t i = 0; i < d.requests.size(); i++) saveRequest(out, d.requests[i]);
+    }
+    out.put((uint64_t)fifo.size());
+    for (size_t i = 0; i < fifo.size(); i++) out.put(fifo[i]);
+    out.putAll(byFirst);
+    out.putAll(byEnd);
+}
+
+void DiskDevice::loadState(SnapshotReader& in) {
+    loadBase(in);
+    in.get(config);
+    in.get(totalBlocks);
+    in.get(head);
+    in.get(movingUp);
+    in.get(nextSeq);
+    in.get(queued);
+    byCylinder.clear();
+    uint64_t n = in.get<uint64_t>();
+    for (uint64_t k = 0; k < n; k++) {
+        DiskRequest d;
+        in.get(d.first);
+        in.get(d.end);
+        in.get(d.cylinder);
+        in.get(d.seq);
+        d.requests.resize(in.get<uint64_t>());
+        for (size_t i = 0; i < d.requests.size(); i++) d.requests[i] = loadRequest(in);
+        byCylinder.emplace_hint(byCylinder.end(), Key(d.cylinder, d.seq), d);
+    }
+    fifo.resize(in.get<uint64_t>());
+    for (size_t i = 0; i < fifo.size(); i++) in.get(fifo[i]);
+    in.getMap(byFirst);
+    in.getMap(byEnd);
+}
+
+unique_ptr<IODevice> loadDevice(SnapshotReader& in) {
+    string kind = in.getString();
+    unique_ptr<IODevice> device;
+    if (kind == "fixed") {
+        device.reset(new FixedLatencyDevice("", 0, 0));
+    } else if (kind == "disk") {
+        device.reset(new DiskDevice(""));
+    } else {
+        throw runtime_error("snapshot contains an unknown device type " + kind);
+    }
+    device->loadState(in);
+    return device;
+}
+
+const char* diskSchedulingName(DiskScheduling scheduling) {
+    switch (scheduling) {
+        case DiskScheduling::FCFS: return "FCFS";
+        case DiskScheduling::SSTF: return "SSTF";
+        case DiskScheduling::SCAN: return "SCAN";
+        case DiskScheduling::C_SCAN: return "C-SCAN";
+        case DiskScheduling::LOOK: return "LOOK";
+    }
+    return "?";
+}
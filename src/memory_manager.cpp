@@ -1,4 +1,8 @@
 #include "memory_manager.h"
+#include "snapshot.h"
+#include "cgroup.h"
+#include <climits>
+#include <algorithm>
 
 using namespace std;
 
@@ -7,6 +11,39 @@ using namespace std;
 MemoryManager::MemoryManager(int total) {
     total_memory = total;
     used_memory = 0;  // start with no memory used
+    config.total = total;
+    compactions = 0;
+    compacted_memory = 0;
+    wake_threshold = LLONG_MAX;
+    groups = nullptr;
+}
+
+// Constructor with a full configuration, sets up paging when asked for
+MemoryManager::MemoryManager(const MemoryConfig& config) {
+    this->config = config;
+    total_memory = config.total;
+    used_memory = 0;
+    compactions = 0;
+    compacted_memory = 0;
+    wake_threshold = LLONG_MAX;
+    groups = nullptr;
+    if (config.model == MemoryModel::PAGED) {
+        int pageSize = config.page_size > 0 ? config.page_size : 1;
+        vm.reset(new VirtualMemory(config.total / pageSize, config.swap_size / pageSize,
+                                   config.replacement, config.ws_window));
+    } else if (config.model == MemoryModel::FIRST_FIT) {
+        allocator.reset(new FreeListAllocator(config.total, FitStrategy::FIRST_FIT));
+    } else if (config.model == MemoryModel::BEST_FIT) {
+        allocator.reset(new FreeListAllocator(config.total, FitStrategy::BEST_FIT));
+    } else if (config.model == MemoryModel::WORST_FIT) {
+        allocator.reset(new FreeListAllocator(config.total, FitStrategy::WORST_FIT));
+    } else if (config.model == MemoryModel::NEXT_FIT) {
+        allocator.reset(new FreeListAllocator(config.total, FitStrategy::NEXT_FIT));
+    } else if (config.model == MemoryModel::BUDDY) {
+        allocator.reset(new BuddyAllocator(config.total, config.buddy_min_block));
+    } else if (config.model == MemoryModel::SLAB) {
+        allocator.reset(new SlabAllocator(config.total, config.slab_classes, config.slab_objects));
+    }
 }
 
 // try to allocate memory for a process
@@ -25,6 +62,107 @@ void MemoryManager::deallocate(int mem) {
     if (used_memory < 0) {
         used_memory = 0;  // make sure we dont go negative
     }
+    // O(1) check, the queue is not woken for releases that dont let its next job in
+    if (release_handler && get_admission_limit() >= wake_threshold) {
+        release_handler();
+    }
+}
+
+// reserve memory for a process, charged to its control group first
+bool MemoryManager::allocate_process(int pid, int mem_required) {
+    if (groups == nullptr) {
+        return place_process(pid, mem_required);
+    }
+    if (!groups->charge(pid, mem_required, !vm)) {
+        return false;   // over the limit of its group
+    }
+    if (!place_process(pid, mem_required)) {
+        groups->uncharge(pid, mem_required);
+        return false;
+    }
+    if (vm) {
+        // the group and everything above it, parents first (a group id is always bigger
+        // than the id of its parent)
+        int pageSize = config.page_size > 0 ? config.page_size : 1;
+        int group = groups->groupOf(pid);
+        vector<int> chain;
+        for (int g = group; g >= 0; g = groups->getParent(g)) {
+            chain.push_back(g);
+        }
+        for (size_t i = chain.size(); i > 0; i--) {
+            int g = chain[i - 1];
+            long long limit = groups->getConfig(g).memory_limit;
+            int pages = limit > 0 ? (int)max(1LL, limit / pageSize) : 0;
+            vm->setChargeGroup(g, groups->getParent(g), pages);
+        }
+        vm->setProcessGroup(pid, group);
+    }
+    return true;
+}
+
+// in paged mode only virtual pages are reserved, so RAM can be overcommitted
+bool MemoryManager::place_process(int pid, int mem_required) {
+    if (allocator) {
+        long long address = allocator->allocate(mem_required);
+        if (address < 0 && config.compaction && allocator->freeSpace() >= mem_required) {
+            // enough memory in total, just not in one piece - slide blocks together and retry
+            vector<pair<long long, long long>> moves;
+            long long moved = allocator->compact(moves);
+            if (moved > 0 || !moves.empty()) {
+                compactions = compactions + 1;
+                compacted_memory = compacted_memory + moved;
+                unordered_map<long long, long long> remap(moves.begin(), moves.end());
+                for (auto it = addresses.begin(); it != addresses.end(); it++) {
+                    auto m = remap.find(it->second);
+                    if (m != remap.end()) it->second = m->second;
+                }
+                address = allocator->allocate(mem_required);
+            }
+        }
+        if (address < 0) {
+            return false;  // no block big enough
+        }
+        addresses[pid] = address;
+        used_memory = used_memory + mem_required;
+        return true;
+    }
+    if (!vm) {
+        return allocate(mem_required);
+    }
+    int pageSize = config.page_size > 0 ? config.page_size : 1;
+    int pages = (mem_required + pageSize - 1) / pageSize;
+    if (!vm->createProcess(pid, pages)) {
+        return false;  // RAM and swap are both full
+    }
+    used_memory = used_memory + mem_required;  // committed (virtual) memory
+    return true;
+}
+
+// free everything a process had
+void MemoryManager::release_process(int pid, int mem) {
+    if (groups != nullptr) {
+        groups->detach(pid);
+    }
+    if (vm) {
+        vm->destroyProcess(pid);
+    }
+    if (allocator) {
+        auto it = addresses.find(pid);
+        if (it == addresses.end()) return;  // never placed
+        allocator->release(it->second);
+        addresses.erase(it);
+    }
+    deallocate(mem);
+}
+
+// in paged mode the process touches part of its pages every time it runs
+int MemoryManager::access_memory(int pid, long long now) {
+    if (!vm) return 0;
+    return vm->touchWorkingSet(pid, config.references_per_dispatch, now);
+}
+
+int MemoryManager::get_fault_cost() const {
+    return vm ? config.fault_cost : 0;
 }
 
 // calculate how much memory is still available
@@ -32,7 +170,134 @@ int MemoryManager::get_available_memory() const {
     return total_memory - used_memory;
 }
 
+int MemoryManager::get_used_memory() const {
+    return used_memory;
+}
+
 // print current memory usage status
 void MemoryManager::print_memory_status() const {
-    cout << "[Memory Status] Used: " << used_memory << " MB / Total: " << total_memory << " MB" << endl;
-}
\ No newline at end of file
+    if (allocator) {
+        AllocatorStats s = allocator->stats();
+        cout << "[Memory Status] Used: " << used_memory << " MB / Total: " << total_memory << " MB" << endl;
+        cout << "[" << allocator->name() << "] Blocks: " << s.live_blocks << " live, " << s.free_blocks << " free"
+             << "  Largest free: " << s.largest_free << "/" << s.free_space << " MB"
+             << "  Fragmentation ext/int: " << (int)(s.external_fragmentation * 100) << "%/"
+             << (int)(s.internal_fragmentation * 100) << "%"
+             << "  Failures: " << s.failures << "/" << s.allocations
+             << "  Avg alloc: " << (int)s.avg_alloc_ns << " ns";
+        if (compactions > 0) {
+            cout << "  Compactions: " << compactions << " (" << compacted_memory << " MB moved)";
+        }
+        cout << endl;
+    } else if (!vm) {
+        cout << "[Memory Status] Used: " << used_memory << " MB / Total: " << total_memory << " MB" << endl;
+    } else {
+        // in paged mode used memory is virtual, it can be larger than RAM
+        cout << "[Memory Status] Committed: " << used_memory << " MB virtual / RAM: " << total_memory << " MB" << endl;
+        const VirtualMemoryStats& s = vm->totals();
+        cout << "[Paging] Policy: " << vm->policyName()
+             << "  Frames: " << vm->frameCount() - vm->freeFrameCount() << "/" << vm->frameCount() << " used"
+             << "  Faults: " << s.faults << "/" << s.accesses << " accesses"
+             << "  Swap in/out: " << s.swap_ins << "/" << s.swap_outs << endl;
+    }
+}
+
+MemoryModel MemoryManager::get_model() const {
+    return config.model;
+}
+
+const VirtualMemory* MemoryManager::get_virtual_memory() const {
+    return vm.get();
+}
+
+const ContiguousAllocator* MemoryManager::get_allocator() const {
+    return allocator.get();
+}
+
+long long MemoryManager::get_address(int pid) const {
+    auto it = addresses.find(pid);
+    return it != addresses.end() ? it->second : -1;
+}
+
+int MemoryManager::get_compactions() const {
+    return compactions;
+}
+
+const MemoryConfig& MemoryManager::get_config() const {
+    return config;
+}
+
+long long MemoryManager::get_admission_limit() const {
+    if (vm) {
+        int pageSize = config.page_size > 0 ? config.page_size : 1;
+        return (long long)vm->uncommittedPages() * pageSize;
+    }
+    if (allocator) {
+        if (config.model == MemoryModel::SLAB) return total_memory;
+        return config.compaction ? allocator->freeSpace() : allocator->largestFree();
+    }
+    return total_memory - used_memory;
+}
+
+long long MemoryManager::get_admission_capacity() const {
+    if (vm) {
+        int pageSize = config.page_size > 0 ? config.page_size : 1;
+        return (long long)(vm->frameCount() + config.swap_size / pageSize) * pageSize;
+    }
+    if (allocator) {
+        // slab: requests above the largest class go straight to its backing allocator,
+        // which spans the whole space as well
+        return allocator->capacity();
+    }
+    return total_memory;
+}
+
+void MemoryManager::set_release_handler(function<void()> handler) {
+    release_handler = handler;
+}
+
+void MemoryManager::set_wake_threshold(long long mb) {
+    wake_threshold = mb;
+}
+
+void MemoryManager::set_control_groups(ControlGroups* groups) {
+    this->groups = groups;
+}
+
+long long MemoryManager::get_group_resident(int group) const {
+    if (!vm) return 0;
+    int pageSize = config.page_size > 0 ? config.page_size : 1;
+    return (long long)vm->groupResident(group) * pageSize;
+}
+
+uint64_t MemoryManager::get_group_reclaims(int group) const {
+    return vm ? vm->groupReclaims(group) : 0;
+}
+
+void MemoryManager::save_state(SnapshotWriter& out) const {
+    out.put(total_memory);
+    out.put(used_memory);
+    out.putAll(addresses);
+    out.put(compactions);
+    out.put(compacted_memory);
+    if (vm) {
+        vm->saveState(out);
+    }
+    if (allocator) {
+        allocator->saveState(out);
+    }
+}
+
+void MemoryManager::load_state(SnapshotReader& in) {
+    in.get(total_memory);
+    in.get(used_memory);
+    in.getMap(addresses);
+    in.get(compactions);
+    in.get(compacted_memory);
+    if (vm) {
+        vm->loadState(in);
+    }
+    if (allocator) {
+        allocator->loadState(in);
+    }
+}
@@ -0,0 +1,356 @@
+#include "metrics.h"
+#include "snapshot.h"
+#include <cmath>
+#include <iostream>
+#include <iomanip>
+
+using namespace std;
+
+// ---------------- QuantileSketch ----------------
+
+// gamma is picked so every bucket covers values within the relative accuracy
+QuantileSketch::QuantileSketch(double relative_accuracy) {
+    gamma = (1.0 + relative_accuracy) / (1.0 - relative_accuracy);
+    log_gamma = log(gamma);
+    offset = 0;
+    zero_count = 0;
+    total = 0;
+}
+
+// bucket i holds values in (gamma^(i-1), gamma^i]
+int QuantileSketch::bucket_index(double value) const {
+    return (int)ceil(log(value) / log_gamma);
+}
+
+// add one value, grows the bucket array only when a new range is reached
+void QuantileSketch::add(double value) {
+    total = total + 1;
+    if (value <= 0) {
+        zero_count = zero_count + 1;
+        return;
+    }
+
+    int index = bucket_index(value);
+    if (buckets.empty()) {
+        offset = index;
+        buckets.push_back(0);
+    } else if (index < offset) {
+        // prepend empty buckets
+        buckets.insert(buckets.begin(), offset - index, 0);
+        offset = index;
+    } else if (index - offset >= (int)buckets.size()) {
+        buckets.resize(index - offset + 1, 0);
+    }
+    buckets[index - offset] = buckets[index - offset] + 1;
+}
+
+// add counts of another sketch built with the same accuracy
+void QuantileSketch::merge(const QuantileSketch& other) {
+    total = total + other.total;
+    zero_count = zero_count + other.zero_count;
+    for (size_t i = 0; i < other.buckets.size(); i++) {
+        if (other.buckets[i] == 0) continue;
+        int index = other.offset + (int)i;
+        if (buckets.empty()) {
+            offset = index;
+            buckets.push_back(0);
+        } else if (index < offset) {
+            buckets.insert(buckets.begin(), offset - index, 0);
+            offset = index;
+        } else if (index - offset >= (int)buckets.size()) {
+            buckets.resize(index - offset + 1, 0);
+        }
+        buckets[index - offset] = buckets[index - offset] + other.buckets[i];
+    }
+}
+
+// walk buckets until we pass the requested rank
+double QuantileSketch::quantile(double q) const {
+    if (total == 0) return 0;
+    if (q < 0) q = 0;
+    if (q > 1) q = 1;
+
+    uint64_t rank = (uint64_t)(q * (double)(total - 1) + 0.5);  // nearest rank
+    if (rank < zero_count) return 0;
+
+    uint64_t seen = zero_count;
+    for (size_t i = 0; i < buckets.size(); i++) {
+        seen = seen + buckets[i];
+        if (seen > rank) {
+            // middle of the bucket in relative terms
+            int index = offset + (int)i;
+            return 2.0 * pow(gamma, index) / (gamma + 1.0);
+        }
+    }
+    return 2.0 * pow(gamma, offset + (int)buckets.size() - 1) / (gamma + 1.0);
+}
+
+uint64_t QuantileSketch::count() const {
+    return total;
+}
+
+void QuantileSketch::clear() {
+    buckets.clear();
+    offset = 0;
+    zero_count = 0;
+    total = 0;
+}
+
+void QuantileSketch::save_state(SnapshotWriter& out) const {
+    out.put(gamma);
+    out.put(log_gamma);
+    out.putVector(buckets);
+    out.put(offset);
+    out.put(zero_count);
+    out.put(total);
+}
+
+void QuantileSketch::load_state(SnapshotReader& in) {
+    in.get(gamma);
+    in.get(log_gamma);
+    in.getVector(buckets);
+    in.get(offset);
+    in.get(zero_count);
+    in.get(total);
+}
+
+// ---------------- MetricsCollector ----------------
+
+MetricsCollector::MetricsCollector() {
+    clear();
+}
+
+// reset all counters
+void MetricsCollector::clear() {
+    completed = 0;
+    sum_turnaround = 0;
+    sum_waiting = 0;
+    sum_response = 0;
+    responded = 0;
+    busy_time = 0;
+    context_switches = 0;
+    first_arrival = 0;
+    last_completion = 0;
+    seen_arrival = false;
+    turnaround.clear();
+    waiting.clear();
+    response.clear();
+    rt_jobs = 0;
+    deadline_misses = 0;
+    sum_job_response = 0;
+    max_lateness = 0;
+    job_response.clear();
+    lateness.clear();
+}
+
+// remember the earliest arrival so throughput has a start point
+void MetricsCollector::record_arrival(const PCB* p) {
+    record_arrival_time(p->arrival_time);
+}
+
+void MetricsCollector::record_arrival_time(long long arrival) {
+    if (!seen_arrival || arrival < first_arrival) {
+        first_arrival = arrival;
+        seen_arrival = true;
+    }
+}
+
+// response time = first time on the CPU - arrival
+void MetricsCollector::record_dispatch(PCB* p, long long now) {
+    if (p->first_run_time >= 0) return;  // already responded before
+    if (p->period > 0) return;
+
+    p->first_run_time = now;
+    p->response_time = (int)(now - p->arrival_time);
+    record_response(p->response_time);
+}
+
+void MetricsCollector::record_response(long long value) {
+    sum_response = sum_response + value;
+    responded = responded + 1;
+    response.add((double)value);
+}
+
+// fill in the PCB timing fields and add them to the running totals
+void MetricsCollector::record_completion(PCB* p, long long now) {
+    p->completion_time = now;
+    p->turnaround_time = now - p->arrival_time;
+    p->waiting_time = p->turnaround_time - p->burst_time - p->io_time;
+    if (p->waiting_time < 0) {
+        p->waiting_time = 0;
+    }
+    record_completion_times(p->arrival_time, p->burst_time + p->io_time, now);
+}
+
+// lateness = completion - absolute deadline, a job is late when that is above 0
+void MetricsCollector::record_job(PCB* p, long long now) {
+    p->completion_time = now;
+    long long responseTime = now - p->release_time;
+    long long late = now - p->deadline;
+    if (rt_jobs == 0 || late > max_lateness) {
+        max_lateness = late;
+    }
+    rt_jobs = rt_jobs + 1;
+    if (late > 0) {
+        deadline_misses = deadline_misses + 1;
+    }
+    sum_job_response = sum_job_response + responseTime;
+    job_response.add((double)responseTime);
+    lateness.add((double)late);
+
+    if (now > last_completion) {
+        last_completion = now;
+    }
+}
+
+// turnaround = completion - arrival, waiting = turnaround - CPU (and I/O) time
+void MetricsCollector::record_completion_times(long long arrival, long long burst, long long now) {
+    long long tat = now - arrival;
+    long long wait = tat - burst;
+    if (wait < 0) wait = 0;
+
+    completed = completed + 1;
+    sum_turnaround = sum_turnaround + tat;
+    sum_waiting = sum_waiting + wait;
+    turnaround.add((double)tat);
+    waiting.add((double)wait);
+
+    if (now > last_completion) {
+        last_completion = now;
+    }
+}
+
+void MetricsCollector::record_busy(long long ticks) {
+    busy_time = busy_time + ticks;
+}
+
+void MetricsCollector::record_context_switch() {
+    context_switches = context_switches + 1;
+}
+
+// add totals from another collector
+void MetricsCollector::merge(const MetricsCollector& other) {
+    completed = completed + other.completed;
+    sum_turnaround = sum_turnaround + other.sum_turnaround;
+    sum_waiting = sum_waiting + other.sum_waiting;
+    sum_response = sum_response + other.sum_response;
+    responded = responded + other.responded;
+    busy_time = busy_time + other.busy_time;
+    context_switches = context_switches + other.context_switches;
+    if (other.seen_arrival && (!seen_arrival || other.first_arrival < first_arrival)) {
+        first_arrival = other.first_arrival;
+        seen_arrival = true;
+    }
+    if (other.last_completion > last_completion) {
+        last_completion = other.last_completion;
+    }
+    turnaround.merge(other.turnaround);
+    waiting.merge(other.waiting);
+    response.merge(other.response);
+    if (other.rt_jobs > 0 && (rt_jobs == 0 || other.max_lateness > max_lateness)) {
+        max_lateness = other.max_lateness;
+    }
+    rt_jobs = rt_jobs + other.rt_jobs;
+    deadline_misses = deadline_misses + other.deadline_misses;
+    sum_job_response = sum_job_response + other.sum_job_response;
+    job_response.merge(other.job_response);
+    lateness.merge(other.lateness);
+}
+
+// compute the final numbers
+MetricsSummary MetricsCollector::summary() const {
+    MetricsSummary s;
+    s.completed = completed;
+    s.mean_turnaround = completed > 0 ? (double)sum_turnaround / completed : 0;
+    s.mean_waiting = completed > 0 ? (double)sum_waiting / completed : 0;
+    s.mean_response = responded > 0 ? (double)sum_response / responded : 0;
+    s.p50_turnaround = turnaround.quantile(0.50);
+    s.p95_turnaround = turnaround.quantile(0.95);
+    s.p99_turnaround = turnaround.quantile(0.99);
+    s.p50_waiting = waiting.quantile(0.50);
+    s.p95_waiting = waiting.quantile(0.95);
+    s.p99_waiting = waiting.quantile(0.99);
+    s.p50_response = response.quantile(0.50);
+    s.p95_response = response.quantile(0.95);
+    s.p99_response = response.quantile(0.99);
+    s.elapsed = last_completion - first_arrival;
+    s.throughput = s.elapsed > 0 ? (double)completed / s.elapsed : 0;
+    s.cpu_utilization = s.elapsed > 0 ? (double)busy_time / s.elapsed : 0;
+    s.context_switches = context_switches;
+    s.rt_jobs = rt_jobs;
+    s.deadline_misses = deadline_misses;
+    s.miss_ratio = rt_jobs > 0 ? (double)deadline_misses / rt_jobs : 0;
+    s.mean_job_response = rt_jobs > 0 ? (double)sum_job_response / rt_jobs : 0;
+    s.p99_job_response = job_response.quantile(0.99);
+    s.p99_lateness = lateness.quantile(0.99);
+    s.max_lateness = max_lateness;
+    return s;
+}
+
+// print the summary as a small report
+void MetricsCollector::print(const string& title) const {
+    MetricsSummary s = summary();
+    cout << endl << "[Evaluation: " << title << "]" << endl;
+    cout << fixed << setprecision(2);
+    cout << "Processes Completed: " << s.completed << endl;
+    cout << "Turnaround Time: mean " << s.mean_turnaround << "  p50 " << s.p50_turnaround
+         << "  p95 " << s.p95_turnaround << "  p99 " << s.p99_turnaround << endl;
+    cout << "Waiting Time:    mean " << s.mean_waiting << "  p50 " << s.p50_waiting
+         << "  p95 " << s.p95_waiting << "  p99 " << s.p99_waiting << endl;
+    cout << "Response Time:   mean " << s.mean_response << "  p50 " << s.p50_response
+         << "  p95 " << s.p95_response << "  p99 " << s.p99_response << endl;
+    cout << "Throughput: " << setprecision(4) << s.throughput << " processes/tick" << endl;
+    cout << "CPU Utilization: " << setprecision(2) << s.cpu_utilization * 100 << "%" << endl;
+    cout << "Context Switches: " << s.context_switches << endl;
+    if (s.rt_jobs > 0) {
+        cout << "Real-time Jobs: " << s.rt_jobs << ", deadline misses " << s.deadline_misses
+             << " (" << s.miss_ratio * 100 << "%), max lateness " << s.max_lateness
+             << ", job response mean " << s.mean_job_response << "  p99 " << s.p99_job_response << endl;
+    }
+    cout.unsetf(ios::fixed);
+    cout << setprecision(6);
+}
+
+void MetricsCollector::save_state(SnapshotWriter& out) const {
+    out.put(completed);
+    out.put(sum_turnaround);
+    out.put(sum_waiting);
+    out.put(sum_response);
+    out.put(responded);
+    out.put(busy_time);
+    out.put(context_switches);
+    out.put(first_arrival);
+    out.put(last_completion);
+    out.put(seen_arrival);
+    turnaround.save_state(out);
+    waiting.save_state(out);
+    response.save_state(out);
+    out.put(rt_jobs);
+    out.put(deadline_misses);
+    out.put(sum_job_response);
+    out.put(max_lateness);
+    job_response.save_state(out);
+    lateness.save_state(out);
+}
+
+void MetricsCollector::load_state(SnapshotReader& in) {
+    in.get(completed);
+    in.get(sum_turnaround);
+    in.get(sum_waiting);
+    in.get(sum_response);
+    in.get(responded);
+    in.get(busy_time);
+    in.get(context_switches);
+    in.get(first_arrival);
+    in.get(last_completion);
+    in.get(seen_arrival);
+    turnaround.load_state(in);
+    waiting.load_state(in);
+    response.load_state(in);
+    in.get(rt_jobs);
+    in.get(deadline_misses);
+    in.get(sum_job_response);
+    in.get(max_lateness);
+    job_response.load_state(in);
+    lateness.load_state(in);
+}
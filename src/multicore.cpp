@@ -0,0 +1,361 @@
+#include "multicore.h"
+#include "event_trace.h"
+#include <thread>
+#include <algorithm>
+#include <iostream>
+#include <iomanip>
+#include <queue>
+#include <stdexcept>
+#include <cstdint>
+
+using namespace std;
+
+// ---------------- ThreadBarrier ----------------
+
+ThreadBarrier::ThreadBarrier(int parties) {
+    this->parties = parties;
+    waiting = 0;
+    generation = 0;
+}
+
+// last thread to arrive wakes everybody up and starts a new generation
+void ThreadBarrier::arrive_and_wait() {
+    unique_lock<mutex> guard(lock);
+    unsigned long long myGeneration = generation;
+    waiting = waiting + 1;
+    if (waiting == parties) {
+        waiting = 0;
+        generation = generation + 1;
+        cv.notify_all();
+        return;
+    }
+    cv.wait(guard, [&] { return generation != myGeneration; });
+}
+
+// ---------------- MultiCoreSimulator ----------------
+
+MultiCoreSimulator::MultiCoreSimulator(const MultiCoreConfig& config) {
+    this->config = config;
+    if (this->config.cores < 1) this->config.cores = 1;
+    if (this->config.quantum < 1) this->config.quantum = 1;
+    if (this->config.epoch < 1) this->config.epoch = 1;
+
+    for (int i = 0; i < this->config.cores; i++) {
+        unique_ptr<CoreState> core(new CoreState());
+        cores.push_back(move(core));
+    }
+    nextArrival = 0;
+    placeCursor = 0;
+    completed = 0;
+    epochStart = 0;
+    epochEnd = 0;
+    finished = false;
+}
+
+void MultiCoreSimulator::addProcess(const PCB& p) {
+    // the process table keeps times in 32 bits
+    if (p.arrival_time < 0 || p.arrival_time > INT32_MAX) {
+        throw invalid_argument("PID " + to_string(p.pid) + " arrives outside the 32 bit time range of multi-core runs");
+    }
+    PendingArrival a;
+    a.pid = p.pid;
+    a.arrival = (int)p.arrival_time;
+    a.burst = p.burst_time;
+    a.priority = p.priority;
+    pending.push_back(a);
+}
+
+// hand out every process arriving before the end of this epoch, round robin over the cores
+void MultiCoreSimulator::placeArrivals() {
+    while (nextArrival < pending.size() && pending[nextArrival].arrival < epochEnd) {
+        const PendingArrival& a = pending[nextArrival];
+        nextArrival = nextArrival + 1;
+
+        CoreState& core = *cores[placeCursor];
+        placeCursor = (placeCursor + 1) % cores.size();
+
+        ProcessHandle h = table.create(a.pid, a.priority, 0, "", a.arrival, a.burst);
+        table.hot(h).state = (uint8_t)ProcessState::READY;
+        core.metrics.record_arrival_time(a.arrival);
+        core.queuedWork = core.queuedWork + a.burst;
+        core.runQueue.push(h);
+    }
+}
+
+// finished processes give their table slot back, only done between epochs
+void MultiCoreSimulator::reapRetired() {
+    for (size_t i = 0; i < cores.size(); i++) {
+        vector<ProcessHandle>& retired = cores[i]->retired;
+        for (size_t j = 0; j < retired.size(); j++) {
+            table.release(retired[j]);
+        }
+        retired.clear();
+    }
+}
+
+// move work from cores above the average queue length to cores below it
+// runs between epochs while every worker waits at the barrier
+void MultiCoreSimulator::pushMigrate() {
+    long long total = 0;
+    for (size_t i = 0; i < cores.size(); i++) {
+        total = total + cores[i]->runQueue.size();
+    }
+    long long target = (total + cores.size() - 1) / cores.size();
+
+    size_t receiver = 0;
+    for (size_t donor = 0; donor < cores.size(); donor++) {
+        while (cores[donor]->runQueue.size() > target) {
+            // find the next core that still has room
+            while (receiver < cores.size() && cores[receiver]->runQueue.size() >= target) {
+                receiver = receiver + 1;
+            }
+            if (receiver >= cores.size()) return;
+
+            ProcessHandle h = INVALID_HANDLE;
+            if (!cores[donor]->runQueue.steal(h)) break;
+            long long work = table.hot(h).remaining_time;
+            cores[donor]->queuedWork = cores[donor]->queuedWork - work;
+            cores[receiver]->queuedWork = cores[receiver]->queuedWork + work;
+            cores[receiver]->runQueue.push(h);
+        }
+    }
+}
+
+// work stealing between epochs. a core runs dry once its clock plus the work in its queue
+// is reached. the core that would run dry first, if that is inside the epoch, takes the
+// oldest process of the core that stays busy the longest, but only when the thief (with the
+// migration cost) is still done before the victim would be without it, so every steal
+// shortens the longer of the two queues. runs while every worker waits at the barrier, at
+// most one steal per queued process
+void MultiCoreSimulator::stealWork() {
+    int n = (int)cores.size();
+    if (n < 2) return;
+    int64_t keep = config.affinity ? 1 : 0;   // affinity: a victim keeps its next process
+    int64_t budget = 0;
+    for (int c = 0; c < n; c++) {
+        budget = budget + cores[c]->runQueue.size();
+    }
+
+    for (; budget > 0; budget--) {
+        int thief = -1;
+        int victim = -1;
+        long long thiefFree = 0;
+        long long victimFree = 0;
+        for (int c = 0; c < n; c++) {
+            CoreState& core = *cores[c];
+            long long freeAt = max(core.clock, epochStart) + core.queuedWork;
+            if (thief < 0 || freeAt < thiefFree) {
+                thief = c;
+                thiefFree = freeAt;
+            }
+            if (core.runQueue.size() > keep && (victim < 0 || freeAt > victimFree)) {
+                victim = c;
+                victimFree = freeAt;
+            }
+        }
+        if (victim < 0 || thief == victim || thiefFree >= epochEnd) return;
+
+        ProcessHandle h = INVALID_HANDLE;
+        if (!cores[victim]->runQueue.peek(h)) return;
+        long long work = table.hot(h).remaining_time;
+        if (thiefFree + config.migration_cost + work >= victimFree) return;
+
+        cores[victim]->runQueue.steal(h);
+        cores[victim]->queuedWork = cores[victim]->queuedWork - work;
+        cores[thief]->queuedWork = cores[thief]->queuedWork + work;
+        cores[thief]->runQueue.push(h);
+        cores[thief]->steals = cores[thief]->steals + 1;
+        TRACE_EVENT(TraceLevel::SCHEDULING, TraceEventKind::STEAL, thiefFree, table.hot(h).pid, victim, thief);
+    }
+}
+
+// run one time slice on core c, a core without work idles to the end of the epoch
+void MultiCoreSimulator::stepCore(int c) {
+    CoreState& core = *cores[c];
+    ProcessHandle h = INVALID_HANDLE;
+    if (!core.runQueue.steal(h)) {
+        core.clock = epochEnd;
+        return;
+    }
+
+    ProcessHot& p = table.hot(h);
+    core.queuedWork = core.queuedWork - p.remaining_time;
+    int arrival = table.arrivalTime(h);
+    if (p.ready_time > core.clock) {
+        core.clock = p.ready_time;
+    }
+
+    // cache is cold when the process last ran somewhere else
+    if (p.last_core >= 0 && p.last_core != c) {
+        TRACE_EVENT(TraceLevel::SCHEDULING, TraceEventKind::MIGRATE, core.clock, p.pid, p.last_core, c);
+        core.clock = core.clock + config.migration_cost;
+        core.migrations = core.migrations + 1;
+    }
+    p.last_core = (int16_t)c;
+    p.state = (uint8_t)ProcessState::RUNNING;
+
+    // first time on a CPU -> response time
+    if (table.firstRunTime(h) < 0) {
+        table.firstRunTime(h) = (int32_t)core.clock;
+        core.metrics.record_response(core.clock - arrival);
+    }
+    if (core.lastPid != 0 && core.lastPid != p.pid) {
+        core.metrics.record_context_switch();
+    }
+    core.lastPid = p.pid;
+
+    int slice = min(config.quantum, (int)p.remaining_time);
+    TRACE_EVENT(TraceLevel::SCHEDULING, TraceEventKind::DISPATCH, core.clock, p.pid, 0, c);
+    core.clock = core.clock + slice;
+    core.slices = core.slices + 1;
+    core.metrics.record_busy(slice);
+    p.remaining_time = p.remaining_time - slice;
+
+    if (p.remaining_time <= 0) {
+        TRACE_EVENT(TraceLevel::LIFECYCLE, TraceEventKind::TERMINATE, core.clock, p.pid, 0, c);
+        p.state = (uint8_t)ProcessState::TERMINATED;
+        table.completionTime(h) = (int32_t)core.clock;
+        core.metrics.record_completion_times(arrival, table.burstTime(h), core.clock);
+        core.retired.push_back(h);
+        completed.fetch_add(1, memory_order_relaxed);
+    } else {
+        TRACE_EVENT(TraceLevel::SCHEDULING, TraceEventKind::QUANTUM_EXPIRE, core.clock, p.pid, 0, c);
+        p.state = (uint8_t)ProcessState::READY;
+        p.ready_time = (int32_t)core.clock;
+        core.queuedWork = core.queuedWork + p.remaining_time;
+        core.runQueue.push(h);
+    }
+}
+
+// simulate this thread's cores up to the end of the epoch, one after the other. cores do
+// not touch each other's queues inside an epoch, so the order does not matter
+void MultiCoreSimulator::runCores(int threadIndex, int threadCount) {
+    for (int c = threadIndex; c < (int)cores.size(); c += threadCount) {
+        if (cores[c]->clock < epochStart) {
+            cores[c]->clock = epochStart;
+        }
+        while (cores[c]->clock < epochEnd) {
+            stepCore(c);
+        }
+    }
+}
+
+// every worker runs this loop, thread 0 also does the serial part between epochs
+void MultiCoreSimulator::workerLoop(int threadIndex, int threadCount, ThreadBarrier& barrier) {
+    while (true) {
+        if (threadIndex == 0) {
+            reapRetired();
+            if (completed.load() == (long long)pending.size()) {
+                finished = true;
+            } else {
+                // nothing queued anywhere - jump straight to the next arrival
+                bool allEmpty = true;
+                for (size_t i = 0; i < cores.size() && allEmpty; i++) {
+                    if (!cores[i]->runQueue.empty()) allEmpty = false;
+                }
+                if (allEmpty && nextArrival < pending.size() && pending[nextArrival].arrival > epochStart) {
+                    epochStart = pending[nextArrival].arrival;
+                }
+                epochEnd = epochStart + config.epoch;
+                placeArrivals();
+                if (config.balance == LoadBalanceMode::PUSH) {
+                    pushMigrate();
+                } else if (config.balance == LoadBalanceMode::WORK_STEAL) {
+                    stealWork();
+                }
+            }
+        }
+        barrier.arrive_and_wait();
+        if (finished) break;
+
+        runCores(threadIndex, threadCount);
+        barrier.arrive_and_wait();
+
+        if (threadIndex == 0) {
+            epochStart = epochEnd;
+        }
+    }
+}
+
+// start the worker threads and wait for them to finish
+void MultiCoreSimulator::run() {
+    stable_sort(pending.begin(), pending.end(), [](const PendingArrival& a, const PendingArrival& b) {
+        return a.arrival < b.arrival;
+    });
+
+    int threadCount = config.threads;
+    if (threadCount <= 0) {
+        threadCount = (int)thread::hardware_concurrency();
+        if (threadCount <= 0) threadCount = 1;
+    }
+    if (threadCount > (int)cores.size()) {
+        threadCount = (int)cores.size();
+    }
+
+    ThreadBarrier barrier(threadCount);
+    vector<thread> workers;
+    for (int i = 1; i < threadCount; i++) {
+        workers.push_back(thread(&MultiCoreSimulator::workerLoop, this, i, threadCount, ref(barrier)));
+    }
+    workerLoop(0, threadCount, barrier);
+    for (size_t i = 0; i < workers.size(); i++) {
+        workers[i].join();
+    }
+}
+
+size_t MultiCoreSimulator::tableSlots() const {
+    return table.capacity();
+}
+
+MetricsCollector MultiCoreSimulator::combinedMetrics() const {
+    MetricsCollector total;
+    for (size_t i = 0; i < cores.size(); i++) {
+        total.merge(cores[i]->metrics);
+    }
+    return total;
+}
+
+long long MultiCoreSimulator::totalSteals() const {
+    long long sum = 0;
+    for (size_t i = 0; i < cores.size(); i++) {
+        sum = sum + cores[i]->steals;
+    }
+    return sum;
+}
+
+long long MultiCoreSimulator::totalMigrations() const {
+    long long sum = 0;
+    for (size_t i = 0; i < cores.size(); i++) {
+        sum = sum + cores[i]->migrations;
+    }
+    return sum;
+}
+
+long long MultiCoreSimulator::totalSlices() const {
+    long long sum = 0;
+    for (size_t i = 0; i < cores.size(); i++) {
+        sum = sum + cores[i]->slices;
+    }
+    return sum;
+}
+
+long long MultiCoreSimulator::totalEvents() const {
+    return (long long)nextArrival + totalSlices();
+}
+
+long long MultiCoreSimulator::finishTime() const {
+    return combinedMetrics().summary().elapsed;
+}
+
+// combined metrics plus the multi core specific counters
+void MultiCoreSimulator::printReport(const string& title) const {
+    MetricsCollector total = combinedMetrics();
+    total.print(title);
+    MetricsSummary s = total.summary();
+    cout << "Cores: " << cores.size()
+         << "  Avg Core Utilization: " << fixed << setprecision(2)
+         << s.cpu_utilization * 100 / cores.size() << "%" << endl;
+    cout.unsetf(ios::fixed);
+    cout << "Steals: " << totalSteals() << "  Migrations: " << totalMigrations()
+         << "  Process Slots Used: " << tableSlots() << endl;
+}
@@ -1,4 +1,5 @@
 #include "process_queues.h"
+#include "snapshot.h"
 #include <iostream>
 
 using namespace std;
@@ -8,11 +9,6 @@ void ProcessQueues::add_to_ready(PCB* process) {
     ready_queue.push(process);
 }
 
-// add a process to blocked queue for a specific resource
-void ProcessQueues::add_to_blocked(const string& resource, PCB* process) {
-    blocked_queue[resource].push_back(process);
-}
-
 // get the next process from ready queue
 PCB* ProcessQueues::pop_ready() {
     if (!ready_queue.empty()) {
@@ -23,31 +19,37 @@ PCB* ProcessQueues::pop_ready() {
     return nullptr;  // no process available
 }
 
-// when a resource becomes free, move all blocked processes to ready queue
-void ProcessQueues::release_resource(const string& resource) {
-    auto it = blocked_queue.find(resource);
-    if (it != blocked_queue.end()) {
-        // move all processes waiting for this resource to ready queue
-        for (auto proc_it = it->second.begin(); proc_it != it->second.end(); proc_it++) {
-            PCB* proc = *proc_it;
-            cout << "[Resource] Process " << proc->pid << " moved from Blocked to Ready (resource: " << resource << ")" << endl;
-            ready_queue.push(proc);
-        }
-        blocked_queue.erase(it);  // remove the resource entry
-    }
+// blocking, handoff and wakeups all go through the resource manager
+ResourceManager& ProcessQueues::get_resources() {
+    return resources;
+}
+
+const ResourceManager& ProcessQueues::get_resources() const {
+    return resources;
 }
 
 // print status of all queues for debugging
 void ProcessQueues::print_queues_status() const {
     cout << "[Ready Queue] Size: " << ready_queue.size() << endl;
     cout << "[Blocked Queues]" << endl;
-    
-    // iterate through blocked queues manually
-    for (auto it = blocked_queue.begin(); it != blocked_queue.end(); it++) {
-        cout << "  Resource: " << it->first << " -> Processes: ";
-        for (auto proc_it = it->second.begin(); proc_it != it->second.end(); proc_it++) {
-            cout << (*proc_it)->pid << " ";
-        }
-        cout << endl;
+    resources.print_waiters();
+}
+
+void ProcessQueues::save_state(SnapshotWriter& out) const {
+    queue<PCB*> ready = ready_queue;
+    out.put((uint64_t)ready.size());
+    while (!ready.empty()) {
+        out.putProcess(ready.front());
+        ready.pop();
     }
-}
\ No newline at end of file
+    resources.save_state(out);
+}
+
+void ProcessQueues::load_state(SnapshotReader& in) {
+    ready_queue = queue<PCB*>();
+    uint64_t n = in.get<uint64_t>();
+    for (uint64_t i = 0; i < n; i++) {
+        ready_queue.push(in.getProcess());
+    }
+    resources.load_state(in);
+}
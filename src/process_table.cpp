@@ -0,0 +1,195 @@
+#include "process_table.h"
+
+using namespace std;
+
+// ---------------- ResourceInterner ----------------
+
+// id 0 is reserved for "no resource" (empty name)
+ResourceInterner::ResourceInterner() {
+    names.push_back("");
+    ids[""] = 0;
+}
+
+int ResourceInterner::intern(const string& name) {
+    auto it = ids.find(name);
+    if (it != ids.end()) {
+        return it->second;
+    }
+    int id = (int)names.size();
+    names.push_back(name);
+    ids[name] = id;
+    return id;
+}
+
+int ResourceInterner::find(const string& name) const {
+    auto it = ids.find(name);
+    if (it == ids.end()) return -1;
+    return it->second;
+}
+
+const string& ResourceInterner::name(int id) const {
+    return names[id];
+}
+
+int ResourceInterner::count() const {
+    return (int)names.size();
+}
+
+// ---------------- ProcessTable ----------------
+
+ProcessTable::ProcessTable() {
+    liveCount = 0;
+}
+
+void ProcessTable::reserve(size_t n) {
+    hotFields.reserve(n);
+    arrivalTimes.reserve(n);
+    burstTimes.reserve(n);
+    memoryRequired.reserve(n);
+    resourceIds.reserve(n);
+    firstRunTimes.reserve(n);
+    completionTimes.reserve(n);
+    vruntimes.reserve(n);
+}
+
+// reuse a free slot when there is one, otherwise grow every column by one
+ProcessHandle ProcessTable::create(int pid, int priority, int memory, const string& resource,
+                                   int arrival, int burst) {
+    ProcessHandle h;
+    if (!freeSlots.empty()) {
+        h = freeSlots.back();
+        freeSlots.pop_back();
+    } else {
+        h = (ProcessHandle)hotFields.size();
+        hotFields.push_back(ProcessHot());
+        arrivalTimes.push_back(0);
+        burstTimes.push_back(0);
+        memoryRequired.push_back(0);
+        resourceIds.push_back(0);
+        firstRunTimes.push_back(-1);
+        completionTimes.push_back(0);
+        vruntimes.push_back(0);
+    }
+
+    ProcessHot& hf = hotFields[h];
+    hf.remaining_time = burst;
+    hf.ready_time = arrival;
+    hf.pid = pid;
+    hf.priority = (int16_t)priority;
+    hf.queue_level = 0;
+    hf.last_core = -1;
+    hf.state = (uint8_t)ProcessState::NEW;
+    hf.flags = PROC_LIVE;
+
+    arrivalTimes[h] = arrival;
+    burstTimes[h] = burst;
+    memoryRequired[h] = memory;
+    resourceIds[h] = (uint32_t)resources.intern(resource);
+    firstRunTimes[h] = -1;
+    completionTimes[h] = 0;
+    vruntimes[h] = 0;
+
+    liveCount = liveCount + 1;
+    return h;
+}
+
+ProcessHandle ProcessTable::createFrom(const PCB& pcb) {
+    return create(pcb.pid, pcb.priority, pcb.memory_required, pcb.required_resource,
+                  pcb.arrival_time, pcb.burst_time);
+}
+
+// mark the slot free and push it on the free list
+void ProcessTable::release(ProcessHandle h) {
+    if (!isLive(h)) return;
+    hotFields[h].flags = 0;
+    hotFields[h].state = (uint8_t)ProcessState::TERMINATED;
+    freeSlots.push_back(h);
+    liveCount = liveCount - 1;
+}
+
+// rebuild a PCB from the columns
+PCB ProcessTable::toPCB(ProcessHandle h) const {
+    const ProcessHot& hf = hotFields[h];
+    PCB p;
+    p.pid = hf.pid;
+    p.state = (ProcessState)hf.state;
+    p.priority = hf.priority;
+    p.required_resource = resources.name(resourceIds[h]);
+    p.has_resource = (hf.flags & PROC_HAS_RESOURCE) != 0;
+    p.memory_required = memoryRequired[h];
+    p.arrival_time = arrivalTimes[h];
+    p.burst_time = burstTimes[h];
+    p.remaining_time = hf.remaining_time;
+    p.completion_time = completionTimes[h];
+    p.turnaround_time = completionTimes[h] - arrivalTimes[h];
+    p.waiting_time = p.turnaround_time - burstTimes[h];
+    p.first_run_time = firstRunTimes[h];
+    p.response_time = firstRunTimes[h] >= 0 ? firstRunTimes[h] - arrivalTimes[h] : 0;
+    p.queue_level = hf.queue_level;
+    p.vruntime = vruntimes[h];
+    p.last_core = hf.last_core;
+    return p;
+}
+
+bool ProcessTable::isLive(ProcessHandle h) const {
+    return h < hotFields.size() && (hotFields[h].flags & PROC_LIVE) != 0;
+}
+
+size_t ProcessTable::size() const {
+    return liveCount;
+}
+
+size_t ProcessTable::capacity() const {
+    return hotFields.size();
+}
+
+ResourceInterner& ProcessTable::resourceNames() {
+    return resources;
+}
+
+const ResourceInterner& ProcessTable::resourceNames() const {
+    return resources;
+}
+
+// ---------------- PCBPool ----------------
+
+PCBPool::PCBPool(size_t chunkSize) {
+    this->chunkSize = chunkSize > 0 ? chunkSize : 1;
+    inUse = 0;
+}
+
+// allocate one more chunk and put all of it on the free list
+void PCBPool::addChunk() {
+    unique_ptr<PCB[]> chunk(new PCB[chunkSize]);
+    // push in reverse so the lowest address is handed out first
+    for (size_t i = chunkSize; i > 0; i--) {
+        freeList.push_back(&chunk[i - 1]);
+    }
+    chunks.push_back(move(chunk));
+}
+
+PCB* PCBPool::acquire() {
+    if (freeList.empty()) {
+        addChunk();
+    }
+    PCB* p = freeList.back();
+    freeList.pop_back();
+    *p = PCB();  // reset to defaults
+    inUse = inUse + 1;
+    return p;
+}
+
+void PCBPool::release(PCB* p) {
+    if (p == nullptr) return;
+    p->required_resource.clear();
+    freeList.push_back(p);
+    inUse = inUse - 1;
+}
+
+size_t PCBPool::liveCount() const {
+    return inUse;
+}
+
+size_t PCBPool::capacity() const {
+    return chunks.size() * chunkSize;
+}
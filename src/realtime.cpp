@@ -0,0 +1,86 @@
+#include "realtime.h"
+#include <cmath>
+#include <algorithm>
+
+using namespace std;
+
+static long long deadlineOf(const RealTimeTask& t) {
+    return t.deadline > 0 ? t.deadline : t.period;
+}
+
+RealTimeTask realTimeTask(const PCB& p) {
+    RealTimeTask t;
+    t.period = p.period;
+    t.deadline = p.relative_deadline;
+    t.wcet = p.wcet > 0 ? p.wcet : p.burst_time;
+    return t;
+}
+
+double utilization(const vector<RealTimeTask>& tasks) {
+    double u = 0;
+    for (size_t i = 0; i < tasks.size(); i++) {
+        u = u + (double)tasks[i].wcet / tasks[i].period;
+    }
+    return u;
+}
+
+double liuLaylandBound(size_t n) {
+    if (n == 0) return 1;
+    return n * (pow(2.0, 1.0 / n) - 1);
+}
+
+bool rmUtilizationTest(const vector<RealTimeTask>& tasks) {
+    return utilization(tasks) <= liuLaylandBound(tasks.size());
+}
+
+bool rmHyperbolicTest(const vector<RealTimeTask>& tasks) {
+    double product = 1;
+    for (size_t i = 0; i < tasks.size(); i++) {
+        product = product * ((double)tasks[i].wcet / tasks[i].period + 1);
+    }
+    return product <= 2;
+}
+
+// tasks are visited by period, so every task only sees the ones above it. the iteration
+// starts at the previous task's sum of wcets and only grows, it stops at the deadline
+vector<long long> rmResponseTimes(const vector<RealTimeTask>& tasks) {
+    vector<size_t> order(tasks.size());
+    for (size_t i = 0; i < order.size(); i++) order[i] = i;
+    stable_sort(order.begin(), order.end(), [&](size_t a, size_t b) { return tasks[a].period < tasks[b].period; });
+
+    vector<long long> result(tasks.size(), -1);
+    for (size_t k = 0; k < order.size(); k++) {
+        const RealTimeTask& task = tasks[order[k]];
+        long long deadline = deadlineOf(task);
+        long long r = task.wcet;
+        for (size_t j = 0; j < k; j++) r = r + tasks[order[j]].wcet;
+
+        while (r <= deadline) {
+            long long next = task.wcet;
+            for (size_t j = 0; j < k; j++) {
+                const RealTimeTask& higher = tasks[order[j]];
+                next = next + (r + higher.period - 1) / higher.period * higher.wcet;
+            }
+            if (next == r) break;
+            r = next;
+        }
+        if (r <= deadline) result[order[k]] = r;
+    }
+    return result;
+}
+
+bool rmSchedulable(const vector<RealTimeTask>& tasks) {
+    vector<long long> r = rmResponseTimes(tasks);
+    for (size_t i = 0; i < r.size(); i++) {
+        if (r[i] < 0) return false;
+    }
+    return true;
+}
+
+bool edfSchedulable(const vector<RealTimeTask>& tasks) {
+    double density = 0;
+    for (size_t i = 0; i < tasks.size(); i++) {
+        density = density + (double)tasks[i].wcet / min(deadlineOf(tasks[i]), (long long)tasks[i].period);
+    }
+    return density <= 1 + 1e-9;
+}
@@ -0,0 +1,342 @@
+#include "resource_manager.h"
+#include "snapshot.h"
+#include <algorithm>
+#include <iostream>
+#include <iomanip>
+
+using namespace std;
+
+// heap order for PRIORITY: lower priority number first, then whoever came first
+static bool waitsLonger(int priorityA, uint64_t seqA, int priorityB, uint64_t seqB) {
+    if (priorityA != priorityB) return priorityA > priorityB;
+    return seqA > seqB;
+}
+
+ResourceManager::ResourceManager(WakePolicy defaultWake) {
+    this->defaultWake = defaultWake;
+    nextSeq = 0;
+}
+
+int ResourceManager::add_resource(const string& name, WakePolicy wake, bool shared) {
+    auto it = ids.find(name);
+    int id;
+    if (it != ids.end()) {
+        id = it->second;
+    } else {
+        id = (int)resources.size();
+        resources.push_back(Resource());
+        resources[id].name = name;
+        ids[name] = id;
+    }
+    Resource& r = resources[id];
+    // waiters move over if the policy changes while some are queued
+    if (r.wake != wake) {
+        vector<Waiter> waiting;
+        while (queue_length(r) > 0) {
+            waiting.push_back(front_waiter(r));
+            pop_waiter(r);
+        }
+        r.wake = wake;
+        for (size_t i = 0; i < waiting.size(); i++) push_waiter(r, waiting[i]);
+    }
+    r.shared = shared;
+    return id;
+}
+
+void ResourceManager::set_default_policy(WakePolicy wake) {
+    defaultWake = wake;
+}
+
+ResourceManager::Resource* ResourceManager::lookup(const string& name) {
+    auto it = ids.find(name);
+    return it == ids.end() ? nullptr : &resources[it->second];
+}
+
+const ResourceManager::Resource* ResourceManager::lookup(const string& name) const {
+    auto it = ids.find(name);
+    return it == ids.end() ? nullptr : &resources[it->second];
+}
+
+size_t ResourceManager::queue_length(const Resource& r) const {
+    return r.wake == WakePolicy::PRIORITY ? r.heap.size() : r.queue.size();
+}
+
+void ResourceManager::push_waiter(Resource& r, const Waiter& w) {
+    if (r.wake != WakePolicy::PRIORITY) {
+        r.queue.push_back(w);
+        return;
+    }
+    r.heap.push_back(w);
+    push_heap(r.heap.begin(), r.heap.end(), [](const Waiter& a, const Waiter& b) {
+        return waitsLonger(a.process->priority, a.seq, b.process->priority, b.seq);
+    });
+}
+
+const ResourceManager::Waiter& ResourceManager::front_waiter(const Resource& r) const {
+    return r.wake == WakePolicy::PRIORITY ? r.heap.front() : r.queue.front();
+}
+
+void ResourceManager::pop_waiter(Resource& r) {
+    if (r.wake != WakePolicy::PRIORITY) {
+        r.queue.pop_front();
+        return;
+    }
+    pop_heap(r.heap.begin(), r.heap.end(), [](const Waiter& a, const Waiter& b) {
+        return waitsLonger(a.process->priority, a.seq, b.process->priority, b.seq);
+    });
+    r.heap.pop_back();
+}
+
+void ResourceManager::grant(Resource& r, PCB* p, AccessMode mode, long long now) {
+    if (mode == AccessMode::EXCLUSIVE) {
+        r.writer = p->pid;
+    } else {
+        r.readers = r.readers + 1;
+    }
+    r.holdSince[p->pid] = now;
+    r.stats.acquisitions = r.stats.acquisitions + 1;
+    p->has_resource = true;
+}
+
+bool ResourceManager::acquire(PCB* p, const string& name, AccessMode mode, long long now) {
+    Resource* r = lookup(name);
+    if (r == nullptr) {
+        r = &resources[add_resource(name, defaultWake)];
+    }
+    if (!r->shared) mode = AccessMode::EXCLUSIVE;
+
+    // a process woken by WAKE_ALL keeps its original wait start
+    long long since = now;
+    bool retry = false;
+    if (!r->wokenSince.empty()) {
+        auto woken = r->wokenSince.find(p->pid);
+        if (woken != r->wokenSince.end()) {
+            since = woken->second;
+            retry = true;
+            r->wokenSince.erase(woken);
+        }
+    }
+
+    // readers may join other readers, but not past a queued writer
+    bool available = r->writer == 0 && (mode == AccessMode::SHARED || r->readers == 0) && queue_length(*r) == 0;
+    if (available) {
+        grant(*r, p, mode, now);
+        if (retry) {
+            r->stats.wait_time.add((double)(now - since));
+        }
+        return true;
+    }
+
+    Waiter w;
+    w.process = p;
+    w.mode = mode;
+    w.since = since;
+    w.seq = nextSeq;
+    nextSeq = nextSeq + 1;
+    push_waiter(*r, w);
+    if (retry) {
+        r->stats.futile_wakeups = r->stats.futile_wakeups + 1;
+    } else {
+        r->stats.contended = r->stats.contended + 1;
+    }
+    r->stats.max_queue = max(r->stats.max_queue, queue_length(*r));
+    return false;
+}
+
+bool ResourceManager::release(PCB* p, const string& name, long long now, vector<PCB*>& woken) {
+    Resource* r = lookup(name);
+    if (r == nullptr) return false;
+    auto held = r->holdSince.find(p->pid);
+    if (held == r->holdSince.end()) return false;   // this process doesn't own this resource
+
+    long long hold = now - held->second;
+    r->stats.total_hold = r->stats.total_hold + hold;
+    r->stats.hold_time.add((double)hold);
+    r->holdSince.erase(held);
+    if (r->writer == p->pid) {
+        r->writer = 0;
+    } else {
+        r->readers = r->readers - 1;
+    }
+    p->has_resource = false;
+
+    if (r->writer != 0 || r->readers > 0 || queue_length(*r) == 0) return true;
+
+    if (r->wake == WakePolicy::WAKE_ALL) {
+        // everybody runs again and asks again, only one of them will win
+        while (!r->queue.empty()) {
+            const Waiter& w = r->queue.front();
+            r->wokenSince[w.process->pid] = w.since;
+            woken.push_back(w.process);
+            r->queue.pop_front();
+            r->stats.wakeups = r->stats.wakeups + 1;
+        }
+        return true;
+    }
+
+    // hand the resource over, a reader brings along the readers right behind it
+    do {
+        Waiter w = front_waiter(*r);
+        pop_waiter(*r);
+        grant(*r, w.process, w.mode, now);
+        r->stats.handoffs = r->stats.handoffs + 1;
+        r->stats.wakeups = r->stats.wakeups + 1;
+        r->stats.wait_time.add((double)(now - w.since));
+        woken.push_back(w.process);
+        if (w.mode == AccessMode::EXCLUSIVE) break;
+    } while (queue_length(*r) > 0 && front_waiter(*r).mode == AccessMode::SHARED);
+    return true;
+}
+
+int ResourceManager::holder(const string& name) const {
+    const Resource* r = lookup(name);
+    return r == nullptr ? 0 : r->writer;
+}
+
+size_t ResourceManager::waiting(const string& name) const {
+    const Resource* r = lookup(name);
+    return r == nullptr ? 0 : queue_length(*r);
+}
+
+int ResourceManager::resource_count() const {
+    return (int)resources.size();
+}
+
+const string& ResourceManager::resource_name(int id) const {
+    return resources[id].name;
+}
+
+const ResourceStats* ResourceManager::get_stats(const string& name) const {
+    const Resource* r = lookup(name);
+    return r == nullptr ? nullptr : &r->stats;
+}
+
+void ResourceManager::print_waiters() const {
+    for (size_t i = 0; i < resources.size(); i++) {
+        const Resource& r = resources[i];
+        if (queue_length(r) == 0) continue;
+        cout << "  Resource: " << r.name << " -> Processes: ";
+        if (r.wake == WakePolicy::PRIORITY) {
+            for (size_t k = 0; k < r.heap.size(); k++) cout << r.heap[k].process->pid << " ";
+        } else {
+            for (size_t k = 0; k < r.queue.size(); k++) cout << r.queue[k].process->pid << " ";
+        }
+        cout << endl;
+    }
+}
+
+void ResourceManager::print_stats() const {
+    cout << left << setw(12) << "Resource" << setw(10) << "Wake" << right
+         << setw(8) << "Grants" << setw(8) << "Waited" << setw(10) << "Handoffs" << setw(9) << "Wakeups"
+         << setw(8) << "Futile" << setw(7) << "MaxQ" << setw(10) << "Avg hold"
+         << setw(10) << "Wait p50" << setw(10) << "Wait p99" << endl;
+    cout << fixed << setprecision(1);
+    for (size_t i = 0; i < resources.size(); i++) {
+        const Resource& r = resources[i];
+        const ResourceStats& s = r.stats;
+        if (s.acquisitions == 0 && s.contended == 0) continue;
+        double avgHold = s.hold_time.count() > 0 ? (double)s.total_hold / s.hold_time.count() : 0;
+        string label = r.name + (r.shared ? " (rw)" : "");
+        cout << left << setw(12) << label << setw(10) << wakePolicyName(r.wake) << right
+             << setw(8) << s.acquisitions << setw(8) << s.contended << setw(10) << s.handoffs
+             << setw(9) << s.wakeups << setw(8) << s.futile_wakeups << setw(7) << s.max_queue
+             << setw(10) << avgHold << setw(10) << s.wait_time.quantile(0.5)
+             << setw(10) << s.wait_time.quantile(0.99) << endl;
+    }
+    cout.unsetf(ios::fixed);
+    cout << setprecision(6);
+}
+
+const char* wakePolicyName(WakePolicy wake) {
+    switch (wake) {
+        case WakePolicy::FIFO: return "FIFO";
+        case WakePolicy::PRIORITY: return "Priority";
+        case WakePolicy::WAKE_ALL: return "Wake all";
+    }
+    return "?";
+}
+
+
+static void saveStats(SnapshotWriter& out, const ResourceStats& stats) {
+    out.put(stats.acquisitions);
+    out.put(stats.contended);
+    out.put(stats.handoffs);
+    out.put(stats.wakeups);
+    out.put(stats.futile_wakeups);
+    out.put(stats.max_queue);
+    out.put(stats.total_hold);
+    stats.hold_time.save_state(out);
+    stats.wait_time.save_state(out);
+}
+
+static void loadStats(SnapshotReader& in, ResourceStats& stats) {
+    in.get(stats.acquisitions);
+    in.get(stats.contended);
+    in.get(stats.handoffs);
+    in.get(stats.wakeups);
+    in.get(stats.futile_wakeups);
+    in.get(stats.max_queue);
+    in.get(stats.total_hold);
+    stats.hold_time.load_state(in);
+    stats.wait_time.load_state(in);
+}
+
+// wait queues are written in their storage order, the heap keeps its layout
+void ResourceManager::save_state(SnapshotWriter& out) const {
+    auto saveWaiter = [&out](const Waiter& w) {
+        out.putProcess(w.process);
+        out.put(w.mode);
+        out.put(w.since);
+        out.put(w.seq);
+    };
+    out.put(defaultWake);
+    out.put(nextSeq);
+    out.put((uint64_t)resources.size());
+    for (size_t i = 0; i < resources.size(); i++) {
+        const Resource& r = resources[i];
+        out.putString(r.name);
+        out.put(r.wake);
+        out.put(r.shared);
+        out.put(r.writer);
+        out.put(r.readers);
+        out.put((uint64_t)r.queue.size());
+        for (size_t k = 0; k < r.queue.size(); k++) saveWaiter(r.queue[k]);
+        out.put((uint64_t)r.heap.size());
+        for (size_t k = 0; k < r.heap.size(); k++) saveWaiter(r.heap[k]);
+        out.putAll(r.holdSince);
+        out.putAll(r.wokenSince);
+        saveStats(out, r.stats);
+    }
+}
+
+void ResourceManager::load_state(SnapshotReader& in) {
+    auto loadWaiter = [&in]() {
+        Waiter w;
+        w.process = in.getProcess();
+        in.get(w.mode);
+        in.get(w.since);
+        in.get(w.seq);
+        return w;
+    };
+    in.get(defaultWake);
+    in.get(nextSeq);
+    resources.clear();
+    ids.clear();
+    resources.resize(in.get<uint64_t>());
+    for (size_t i = 0; i < resources.size(); i++) {
+        Resource& r = resources[i];
+        r.name = in.getString();
+        ids[r.name] = (int)i;
+        in.get(r.wake);
+        in.get(r.shared);
+        in.get(r.writer);
+        in.get(r.readers);
+        uint64_t queued = in.get<uint64_t>();
+        for (uint64_t k = 0; k < queued; k++) r.queue.push_back(loadWaiter());
+        uint64_t heaped = in.get<uint64_t>();
+        for (uint64_t k = 0; k < heaped; k++) r.heap.push_back(loadWaiter());
+        in.getMap(r.holdSince);
+        in.getMap(r.wokenSince);
+        loadStats(in, r.stats);
+    }
+}
@@ -0,0 +1,533 @@
+#include "run_config.h"
+#include "scheduler.h"
+#include "process_queues.h"
+#include "trace_loader.h"
+#include "event_trace.h"
+#include "telemetry.h"
+#include <fstream>
+#include <sstream>
+#include <iomanip>
+#include <chrono>
+#include <stdexcept>
+#include <algorithm>
+#include <cctype>
+#include <climits>
+
+using namespace std;
+
+// names of the enum values, in declaration order
+static const char* memoryModelNames[] = {"counter", "paged", "first_fit", "best_fit", "worst_fit",
+                                         "next_fit", "buddy", "slab"};
+static const char* replacementNames[] = {"fifo", "lru", "lfu", "clock", "working_set"};
+static const char* burstNames[] = {"uniform", "exponential", "pareto"};
+static const char* balanceNames[] = {"none", "push", "work_steal"};
+
+RunConfig::RunConfig() {
+    // what main.cpp always ran with
+    memory.model = MemoryModel::PAGED;
+    memory.total = 1024;
+    memory.swap_size = 4096;
+    memory.replacement = ReplacementPolicy::LRU;
+    multicore.migration_cost = 1;
+}
+
+static string trim(const string& s) {
+    size_t first = 0;
+    while (first < s.size() && isspace((unsigned char)s[first])) first = first + 1;
+    size_t last = s.size();
+    while (last > first && isspace((unsigned char)s[last - 1])) last = last - 1;
+    return s.substr(first, last - first);
+}
+
+// "Work-Steal" and "work_steal" both mean work_steal
+static string normalize(const string& s) {
+    string result = trim(s);
+    for (size_t i = 0; i < result.size(); i++) {
+        result[i] = result[i] == '-' ? '_' : (char)tolower((unsigned char)result[i]);
+    }
+    return result;
+}
+
+static long long toInteger(const string& key, const string& value) {
+    string v = trim(value);
+    size_t used = 0;
+    long long result = 0;
+    try {
+        result = stoll(v, &used);
+    } catch (const exception&) {
+        used = 0;
+    }
+    if (v.empty() || used != v.size()) {
+        throw invalid_argument(key + " needs a whole number, got '" + value + "'");
+    }
+    return result;
+}
+
+static int toInt(const string& key, const string& value) {
+    long long result = toInteger(key, value);
+    if (result < INT_MIN || result > INT_MAX) {
+        throw invalid_argument(key + " is out of range: " + value);
+    }
+    return (int)result;
+}
+
+static double toDouble(const string& key, const string& value) {
+    string v = trim(value);
+    size_t used = 0;
+    double result = 0;
+    try {
+        result = stod(v, &used);
+    } catch (const exception&) {
+        used = 0;
+    }
+    if (v.empty() || used != v.size()) {
+        throw invalid_argument(key + " needs a number, got '" + value + "'");
+    }
+    return result;
+}
+
+static bool toBool(const string& key, const string& value) {
+    string v = normalize(value);
+    if (v == "true" || v == "yes" || v == "on" || v == "1") return true;
+    if (v == "false" || v == "no" || v == "off" || v == "0") return false;
+    throw invalid_argument(key + " needs true or false, got '" + value + "'");
+}
+
+// index of value in names, the allowed names in the error otherwise
+static int toChoice(const string& key, const string& value, const char* const* names, int count) {
+    string v = normalize(value);
+    string allowed;
+    for (int i = 0; i < count; i++) {
+        if (v == names[i]) return i;
+        allowed = allowed + (i > 0 ? ", " : "") + names[i];
+    }
+    throw invalid_argument(key + " must be one of " + allowed + ", got '" + value + "'");
+}
+
+// comma separated, "none" or an empty item is a process that needs no resource
+static vector<string> toResources(const string& value) {
+    vector<string> result;
+    stringstream in(value);
+    string item;
+    while (getline(in, item, ',')) {
+        item = trim(item);
+        result.push_back(item == "none" ? "" : item);
+    }
+    if (!value.empty() && value.back() == ',') {
+        result.push_back("");
+    }
+    if (result.empty()) {
+        result.push_back("");
+    }
+    return result;
+}
+
+static vector<int> toIntList(const string& key, const string& value) {
+    vector<int> result;
+    stringstream in(value);
+    string item;
+    while (getline(in, item, ',')) {
+        result.push_back(toInt(key, item));
+    }
+    return result;
+}
+
+void setRunOption(RunConfig& config, const string& key, const string& value) {
+    const string& k = key;
+    string v = trim(value);
+    if (k == "mode") {
+        const char* modes[] = {"demo", "run"};
+        config.mode = modes[toChoice(k, v, modes, 2)];
+    } else if (k == "headless") {
+        config.headless = toBool(k, v);
+    } else if (k == "seed") {
+        config.seed = (uint64_t)toInteger(k, v);
+    } else if (k == "policy" || k == "policy.name") {
+        createPolicy(normalize(v));   // throws for an unknown name
+        config.policy = normalize(v);
+    } else if (k == "cores") {
+        config.cores = toInt(k, v);
+        if (config.cores < 1) throw invalid_argument("cores must be at least 1");
+    } else if (k == "trace") {
+        config.trace = v;
+    } else if (k == "until") {
+        config.until = toInteger(k, v);
+    } else if (k == "cycles") {
+        config.cycles = toInt(k, v);
+
+    } else if (k == "policy.quantum") {
+        config.params.quantum = toInt(k, v);
+    } else if (k == "policy.levels") {
+        config.params.mlfq_levels = toInt(k, v);
+    } else if (k == "policy.base_quantum") {
+        config.params.mlfq_base_quantum = toInt(k, v);
+    } else if (k == "policy.quanta") {
+        config.params.mlfq_quanta = toIntList(k, v);
+    } else if (k == "policy.allotment") {
+        config.params.mlfq_allotment = toInt(k, v);
+    } else if (k == "policy.boost_interval") {
+        config.params.mlfq_boost_interval = toInt(k, v);
+    } else if (k == "policy.aging_threshold") {
+        config.params.mlfq_aging_threshold = toInt(k, v);
+    } else if (k == "policy.starvation_threshold") {
+        config.params.mlfq_starvation_threshold = toInt(k, v);
+    } else if (k == "policy.latency") {
+        config.params.cfs_latency = toInt(k, v);
+    } else if (k == "policy.granularity") {
+        config.params.cfs_min_granularity = toInt(k, v);
+    } else if (k == "policy.preemptive") {
+        config.params.preemptive = toBool(k, v);
+    } else if (k == "policy.rt_background") {
+        config.params.rt_background = normalize(v);
+    } else if (k == "policy.rt_runtime") {
+        config.params.rt_runtime = toInt(k, v);
+    } else if (k == "policy.rt_period") {
+        config.params.rt_period = toInt(k, v);
+
+    } else if (k == "memory.model") {
+        config.memory.model = (MemoryModel)toChoice(k, v, memoryModelNames, 8);
+    } else if (k == "memory.total") {
+        config.memory.total = toInt(k, v);
+    } else if (k == "memory.page_size") {
+        config.memory.page_size = toInt(k, v);
+    } else if (k == "memory.swap") {
+        config.memory.swap_size = toInt(k, v);
+    } else if (k == "memory.replacement") {
+        config.memory.replacement = (ReplacementPolicy)toChoice(k, v, replacementNames, 5);
+    } else if (k == "memory.ws_window") {
+        config.memory.ws_window = toInt(k, v);
+    } else if (k == "memory.references") {
+        config.memory.references_per_dispatch = toInt(k, v);
+    } else if (k == "memory.fault_cost") {
+        config.memory.fault_cost = toInt(k, v);
+    } else if (k == "memory.compaction") {
+        config.memory.compaction = toBool(k, v);
+    } else if (k == "memory.buddy_min_block") {
+        config.memory.buddy_min_block = toInt(k, v);
+
+    } else if (k == "workload.count" || k == "processes") {
+        config.workload.count = toInteger(k, v);
+    } else if (k == "workload.arrival_rate") {
+        config.workload.arrival_rate = toDouble(k, v);
+    } else if (k == "workload.burst") {
+        config.workload.burst = (BurstDistribution)toChoice(k, v, burstNames, 3);
+    } else if (k == "workload.burst_min") {
+        config.workload.burst_min = toInt(k, v);
+    } else if (k == "workload.burst_max") {
+        config.workload.burst_max = toInt(k, v);
+    } else if (k == "workload.burst_mean") {
+        config.workload.burst_mean = toDouble(k, v);
+    } else if (k == "workload.pareto_shape") {
+        config.workload.pareto_shape = toDouble(k, v);
+    } else if (k == "workload.priority_levels") {
+        config.workload.priority_levels = toInt(k, v);
+    } else if (k == "workload.resources") {
+        config.workload.resources = toResources(v);
+    } else if (k == "workload.zipf") {
+        config.workload.zipf_s = toDouble(k, v);
+    } else if (k == "workload.small_fraction") {
+        config.workload.small_fraction = toDouble(k, v);
+    } else if (k == "workload.small_min") {
+        config.workload.small_min = toInt(k, v);
+    } else if (k == "workload.small_max") {
+        config.workload.small_max = toInt(k, v);
+    } else if (k == "workload.large_min") {
+        config.workload.large_min = toInt(k, v);
+    } else if (k == "workload.large_max") {
+        config.workload.large_max = toInt(k, v);
+    } else if (k == "workload.io_probability") {
+        config.workload.io_probability = toDouble(k, v);
+    } else if (k == "workload.io_mean") {
+        config.workload.io_mean = toDouble(k, v);
+
+    } else if (k == "multicore.balance") {
+        config.multicore.balance = (LoadBalanceMode)toChoice(k, v, balanceNames, 3);
+    } else if (k == "multicore.threads") {
+        config.multicore.threads = toInt(k, v);
+    } else if (k == "multicore.epoch") {
+        config.multicore.epoch = toInt(k, v);
+    } else if (k == "multicore.migration_cost") {
+        config.multicore.migration_cost = toInt(k, v);
+    } else if (k == "multicore.affinity") {
+        config.multicore.affinity = toBool(k, v);
+
+    } else if (k == "output.metrics") {
+        config.metrics_path = v;
+    } else if (k == "output.format") {
+        const char* formats[] = {"text", "json", "csv"};
+        config.metrics_format = formats[toChoice(k, v, formats, 3)];
+    } else if (k == "output.event_log") {
+        config.event_log = v;
+    } else if (k == "output.series") {
+        config.series_path = v;
+    } else if (k == "output.sample_interval") {
+        config.sample_interval = toInteger(k, v);
+    } else {
+        throw invalid_argument("unknown option '" + key + "'");
+    }
+}
+
+void loadRunConfig(RunConfig& config, const string& path) {
+    ifstream in(path);
+    if (!in) {
+        throw runtime_error("cannot read config file " + path);
+    }
+    string section;
+    string line;
+    long long lineNumber = 0;
+    while (getline(in, line)) {
+        lineNumber = lineNumber + 1;
+        size_t comment = line.find('#');
+        if (comment != string::npos) {
+            line = line.substr(0, comment);
+        }
+        line = trim(line);
+        if (line.empty()) continue;
+
+        string where = path + ":" + to_string(lineNumber) + ": ";
+        if (line[0] == '[') {
+            if (line.back() != ']') {
+                throw runtime_error(where + "section without closing ]");
+            }
+            section = trim(line.substr(1, line.size() - 2));
+            continue;
+        }
+        size_t equals = line.find('=');
+        if (equals == string::npos) {
+            throw runtime_error(where + "expected key = value");
+        }
+        string key = trim(line.substr(0, equals));
+        if (!section.empty()) {
+            key = section + "." + key;
+        }
+        try {
+            setRunOption(config, key, line.substr(equals + 1));
+        } catch (const invalid_argument& e) {
+            throw runtime_error(where + e.what());
+        }
+    }
+}
+
+bool parseCommandLine(RunConfig& config, int argc, char** argv) {
+    // the file first, so everything else on the command line overrides it
+    for (int i = 1; i < argc; i++) {
+        string arg = argv[i];
+        if (arg == "--config") {
+            if (i + 1 >= argc) throw invalid_argument("--config needs a file");
+            loadRunConfig(config, argv[i + 1]);
+            i = i + 1;
+        } else if (arg.compare(0, 9, "--config=") == 0) {
+            loadRunConfig(config, arg.substr(9));
+        }
+    }
+
+    for (int i = 1; i < argc; i++) {
+        string arg = argv[i];
+        if (arg == "--help" || arg == "-h") {
+            return false;
+        }
+        if (arg == "--config") {
+            i = i + 1;
+            continue;
+        }
+        if (arg.compare(0, 9, "--config=") == 0) {
+            continue;
+        }
+        if (arg == "--headless") {
+            setRunOption(config, "headless", "true");
+            continue;
+        }
+        if (arg.size() < 3 || arg.compare(0, 2, "--") != 0) {
+            throw invalid_argument("unexpected argument '" + arg + "'");
+        }
+        string key = arg.substr(2);
+        string value;
+        size_t equals = key.find('=');
+        if (equals != string::npos) {
+            value = key.substr(equals + 1);
+            key = key.substr(0, equals);
+        } else if (i + 1 < argc) {
+            value = argv[i + 1];
+            i = i + 1;
+        } else {
+            throw invalid_argument("--" + key + " needs a value");
+        }
+        setRunOption(config, key, value);
+    }
+    return true;
+}
+
+string runUsage() {
+    return "usage: os_simulator [--config file] [--headless] [--key=value | --key value ...]\n"
+           "  without options the full demo runs. --mode run (or --headless) simulates one\n"
+           "  configured workload and reports its metrics instead, --headless prints nothing else.\n"
+           "  keys, also usable as key = value lines (with [section] headers) in the config file:\n"
+           "    mode (demo, run), headless, seed, policy, cores, trace, until, cycles, processes\n"
+           "    policy.quantum, policy.levels, policy.latency, policy.granularity, policy.preemptive ...\n"
+           "    memory.model (counter, paged, first_fit, best_fit, worst_fit, next_fit, buddy, slab),\n"
+           "    memory.total, memory.swap, memory.page_size, memory.replacement (fifo, lru, lfu, clock,\n"
+           "    working_set) ...\n"
+           "    workload.count, workload.arrival_rate, workload.burst (uniform, exponential, pareto),\n"
+           "    workload.burst_min, workload.burst_max, workload.resources (disk,printer,none) ...\n"
+           "    multicore.balance (none, push, work_steal), multicore.epoch, multicore.migration_cost\n"
+           "    output.metrics (appended to), output.format (text, json, csv), output.event_log,\n"
+           "    output.series, output.sample_interval\n"
+           "  every key is listed in include/run_config.h\n";
+}
+
+RunReport runConfigured(const RunConfig& config) {
+    if (config.cores > 1 && config.until > 0) {
+        throw invalid_argument("multi-core runs always run until every process finished, until must be 0");
+    }
+    unique_ptr<SchedulingPolicy> policy = createPolicy(config.policy, config.params);
+
+    unique_ptr<TraceSource> source;
+    if (!config.trace.empty()) {
+        source = openTrace(config.trace);
+    } else {
+        WorkloadConfig workload = config.workload;
+        workload.seed = config.seed;
+        source.reset(new GeneratedTraceSource(workload));
+    }
+
+    bool tracing = false;
+    if (!config.event_log.empty()) {
+        TraceConfig traceConfig;
+        traceConfig.path = config.event_log;
+        tracing = EventTracer::start(traceConfig);
+        if (!tracing) {
+            throw runtime_error("cannot write event log " + config.event_log);
+        }
+    }
+
+    RunReport report;
+    auto start = chrono::steady_clock::now();
+    if (config.cores > 1) {
+        // every core runs round robin with policy.quantum, memory is not simulated here
+        MultiCoreConfig coreConfig = config.multicore;
+        coreConfig.cores = config.cores;
+        coreConfig.quantum = config.params.quantum;
+        MultiCoreSimulator multiCore(coreConfig);
+        TraceRecord r;
+        while (source->next(r)) {
+            PCB p;
+            traceRecordToPCB(r, &p);
+            multiCore.addProcess(p);
+            report.submitted = report.submitted + 1;
+        }
+        multiCore.run();
+        report.summary = multiCore.combinedMetrics().summary();
+        // combined busy time is over every core, the report shows the average core
+        report.summary.cpu_utilization = report.summary.cpu_utilization / config.cores;
+        report.end_time = multiCore.finishTime();
+        report.events = multiCore.totalEvents();
+        report.decisions = multiCore.totalSlices();
+    } else {
+        MetricsRegistry registry;   // outlives the scheduler that samples into it
+        MemoryManager memory(config.memory);
+        ProcessQueues queues;
+        Scheduler scheduler(&memory, &queues);
+        scheduler.setVerbose(!config.headless);
+        scheduler.setPolicy(move(policy));
+        if (!config.series_path.empty()) {
+            TelemetryConfig telemetryConfig;
+            telemetryConfig.sample_interval = config.sample_interval;
+            telemetryConfig.series_path = config.series_path;
+            scheduler.enableTelemetry(&registry, telemetryConfig);
+        }
+
+        TraceReplayer replayer(&scheduler, &memory);
+        replayer.setEndTime(config.until);
+        ReplayResult replayed = replayer.replay(*source);
+        report.summary = replayed.summary;
+        report.submitted = replayed.submitted;
+        report.rejected = replayed.rejected;
+        report.end_time = scheduler.getCurrentTime();
+        report.events = scheduler.getEventsHandled();
+        report.decisions = scheduler.getDecisions();
+        report.page_faults = memory.get_virtual_memory() ? memory.get_virtual_memory()->totals().faults : 0;
+    }
+    report.wall_seconds = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+
+    if (tracing) {
+        EventTracer::stop();
+    }
+    return report;
+}
+
+void writeRunReport(ostream& out, const RunConfig& config, const RunReport& report, bool header) {
+    const MetricsSummary& s = report.summary;
+    string workload = config.trace.empty() ? "generated" : config.trace;
+    string policy = config.cores > 1 ? "rr" : config.policy;
+    string memory = config.cores > 1 ? "none" : memoryModelNames[(int)config.memory.model];
+
+    if (config.metrics_format == "json") {
+        // the trace path is the only free text, quotes and backslashes in it are escaped
+        string escaped;
+        for (size_t i = 0; i < workload.size(); i++) {
+            if (workload[i] == '"' || workload[i] == '\\') escaped.push_back('\\');
+            escaped.push_back(workload[i]);
+        }
+        out << "{\"policy\":\"" << policy << "\",\"quantum\":" << config.params.quantum
+            << ",\"cores\":" << config.cores << ",\"memory\":\"" << memory << "\",\"memory_total\":" << config.memory.total
+            << ",\"workload\":\"" << escaped << "\",\"seed\":" << config.seed
+            << ",\"submitted\":" << report.submitted << ",\"rejected\":" << report.rejected
+            << ",\"completed\":" << s.completed << ",\"end_time\":" << report.end_time
+            << ",\"mean_turnaround\":" << s.mean_turnaround << ",\"p99_turnaround\":" << s.p99_turnaround
+            << ",\"mean_waiting\":" << s.mean_waiting << ",\"p99_waiting\":" << s.p99_waiting
+            << ",\"mean_response\":" << s.mean_response << ",\"p99_response\":" << s.p99_response
+            << ",\"throughput\":" << s.throughput << ",\"cpu_utilization\":" << s.cpu_utilization
+            << ",\"context_switches\":" << s.context_switches << ",\"page_faults\":" << report.page_faults
+            << ",\"deadline_misses\":" << s.deadline_misses << ",\"events\":" << report.events
+            << ",\"decisions\":" << report.decisions << ",\"wall_seconds\":" << report.wall_seconds << "}" << endl;
+        return;
+    }
+
+    if (config.metrics_format == "csv") {
+        if (header) {
+            out << "policy,quantum,cores,memory,memory_total,workload,seed,submitted,rejected,completed,end_time,"
+                   "mean_turnaround,p99_turnaround,mean_waiting,p99_waiting,mean_response,p99_response,"
+                   "throughput,cpu_utilization,context_switches,page_faults,deadline_misses,events,decisions,"
+                   "wall_seconds" << endl;
+        }
+        // a trace path with a comma or a quote in it is quoted
+        if (workload.find_first_of(",\"") != string::npos) {
+            string quoted = "\"";
+            for (size_t i = 0; i < workload.size(); i++) {
+                if (workload[i] == '"') quoted.push_back('"');
+                quoted.push_back(workload[i]);
+            }
+            workload = quoted + "\"";
+        }
+        out << policy << "," << config.params.quantum << "," << config.cores << "," << memory << ","
+            << config.memory.total << "," << workload << "," << config.seed << "," << report.submitted << ","
+            << report.rejected << "," << s.completed << "," << report.end_time << "," << s.mean_turnaround << ","
+            << s.p99_turnaround << "," << s.mean_waiting << "," << s.p99_waiting << "," << s.mean_response << ","
+            << s.p99_response << "," << s.throughput << "," << s.cpu_utilization << "," << s.context_switches << ","
+            << report.page_faults << "," << s.deadline_misses << "," << report.events << "," << report.decisions << ","
+            << report.wall_seconds << endl;
+        return;
+    }
+
+    out << endl << "[Run: " << policy << ", " << config.cores << (config.cores > 1 ? " cores" : " core")
+        << ", " << memory << " memory, " << workload << " workload]" << endl;
+    out << fixed << setprecision(2);
+    out << "Processes: " << report.submitted << " submitted, " << report.rejected << " rejected, "
+        << s.completed << " completed by t=" << report.end_time << endl;
+    out << "Turnaround Time: mean " << s.mean_turnaround << "  p50 " << s.p50_turnaround
+        << "  p95 " << s.p95_turnaround << "  p99 " << s.p99_turnaround << endl;
+    out << "Waiting Time:    mean " << s.mean_waiting << "  p50 " << s.p50_waiting
+        << "  p95 " << s.p95_waiting << "  p99 " << s.p99_waiting << endl;
+    out << "Response Time:   mean " << s.mean_response << "  p50 " << s.p50_response
+        << "  p95 " << s.p95_response << "  p99 " << s.p99_response << endl;
+    out << "Throughput: " << setprecision(4) << s.throughput << " processes/tick" << endl;
+    out << "CPU Utilization: " << setprecision(2) << s.cpu_utilization * 100 << "%" << endl;
+    out << "Context Switches: " << s.context_switches << ", page faults " << report.page_faults << endl;
+    if (s.rt_jobs > 0) {
+        out << "Real-time Jobs: " << s.rt_jobs << ", deadline misses " << s.deadline_misses
+            << " (" << s.miss_ratio * 100 << "%)" << endl;
+    }
+    out << "Simulated in " << setprecision(3) << report.wall_seconds << " s (" << report.events << " events)" << endl;
+    out.unsetf(ios::fixed);
+    out << setprecision(6);
+}
@@ -1,6 +1,13 @@
 #include "scheduler.h"
+#include "event_trace.h"
+#include "snapshot.h"
+#include "workload_generator.h"
+#include "process_table.h"
+#include "cgroup.h"
+#include "deadlock.h"
 #include <algorithm>
 #include <iomanip>
+#include <climits>
 
 using namespace std;
 
@@ -10,6 +17,7 @@ Scheduler::Scheduler(MemoryManager* mm, ProcessQueues* pq) {
     // Store the pointers for later use
     memoryManager = mm;
     processQueues = pq;
+    resources = &pq->get_resources();
     runningProcess = nullptr;  // no process running initially - shows the initial state of cpu 
     
     // performance calculating variables
@@ -17,15 +25,40 @@ Scheduler::Scheduler(MemoryManager* mm, ProcessQueues* pq) {
     total_waiting_time = 0;
     total_processes_terminated = 0;
     simulation_time = 0;
+    lastRunPid = 0;
+    eventsHandled = 0;
+    decisions = 0;
+
+    // event engine starts with nothing scheduled
+    sliceStart = 0;
+    sliceToken = 0;
+    verbose = true;
+
+    processPool = nullptr;
+    nextPid = 1;
+    cgroups = nullptr;
+    multiResources = nullptr;
+
+    // default policy keeps the old behaviour: preemptive priority scheduling
+    policy = createPolicy("priority");
 }
 
 
 
 // Function to add processes to ready queue
 void Scheduler::addToReadyQueue(PCB* p) {
+    if (p->state == ProcessState::NEW) {
+        metrics.record_arrival(p);  // first time this process shows up
+        TRACE_EVENT(TraceLevel::LIFECYCLE, TraceEventKind::ARRIVAL, simulation_time, p->pid, p->burst_time, 0);
+        if (telemetry) telemetry->arrivals->add();
+    }
     p->state = ProcessState::READY;  // mark process as ready
-    readyQueue.push(p);
-    cout << "[Ready] Process " << p->pid << " added to Ready Queue" << endl;
+    p->ready_time = simulation_time;
+    policy->enqueue(p, simulation_time);
+    TRACE_EVENT(TraceLevel::DETAIL, TraceEventKind::READY, simulation_time, p->pid, p->priority, 0);
+    if (verbose) {
+        cout << "[Ready] Process " << p->pid << " added to Ready Queue\n";
+    }
 }
 
 
@@ -34,189 +67,521 @@ void Scheduler::addToReadyQueue(PCB* p) {
 void Scheduler::scheduleNextProcess() {
     // if there's already a process running, put it back in queue
     if (runningProcess != nullptr) {
-        cout << "[Context Switch] Process " << runningProcess->pid << " put back to Ready Queue" << endl;
-        addToReadyQueue(runningProcess);
+        if (verbose) {
+            cout << "[Context Switch] Process " << runningProcess->pid << " put back to Ready Queue\n";
+        }
+        TRACE_EVENT(TraceLevel::SCHEDULING, TraceEventKind::PREEMPT, simulation_time, runningProcess->pid, 0, 0);
+        PCB* previous = runningProcess;
+        stopRunning();
+        addToReadyQueue(previous);
     }
 
-    // check if we have any processes waiting to run
-    if (!readyQueue.empty()) {
-        // get the process with highest priority (lowest number = higher priority)
-        runningProcess = readyQueue.top();
-        readyQueue.pop();
-        runningProcess->state = ProcessState::RUNNING;
-        cout << "[Scheduler] Running PID: " << runningProcess->pid << endl;
-    } else {
-        // no processes to run, CPU is idle
-        runningProcess = nullptr;
-        cout << "[Scheduler] No process to schedule. CPU Idle." << endl;
-    }
+    dispatch();
 }
 
 // function to request a resource for a process
 // if resource is free, give it to process, otherwise block the process
 void Scheduler::requestResource(PCB* p, const string& resourceName) {
-    if (resourceTable[resourceName] == 0) {
-        // resource is free, allocate it
-        resourceTable[resourceName] = p->pid;
-        p->has_resource = true;
-        cout << "[Resource] Allocated " << resourceName << " to PID: " << p->pid << endl;
+    AccessMode mode = p->shared_access ? AccessMode::SHARED : AccessMode::EXCLUSIVE;
+    if (resources->acquire(p, resourceName, mode, simulation_time)) {
+        // resource was free, it is allocated now
+        TRACE_EVENT(TraceLevel::DETAIL, TraceEventKind::RESOURCE_ACQUIRE, simulation_time, p->pid, 0, 0);
+        if (verbose) {
+            cout << "[Resource] Allocated " << resourceName << " to PID: " << p->pid << "\n";
+        }
     } else {
-        // resource is busy, block the process
-        cout << "[Resource] PID: " << p->pid << " blocked on " << resourceName << endl;
+        // resource is busy, the process waits in the resource's queue
+        // arg = pid holding the resource (0 when readers hold it)
+        TRACE_EVENT(TraceLevel::SCHEDULING, TraceEventKind::BLOCK, simulation_time, p->pid, resources->holder(resourceName), 0);
+        if (verbose) {
+            cout << "[Resource] PID: " << p->pid << " blocked on " << resourceName << "\n";
+        }
         p->state = ProcessState::BLOCKED;
-        blockedQueues[resourceName].push(p);
-        runningProcess = nullptr;  // process is not running anymore
+        if (runningProcess == p) {
+            stopRunning();  // process is not running anymore
+        }
     }
 }
 
 // when a process releases a resource
-// check if any other process was waiting for it
+// the resource manager decides who was waiting for it and gets to run
 void Scheduler::releaseResource(PCB* p, const string& resourceName) {
-    if (resourceTable[resourceName] != p->pid) return;  // this process doesn't own this resource
-
-    cout << "[Resource] PID: " << p->pid << " released " << resourceName << endl;
-    resourceTable[resourceName] = 0;  // mark resource as free
-
-    // check if any process was waiting for this resource
-    if (!blockedQueues[resourceName].empty()) {
-        PCB* nextProc = blockedQueues[resourceName].front();
-        blockedQueues[resourceName].pop();
-        nextProc->state = ProcessState::READY;
-        nextProc->has_resource = true;
-        resourceTable[resourceName] = nextProc->pid;
+    woken.clear();
+    if (!resources->release(p, resourceName, simulation_time, woken)) return;  // this process doesn't own this resource
+
+    TRACE_EVENT(TraceLevel::DETAIL, TraceEventKind::RESOURCE_RELEASE, simulation_time, p->pid, 0, 0);
+    if (verbose) {
+        cout << "[Resource] PID: " << p->pid << " released " << resourceName << "\n";
+    }
+
+    // handed over processes already own it, with wake all they have to ask again
+    for (size_t i = 0; i < woken.size(); i++) {
+        PCB* nextProc = woken[i];
         addToReadyQueue(nextProc);
-        cout << "[Unblock] PID: " << nextProc->pid << " unblocked from " << resourceName << endl;
+        // arg = pid that released the resource
+        TRACE_EVENT(TraceLevel::SCHEDULING, TraceEventKind::UNBLOCK, simulation_time, nextProc->pid, p->pid, 0);
+        if (verbose) {
+            cout << "[Unblock] PID: " << nextProc->pid << " unblocked from " << resourceName << "\n";
+        }
+    }
+}
+
+// next missing type of the claim. true once the process holds all of it and may run,
+// false when it is off the CPU again: back in the ready structure to ask for the next type
+// (so it holds what it has while it waits, like a real hold and wait), blocked, or killed
+bool Scheduler::acquireMultiResources(PCB* p) {
+    if (p->resource_alloc.empty()) {
+        multiResources->addProcess(p->pid, p->resource_claim);
+        p->resource_alloc.assign(multiResources->resourceCount(), 0);
+        multiHolders[p->pid] = p;
+    }
+    int types = (int)p->resource_claim.size();
+    int next = -1;
+    int missing = 0;
+    for (int i = 0; i < types && next < 0; i++) {
+        int r = i < (int)p->resource_order.size() ? p->resource_order[i] : i;
+        if (r >= 0 && r < types && p->resource_claim[r] > p->resource_alloc[r]) {
+            next = r;
+            missing = p->resource_claim[r] - p->resource_alloc[r];
+        }
+    }
+    if (next < 0) return true;   // holds everything
+
+    RequestResult result = multiResources->request(p->pid, next, missing);
+    if (result == RequestResult::DENIED) {
+        throw runtime_error("request of PID " + to_string(p->pid) + " for resource type " + to_string(next) + " denied");
+    }
+    if (result == RequestResult::GRANTED) {
+        p->resource_alloc[next] = p->resource_claim[next];
+        TRACE_EVENT(TraceLevel::DETAIL, TraceEventKind::RESOURCE_ACQUIRE, simulation_time, p->pid, next, 0);
+        if (verbose) {
+            cout << "[Resource] Allocated " << missing << " of type " << next << " to PID: " << p->pid << "\n";
+        }
+        stopRunning();
+        addToReadyQueue(p);
+        return false;
+    }
+
+    TRACE_EVENT(TraceLevel::SCHEDULING, TraceEventKind::BLOCK, simulation_time, p->pid, 0, 0);
+    if (verbose) {
+        cout << "[Resource] PID: " << p->pid << " waits for " << missing << " of type " << next << "\n";
+    }
+    p->state = ProcessState::BLOCKED;
+    stopRunning();
+
+    // detect: this wait closed a cycle. the victims give back what they hold right away and
+    // exit the next time they are dispatched
+    vector<int> victims = multiResources->takeVictims();
+    for (size_t i = 0; i < victims.size(); i++) {
+        auto found = multiHolders.find(victims[i]);
+        if (found == multiHolders.end()) continue;
+        PCB* victim = found->second;
+        if (verbose) {
+            cout << "[Deadlock] PID: " << victim->pid << " killed to break a deadlock\n";
+        }
+        releaseMultiResources(victim);
+        killProcess(victim);
+        if (victim->state == ProcessState::BLOCKED) {
+            addToReadyQueue(victim);
+        }
+    }
+    return false;
+}
+
+// everything p holds goes back, processes whose waiting request that grants become ready
+void Scheduler::releaseMultiResources(PCB* p) {
+    if (multiResources == nullptr || p->resource_alloc.empty()) return;
+    vector<int> granted = multiResources->removeProcess(p->pid);
+    p->resource_alloc.clear();
+    multiHolders.erase(p->pid);
+    TRACE_EVENT(TraceLevel::DETAIL, TraceEventKind::RESOURCE_RELEASE, simulation_time, p->pid, 0, 0);
+    if (verbose) {
+        cout << "[Resource] PID: " << p->pid << " released its resource claim\n";
+    }
+
+    for (size_t i = 0; i < granted.size(); i++) {
+        PCB* waiter = multiHolders[granted[i]];
+        for (size_t r = 0; r < waiter->resource_alloc.size(); r++) {
+            waiter->resource_alloc[r] = multiResources->allocated(waiter->pid, (int)r);
+        }
+        addToReadyQueue(waiter);
+        TRACE_EVENT(TraceLevel::SCHEDULING, TraceEventKind::UNBLOCK, simulation_time, waiter->pid, p->pid, 0);
+        if (verbose) {
+            cout << "[Unblock] PID: " << waiter->pid << " got the resources it waited for\n";
+        }
     }
 }
 
 // function to terminate a process
 // clean up memory and resources before killing it
 void Scheduler::terminateProcess(PCB* p) {
-    cout << "[Terminate] PID: " << p->pid << " terminated." << endl;
+    TRACE_EVENT(TraceLevel::LIFECYCLE, TraceEventKind::TERMINATE, simulation_time, p->pid, 0, 0);
+    if (verbose) {
+        cout << "[Terminate] PID: " << p->pid << " terminated.\n";
+    }
+    if (runningProcess == p) {
+        stopRunning();  // CPU becomes free
+    }
     p->state = ProcessState::TERMINATED;
-    memoryManager->deallocate(p->memory_required);
-    releaseResource(p, p->required_resource);
-    runningProcess = nullptr;  // CPU becomes free
-}
+    p->remaining_time = 0;
+    memoryManager->release_process(p->pid, p->memory_required);
+
+    // fill in completion, turnaround and waiting time
+    // a real-time task ends with its last job, which is counted like the ones before
+    if (p->period > 0) {
+        metrics.record_job(p, simulation_time);
+        recordJobTelemetry(p);
+    } else {
+        metrics.record_completion(p, simulation_time);
+        if (telemetry) telemetry->completions->add();
+        total_turnaround_time = total_turnaround_time + p->turnaround_time;
+        total_waiting_time = total_waiting_time + p->waiting_time;
+        total_processes_terminated = total_processes_terminated + 1;
+    }
+    if (cgroups != nullptr) {
+        cgroups->recordCompletion(p, simulation_time);
+    }
 
-// main CPU simulation loop
-// this runs for specified number of cycles
+    // the resource goes back at the same instant, after this termination is handled
+    if (p->has_resource || !p->resource_alloc.empty()) {
+        events.push(simulation_time, EventType::RESOURCE_RELEASE, p);
+    }
+}
 
+// main CPU simulation
+// advances the simulated clock by the given number of ticks, but only
+// does work when an event (arrival, completion, quantum expiry...) happens
 void Scheduler::simulateCPU(int cycles) { // performs the preemptive priority scheduling
+    runUntil(simulation_time + cycles);
+}
 
+// put a process into the system, it shows up at its arrival time
+void Scheduler::submitProcess(PCB* p) {
+    if (multiResources != nullptr) {
+        if ((int)p->resource_claim.size() > multiResources->resourceCount()) {
+            throw invalid_argument("PID " + to_string(p->pid) + " claims more resource types than there are");
+        }
+        for (size_t r = 0; r < p->resource_claim.size(); r++) {
+            if (p->resource_claim[r] > multiResources->totalInstances((int)r)) {
+                throw invalid_argument("PID " + to_string(p->pid) + " claims more instances of type " + to_string(r) + " than exist");
+            }
+        }
+    }
+    p->state = ProcessState::NEW;
+    if (p->pid >= nextPid) {
+        nextPid = p->pid + 1;   // forked children never reuse a pid
+    }
+    if (p->remaining_time <= 0) {
+        p->remaining_time = p->burst_time;
+    }
+    if (!p->phases.empty() && p->phase_remaining <= 0) {
+        p->phase_index = 0;
+        p->phase_remaining = p->phases[0];
+    }
+    long long when = p->arrival_time;
+    if (when < simulation_time) {
+        when = simulation_time;  // cant arrive in the past
+    }
+    if (p->period > 0) {
+        p->release_time = when;   // first job is released on arrival
+        p->deadline = when + (p->relative_deadline > 0 ? p->relative_deadline : p->period);
+    }
+    events.push(when, EventType::ARRIVAL, p);
+}
 
-    for (int i = 0; i < cycles; i++) {  // using traditional for loop style
-        cout << endl << "[Cycle] " << i + 1 << "/" << cycles << endl;
+// run all events up to endTime, then move the clock to endTime
+void Scheduler::runUntil(long long endTime) {
+    processEvents(endTime);
+    if (endTime > simulation_time) {
+        simulation_time = endTime;
+    }
+}
 
-        // if no process is running or current process stopped, schedule next one
-        if (runningProcess == nullptr || runningProcess->state != ProcessState::RUNNING) {
-            scheduleNextProcess();
+// run until nothing is left to do, clock stays at the last event
+void Scheduler::runToCompletion() {
+    processEvents(LLONG_MAX);
+    if (telemetry) {
+        sampleTelemetry(true);   // final state, always exported
+    }
+}
+
+// main event loop - pop events in time order and handle them
+void Scheduler::processEvents(long long endTime) {
+    // processes put directly into the ready queue still need the CPU
+    if (runningProcess == nullptr) {
+        dispatch();
+    }
+
+    while (!events.empty() && events.top().time <= endTime) {
+        Event e = events.pop();
+        simulation_time = e.time;  // jump straight to the event
+        eventsHandled = eventsHandled + 1;
+        if (telemetry && simulation_time >= telemetry->nextSample) {
+            sampleTelemetry();
         }
 
-        // if we have a running process, do some work
-        if (runningProcess != nullptr) {
-            // check if process needs resource but doesnt have it
-            if (!runningProcess->has_resource && !runningProcess->required_resource.empty()) {
-                requestResource(runningProcess, runningProcess->required_resource);
-                if (runningProcess == nullptr) continue;  // process got blocked
-            }
+        switch (e.type) {
+            case EventType::ARRIVAL:
+                handleArrival(e.process);
+                break;
+            case EventType::BURST_COMPLETE:
+                handleBurstComplete(e);
+                break;
+            case EventType::QUANTUM_EXPIRE:
+                handleQuantumExpire(e);
+                break;
+            case EventType::RESOURCE_RELEASE:
+                handleResourceRelease(e.process);
+                break;
+            case EventType::IO_COMPLETE:
+                handleIOComplete(e.process);
+                break;
+            case EventType::DEVICE_COMPLETE:
+                handleDeviceComplete(e);
+                break;
+            case EventType::RELEASE:
+                handleArrival(e.process);   // a new job competes like a new process
+                break;
+            case EventType::TIMER:
+                if (runningProcess == nullptr) {
+                    dispatch();
+                }
+                break;
+        }
+    }
+}
 
-            // simulate some random action - terminate, release resource, or continue
-            int action = rand() % 3;
-            if (action == 0) {
-                terminateProcess(runningProcess);
-            } else if (action == 1) {
-                releaseResource(runningProcess, runningProcess->required_resource);
-                scheduleNextProcess();
-            } else {
-                cout << "[Execute] PID: " << runningProcess->pid << " continues execution." << endl;
-            }
+// new process came in
+void Scheduler::handleArrival(PCB* p) {
+    addToReadyQueue(p);
+
+    if (runningProcess == nullptr) {
+        dispatch();
+    } else if (policy->shouldPreempt(runningProcess, (int)(simulation_time - sliceStart), p)) {
+        // policy says the newcomer should get the CPU right away
+        scheduleNextProcess();
+    }
+}
+
+// running process finished its CPU burst, it either starts its next I/O phase or is done
+void Scheduler::handleBurstComplete(const Event& e) {
+    if (e.token != sliceToken || e.process != runningProcess) return;  // stale event
+
+    PCB* p = e.process;
+    if (p->phase_index + 1 < (int)p->phases.size()) {
+        stopRunning();
+        startIO(p);
+    } else if (p->period > 0 && p->jobs_left > 1) {
+        stopRunning();
+        finishJob(p);
+    } else if (p->fork_children > 0 || (p->wait_children && p->first_child != nullptr)) {
+        runProgram(p);
+    } else if (p->family_slot >= 0 || p->pooled) {
+        exitNow(p);   // has a parent to tell, children to hand over or a PCB to give back
+    } else {
+        terminateProcess(p);
+    }
+    dispatch();
+}
+
+// a real-time job is done, the task sleeps until its next release. releases stay on the
+// period grid: a job that finished late lets the next one start right away, with the
+// deadline it would have had anyway. sporadic tasks add a random gap to the period
+void Scheduler::finishJob(PCB* p) {
+    metrics.record_job(p, simulation_time);
+    recordJobTelemetry(p);
+    if (verbose) {
+        cout << "[Real-time] PID: " << p->pid << " job done at t=" << simulation_time
+             << ", deadline " << p->deadline << "\n";
+    }
+
+    long long next = p->release_time + p->period;
+    if (p->sporadic_gap > 0) {
+        uint32_t counter[4] = {(uint32_t)p->jobs_left, 0, 0, 0};
+        uint32_t key[2] = {(uint32_t)p->pid, 0x53504f52};
+        uint32_t random[4];
+        Philox4x32::generate(counter, key, random);
+        next = next + random[0] % (uint32_t)(p->sporadic_gap + 1);
+    }
+    p->jobs_left = p->jobs_left - 1;
+    p->release_time = next;
+    p->deadline = next + (p->relative_deadline > 0 ? p->relative_deadline : p->period);
+    p->remaining_time = p->burst_time;
+    p->state = ProcessState::BLOCKED;
+    events.push(max(next, simulation_time), EventType::RELEASE, p);
+}
+
+// process leaves the CPU for its next I/O phase, it comes back when the I/O is done
+void Scheduler::startIO(PCB* p) {
+    int io = p->phases[p->phase_index + 1];
+    p->phase_index = p->phase_index + 2;
+    p->phase_remaining = p->phase_index < (int)p->phases.size() ? p->phases[p->phase_index] : 0;
+    p->state = ProcessState::BLOCKED;
+    TRACE_EVENT(TraceLevel::SCHEDULING, TraceEventKind::IO_START, simulation_time, p->pid, io, 0);
+
+    // requests for a device wait in its queue, the phase length is the request size
+    for (size_t i = 0; i < devices.size() && !p->io_device.empty(); i++) {
+        if (devices[i]->getName() != p->io_device) continue;
+        if (verbose) {
+            cout << "[I/O] PID: " << p->pid << " sent " << io << " blocks to " << p->io_device << "\n";
         }
+        IoRequest r;
+        r.process = p;
+        r.issued = simulation_time;
+        r.block = p->io_block >= 0 ? p->io_block : devices[i]->homeBlock(p->pid);
+        r.blocks = io;
+        p->io_block = r.block + io;   // next request continues where this one ends
+        devices[i]->submit(r);
+        startDevice(i);
+        return;
+    }
+
+    if (verbose) {
+        cout << "[I/O] PID: " << p->pid << " doing I/O for " << io << " ticks\n";
+    }
+    events.push(simulation_time + io, EventType::IO_COMPLETE, p);
+}
+
+// an idle device with queued requests starts on its next batch
+void Scheduler::startDevice(size_t index) {
+    long long done = devices[index]->start(simulation_time);
+    if (done >= 0) {
+        events.push(done, EventType::DEVICE_COMPLETE, nullptr, (long long)index);
+    }
+}
+
+// a device finished a batch, every process in it gets its own completion event
+void Scheduler::handleDeviceComplete(const Event& e) {
+    size_t index = (size_t)e.token;
+    ioDone.clear();
+    devices[index]->complete(simulation_time, ioDone);
+    for (size_t i = 0; i < ioDone.size(); i++) {
+        // time in the device queue is I/O time as well, not waiting for the CPU
+        PCB* p = ioDone[i].process;
+        p->io_time = p->io_time + (int)(simulation_time - ioDone[i].issued) - ioDone[i].blocks;
+        events.push(simulation_time, EventType::IO_COMPLETE, p);
+    }
+    startDevice(index);
+}
+
+// running process used up its quantum, send it to the back
+void Scheduler::handleQuantumExpire(const Event& e) {
+    if (e.token != sliceToken || e.process != runningProcess) return;  // stale event
+
+    PCB* p = runningProcess;
+    TRACE_EVENT(TraceLevel::SCHEDULING, TraceEventKind::QUANTUM_EXPIRE, simulation_time, p->pid, 0, 0);
+    if (verbose) {
+        cout << "[Quantum] PID: " << p->pid << " time slice expired\n";
+    }
+    stopRunning(true);
+    addToReadyQueue(p);
+    dispatch();
+}
+
+// deferred resource release after termination
+void Scheduler::handleResourceRelease(PCB* p) {
+    releaseResource(p, p->required_resource);
+    releaseMultiResources(p);
+    if (runningProcess == nullptr) {
+        dispatch();
+    }
+}
+
+// I/O finished, process can compete for the CPU again
+void Scheduler::handleIOComplete(PCB* p) {
+    TRACE_EVENT(TraceLevel::SCHEDULING, TraceEventKind::IO_COMPLETE, simulation_time, p->pid, 0, 0);
+    addToReadyQueue(p);
+    if (runningProcess == nullptr) {
+        dispatch();
+    }
+}
+
+// take the running process off the CPU and charge it for the time it used
+void Scheduler::stopRunning(bool sliceExpired) {
+    if (runningProcess == nullptr) return;
+
+    int used = (int)(simulation_time - sliceStart);
+    if (used < 0) {
+        used = 0;  // taken off the CPU while still waiting for a page fault
+    }
+    metrics.record_busy(used);
+    policy->onDescheduled(runningProcess, used, sliceExpired);
+    runningProcess->remaining_time = runningProcess->remaining_time - used;
+    if (runningProcess->remaining_time < 0) {
+        runningProcess->remaining_time = 0;
+    }
+    if (!runningProcess->phases.empty()) {
+        runningProcess->phase_remaining = max(0, runningProcess->phase_remaining - used);
     }
+    runningProcess = nullptr;
+    sliceToken = sliceToken + 1;  // pending completion event is now stale
+}
+
+// FCFS scheduling - processes run in the order they became ready
+void Scheduler::runFIFOScheduling() {
+    cout << endl << "[FCFS Scheduling]" << endl;
+    setPolicy(createPolicy("fcfs"));
+    runToCompletion();
 }
 
 // Priority scheduling algorithm
 // runs processes based on their priority value (lower number = higher priority)
 void Scheduler::runPriorityScheduling() {
-    vector<PCB*> processes;
-    // make a copy of the queue so we don't mess up the original
-    priority_queue<PCB*, vector<PCB*>, CompareProcessPriority> tempQueue = readyQueue;
-    while (!readyQueue.empty()) {
-        processes.push_back(readyQueue.top());
-        readyQueue.pop();
-    }
-    
     cout << endl << "[Priority Scheduling]" << endl;
-    int i;
-    for (i = 0; i < processes.size(); i++) {  // traditional for loop
-        PCB* p = processes[i];
-        cout << "[Run] PID: " << p->pid << " Priority: " << p->priority << endl;
-    }
+    PolicyParams params;
+    params.preemptive = false;
+    setPolicy(createPolicy("priority", params));
+    runToCompletion();
 }
 
 // Shortest Job First scheduling
-// runs the process with smallest memory requirement first
+// runs the process with the smallest remaining CPU time first
 void Scheduler::runSJFScheduling() {
-    vector<PCB*> processes;
-    // copy all processes from priority queue
-    priority_queue<PCB*, vector<PCB*>, CompareProcessPriority> tempQueue = readyQueue;
-    while (!tempQueue.empty()) {
-        processes.push_back(tempQueue.top());
-        tempQueue.pop();
-    }
-    
-    // sort by memory requirement (using it as job size) using standard sort function
-    sort(processes.begin(), processes.end(), [](PCB* a, PCB* b) {
-        return a->memory_required < b->memory_required;
-    });
-
     cout << endl << "[Shortest Job First Scheduling]" << endl;
-    for (int i = 0; i < processes.size(); i++) {
-        PCB* p = processes[i];
-        cout << "[Run] PID: " << p->pid << " Memory Req: " << p->memory_required << endl;
-    }
+    setPolicy(createPolicy("sjf"));
+    runToCompletion();
 }
 
 // Round Robin scheduling - give each process equal time
 // time quantum determines how long each process gets to run
 void Scheduler::runRoundRobinScheduling(int timeQuantum) {
-    vector<PCB*> processes;
-    // copy processes from priority queue to a regular vector
-    priority_queue<PCB*, vector<PCB*>, CompareProcessPriority> tempQueue = readyQueue;
-
-    while (!tempQueue.empty()) {
-        processes.push_back(tempQueue.top());
-        tempQueue.pop();
-    }
-    
-    // create a simple queue for round robin
-    queue<PCB*> rrQueue;
-    for (int i = 0; i < processes.size(); i++) {
-        rrQueue.push(processes[i]);
-    }
-    
     cout << endl << "[Round Robin Scheduling] (Time Quantum: " << timeQuantum << ")" << endl;
-    int cycle = 0;
-    while (!rrQueue.empty()) {
-        PCB* current = rrQueue.front();
-        rrQueue.pop();
-        cycle = cycle + 1;  // simple increment
-        cout << "[Cycle " << cycle << "] Running PID: " << current->pid << endl;
-        rrQueue.push(current);  // put back at end of queue
-        if (cycle > processes.size() * 2) {
-            break;  // stop infinite loop for demo purposes
-        }
-    }
+    PolicyParams params;
+    params.quantum = timeQuantum;
+    setPolicy(createPolicy("rr", params));
+    runToCompletion();
+}
+
+// Multilevel feedback queue - CPU bound processes sink to longer, lower priority levels
+void Scheduler::runMLFQScheduling(int levels) {
+    cout << endl << "[MLFQ Scheduling] (Levels: " << levels << ")" << endl;
+    PolicyParams params;
+    params.mlfq_levels = levels;
+    setPolicy(createPolicy("mlfq", params));
+    runToCompletion();
+}
+
+// CFS style fair share - every process gets CPU in proportion to its weight
+void Scheduler::runFairShareScheduling() {
+    cout << endl << "[Fair Share Scheduling]" << endl;
+    setPolicy(createPolicy("cfs"));
+    runToCompletion();
 }
 
 // Performance evaluation function
-// TODO: need to implement proper metrics calculation
+// prints the numbers collected while the simulation was running
 void Scheduler::evaluatePerformance(const string& algorithm) {
-    cout << endl << "[Evaluation: " << algorithm << "]" << endl;
-    cout << "(Metrics simulation not fully implemented yet)" << endl;
-    cout << "Turnaround Time: Will calculate later" << endl;
-    cout << "Waiting Time: Will calculate later" << endl;
-    cout << "CPU Utilization: Will calculate later" << endl;
+    metrics.print(algorithm);
+    if (resources->resource_count() > 0) {
+        cout << "Resource contention:" << endl;
+        resources->print_stats();
+    }
+    if (multiResources != nullptr) {
+        const DeadlockStats& s = multiResources->stats();
+        cout << "Multi-type resources (" << deadlockModeName(multiResources->getMode()) << "): "
+             << s.grants << " grants, " << s.waits << " waits, " << s.unsafe_delays << " unsafe delays, "
+             << s.deadlocks << " deadlocks" << endl;
+    }
 }
 
 // Simple wrapper function to add process
@@ -230,11 +595,644 @@ void Scheduler::runSimulation() {
 }
 
 // Helper function for dispatching
+// gives the CPU to the best ready process and schedules the end of its slice
 void Scheduler::dispatch() {
-    scheduleNextProcess();
+    while (!policy->empty()) {
+        // ask the policy which process goes next
+        PCB* p = policy->pickNext(simulation_time);
+        decisions = decisions + 1;
+        if (p == nullptr) break;   // everything ready is held back for now
+        runningProcess = p;
+        p->state = ProcessState::RUNNING;
+        sliceStart = simulation_time;
+
+        // killed while it was waiting for the CPU, it exits instead of running
+        if (p->exit_pending) {
+            exitNow(p);
+            continue;
+        }
+
+        // check if process needs resource but doesnt have it
+        // (a parent coming back from wait() has no CPU work left and doesnt need it)
+        if (!p->has_resource && !p->required_resource.empty() && p->remaining_time > 0) {
+            requestResource(p, p->required_resource);
+            if (runningProcess == nullptr) continue;  // process got blocked, try next one
+        }
+
+        // multi-type resources, it runs once it holds its whole claim
+        if (multiResources != nullptr && !p->resource_claim.empty() && p->remaining_time > 0) {
+            if (!acquireMultiResources(p)) continue;
+        }
+
+        // response time and context switch accounting
+        metrics.record_dispatch(p, simulation_time);
+        if (lastRunPid != 0 && lastRunPid != p->pid) {
+            metrics.record_context_switch();
+            if (telemetry) telemetry->contextSwitches->add();
+        }
+        lastRunPid = p->pid;
+
+        // pages the process touches may fault, it stalls while they are loaded
+        int faults = memoryManager->access_memory(p->pid, simulation_time);
+        long long stall = (long long)faults * memoryManager->get_fault_cost();
+        if (telemetry) {
+            telemetry->dispatches->add();
+            telemetry->dispatchLatency->record(simulation_time - p->ready_time);
+            if (faults > 0) telemetry->pageFaults->add(faults);
+        }
+        sliceStart = simulation_time + stall;
+
+        // figure out when this process gives up the CPU
+        sliceToken = sliceToken + 1;
+        int slice = p->remaining_time;
+        if (!p->phases.empty() && p->phase_remaining < slice) {
+            slice = p->phase_remaining;  // CPU phase ends in an I/O request
+        }
+        EventType kind = EventType::BURST_COMPLETE;
+        int quantum = policy->timeSlice(p);
+        if (quantum > 0 && quantum < slice) {
+            slice = quantum;
+            kind = EventType::QUANTUM_EXPIRE;
+        }
+        events.push(sliceStart + slice, kind, p, sliceToken);
+
+        // arg = page faults taken on the way in
+        TRACE_EVENT(TraceLevel::SCHEDULING, TraceEventKind::DISPATCH, simulation_time, p->pid, faults, 0);
+        if (verbose) {
+            cout << "[Scheduler] t=" << simulation_time << " Running PID: " << p->pid << "\n";
+        }
+        return;
+    }
+
+    // no processes to run, CPU is idle. a policy holding some back says when to look again
+    runningProcess = nullptr;
+    long long held = policy->heldUntil();
+    if (held > simulation_time) {
+        events.push(held, EventType::TIMER, nullptr);
+    }
+    TRACE_EVENT(TraceLevel::SCHEDULING, TraceEventKind::IDLE, simulation_time, 0, 0, 0);
+    if (verbose) {
+        cout << "[Scheduler] t=" << simulation_time << " No process to schedule. CPU Idle.\n";
+    }
 }
 
 // Helper function for termination
 void Scheduler::handleTermination(PCB* p) {
     terminateProcess(p);
-}
\ No newline at end of file
+}
+
+// switch to another policy, processes already waiting move over to the new ready structure
+void Scheduler::setPolicy(unique_ptr<SchedulingPolicy> newPolicy) {
+    if (!newPolicy) {
+        throw invalid_argument("setPolicy needs a policy, not nullptr");
+    }
+    while (!policy->empty()) {
+        PCB* p = policy->pickNext(simulation_time);
+        if (p == nullptr) {
+            throw runtime_error(policy->name() + " holds processes back, it can not be switched now");
+        }
+        newPolicy->enqueue(p, simulation_time);
+    }
+    policy = move(newPolicy);
+}
+
+const SchedulingPolicy& Scheduler::getPolicy() const {
+    return *policy;
+}
+
+void Scheduler::setVerbose(bool enabled) {
+    verbose = enabled;
+}
+
+long long Scheduler::getCurrentTime() const {
+    return simulation_time;
+}
+
+const MetricsCollector& Scheduler::getMetrics() const {
+    return metrics;
+}
+
+const ResourceManager& Scheduler::getResources() const {
+    return *resources;
+}
+
+uint64_t Scheduler::getEventsHandled() const {
+    return eventsHandled;
+}
+
+uint64_t Scheduler::getDecisions() const {
+    return decisions;
+}
+
+const MemoryManager& Scheduler::getMemoryManager() const {
+    return *memoryManager;
+}
+
+const ProcessQueues& Scheduler::getProcessQueues() const {
+    return *processQueues;
+}
+
+void Scheduler::saveState(SnapshotWriter& out) const {
+    policy->saveState(out);
+    out.putProcess(runningProcess);
+    events.save_state(out);
+    out.put(sliceStart);
+    out.put(sliceToken);
+    out.put(verbose);
+    out.put(total_turnaround_time);
+    out.put(total_waiting_time);
+    out.put(total_processes_terminated);
+    out.put(simulation_time);
+    out.put(lastRunPid);
+    out.put(eventsHandled);
+    out.put(decisions);
+    metrics.save_state(out);
+    out.put((uint64_t)devices.size());
+    for (size_t i = 0; i < devices.size(); i++) {
+        devices[i]->saveState(out);
+    }
+
+    // tree links are pointers, they are written here where PCBs can be referenced
+    out.put(nextPid);
+    out.put(lifecycle);
+    out.put((uint64_t)family.size());
+    for (size_t i = 0; i < family.size(); i++) {
+        const PCB* p = family[i];
+        out.putProcess(p);
+        out.putProcess(p->parent);
+        out.putProcess(p->first_child);
+        out.putProcess(p->next_sibling);
+        out.putProcess(p->prev_sibling);
+    }
+}
+
+void Scheduler::loadState(SnapshotReader& in) {
+    policy = loadPolicy(in);
+    runningProcess = in.getProcess();
+    events.load_state(in);
+    in.get(sliceStart);
+    in.get(sliceToken);
+    in.get(verbose);
+    in.get(total_turnaround_time);
+    in.get(total_waiting_time);
+    in.get(total_processes_terminated);
+    in.get(simulation_time);
+    in.get(lastRunPid);
+    in.get(eventsHandled);
+    in.get(decisions);
+    metrics.load_state(in);
+    devices.clear();
+    uint64_t n = in.get<uint64_t>();
+    for (uint64_t i = 0; i < n; i++) {
+        devices.push_back(loadDevice(in));
+    }
+
+    in.get(nextPid);
+    in.get(lifecycle);
+    family.clear();
+    uint64_t members = in.get<uint64_t>();
+    for (uint64_t i = 0; i < members; i++) {
+        PCB* p = in.getProcess();
+        p->parent = in.getProcess();
+        p->first_child = in.getProcess();
+        p->next_sibling = in.getProcess();
+        p->prev_sibling = in.getProcess();
+        p->family_slot = (int)family.size();
+        family.push_back(p);
+    }
+}
+
+void Scheduler::addDevice(unique_ptr<IODevice> device) {
+    devices.push_back(move(device));
+}
+
+IODevice* Scheduler::getDevice(const string& name) const {
+    for (size_t i = 0; i < devices.size(); i++) {
+        if (devices[i]->getName() == name) return devices[i].get();
+    }
+    return nullptr;
+}
+
+void Scheduler::printDeviceStats() const {
+    cout << left << setw(28) << "Device" << right << setw(9) << "Requests" << setw(8) << "Merged"
+         << setw(10) << "Services" << setw(9) << "Batched" << setw(7) << "MaxQ" << setw(8) << "Util%"
+         << setw(10) << "Seek cyl" << setw(10) << "Resp p50" << setw(10) << "Resp p99" << endl;
+    cout << fixed << setprecision(1);
+    long long elapsed = max(1LL, simulation_time);
+    for (size_t i = 0; i < devices.size(); i++) {
+        const IoDeviceStats& s = devices[i]->getStats();
+        cout << left << setw(28) << devices[i]->describe() << right << setw(9) << s.requests
+             << setw(8) << s.merged << setw(10) << s.services << setw(9) << s.batched
+             << setw(7) << s.max_queue << setw(8) << 100.0 * s.busy_time / elapsed
+             << setw(10) << s.seek_distance << setw(10) << s.response.quantile(0.5)
+             << setw(10) << s.response.quantile(0.99) << endl;
+    }
+    cout.unsetf(ios::fixed);
+    cout << setprecision(6);
+}
+
+// ---------------- telemetry ----------------
+
+void Scheduler::enableTelemetry(MetricsRegistry* registry, const TelemetryConfig& config) {
+    if (registry == nullptr) {
+        telemetry.reset();
+        return;
+    }
+    unique_ptr<TelemetryHooks> t(new TelemetryHooks());
+    t->registry = registry;
+    t->config = config;
+    if (t->config.sample_interval < 1) t->config.sample_interval = 1;
+    t->labels = config.instance.empty() ? "" : MetricsRegistry::label("instance", config.instance);
+    if (!config.series_path.empty()) {
+        t->series.reset(new ofstream(config.series_path));
+        if (!*t->series) {
+            throw runtime_error("cannot write telemetry series " + config.series_path);
+        }
+    }
+
+    const string& l = t->labels;
+    t->arrivals = &registry->counter("ossim_arrivals_total", "Processes that entered the system", l);
+    t->dispatches = &registry->counter("ossim_dispatches_total", "Processes given the CPU", l);
+    t->contextSwitches = &registry->counter("ossim_context_switches_total", "CPU switches between different processes", l);
+    t->completions = &registry->counter("ossim_completions_total", "Best effort processes finished", l);
+    t->jobs = &registry->counter("ossim_rt_jobs_total", "Real-time jobs finished", l);
+    t->deadlineMisses = &registry->counter("ossim_deadline_misses_total", "Real-time jobs finished after their deadline", l);
+    t->pageFaults = &registry->counter("ossim_page_faults_total", "Page faults taken when dispatching", l);
+    t->events = &registry->counter("ossim_events_total", "Simulation events handled", l);
+    t->dispatchLatency = &registry->histogram("ossim_dispatch_latency_ticks", "Simulated ticks from ready to running", l);
+    t->readyLength = &registry->gauge("ossim_ready_queue_length", "Processes in the ready structure", l);
+    t->running = &registry->gauge("ossim_cpu_busy", "1 while a process has the CPU", l);
+    t->memoryUsed = &registry->gauge("ossim_memory_used", "Memory committed to processes", l);
+    t->clock = &registry->gauge("ossim_simulated_time_ticks", "Simulated clock", l);
+    t->eventsSeen = eventsHandled;
+    t->nextSample = simulation_time;
+    t->samples = 0;
+    t->lastExport = chrono::steady_clock::now();
+    telemetry = move(t);
+}
+
+uint64_t Scheduler::getTelemetrySamples() const {
+    return telemetry ? telemetry->samples : 0;
+}
+
+void Scheduler::recordJobTelemetry(const PCB* p) {
+    if (!telemetry) return;
+    telemetry->jobs->add();
+    if (p->completion_time > p->deadline) telemetry->deadlineMisses->add();
+}
+
+// refresh the sampled gauges, then feed the time series and the export file. this runs
+// once per sample interval, so it may look at every resource
+void Scheduler::sampleTelemetry(bool final) {
+    TelemetryHooks& t = *telemetry;
+    t.readyLength->set((int64_t)policy->size());
+    t.running->set(runningProcess != nullptr ? 1 : 0);
+    t.memoryUsed->set(memoryManager->get_used_memory());
+    t.clock->set(simulation_time);
+    t.events->add(eventsHandled - t.eventsSeen);
+    t.eventsSeen = eventsHandled;
+
+    // resources show up while the simulation runs, each gets its own labelled gauge
+    while ((int)t.blocked.size() < resources->resource_count()) {
+        string labels = MetricsRegistry::label("resource", resources->resource_name((int)t.blocked.size()));
+        if (!t.labels.empty()) labels = t.labels + "," + labels;
+        t.blocked.push_back(&t.registry->gauge("ossim_resource_blocked", "Processes waiting for a resource", labels));
+    }
+    for (size_t i = 0; i < t.blocked.size(); i++) {
+        t.blocked[i]->set((int64_t)resources->waiting(resources->resource_name((int)i)));
+    }
+
+    t.samples = t.samples + 1;
+    t.nextSample = (simulation_time / t.config.sample_interval + 1) * t.config.sample_interval;
+    if (t.series) {
+        t.registry->writePrometheus(*t.series, simulation_time);
+    }
+    if (!t.config.export_path.empty()) {
+        chrono::steady_clock::time_point now = chrono::steady_clock::now();
+        if (final || t.samples == 1 || now - t.lastExport >= chrono::milliseconds(t.config.export_interval_ms)) {
+            t.registry->writeFile(t.config.export_path);
+            t.lastExport = now;
+        }
+    }
+}
+
+// ---------------- process lifecycle ----------------
+
+void Scheduler::setMultiResources(MultiResourceManager* manager) {
+    multiResources = manager;
+}
+
+void Scheduler::setProcessPool(PCBPool* pool) {
+    processPool = pool;
+}
+
+void Scheduler::setControlGroups(ControlGroups* groups) {
+    cgroups = groups;
+    memoryManager->set_control_groups(groups);
+    if (groups != nullptr) {
+        groups->setOomHandler([this](PCB* victim) { return killProcess(victim) > 0; });
+    }
+}
+
+const LifecycleStats& Scheduler::getLifecycleStats() const {
+    return lifecycle;
+}
+
+PCB* Scheduler::forkProcess(PCB* parent) {
+    return spawnProcess(parent, *parent);
+}
+
+// the child gets the program of image (what it runs and needs), everything about its own
+// life starts fresh: new pid, arrives now, holds nothing yet
+PCB* Scheduler::spawnProcess(PCB* parent, const PCB& image) {
+    if (processPool == nullptr) {
+        throw runtime_error("forking needs a process pool, see Scheduler::setProcessPool");
+    }
+    int pid = nextPid;
+    int group = parent != nullptr ? parent->cgroup : image.cgroup;
+    PCB* child = nullptr;
+    if (cgroups != nullptr) {
+        // memory is charged to the group of the pid, so the child joins it first
+        child = processPool->acquire();
+        child->pid = pid;
+        cgroups->attach(child, group);
+    }
+    if (!memoryManager->allocate_process(pid, image.memory_required)) {
+        if (child != nullptr) {
+            cgroups->detach(pid);
+            processPool->release(child);
+        }
+        lifecycle.fork_failures = lifecycle.fork_failures + 1;
+        if (verbose) {
+            cout << "[Fork] No memory for a child of PID: " << (parent != nullptr ? parent->pid : 0) << "\n";
+        }
+        return nullptr;
+    }
+    nextPid = nextPid + 1;
+
+    if (child == nullptr) {
+        child = processPool->acquire();
+    }
+    child->pid = pid;
+    child->cgroup = group;
+    child->priority = image.priority;
+    child->required_resource = image.required_resource;
+    child->has_resource = false;
+    child->shared_access = image.shared_access;
+    child->resource_claim = image.resource_claim;
+    child->resource_order = image.resource_order;
+    child->resource_alloc.clear();
+    child->memory_required = image.memory_required;
+    child->arrival_time = simulation_time;
+    child->burst_time = image.burst_time;
+    child->remaining_time = image.burst_time;
+    child->phases = image.phases;
+    child->io_device = image.io_device;
+    child->period = image.period;
+    child->relative_deadline = image.relative_deadline;
+    child->wcet = image.wcet;
+    child->jobs_left = image.jobs_left;
+    child->sporadic_gap = image.sporadic_gap;
+    child->exit_code = image.exit_code;
+    child->fork_children = image.fork_children;
+    child->fork_depth = image.fork_depth;
+    child->wait_children = image.wait_children;
+    child->pooled = true;
+
+    if (parent != nullptr) {
+        joinFamily(parent);
+        joinFamily(child);
+        linkChild(parent, child, false);
+    }
+    lifecycle.forks = lifecycle.forks + 1;
+    TRACE_EVENT(TraceLevel::LIFECYCLE, TraceEventKind::FORK, simulation_time, pid, parent != nullptr ? parent->pid : 0, 0);
+    if (verbose) {
+        cout << "[Fork] PID: " << (parent != nullptr ? parent->pid : 0) << " created PID: " << pid << "\n";
+    }
+    submitProcess(child);
+    return child;
+}
+
+// end of the last burst of a process with a fork program: fork the children once, then
+// reap them like a loop around wait(). every reap makes it ready again for a zero length
+// burst, the way a shell comes back from wait() before it waits for the next child
+void Scheduler::runProgram(PCB* p) {
+    stopRunning();
+    if (p->has_resource) {
+        releaseResource(p, p->required_resource);   // children may need it, the parent is done with it
+    }
+    releaseMultiResources(p);
+    if (p->fork_children > 0) {
+        int n = p->fork_children;
+        int depth = p->fork_depth;
+        p->fork_children = 0;
+        for (int i = 0; i < n; i++) {
+            PCB* child = forkProcess(p);
+            if (child == nullptr) break;   // out of memory, it waits for the ones it got
+            child->fork_children = depth > 0 ? n : 0;
+            child->fork_depth = depth > 0 ? depth - 1 : 0;
+        }
+    }
+    if (p->wait_children) {
+        int reaped = waitProcess(p, -1);
+        if (reaped > 0) {
+            addToReadyQueue(p);   // a child had exited already, back for the next wait()
+            return;
+        }
+        if (reaped == 0) return;  // blocked until one exits
+    }
+    exitNow(p);
+}
+
+void Scheduler::exitProcess(PCB* p, int code) {
+    if (p->state == ProcessState::TERMINATED || p->state == ProcessState::ZOMBIE) return;
+    p->exit_code = code;
+    if (runningProcess == p || p->wait_pid != 0) {
+        exitNow(p);
+    } else {
+        // it sits in a ready structure, a resource queue or an event, it exits when it runs
+        p->exit_pending = true;
+    }
+}
+
+// p leaves the system: resource and memory go back, its children go to init and p waits
+// as a zombie for its parent (init reaps right away)
+void Scheduler::exitNow(PCB* p) {
+    p->exit_pending = false;
+    p->wait_pid = 0;
+    if (p->has_resource) {
+        releaseResource(p, p->required_resource);   // now and not deferred, the PCB may be reused
+    }
+    releaseMultiResources(p);
+    terminateProcess(p);
+    lifecycle.exits = lifecycle.exits + 1;
+    if (verbose) {
+        cout << "[Exit] PID: " << p->pid << " exited with code " << p->exit_code << "\n";
+    }
+
+    // orphans go to init, the ones that already exited are reaped on the way
+    while (p->first_child != nullptr) {
+        PCB* child = p->first_child;
+        unlinkChild(child);
+        lifecycle.orphans = lifecycle.orphans + 1;
+        if (child->state == ProcessState::ZOMBIE) {
+            reap(child);
+        }
+    }
+
+    PCB* parent = p->parent;
+    if (parent == nullptr) {
+        reap(p);
+        return;
+    }
+    p->state = ProcessState::ZOMBIE;
+    lifecycle.zombies = lifecycle.zombies + 1;
+    lifecycle.peak_zombies = max(lifecycle.peak_zombies, lifecycle.zombies);
+    unlinkChild(p);
+    linkChild(parent, p, true);   // zombies first
+    if (parent->wait_pid == -1 || parent->wait_pid == p->pid) {
+        wakeWaiter(parent, p);
+    }
+}
+
+int Scheduler::waitProcess(PCB* parent, int pid) {
+    if (parent->state == ProcessState::READY) {
+        throw runtime_error("only a process that is not in the ready structure can wait");
+    }
+    PCB* found = nullptr;
+    for (PCB* c = parent->first_child; c != nullptr; c = c->next_sibling) {
+        if (pid == -1 || c->pid == pid) {
+            found = c;
+            break;   // with -1 the first child is a zombie if any child is
+        }
+    }
+    if (found == nullptr) return -1;
+    if (found->state == ProcessState::ZOMBIE) {
+        int reaped = found->pid;
+        parent->child_status = found->exit_code;
+        if (verbose) {
+            cout << "[Wait] PID: " << parent->pid << " reaped PID: " << reaped << " (code " << found->exit_code << ")\n";
+        }
+        reap(found);
+        return reaped;
+    }
+
+    parent->wait_pid = pid;
+    if (runningProcess == parent) {
+        stopRunning();
+    }
+    parent->state = ProcessState::BLOCKED;
+    // arg = pid it waits for (-1 = any child)
+    TRACE_EVENT(TraceLevel::SCHEDULING, TraceEventKind::BLOCK, simulation_time, parent->pid, pid, 0);
+    if (verbose) {
+        cout << "[Wait] PID: " << parent->pid << " waiting for " << (pid == -1 ? string("any child") : "PID: " + to_string(pid)) << "\n";
+    }
+    return 0;
+}
+
+// the parent was blocked in wait() for this child: it gets the code and is ready again
+void Scheduler::wakeWaiter(PCB* parent, PCB* child) {
+    parent->wait_pid = 0;
+    parent->child_status = child->exit_code;
+    if (verbose) {
+        cout << "[Wait] PID: " << parent->pid << " reaped PID: " << child->pid << " (code " << child->exit_code << ")\n";
+    }
+    reap(child);
+    addToReadyQueue(parent);
+    TRACE_EVENT(TraceLevel::SCHEDULING, TraceEventKind::UNBLOCK, simulation_time, parent->pid, 0, 0);
+}
+
+// the subtree is collected first and killed deepest first, so children die before their
+// parents and nothing is orphaned on the way
+int Scheduler::killProcess(PCB* p, bool cascade) {
+    vector<PCB*> victims(1, p);
+    for (size_t i = 0; cascade && i < victims.size(); i++) {
+        for (PCB* c = victims[i]->first_child; c != nullptr; c = c->next_sibling) {
+            if (c->state != ProcessState::ZOMBIE) victims.push_back(c);
+        }
+    }
+    int killed = 0;
+    for (size_t i = victims.size(); i > 0; i--) {
+        PCB* v = victims[i - 1];
+        if (v->state == ProcessState::TERMINATED || v->state == ProcessState::ZOMBIE || v->exit_pending) continue;
+        exitProcess(v, EXIT_KILLED);
+        killed = killed + 1;
+    }
+    lifecycle.kills = lifecycle.kills + killed;
+    return killed;
+}
+
+// exit code collected, the PCB goes back to the pool
+void Scheduler::reap(PCB* p) {
+    TRACE_EVENT(TraceLevel::LIFECYCLE, TraceEventKind::REAP, simulation_time, p->pid, p->exit_code, 0);
+    if (p->state == ProcessState::ZOMBIE) {
+        lifecycle.zombies = lifecycle.zombies - 1;
+    }
+    p->state = ProcessState::TERMINATED;
+    unlinkChild(p);
+    leaveFamily(p);
+    lifecycle.reaped = lifecycle.reaped + 1;
+    if (p->pooled && processPool != nullptr) {
+        processPool->release(p);
+    }
+}
+
+void Scheduler::joinFamily(PCB* p) {
+    if (p->family_slot >= 0) return;
+    p->family_slot = (int)family.size();
+    family.push_back(p);
+}
+
+void Scheduler::leaveFamily(PCB* p) {
+    if (p->family_slot < 0) return;
+    PCB* last = family.back();
+    family[p->family_slot] = last;
+    last->family_slot = p->family_slot;
+    family.pop_back();
+    p->family_slot = -1;
+}
+
+// children form a list where first_child->prev_sibling is the last child, so a child can
+// go to either end in O(1)
+void Scheduler::linkChild(PCB* parent, PCB* child, bool front) {
+    child->parent = parent;
+    PCB* head = parent->first_child;
+    if (head == nullptr) {
+        child->prev_sibling = child;
+        child->next_sibling = nullptr;
+        parent->first_child = child;
+    } else if (front) {
+        child->next_sibling = head;
+        child->prev_sibling = head->prev_sibling;
+        head->prev_sibling = child;
+        parent->first_child = child;
+    } else {
+        PCB* tail = head->prev_sibling;
+        tail->next_sibling = child;
+        child->prev_sibling = tail;
+        child->next_sibling = nullptr;
+        head->prev_sibling = child;
+    }
+}
+
+void Scheduler::unlinkChild(PCB* child) {
+    PCB* parent = child->parent;
+    if (parent == nullptr) return;
+    PCB* head = parent->first_child;
+    if (child == head) {
+        parent->first_child = child->next_sibling;
+        if (child->next_sibling != nullptr) {
+            child->next_sibling->prev_sibling = child->prev_sibling;
+        }
+    } else {
+        child->prev_sibling->next_sibling = child->next_sibling;
+        if (child->next_sibling != nullptr) {
+            child->next_sibling->prev_sibling = child->prev_sibling;
+        } else {
+            head->prev_sibling = child->prev_sibling;   // it was the last one
+        }
+    }
+    child->parent = nullptr;
+    child->next_sibling = nullptr;
+    child->prev_sibling = nullptr;
+}
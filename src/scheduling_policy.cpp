@@ -0,0 +1,802 @@
+#include "scheduling_policy.h"
+#include "event_trace.h"
+#include "snapshot.h"
+#include <algorithm>
+#include <climits>
+#include <stdexcept>
+
+using namespace std;
+
+// ---------------- snapshots ----------------
+
+void SchedulingPolicy::saveState(SnapshotWriter& out) const {
+    throw runtime_error("the " + name() + " policy cannot be snapshotted");
+}
+
+void SchedulingPolicy::loadState(SnapshotReader& in) {
+    throw runtime_error("the " + name() + " policy cannot be restored from a snapshot");
+}
+
+static void saveRing(SnapshotWriter& out, const RingBuffer<PCB*>& ring) {
+    out.put((uint64_t)ring.size());
+    for (size_t i = 0; i < ring.size(); i++) out.putProcess(ring.at(i));
+}
+
+static void loadRing(SnapshotReader& in, RingBuffer<PCB*>& ring) {
+    uint64_t n = in.get<uint64_t>();
+    for (uint64_t i = 0; i < n; i++) ring.push_back(in.getProcess());
+}
+
+static void saveEntry(SnapshotWriter& out, const HeapEntry& e) {
+    out.put(e.key);
+    out.put(e.seq);
+    out.putProcess(e.process);
+}
+
+static HeapEntry loadEntry(SnapshotReader& in) {
+    HeapEntry e;
+    in.get(e.key);
+    in.get(e.seq);
+    e.process = in.getProcess();
+    return e;
+}
+
+// entries come out in pop order, (key, seq) is unique so pushing them back gives the same order
+static void saveHeap(SnapshotWriter& out, priority_queue<HeapEntry, vector<HeapEntry>, CompareHeapEntry> heap) {
+    out.put((uint64_t)heap.size());
+    while (!heap.empty()) {
+        saveEntry(out, heap.top());
+        heap.pop();
+    }
+}
+
+static void loadHeap(SnapshotReader& in, priority_queue<HeapEntry, vector<HeapEntry>, CompareHeapEntry>& heap) {
+    uint64_t n = in.get<uint64_t>();
+    for (uint64_t i = 0; i < n; i++) heap.push(loadEntry(in));
+}
+
+// ---------------- FCFS ----------------
+
+void FCFSPolicy::enqueue(PCB* p, long long now) {
+    queue.push_back(p);
+}
+
+PCB* FCFSPolicy::pickNext(long long now) {
+    if (queue.empty()) return nullptr;
+    return queue.pop_front();
+}
+
+bool FCFSPolicy::empty() const {
+    return queue.empty();
+}
+
+size_t FCFSPolicy::size() const {
+    return queue.size();
+}
+
+string FCFSPolicy::name() const {
+    return "FCFS";
+}
+
+void FCFSPolicy::saveState(SnapshotWriter& out) const {
+    out.putString("fcfs");
+    saveRing(out, queue);
+}
+
+void FCFSPolicy::loadState(SnapshotReader& in) {
+    loadRing(in, queue);
+}
+
+// ---------------- Priority ----------------
+
+PriorityPolicy::PriorityPolicy(bool preemptive) {
+    this->preemptive = preemptive;
+    next_seq = 0;
+}
+
+// lower priority number comes out first
+void PriorityPolicy::enqueue(PCB* p, long long now) {
+    HeapEntry e;
+    e.key = p->priority;
+    e.seq = next_seq;
+    e.process = p;
+    next_seq = next_seq + 1;
+    heap.push(e);
+}
+
+PCB* PriorityPolicy::pickNext(long long now) {
+    if (heap.empty()) return nullptr;
+    PCB* p = heap.top().process;
+    heap.pop();
+    return p;
+}
+
+bool PriorityPolicy::empty() const {
+    return heap.empty();
+}
+
+size_t PriorityPolicy::size() const {
+    return heap.size();
+}
+
+bool PriorityPolicy::shouldPreempt(const PCB* running, int ranSoFar, const PCB* candidate) const {
+    return preemptive && candidate->priority < running->priority;
+}
+
+string PriorityPolicy::name() const {
+    return preemptive ? "Preemptive Priority" : "Priority";
+}
+
+void PriorityPolicy::saveState(SnapshotWriter& out) const {
+    out.putString("priority");
+    out.put(preemptive);
+    out.put(next_seq);
+    saveHeap(out, heap);
+}
+
+void PriorityPolicy::loadState(SnapshotReader& in) {
+    in.get(preemptive);
+    in.get(next_seq);
+    loadHeap(in, heap);
+}
+
+// ---------------- SJF / SRTF ----------------
+
+SJFPolicy::SJFPolicy(bool preemptive) {
+    this->preemptive = preemptive;
+    next_seq = 0;
+}
+
+// shortest remaining time comes out first
+void SJFPolicy::enqueue(PCB* p, long long now) {
+    HeapEntry e;
+    e.key = p->remaining_time;
+    e.seq = next_seq;
+    e.process = p;
+    next_seq = next_seq + 1;
+    heap.push(e);
+}
+
+PCB* SJFPolicy::pickNext(long long now) {
+    if (heap.empty()) return nullptr;
+    PCB* p = heap.top().process;
+    heap.pop();
+    return p;
+}
+
+bool SJFPolicy::empty() const {
+    return heap.empty();
+}
+
+size_t SJFPolicy::size() const {
+    return heap.size();
+}
+
+// SRTF: preempt when the newcomer needs less than what the running one has left
+bool SJFPolicy::shouldPreempt(const PCB* running, int ranSoFar, const PCB* candidate) const {
+    if (!preemptive) return false;
+    return candidate->remaining_time < running->remaining_time - ranSoFar;
+}
+
+string SJFPolicy::name() const {
+    return preemptive ? "SRTF" : "SJF";
+}
+
+void SJFPolicy::saveState(SnapshotWriter& out) const {
+    out.putString("sjf");
+    out.put(preemptive);
+    out.put(next_seq);
+    saveHeap(out, heap);
+}
+
+void SJFPolicy::loadState(SnapshotReader& in) {
+    in.get(preemptive);
+    in.get(next_seq);
+    loadHeap(in, heap);
+}
+
+// ---------------- Round Robin ----------------
+
+RoundRobinPolicy::RoundRobinPolicy(int quantum) {
+    this->quantum = quantum > 0 ? quantum : 1;
+}
+
+void RoundRobinPolicy::enqueue(PCB* p, long long now) {
+    queue.push_back(p);
+}
+
+PCB* RoundRobinPolicy::pickNext(long long now) {
+    if (queue.empty()) return nullptr;
+    return queue.pop_front();
+}
+
+bool RoundRobinPolicy::empty() const {
+    return queue.empty();
+}
+
+size_t RoundRobinPolicy::size() const {
+    return queue.size();
+}
+
+int RoundRobinPolicy::timeSlice(const PCB* p) const {
+    return quantum;
+}
+
+string RoundRobinPolicy::name() const {
+    return "Round Robin (q=" + to_string(quantum) + ")";
+}
+
+void RoundRobinPolicy::saveState(SnapshotWriter& out) const {
+    out.putString("rr");
+    out.put(quantum);
+    saveRing(out, queue);
+}
+
+void RoundRobinPolicy::loadState(SnapshotReader& in) {
+    in.get(quantum);
+    loadRing(in, queue);
+}
+
+// ---------------- MLFQ ----------------
+
+MLFQPolicy::MLFQPolicy(const PolicyParams& params) {
+    int numLevels = params.mlfq_levels;
+    if (numLevels < 1) numLevels = 1;
+    if (numLevels > 64) numLevels = 64;  // one bit per level
+    levels.resize(numLevels);
+
+    // quantum doubles at every lower level unless given per level
+    int baseQuantum = params.mlfq_base_quantum > 0 ? params.mlfq_base_quantum : 1;
+    for (int i = 0; i < numLevels; i++) {
+        int quantum = baseQuantum << min(i, 20);
+        if (i < (int)params.mlfq_quanta.size() && params.mlfq_quanta[i] > 0) {
+            quantum = params.mlfq_quanta[i];
+        }
+        quanta.push_back(quantum);
+    }
+
+    nonEmpty = 0;
+    boosted = 0;
+    count = 0;
+    allotment = max(0, params.mlfq_allotment);
+    boostInterval = max(0, params.mlfq_boost_interval);
+    nextBoost = boostInterval;
+    boostEpoch = 0;
+    agingThreshold = max(0, params.mlfq_aging_threshold);
+    starvationThreshold = max(0, params.mlfq_starvation_threshold);
+    boosts = 0;
+    promotions = 0;
+    alarms = 0;
+}
+
+void MLFQPolicy::push(int level, PCB* p, long long now) {
+    MLFQEntry e;
+    e.process = p;
+    e.since = now;
+    e.epoch = boostEpoch;
+    levels[level].push_back(e);
+    nonEmpty = nonEmpty | (1ULL << level);
+}
+
+// keep the bits of a level in sync after its front changed
+void MLFQPolicy::updateLevelBits(int level) {
+    if (levels[level].empty()) {
+        nonEmpty = nonEmpty & ~(1ULL << level);
+        boosted = boosted & ~(1ULL << level);
+    } else if (levels[level].front().epoch == boostEpoch) {
+        boosted = boosted & ~(1ULL << level);
+    }
+}
+
+// boosts, aging and starvation alarms, everything here only touches queue fronts
+void MLFQPolicy::maintain(long long now) {
+    if (boostInterval > 0 && now >= nextBoost) {
+        boostEpoch = boostEpoch + 1;
+        boosts = boosts + 1;
+        boosted = nonEmpty & ~1ULL;
+        nextBoost = nextBoost + ((now - nextBoost) / boostInterval + 1) * boostInterval;
+        size_t below = count - (levels[0].size());
+        TRACE_EVENT(TraceLevel::SCHEDULING, TraceEventKind::PRIORITY_BOOST, now, 0, below, 0);
+    }
+
+    // waited too long on a level -> one level up, the front of a FIFO waited the longest
+    if (agingThreshold > 0) {
+        uint64_t candidates = nonEmpty & ~boosted & ~1ULL;
+        while (candidates != 0) {
+            int level = __builtin_ctzll(candidates);
+            candidates = candidates & (candidates - 1);
+            while (!levels[level].empty() && levels[level].front().epoch == boostEpoch
+                   && now - levels[level].front().since >= agingThreshold) {
+                PCB* p = levels[level].pop_front().process;
+                p->queue_level = level - 1;
+                p->level_time = 0;
+                push(level - 1, p, now);
+                promotions = promotions + 1;
+            }
+            updateLevelBits(level);
+        }
+    }
+
+    if (starvationThreshold > 0) {
+        while (!readyOrder.empty()) {
+            const MLFQEntry& e = readyOrder.front();
+            PCB* p = e.process;
+            if (p->ready_since != e.since) {
+                readyOrder.pop_front();   // picked since then, or already reported
+                continue;
+            }
+            long long waited = now - e.since;
+            if (waited < starvationThreshold) break;
+            alarms = alarms + 1;
+            p->ready_since = -1;
+            TRACE_EVENT(TraceLevel::SCHEDULING, TraceEventKind::STARVATION, now, p->pid, waited, 0);
+            if (starvationHandler) starvationHandler(p, waited);
+            readyOrder.pop_front();
+        }
+    }
+}
+
+void MLFQPolicy::enqueue(PCB* p, long long now) {
+    maintain(now);
+
+    // missed a boost while running or blocked
+    if (p->boost_epoch != boostEpoch) {
+        p->boost_epoch = boostEpoch;
+        p->queue_level = 0;
+        p->level_time = 0;
+    }
+    int level = p->queue_level;
+    if (level < 0) level = 0;
+    if (level >= (int)levels.size()) level = (int)levels.size() - 1;
+    p->queue_level = level;
+
+    push(level, p, now);
+    count = count + 1;
+
+    if (starvationThreshold > 0) {
+        p->ready_since = now;
+        MLFQEntry e;
+        e.process = p;
+        e.since = now;
+        e.epoch = boostEpoch;
+        readyOrder.push_back(e);
+    }
+}
+
+// lowest set bit = highest non empty level. boosted levels count as the top level,
+// among them the front that waited the longest goes first, as if they had been merged
+PCB* MLFQPolicy::pickNext(long long now) {
+    maintain(now);
+    if (nonEmpty == 0) return nullptr;
+
+    uint64_t top = (nonEmpty & 1ULL) | boosted;
+    int level = __builtin_ctzll(top != 0 ? top : nonEmpty);
+    if (top != 0) {
+        uint64_t others = top & (top - 1);
+        while (others != 0) {
+            int other = __builtin_ctzll(others);
+            others = others & (others - 1);
+            if (levels[other].front().since < levels[level].front().since) level = other;
+        }
+    }
+    MLFQEntry e = levels[level].pop_front();
+    updateLevelBits(level);
+    count = count - 1;
+
+    PCB* p = e.process;
+    if (e.epoch != boostEpoch) {
+        p->queue_level = 0;   // was waiting when the boost happened
+        p->level_time = 0;
+    }
+    p->boost_epoch = boostEpoch;
+    p->ready_since = -1;
+    return p;
+}
+
+bool MLFQPolicy::empty() const {
+    return count == 0;
+}
+
+size_t MLFQPolicy::size() const {
+    return count;
+}
+
+int MLFQPolicy::timeSlice(const PCB* p) const {
+    return quanta[p->queue_level];
+}
+
+bool MLFQPolicy::shouldPreempt(const PCB* running, int ranSoFar, const PCB* candidate) const {
+    return candidate->queue_level < running->queue_level;
+}
+
+// used the whole quantum -> looks CPU bound, move one level down.
+// with an allotment the CPU time on a level adds up, so giving up the CPU just
+// before the quantum ends does not keep a process at the top forever
+void MLFQPolicy::onDescheduled(PCB* p, int ran, bool sliceExpired) {
+    bool demote;
+    if (allotment > 0) {
+        p->level_time = p->level_time + ran;
+        demote = p->level_time >= allotment;
+    } else {
+        demote = sliceExpired;
+    }
+    if (demote && p->queue_level + 1 < (int)levels.size()) {
+        p->queue_level = p->queue_level + 1;
+        p->level_time = 0;
+    }
+}
+
+string MLFQPolicy::name() const {
+    string label = "MLFQ (" + to_string(levels.size()) + " levels";
+    if (boostInterval > 0) label = label + ", boost " + to_string(boostInterval);
+    if (agingThreshold > 0) label = label + ", aging " + to_string(agingThreshold);
+    return label + ")";
+}
+
+void MLFQPolicy::setStarvationHandler(function<void(const PCB*, long long)> handler) {
+    starvationHandler = handler;
+}
+
+uint64_t MLFQPolicy::getBoosts() const {
+    return boosts;
+}
+
+uint64_t MLFQPolicy::getPromotions() const {
+    return promotions;
+}
+
+uint64_t MLFQPolicy::getStarvationAlarms() const {
+    return alarms;
+}
+
+static void saveMLFQRing(SnapshotWriter& out, const RingBuffer<MLFQEntry>& ring) {
+    out.put((uint64_t)ring.size());
+    for (size_t i = 0; i < ring.size(); i++) {
+        out.putProcess(ring.at(i).process);
+        out.put(ring.at(i).since);
+        out.put(ring.at(i).epoch);
+    }
+}
+
+static void loadMLFQRing(SnapshotReader& in, RingBuffer<MLFQEntry>& ring) {
+    uint64_t n = in.get<uint64_t>();
+    for (uint64_t i = 0; i < n; i++) {
+        MLFQEntry e;
+        e.process = in.getProcess();
+        in.get(e.since);
+        in.get(e.epoch);
+        ring.push_back(e);
+    }
+}
+
+// the starvation handler is code, it is not part of the snapshot
+void MLFQPolicy::saveState(SnapshotWriter& out) const {
+    out.putString("mlfq");
+    out.putVector(quanta);
+    for (size_t i = 0; i < levels.size(); i++) saveMLFQRing(out, levels[i]);
+    out.put(nonEmpty);
+    out.put(boosted);
+    out.put(count);
+    out.put(allotment);
+    out.put(boostInterval);
+    out.put(nextBoost);
+    out.put(boostEpoch);
+    out.put(agingThreshold);
+    out.put(starvationThreshold);
+    saveMLFQRing(out, readyOrder);
+    out.put(boosts);
+    out.put(promotions);
+    out.put(alarms);
+}
+
+void MLFQPolicy::loadState(SnapshotReader& in) {
+    in.getVector(quanta);
+    levels.assign(quanta.size(), RingBuffer<MLFQEntry>());
+    for (size_t i = 0; i < levels.size(); i++) loadMLFQRing(in, levels[i]);
+    in.get(nonEmpty);
+    in.get(boosted);
+    in.get(count);
+    in.get(allotment);
+    in.get(boostInterval);
+    in.get(nextBoost);
+    in.get(boostEpoch);
+    in.get(agingThreshold);
+    in.get(starvationThreshold);
+    readyOrder = RingBuffer<MLFQEntry>();
+    loadMLFQRing(in, readyOrder);
+    in.get(boosts);
+    in.get(promotions);
+    in.get(alarms);
+}
+
+// ---------------- CFS ----------------
+
+// nice -5 .. +4 weights from the Linux prio_to_weight table
+int CFSPolicy::weightFor(int priority) {
+    static const int weights[10] = {3121, 2501, 1991, 1586, 1277, 1024, 820, 655, 526, 423};
+    if (priority < 0) priority = 0;
+    if (priority > 9) priority = 9;
+    return weights[priority];
+}
+
+CFSPolicy::CFSPolicy(int latency, int minGranularity) {
+    this->latency = latency > 0 ? latency : 1;
+    this->minGranularity = minGranularity > 0 ? minGranularity : 1;
+    next_seq = 0;
+    minVruntime = 0;
+    totalWeight = 0;
+}
+
+// new processes start at the current minimum so they cant starve everybody else,
+// returning sleepers get at most half a period of credit
+void CFSPolicy::enqueue(PCB* p, long long now) {
+    if (p->first_run_time < 0 && p->vruntime == 0) {
+        p->vruntime = minVruntime;
+    } else if (p->vruntime < minVruntime - latency / 2) {
+        p->vruntime = minVruntime - latency / 2;
+    }
+
+    HeapEntry e;
+    e.key = p->vruntime;
+    e.seq = next_seq;
+    e.process = p;
+    next_seq = next_seq + 1;
+    tree.insert(e);
+    totalWeight = totalWeight + weightFor(p->priority);
+}
+
+// leftmost node of the tree has the smallest vruntime
+PCB* CFSPolicy::pickNext(long long now) {
+    if (tree.empty()) return nullptr;
+    PCB* p = tree.begin()->process;
+    tree.erase(tree.begin());
+    totalWeight = totalWeight - weightFor(p->priority);
+    if (p->vruntime > minVruntime) {
+        minVruntime = p->vruntime;
+    }
+    return p;
+}
+
+bool CFSPolicy::empty() const {
+    return tree.empty();
+}
+
+size_t CFSPolicy::size() const {
+    return tree.size();
+}
+
+// share of the target latency proportional to the weight
+int CFSPolicy::timeSlice(const PCB* p) const {
+    long long weight = weightFor(p->priority);
+    long long slice = (long long)latency * weight / (totalWeight + weight);
+    if (slice < minGranularity) slice = minGranularity;
+    return (int)slice;
+}
+
+// wakeup preemption - candidate is far enough behind the running process
+bool CFSPolicy::shouldPreempt(const PCB* running, int ranSoFar, const PCB* candidate) const {
+    long long current = running->vruntime + (long long)ranSoFar * 1024 / weightFor(running->priority);
+    return current - candidate->vruntime > minGranularity;
+}
+
+// charge the CPU time, scaled by weight
+void CFSPolicy::onDescheduled(PCB* p, int ran, bool sliceExpired) {
+    p->vruntime = p->vruntime + (long long)ran * 1024 / weightFor(p->priority);
+}
+
+string CFSPolicy::name() const {
+    return "CFS Fair Share";
+}
+
+void CFSPolicy::saveState(SnapshotWriter& out) const {
+    out.putString("cfs");
+    out.put(latency);
+    out.put(minGranularity);
+    out.put(next_seq);
+    out.put(minVruntime);
+    out.put(totalWeight);
+    out.put((uint64_t)tree.size());
+    for (auto it = tree.begin(); it != tree.end(); it++) saveEntry(out, *it);
+}
+
+void CFSPolicy::loadState(SnapshotReader& in) {
+    in.get(latency);
+    in.get(minGranularity);
+    in.get(next_seq);
+    in.get(minVruntime);
+    in.get(totalWeight);
+    tree.clear();
+    uint64_t n = in.get<uint64_t>();
+    for (uint64_t i = 0; i < n; i++) tree.insert(tree.end(), loadEntry(in));
+}
+
+// ---------------- EDF / Rate-Monotonic ----------------
+
+RealTimePolicy::RealTimePolicy(RealTimeMode mode, unique_ptr<SchedulingPolicy> background, int runtime, int period) {
+    this->mode = mode;
+    this->background = move(background);
+    this->runtime = runtime;
+    this->period = period > 0 ? period : 1;
+    next_seq = 0;
+    windowStart = 0;
+    used = 0;
+    clock = 0;
+    throttled = 0;
+}
+
+// windows are rolled lazily, a window nobody looked at simply had no real-time work
+void RealTimePolicy::refill(long long now) {
+    clock = now;
+    if (runtime > 0 && now >= windowStart + period) {
+        windowStart = windowStart + (now - windowStart) / period * period;
+        used = 0;
+    }
+}
+
+long long RealTimePolicy::budgetLeft() const {
+    if (runtime <= 0) return LLONG_MAX;
+    return max(0LL, runtime - used);
+}
+
+long long RealTimePolicy::windowLeft() const {
+    return max(1LL, windowStart + period - clock);
+}
+
+// real-time jobs by absolute deadline (EDF) or period (RM), the rest goes to the background policy
+void RealTimePolicy::enqueue(PCB* p, long long now) {
+    refill(now);
+    if (p->period <= 0) {
+        background->enqueue(p, now);
+        return;
+    }
+    HeapEntry e;
+    e.key = mode == RealTimeMode::EDF ? p->deadline : p->period;
+    e.seq = next_seq;
+    e.process = p;
+    next_seq = next_seq + 1;
+    heap.push(e);
+}
+
+// real-time class first, unless it used up its window and best effort work is waiting
+PCB* RealTimePolicy::pickNext(long long now) {
+    refill(now);
+    if (!heap.empty() && (budgetLeft() > 0 || background->empty())) {
+        PCB* p = heap.top().process;
+        heap.pop();
+        return p;
+    }
+    if (background->empty()) return nullptr;
+    if (!heap.empty()) {
+        throttled = throttled + 1;
+    }
+    return background->pickNext(now);
+}
+
+bool RealTimePolicy::empty() const {
+    return heap.empty() && background->empty();
+}
+
+size_t RealTimePolicy::size() const {
+    return heap.size() + background->size();
+}
+
+// with a reservation a real-time job stops when the budget or the window ends, a best effort
+// process stops at the end of the window when throttled real-time jobs are waiting for it
+int RealTimePolicy::timeSlice(const PCB* p) const {
+    if (p->period > 0) {
+        if (runtime <= 0) return 0;
+        long long left = budgetLeft();
+        return (int)(left > 0 ? min(left, windowLeft()) : windowLeft());
+    }
+    int slice = background->timeSlice(p);
+    if (runtime > 0 && !heap.empty() && budgetLeft() == 0) {
+        long long cap = windowLeft();
+        if (slice == 0 || cap < slice) slice = (int)cap;
+    }
+    return slice;
+}
+
+bool RealTimePolicy::shouldPreempt(const PCB* running, int ranSoFar, const PCB* candidate) const {
+    if (candidate->period > 0 && running->period <= 0) {
+        return budgetLeft() > 0;
+    }
+    if (candidate->period > 0) {
+        if (mode == RealTimeMode::EDF) return candidate->deadline < running->deadline;
+        return candidate->period < running->period;
+    }
+    if (running->period > 0) return false;
+    return background->shouldPreempt(running, ranSoFar, candidate);
+}
+
+// real-time time is charged to the window, a best effort slice cut short by the window is
+// not a quantum expiry for the background policy
+void RealTimePolicy::onDescheduled(PCB* p, int ran, bool sliceExpired) {
+    if (p->period > 0) {
+        used = used + ran;
+        return;
+    }
+    int slice = background->timeSlice(p);
+    background->onDescheduled(p, ran, sliceExpired && slice > 0 && ran >= slice);
+}
+
+string RealTimePolicy::name() const {
+    return string(mode == RealTimeMode::EDF ? "EDF" : "RM") + " + " + background->name();
+}
+
+uint64_t RealTimePolicy::getThrottled() const {
+    return throttled;
+}
+
+void RealTimePolicy::saveState(SnapshotWriter& out) const {
+    out.putString(mode == RealTimeMode::EDF ? "edf" : "rm");
+    out.put(mode);
+    out.put(next_seq);
+    saveHeap(out, heap);
+    out.put(runtime);
+    out.put(period);
+    out.put(windowStart);
+    out.put(used);
+    out.put(clock);
+    out.put(throttled);
+    background->saveState(out);
+}
+
+void RealTimePolicy::loadState(SnapshotReader& in) {
+    in.get(mode);
+    in.get(next_seq);
+    loadHeap(in, heap);
+    in.get(runtime);
+    in.get(period);
+    in.get(windowStart);
+    in.get(used);
+    in.get(clock);
+    in.get(throttled);
+    background = loadPolicy(in);
+}
+
+// ---------------- factory ----------------
+
+unique_ptr<SchedulingPolicy> createPolicy(const string& name, const PolicyParams& params) {
+    if (name == "fcfs" || name == "fifo") {
+        return unique_ptr<SchedulingPolicy>(new FCFSPolicy());
+    }
+    if (name == "priority") {
+        return unique_ptr<SchedulingPolicy>(new PriorityPolicy(params.preemptive));
+    }
+    if (name == "sjf") {
+        return unique_ptr<SchedulingPolicy>(new SJFPolicy(false));
+    }
+    if (name == "srtf") {
+        return unique_ptr<SchedulingPolicy>(new SJFPolicy(true));
+    }
+    if (name == "rr") {
+        return unique_ptr<SchedulingPolicy>(new RoundRobinPolicy(params.quantum));
+    }
+    if (name == "mlfq") {
+        return unique_ptr<SchedulingPolicy>(new MLFQPolicy(params));
+    }
+    if (name == "cfs") {
+        return unique_ptr<SchedulingPolicy>(new CFSPolicy(params.cfs_latency, params.cfs_min_granularity));
+    }
+    if (name == "edf" || name == "rm") {
+        if (params.rt_background == "edf" || params.rt_background == "rm") {
+            throw invalid_argument("policy " + name + " can not run over the real-time policy " + params.rt_background);
+        }
+        unique_ptr<SchedulingPolicy> background = createPolicy(params.rt_background, params);
+        RealTimeMode mode = name == "edf" ? RealTimeMode::EDF : RealTimeMode::RATE_MONOTONIC;
+        return unique_ptr<SchedulingPolicy>(new RealTimePolicy(mode, move(background), params.rt_runtime, params.rt_period));
+    }
+    throw invalid_argument("unknown scheduling policy '" + name + "'");
+}
+
+unique_ptr<SchedulingPolicy> loadPolicy(SnapshotReader& in) {
+    string kind = in.getString();
+    unique_ptr<SchedulingPolicy> policy;
+    try {
+        policy = createPolicy(kind);
+    } catch (const invalid_argument&) {
+        throw runtime_error("snapshot contains an unknown policy " + kind);
+    }
+    policy->loadState(in);
+    return policy;
+}
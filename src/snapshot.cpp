@@ -0,0 +1,331 @@
+#include "snapshot.h"
+#include <fstream>
+
+using namespace std;
+
+static const char SNAPSHOT_MAGIC[8] = {'O', 'S', 'S', 'N', 'A', 'P', 'S', '1'};
+static const uint32_t SNAPSHOT_VERSION = 1;
+static const uint32_t NO_PROCESS = 0xFFFFFFFFu;
+
+// ---------------- PCB ----------------
+
+static void savePCB(SnapshotWriter& out, const PCB& p) {
+    out.put(p.pid);
+    out.put(p.state);
+    out.put(p.priority);
+    out.putString(p.required_resource);
+    out.put(p.has_resource);
+    out.put(p.shared_access);
+    out.putVector(p.resource_claim);
+    out.putVector(p.resource_order);
+    out.putVector(p.resource_alloc);
+    out.put(p.memory_required);
+    out.put(p.arrival_time);
+    out.put(p.burst_time);
+    out.put(p.remaining_time);
+    out.put(p.completion_time);
+    out.put(p.turnaround_time);
+    out.put(p.waiting_time);
+    out.put(p.first_run_time);
+    out.put(p.response_time);
+    out.put(p.queue_level);
+    out.put(p.level_time);
+    out.put(p.boost_epoch);
+    out.put(p.ready_since);
+    out.put(p.ready_time);
+    out.put(p.vruntime);
+    out.put(p.last_core);
+    out.put(p.cgroup);
+    out.putVector(p.phases);
+    out.put(p.phase_index);
+    out.put(p.phase_remaining);
+    out.put(p.io_time);
+    out.putString(p.io_device);
+    out.put(p.io_block);
+    out.put(p.period);
+    out.put(p.relative_deadline);
+    out.put(p.wcet);
+    out.put(p.jobs_left);
+    out.put(p.sporadic_gap);
+    out.put(p.release_time);
+    out.put(p.deadline);
+    out.put(p.family_slot);
+    out.put(p.exit_code);
+    out.put(p.exit_pending);
+    out.put(p.wait_pid);
+    out.put(p.child_status);
+    out.put(p.pooled);
+    out.put(p.fork_children);
+    out.put(p.fork_depth);
+    out.put(p.wait_children);
+}
+
+static void loadPCB(SnapshotReader& in, PCB& p) {
+    in.get(p.pid);
+    in.get(p.state);
+    in.get(p.priority);
+    p.required_resource = in.getString();
+    in.get(p.has_resource);
+    in.get(p.shared_access);
+    in.getVector(p.resource_claim);
+    in.getVector(p.resource_order);
+    in.getVector(p.resource_alloc);
+    in.get(p.memory_required);
+    in.get(p.arrival_time);
+    in.get(p.burst_time);
+    in.get(p.remaining_time);
+    in.get(p.completion_time);
+    in.get(p.turnaround_time);
+    in.get(p.waiting_time);
+    in.get(p.first_run_time);
+    in.get(p.response_time);
+    in.get(p.queue_level);
+    in.get(p.level_time);
+    in.get(p.boost_epoch);
+    in.get(p.ready_since);
+    in.get(p.ready_time);
+    in.get(p.vruntime);
+    in.get(p.last_core);
+    in.get(p.cgroup);
+    in.getVector(p.phases);
+    in.get(p.phase_index);
+    in.get(p.phase_remaining);
+    in.get(p.io_time);
+    p.io_device = in.getString();
+    in.get(p.io_block);
+    in.get(p.period);
+    in.get(p.relative_deadline);
+    in.get(p.wcet);
+    in.get(p.jobs_left);
+    in.get(p.sporadic_gap);
+    in.get(p.release_time);
+    in.get(p.deadline);
+    in.get(p.family_slot);
+    in.get(p.exit_code);
+    in.get(p.exit_pending);
+    in.get(p.wait_pid);
+    in.get(p.child_status);
+    in.get(p.pooled);
+    in.get(p.fork_children);
+    in.get(p.fork_depth);
+    in.get(p.wait_children);
+}
+
+// ---------------- SnapshotWriter ----------------
+
+void SnapshotWriter::bytes(const void* data, size_t n) {
+    const char* from = (const char*)data;
+    body.insert(body.end(), from, from + n);
+}
+
+void SnapshotWriter::putString(const string& s) {
+    put((uint64_t)s.size());
+    bytes(s.data(), s.size());
+}
+
+void SnapshotWriter::putProcess(const PCB* p) {
+    if (p == nullptr) {
+        put(NO_PROCESS);
+        return;
+    }
+    auto it = ids.find(p);
+    if (it != ids.end()) {
+        put(it->second);
+        return;
+    }
+    uint32_t id = (uint32_t)processes.size();
+    ids[p] = id;
+    processes.push_back(p);
+    put(id);
+}
+
+size_t SnapshotWriter::processCount() const {
+    return processes.size();
+}
+
+// the process table goes first, so a reader has every PCB before the first reference to one
+vector<char> SnapshotWriter::finish() const {
+    SnapshotWriter head;
+    head.bytes(SNAPSHOT_MAGIC, sizeof(SNAPSHOT_MAGIC));
+    head.put(SNAPSHOT_VERSION);
+    head.put((uint64_t)processes.size());
+    for (size_t i = 0; i < processes.size(); i++) {
+        savePCB(head, *processes[i]);
+    }
+    vector<char> result;
+    result.reserve(head.body.size() + body.size());
+    result.insert(result.end(), head.body.begin(), head.body.end());
+    result.insert(result.end(), body.begin(), body.end());
+    return result;
+}
+
+// ---------------- SnapshotReader ----------------
+
+SnapshotReader::SnapshotReader(const vector<char>& buffer) {
+    data = buffer.data();
+    size = buffer.size();
+    position = 0;
+}
+
+void SnapshotReader::bytes(void* out, size_t n) {
+    if (n > size - position) {
+        throw runtime_error("snapshot is truncated");
+    }
+    memcpy(out, data + position, n);
+    position = position + n;
+}
+
+string SnapshotReader::getString() {
+    uint64_t n = get<uint64_t>();
+    if (n > size - position) {
+        throw runtime_error("snapshot is truncated");
+    }
+    string s(data + position, n);
+    position = position + n;
+    return s;
+}
+
+PCB* SnapshotReader::getProcess() {
+    uint32_t id = get<uint32_t>();
+    if (id == NO_PROCESS) return nullptr;
+    if (id >= processes.size()) {
+        throw runtime_error("snapshot refers to an unknown process");
+    }
+    return processes[id];
+}
+
+void SnapshotReader::loadProcesses(vector<PCB>& storage) {
+    char magic[sizeof(SNAPSHOT_MAGIC)];
+    bytes(magic, sizeof(magic));
+    if (memcmp(magic, SNAPSHOT_MAGIC, sizeof(magic)) != 0) {
+        throw runtime_error("not a simulator snapshot");
+    }
+    if (get<uint32_t>() != SNAPSHOT_VERSION) {
+        throw runtime_error("unsupported snapshot version");
+    }
+    uint64_t count = get<uint64_t>();
+    if (count > size - position) {
+        throw runtime_error("snapshot is truncated");
+    }
+    storage.assign(count, PCB());
+    processes.resize(count);
+    for (size_t i = 0; i < count; i++) {
+        loadPCB(*this, storage[i]);
+        processes[i] = &storage[i];
+    }
+}
+
+// ---------------- SimulationFork ----------------
+
+PCB* SimulationFork::process(int pid) {
+    for (size_t i = 0; i < processes.size(); i++) {
+        if (processes[i].pid == pid) return &processes[i];
+    }
+    return nullptr;
+}
+
+// ---------------- SimulationSnapshot ----------------
+
+static void saveMemoryConfig(SnapshotWriter& out, const MemoryConfig& config) {
+    out.put(config.model);
+    out.put(config.total);
+    out.put(config.page_size);
+    out.put(config.swap_size);
+    out.put(config.replacement);
+    out.put(config.ws_window);
+    out.put(config.references_per_dispatch);
+    out.put(config.fault_cost);
+    out.put(config.compaction);
+    out.put(config.buddy_min_block);
+    out.putVector(config.slab_classes);
+    out.put(config.slab_objects);
+}
+
+static MemoryConfig loadMemoryConfig(SnapshotReader& in) {
+    MemoryConfig config;
+    in.get(config.model);
+    in.get(config.total);
+    in.get(config.page_size);
+    in.get(config.swap_size);
+    in.get(config.replacement);
+    in.get(config.ws_window);
+    in.get(config.references_per_dispatch);
+    in.get(config.fault_cost);
+    in.get(config.compaction);
+    in.get(config.buddy_min_block);
+    in.getVector(config.slab_classes);
+    in.get(config.slab_objects);
+    return config;
+}
+
+SimulationSnapshot::SimulationSnapshot() {
+}
+
+SimulationSnapshot SimulationSnapshot::capture(const Scheduler& scheduler, const vector<const CounterRng*>& rngs) {
+    SnapshotWriter out;
+    const MemoryManager& memory = scheduler.getMemoryManager();
+    saveMemoryConfig(out, memory.get_config());
+    memory.save_state(out);
+    scheduler.getProcessQueues().save_state(out);
+    scheduler.saveState(out);
+    out.put((uint64_t)rngs.size());
+    for (size_t i = 0; i < rngs.size(); i++) {
+        rngs[i]->saveState(out);
+    }
+
+    SimulationSnapshot snapshot;
+    snapshot.buffer = out.finish();
+    return snapshot;
+}
+
+// same order as capture: PCBs, memory, queues and resources, scheduler, RNGs
+unique_ptr<SimulationFork> SimulationSnapshot::restore() const {
+    SnapshotReader in(buffer);
+    unique_ptr<SimulationFork> fork(new SimulationFork());
+    in.loadProcesses(fork->processes);
+
+    fork->memory.reset(new MemoryManager(loadMemoryConfig(in)));
+    fork->memory->load_state(in);
+    fork->queues.reset(new ProcessQueues());
+    fork->queues->load_state(in);
+    fork->scheduler.reset(new Scheduler(fork->memory.get(), fork->queues.get()));
+    fork->scheduler->loadState(in);
+    // restored PCBs live in the array, only children forked from now on use the pool
+    for (size_t i = 0; i < fork->processes.size(); i++) {
+        fork->processes[i].pooled = false;
+    }
+    fork->scheduler->setProcessPool(&fork->pool);
+
+    uint64_t rngCount = in.get<uint64_t>();
+    for (uint64_t i = 0; i < rngCount; i++) {
+        CounterRng rng(0);
+        rng.loadState(in);
+        fork->rngs.push_back(rng);
+    }
+    return fork;
+}
+
+size_t SimulationSnapshot::size() const {
+    return buffer.size();
+}
+
+void SimulationSnapshot::save(const string& path) const {
+    ofstream file(path, ios::binary);
+    if (!file) {
+        throw runtime_error("cannot write snapshot " + path);
+    }
+    file.write(buffer.data(), buffer.size());
+    if (!file) {
+        throw runtime_error("cannot write snapshot " + path);
+    }
+}
+
+SimulationSnapshot SimulationSnapshot::load(const string& path) {
+    ifstream file(path, ios::binary);
+    if (!file) {
+        throw runtime_error("cannot open snapshot " + path);
+    }
+    SimulationSnapshot snapshot;
+    snapshot.buffer.assign(istreambuf_iterator<char>(file), istreambuf_iterator<char>());
+    return snapshot;
+}
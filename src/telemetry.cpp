@@ -0,0 +1,344 @@
+#include "telemetry.h"
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <sstream>
+#include <stdexcept>
+
+#ifndef _WIN32
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <poll.h>
+#include <unistd.h>
+#endif
+
+using namespace std;
+
+// ---------------- TelemetryHistogram ----------------
+
+TelemetryHistogram::TelemetryHistogram() : total(0), sum(0), maximum(0) {
+    for (int i = 0; i < BUCKETS; i++) counts[i].store(0, memory_order_relaxed);
+}
+
+// below SUB_BUCKETS the value is the index, above it the top SUB_BUCKET_BITS bits of the
+// value pick one of HALF_BUCKETS buckets of its power of two
+int TelemetryHistogram::bucketIndex(uint64_t value) {
+    if (value < (uint64_t)SUB_BUCKETS) return (int)value;
+    int msb = 63 - __builtin_clzll(value);
+    int shift = msb - (SUB_BUCKET_BITS - 1);
+    return SUB_BUCKETS + (shift - 1) * HALF_BUCKETS + (int)((value >> shift) - HALF_BUCKETS);
+}
+
+uint64_t TelemetryHistogram::bucketLow(int index) {
+    if (index < SUB_BUCKETS) return (uint64_t)index;
+    int k = index - SUB_BUCKETS;
+    int shift = k / HALF_BUCKETS + 1;
+    return (uint64_t)(k % HALF_BUCKETS + HALF_BUCKETS) << shift;
+}
+
+uint64_t TelemetryHistogram::bucketHigh(int index) {
+    if (index < SUB_BUCKETS) return (uint64_t)index;
+    int shift = (index - SUB_BUCKETS) / HALF_BUCKETS + 1;
+    return bucketLow(index) + ((uint64_t)1 << shift) - 1;
+}
+
+uint64_t TelemetryHistogram::count() const {
+    return total.load(memory_order_relaxed);
+}
+
+uint64_t TelemetryHistogram::getSum() const {
+    return sum.load(memory_order_relaxed);
+}
+
+uint64_t TelemetryHistogram::getMax() const {
+    return maximum.load(memory_order_relaxed);
+}
+
+double TelemetryHistogram::quantile(double q) const {
+    double result;
+    quantiles(&q, &result, 1);
+    return result;
+}
+
+// the buckets are read one by one while the simulation keeps recording, so ranks are taken
+// from the counts seen on the way and not from total. a first pass over the counts finds
+// the last used bucket, the second one stops there
+void TelemetryHistogram::quantiles(const double* qs, double* out, int n) const {
+    uint64_t snapshot[BUCKETS];
+    uint64_t seen = 0;
+    int last = -1;
+    for (int i = 0; i < BUCKETS; i++) {
+        snapshot[i] = counts[i].load(memory_order_relaxed);
+        if (snapshot[i] != 0) {
+            seen = seen + snapshot[i];
+            last = i;
+        }
+    }
+    int bucket = 0;
+    uint64_t passed = last >= 0 ? snapshot[0] : 0;
+    for (int k = 0; k < n; k++) {
+        if (seen == 0) {
+            out[k] = 0;
+            continue;
+        }
+        double q = qs[k] < 0 ? 0 : (qs[k] > 1 ? 1 : qs[k]);
+        uint64_t rank = (uint64_t)(q * (double)(seen - 1) + 0.5);
+        while (passed <= rank && bucket < last) {
+            bucket = bucket + 1;
+            passed = passed + snapshot[bucket];
+        }
+        out[k] = (bucketLow(bucket) + bucketHigh(bucket)) / 2.0;
+    }
+}
+
+// ---------------- MetricsRegistry ----------------
+
+MetricsRegistry::Series& MetricsRegistry::find(const string& name, const string& help, TelemetryKind kind, const string& labels) {
+    lock_guard<mutex> guard(lock);
+    Family* family = nullptr;
+    for (size_t i = 0; i < families.size(); i++) {
+        if (families[i]->name == name) {
+            family = families[i].get();
+            break;
+        }
+    }
+    if (family == nullptr) {
+        families.push_back(unique_ptr<Family>(new Family()));
+        family = families.back().get();
+        family->name = name;
+        family->help = help;
+        family->kind = kind;
+    } else if (family->kind != kind) {
+        throw runtime_error("metric " + name + " is already registered as another kind");
+    }
+
+    for (size_t i = 0; i < family->series.size(); i++) {
+        if (family->series[i]->labels == labels) return *family->series[i];
+    }
+    unique_ptr<Series> series(new Series());
+    series->labels = labels;
+    if (kind == TelemetryKind::COUNTER) series->counter.reset(new TelemetryCounter());
+    if (kind == TelemetryKind::GAUGE) series->gauge.reset(new TelemetryGauge());
+    if (kind == TelemetryKind::HISTOGRAM) series->histogram.reset(new TelemetryHistogram());
+    family->series.push_back(move(series));
+    return *family->series.back();
+}
+
+TelemetryCounter& MetricsRegistry::counter(const string& name, const string& help, const string& labels) {
+    return *find(name, help, TelemetryKind::COUNTER, labels).counter;
+}
+
+TelemetryGauge& MetricsRegistry::gauge(const string& name, const string& help, const string& labels) {
+    return *find(name, help, TelemetryKind::GAUGE, labels).gauge;
+}
+
+TelemetryHistogram& MetricsRegistry::histogram(const string& name, const string& help, const string& labels) {
+    return *find(name, help, TelemetryKind::HISTOGRAM, labels).histogram;
+}
+
+// label values escape backslash, double quote and newline
+string MetricsRegistry::label(const string& key, const string& value) {
+    string s = key + "=\"";
+    for (size_t i = 0; i < value.size(); i++) {
+        if (value[i] == '\\') s += "\\\\";
+        else if (value[i] == '"') s += "\\\"";
+        else if (value[i] == '\n') s += "\\n";
+        else s += value[i];
+    }
+    return s + "\"";
+}
+
+// counters, gauges and sums are integers, only quantiles are written as doubles
+template <typename T>
+static void writeSample(ostream& out, const string& name, const string& labels, const char* extra, T value, long long timestamp) {
+    out << name;
+    if (!labels.empty() || extra[0] != 0) {
+        out << "{" << labels << (!labels.empty() && extra[0] != 0 ? "," : "") << extra << "}";
+    }
+    out << " " << value;
+    if (timestamp >= 0) out << " " << timestamp;
+    out << "\n";
+}
+
+void MetricsRegistry::writePrometheus(ostream& out, long long timestamp) const {
+    static const double quantiles[] = {0.5, 0.9, 0.99, 0.999};
+    static const char* quantileLabels[] = {"quantile=\"0.5\"", "quantile=\"0.9\"", "quantile=\"0.99\"", "quantile=\"0.999\""};
+
+    lock_guard<mutex> guard(lock);
+    for (size_t f = 0; f < families.size(); f++) {
+        const Family& family = *families[f];
+        const char* type = family.kind == TelemetryKind::COUNTER ? "counter"
+                         : family.kind == TelemetryKind::GAUGE ? "gauge" : "summary";
+        out << "# HELP " << family.name << " " << family.help << "\n";
+        out << "# TYPE " << family.name << " " << type << "\n";
+        for (size_t s = 0; s < family.series.size(); s++) {
+            const Series& series = *family.series[s];
+            if (series.counter) {
+                writeSample(out, family.name, series.labels, "", series.counter->get(), timestamp);
+            } else if (series.gauge) {
+                writeSample(out, family.name, series.labels, "", series.gauge->get(), timestamp);
+            } else {
+                const TelemetryHistogram& h = *series.histogram;
+                double values[4];
+                h.quantiles(quantiles, values, 4);
+                for (int q = 0; q < 4; q++) {
+                    writeSample(out, family.name, series.labels, quantileLabels[q], values[q], timestamp);
+                }
+                writeSample(out, family.name + "_sum", series.labels, "", h.getSum(), timestamp);
+                writeSample(out, family.name + "_count", series.labels, "", h.count(), timestamp);
+            }
+        }
+    }
+}
+
+string MetricsRegistry::prometheusText() const {
+    ostringstream out;
+    writePrometheus(out);
+    return out.str();
+}
+
+void MetricsRegistry::writeFile(const string& path) const {
+    string temporary = path + ".tmp";
+    {
+        ofstream file(temporary);
+        if (!file) {
+            throw runtime_error("cannot write metrics file " + temporary);
+        }
+        writePrometheus(file);
+        if (!file) {
+            throw runtime_error("cannot write metrics file " + temporary);
+        }
+    }
+    if (rename(temporary.c_str(), path.c_str()) != 0) {
+        throw runtime_error("cannot replace metrics file " + path);
+    }
+}
+
+size_t MetricsRegistry::size() const {
+    lock_guard<mutex> guard(lock);
+    size_t n = 0;
+    for (size_t i = 0; i < families.size(); i++) n = n + families[i]->series.size();
+    return n;
+}
+
+// ---------------- TelemetryServer ----------------
+
+TelemetryServer::TelemetryServer(const MetricsRegistry& registry) : registry(registry), listenFd(-1), running(false), scrapes(0) {
+}
+
+TelemetryServer::~TelemetryServer() {
+    stop();
+}
+
+uint64_t TelemetryServer::getScrapes() const {
+    return scrapes.load(memory_order_relaxed);
+}
+
+#ifndef _WIN32
+
+bool TelemetryServer::start(const string& socketPath) {
+    stop();
+    sockaddr_un address;
+    memset(&address, 0, sizeof(address));
+    address.sun_family = AF_UNIX;
+    if (socketPath.size() >= sizeof(address.sun_path)) return false;
+    strcpy(address.sun_path, socketPath.c_str());
+
+    int fd = socket(AF_UNIX, SOCK_STREAM, 0);
+    if (fd < 0) return false;
+    unlink(socketPath.c_str());   // left over from an earlier run
+    if (bind(fd, (sockaddr*)&address, sizeof(address)) != 0 || listen(fd, 8) != 0) {
+        close(fd);
+        return false;
+    }
+    path = socketPath;
+    listenFd = fd;
+    running.store(true);
+    worker = thread(&TelemetryServer::serve, this);
+    return true;
+}
+
+void TelemetryServer::stop() {
+    if (!running.load()) return;
+    running.store(false);
+    worker.join();
+    close(listenFd);
+    listenFd = -1;
+    unlink(path.c_str());
+}
+
+// the accept loop wakes up every 100 ms to see if it should stop. a client gets 50 ms to
+// send a request, without one it is answered in plain text
+void TelemetryServer::serve() {
+    while (running.load()) {
+        pollfd listener = {listenFd, POLLIN, 0};
+        if (poll(&listener, 1, 100) <= 0) continue;
+        int client = accept(listenFd, nullptr, nullptr);
+        if (client < 0) continue;
+
+        bool http = false;
+        pollfd request = {client, POLLIN, 0};
+        if (poll(&request, 1, 50) > 0) {
+            char buffer[1024];
+            ssize_t n = recv(client, buffer, sizeof(buffer), 0);
+            http = n >= 4 && memcmp(buffer, "GET ", 4) == 0;
+        }
+
+        string body = registry.prometheusText();
+        string reply;
+        if (http) {
+            reply = "HTTP/1.0 200 OK\r\nContent-Type: text/plain; version=0.0.4\r\nContent-Length: "
+                  + to_string(body.size()) + "\r\nConnection: close\r\n\r\n";
+        }
+        reply += body;
+        size_t sent = 0;
+        while (sent < reply.size()) {
+            ssize_t n = send(client, reply.data() + sent, reply.size() - sent, MSG_NOSIGNAL);
+            if (n <= 0) break;
+            sent = sent + n;
+        }
+        close(client);
+        scrapes.fetch_add(1, memory_order_relaxed);
+    }
+}
+
+bool scrapeTelemetrySocket(const string& socketPath, string& text) {
+    sockaddr_un address;
+    memset(&address, 0, sizeof(address));
+    address.sun_family = AF_UNIX;
+    if (socketPath.size() >= sizeof(address.sun_path)) return false;
+    strcpy(address.sun_path, socketPath.c_str());
+
+    int fd = socket(AF_UNIX, SOCK_STREAM, 0);
+    if (fd < 0) return false;
+    if (connect(fd, (sockaddr*)&address, sizeof(address)) != 0) {
+        close(fd);
+        return false;
+    }
+    text.clear();
+    char buffer[4096];
+    ssize_t n;
+    while ((n = recv(fd, buffer, sizeof(buffer), 0)) > 0) {
+        text.append(buffer, n);
+    }
+    close(fd);
+    return true;
+}
+
+#else
+
+bool TelemetryServer::start(const string& socketPath) {
+    return false;
+}
+
+void TelemetryServer::stop() {
+}
+
+void TelemetryServer::serve() {
+}
+
+bool scrapeTelemetrySocket(const string& socketPath, string& text) {
+    return false;
+}
+
+#endif
@@ -0,0 +1,588 @@
+#include "trace_loader.h"
+#include <cstring>
+#include <cstdlib>
+#include <cctype>
+#include <stdexcept>
+#include <sstream>
+#include <algorithm>
+#include <climits>
+
+#ifndef _WIN32
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
+using namespace std;
+
+static const char TRACE_MAGIC[8] = {'O', 'S', 'T', 'R', 'A', 'C', 'E', '1'};
+static const uint32_t TRACE_VERSION = 1;
+static const size_t TRACE_HEADER_SIZE = 40;   // magic, version, reserved, records, blocks, resource offset
+static const size_t TRACE_BLOCK_HEADER_SIZE = 16;   // records, reserved, phase count
+
+void traceRecordToPCB(const TraceRecord& r, PCB* p) {
+    p->pid = r.pid;
+    p->state = ProcessState::NEW;
+    p->priority = r.priority;
+    p->required_resource = r.resource;
+    p->has_resource = false;
+    p->memory_required = r.memory;
+    p->arrival_time = r.arrival;
+
+    // even phases are CPU, odd phases are I/O
+    int cpu = 0;
+    int io = 0;
+    for (size_t i = 0; i < r.phases.size(); i++) {
+        if (i % 2 == 0) cpu = cpu + r.phases[i];
+        else io = io + r.phases[i];
+    }
+    p->burst_time = cpu;
+    p->remaining_time = cpu;
+    p->io_time = io;
+    if (r.phases.size() > 1) {
+        p->phases = r.phases;   // only keep the phase list when there is I/O
+    } else {
+        p->phases.clear();
+    }
+    p->phase_index = 0;
+    p->phase_remaining = p->phases.empty() ? 0 : p->phases[0];
+}
+
+
+// ---------------- CSV ----------------
+
+CsvTraceSource::CsvTraceSource(const string& path) : in(path) {
+    lineNumber = 0;
+    if (!in) {
+        throw runtime_error("cannot open trace: " + path);
+    }
+}
+
+bool CsvTraceSource::next(TraceRecord& r) {
+    string line;
+    while (getline(in, line)) {
+        lineNumber = lineNumber + 1;
+        if (!line.empty() && line.back() == '\r') line.pop_back();
+        if (line.empty() || line[0] == '#') continue;
+        if (!isdigit((unsigned char)line[0]) && line[0] != '-') continue;   // header
+
+        // split into the six fields
+        string fields[6];
+        int field = 0;
+        for (size_t i = 0; i < line.size(); i++) {
+            if (line[i] == ',' && field < 5) {
+                field = field + 1;
+            } else {
+                fields[field] += line[i];
+            }
+        }
+        if (field < 5) {
+            throw runtime_error("trace line " + to_string(lineNumber) + ": expected 6 fields");
+        }
+
+        r.pid = atoi(fields[0].c_str());
+        r.arrival = atoll(fields[1].c_str());
+        r.priority = atoi(fields[2].c_str());
+        r.memory = atoi(fields[3].c_str());
+        r.resource = fields[4];
+        r.phases.clear();
+        const char* s = fields[5].c_str();
+        while (*s) {
+            char* end;
+            long value = strtol(s, &end, 10);
+            if (end == s) {
+                s++;   // separator or blank
+            } else {
+                r.phases.push_back((int)value);
+                s = end;
+            }
+        }
+        return true;
+    }
+    return false;
+}
+
+string CsvTraceSource::format() const {
+    return "csv";
+}
+
+
+// ---------------- JSON ----------------
+
+// small recursive descent parser, just enough for an array of flat trace objects
+namespace {
+
+class JsonReader {
+private:
+    const string& text;
+    size_t pos;
+
+    void fail(const string& what) {
+        throw runtime_error("trace json at offset " + to_string(pos) + ": " + what);
+    }
+
+    void skipSpace() {
+        while (pos < text.size() && isspace((unsigned char)text[pos])) pos++;
+    }
+
+    void expect(char c) {
+        skipSpace();
+        if (pos >= text.size() || text[pos] != c) fail(string("expected '") + c + "'");
+        pos++;
+    }
+
+    bool consume(char c) {
+        skipSpace();
+        if (pos < text.size() && text[pos] == c) {
+            pos++;
+            return true;
+        }
+        return false;
+    }
+
+    string readString() {
+        expect('"');
+        string out;
+        while (pos < text.size() && text[pos] != '"') {
+            if (text[pos] == '\\' && pos + 1 < text.size()) pos++;
+            out += text[pos];
+            pos++;
+        }
+        if (pos >= text.size()) fail("unterminated string");
+        pos++;
+        return out;
+    }
+
+    long long readNumber() {
+        skipSpace();
+        const char* start = text.c_str() + pos;
+        char* end;
+        long long value = strtoll(start, &end, 10);
+        if (end == start) fail("expected a number");
+        pos = pos + (end - start);
+        // ignore a fraction part, trace values are whole ticks / MB
+        if (pos < text.size() && text[pos] == '.') {
+            pos++;
+            while (pos < text.size() && isdigit((unsigned char)text[pos])) pos++;
+        }
+        return value;
+    }
+
+    // skip a value we dont know about
+    void skipValue() {
+        skipSpace();
+        if (pos >= text.size()) fail("unexpected end");
+        char c = text[pos];
+        if (c == '"') {
+            readString();
+        } else if (c == '[' || c == '{') {
+            char close = c == '[' ? ']' : '}';
+            pos++;
+            if (consume(close)) return;
+            do {
+                if (close == '}') {
+                    readString();
+                    expect(':');
+                }
+                skipValue();
+            } while (consume(','));
+            expect(close);
+        } else if (isalpha((unsigned char)c)) {
+            while (pos < text.size() && isalpha((unsigned char)text[pos])) pos++;   // true / false / null
+        } else {
+            readNumber();
+        }
+    }
+
+    TraceRecord readRecord() {
+        TraceRecord r;
+        expect('{');
+        if (consume('}')) return r;
+        do {
+            string key = readString();
+            expect(':');
+            if (key == "pid") r.pid = (int)readNumber();
+            else if (key == "arrival") r.arrival = readNumber();
+            else if (key == "priority") r.priority = (int)readNumber();
+            else if (key == "memory") r.memory = (int)readNumber();
+            else if (key == "resource") r.resource = readString();
+            else if (key == "burst") r.phases.assign(1, (int)readNumber());
+            else if (key == "phases") {
+                r.phases.clear();
+                expect('[');
+                if (!consume(']')) {
+                    do {
+                        r.phases.push_back((int)readNumber());
+                    } while (consume(','));
+                    expect(']');
+                }
+            } else {
+                skipValue();
+            }
+        } while (consume(','));
+        expect('}');
+        return r;
+    }
+
+public:
+    JsonReader(const string& text) : text(text), pos(0) {}
+
+    vector<TraceRecord> readAll() {
+        vector<TraceRecord> records;
+        expect('[');
+        if (consume(']')) return records;
+        do {
+            records.push_back(readRecord());
+        } while (consume(','));
+        expect(']');
+        return records;
+    }
+};
+
+}
+
+JsonTraceSource::JsonTraceSource(const string& path) {
+    ifstream in(path);
+    if (!in) {
+        throw runtime_error("cannot open trace: " + path);
+    }
+    stringstream buffer;
+    buffer << in.rdbuf();
+    string text = buffer.str();
+    records = JsonReader(text).readAll();
+    position = 0;
+}
+
+bool JsonTraceSource::next(TraceRecord& r) {
+    if (position >= records.size()) return false;
+    r = records[position];
+    position = position + 1;
+    return true;
+}
+
+long long JsonTraceSource::size() const {
+    return (long long)records.size();
+}
+
+string JsonTraceSource::format() const {
+    return "json";
+}
+
+
+// ---------------- binary writer ----------------
+
+// values are stored in host byte order (little endian on every platform we build for)
+template <typename T>
+static void writeValue(ofstream& out, T value) {
+    out.write(reinterpret_cast<const char*>(&value), sizeof(T));
+}
+
+template <typename T>
+static T readValue(const unsigned char* at) {
+    T value;
+    memcpy(&value, at, sizeof(T));
+    return value;
+}
+
+BinaryTraceWriter::BinaryTraceWriter(const string& path) : out(path, ios::binary | ios::trunc) {
+    recordCount = 0;
+    blockCount = 0;
+    block.reserve(TRACE_BLOCK_RECORDS);
+
+    // header is rewritten by close() once the counts are known
+    out.write(TRACE_MAGIC, sizeof(TRACE_MAGIC));
+    writeValue<uint32_t>(out, TRACE_VERSION);
+    writeValue<uint32_t>(out, 0);
+    writeValue<uint64_t>(out, 0);
+    writeValue<uint64_t>(out, 0);
+    writeValue<uint64_t>(out, 0);
+}
+
+BinaryTraceWriter::~BinaryTraceWriter() {
+    if (out.is_open()) {
+        close();
+    }
+}
+
+bool BinaryTraceWriter::good() const {
+    return out.good();
+}
+
+void BinaryTraceWriter::write(const TraceRecord& r) {
+    block.push_back(r);
+    if (block.size() >= TRACE_BLOCK_RECORDS) {
+        flushBlock();
+    }
+}
+
+// write the buffered records column by column
+void BinaryTraceWriter::flushBlock() {
+    if (block.empty()) return;
+
+    uint64_t phaseCount = 0;
+    for (size_t i = 0; i < block.size(); i++) {
+        phaseCount = phaseCount + block[i].phases.size();
+    }
+    writeValue<uint32_t>(out, (uint32_t)block.size());
+    writeValue<uint32_t>(out, 0);
+    writeValue<uint64_t>(out, phaseCount);
+
+    for (size_t i = 0; i < block.size(); i++) writeValue<int32_t>(out, block[i].pid);
+    for (size_t i = 0; i < block.size(); i++) writeValue<int64_t>(out, block[i].arrival);
+    for (size_t i = 0; i < block.size(); i++) writeValue<int32_t>(out, block[i].priority);
+    for (size_t i = 0; i < block.size(); i++) writeValue<int32_t>(out, block[i].memory);
+    for (size_t i = 0; i < block.size(); i++) writeValue<int32_t>(out, resources.intern(block[i].resource));
+    for (size_t i = 0; i < block.size(); i++) writeValue<int32_t>(out, (int32_t)block[i].phases.size());
+    for (size_t i = 0; i < block.size(); i++) {
+        if (!block[i].phases.empty()) {
+            out.write(reinterpret_cast<const char*>(block[i].phases.data()), block[i].phases.size() * sizeof(int32_t));
+        }
+    }
+
+    recordCount = recordCount + block.size();
+    blockCount = blockCount + 1;
+    block.clear();
+}
+
+void BinaryTraceWriter::close() {
+    flushBlock();
+
+    // resource names go after the last block
+    uint64_t resourceOffset = (uint64_t)out.tellp();
+    writeValue<uint32_t>(out, (uint32_t)resources.count());
+    for (int id = 0; id < resources.count(); id++) {
+        const string& name = resources.name(id);
+        writeValue<uint32_t>(out, (uint32_t)name.size());
+        out.write(name.data(), name.size());
+    }
+
+    out.seekp(sizeof(TRACE_MAGIC) + 2 * sizeof(uint32_t));
+    writeValue<uint64_t>(out, recordCount);
+    writeValue<uint64_t>(out, blockCount);
+    writeValue<uint64_t>(out, resourceOffset);
+    out.close();
+}
+
+
+// ---------------- binary reader ----------------
+
+BinaryTraceSource::BinaryTraceSource(const string& path) {
+    data = nullptr;
+    length = 0;
+    mappedLength = 0;
+    fd = -1;
+
+#ifndef _WIN32
+    fd = open(path.c_str(), O_RDONLY);
+    if (fd < 0) {
+        throw runtime_error("cannot open trace: " + path);
+    }
+    struct stat info;
+    if (fstat(fd, &info) == 0 && info.st_size > 0) {
+        length = (size_t)info.st_size;
+        void* mapped = mmap(nullptr, length, PROT_READ, MAP_PRIVATE, fd, 0);
+        if (mapped != MAP_FAILED) {
+            data = static_cast<const unsigned char*>(mapped);
+            mappedLength = length;
+            madvise(mapped, length, MADV_SEQUENTIAL);   // read once front to back
+        }
+    }
+#endif
+    if (data == nullptr) {
+        // no mmap, read the file into memory instead
+        ifstream in(path, ios::binary);
+        if (!in) {
+            throw runtime_error("cannot open trace: " + path);
+        }
+        fallback.assign(istreambuf_iterator<char>(in), istreambuf_iterator<char>());
+        data = fallback.data();
+        length = fallback.size();
+    }
+
+    if (length < TRACE_HEADER_SIZE || memcmp(data, TRACE_MAGIC, sizeof(TRACE_MAGIC)) != 0) {
+        throw runtime_error("not a binary trace: " + path);
+    }
+    if (readValue<uint32_t>(data + 8) != TRACE_VERSION) {
+        throw runtime_error("unsupported trace version: " + path);
+    }
+    recordCount = readValue<uint64_t>(data + 16);
+    uint64_t resourceOffset = readValue<uint64_t>(data + 32);
+    if (resourceOffset < TRACE_HEADER_SIZE || resourceOffset + 4 > length) {
+        throw runtime_error("corrupt trace (resource table): " + path);
+    }
+
+    // resource table
+    size_t at = resourceOffset;
+    uint32_t count = readValue<uint32_t>(data + at);
+    at = at + 4;
+    for (uint32_t i = 0; i < count; i++) {
+        if (at + 4 > length) throw runtime_error("corrupt trace (resource table): " + path);
+        uint32_t size = readValue<uint32_t>(data + at);
+        at = at + 4;
+        if (at + size > length) throw runtime_error("corrupt trace (resource table): " + path);
+        resources.push_back(string(reinterpret_cast<const char*>(data + at), size));
+        at = at + size;
+    }
+    if (resources.empty()) {
+        resources.push_back("");
+    }
+
+    length = resourceOffset;   // blocks end where the resource table starts
+    blockOffset = TRACE_HEADER_SIZE;
+    blockRecords = 0;
+    blockIndex = 0;
+    blockPhasesLeft = 0;
+}
+
+BinaryTraceSource::~BinaryTraceSource() {
+#ifndef _WIN32
+    if (mappedLength > 0) {
+        munmap(const_cast<unsigned char*>(data), mappedLength);
+    }
+    if (fd >= 0) {
+        ::close(fd);
+    }
+#endif
+}
+
+// point the column pointers at the next block
+bool BinaryTraceSource::loadBlock() {
+    if (blockOffset + TRACE_BLOCK_HEADER_SIZE > length) return false;
+
+    const unsigned char* at = data + blockOffset;
+    uint32_t records = readValue<uint32_t>(at);
+    uint64_t phases = readValue<uint64_t>(at + 8);
+    if (phases > length / 4) {
+        throw runtime_error("corrupt trace block at offset " + to_string(blockOffset));
+    }
+    size_t bytes = TRACE_BLOCK_HEADER_SIZE + (size_t)records * (4 + 8 + 4 + 4 + 4 + 4) + (size_t)phases * 4;
+    if (records == 0 || blockOffset + bytes > length) {
+        throw runtime_error("corrupt trace block at offset " + to_string(blockOffset));
+    }
+
+    at = at + TRACE_BLOCK_HEADER_SIZE;
+    pidColumn = at;        at = at + records * 4;
+    arrivalColumn = at;    at = at + records * 8;
+    priorityColumn = at;   at = at + records * 4;
+    memoryColumn = at;     at = at + records * 4;
+    resourceColumn = at;   at = at + records * 4;
+    phaseCountColumn = at; at = at + records * 4;
+    phaseColumn = at;
+
+    blockRecords = records;
+    blockIndex = 0;
+    blockPhasesLeft = phases;
+    blockOffset = blockOffset + bytes;
+    return true;
+}
+
+bool BinaryTraceSource::next(TraceRecord& r) {
+    if (blockIndex >= blockRecords && !loadBlock()) {
+        return false;
+    }
+    size_t i = blockIndex;
+    r.pid = readValue<int32_t>(pidColumn + i * 4);
+    r.arrival = readValue<int64_t>(arrivalColumn + i * 8);
+    r.priority = readValue<int32_t>(priorityColumn + i * 4);
+    r.memory = readValue<int32_t>(memoryColumn + i * 4);
+    int32_t resource = readValue<int32_t>(resourceColumn + i * 4);
+    r.resource = resource > 0 && resource < (int32_t)resources.size() ? resources[resource] : string();
+
+    // the block header says how many phases its records have together, a count beyond
+    // what is left would read past the block
+    int32_t phaseCount = readValue<int32_t>(phaseCountColumn + i * 4);
+    if (phaseCount < 0 || (uint64_t)phaseCount > blockPhasesLeft) {
+        throw runtime_error("corrupt trace record " + to_string(i) + " in block ending at offset " + to_string(blockOffset)
+                            + ": " + to_string(phaseCount) + " phases, " + to_string(blockPhasesLeft) + " left");
+    }
+    blockPhasesLeft = blockPhasesLeft - phaseCount;
+    r.phases.resize(phaseCount);
+    if (phaseCount > 0) {
+        memcpy(r.phases.data(), phaseColumn, phaseCount * sizeof(int32_t));
+    }
+    phaseColumn = phaseColumn + phaseCount * 4;   // phases of the records are stored back to back
+
+    blockIndex = blockIndex + 1;
+    return true;
+}
+
+long long BinaryTraceSource::size() const {
+    return (long long)recordCount;
+}
+
+string BinaryTraceSource::format() const {
+    return "binary";
+}
+
+
+// ---------------- helpers ----------------
+
+unique_ptr<TraceSource> openTrace(const string& path) {
+    ifstream probe(path, ios::binary);
+    if (!probe) {
+        throw runtime_error("cannot open trace: " + path);
+    }
+    char magic[sizeof(TRACE_MAGIC)] = {0};
+    probe.read(magic, sizeof(magic));
+    probe.close();
+    if (memcmp(magic, TRACE_MAGIC, sizeof(TRACE_MAGIC)) == 0) {
+        return unique_ptr<TraceSource>(new BinaryTraceSource(path));
+    }
+
+    string lower = path;
+    transform(lower.begin(), lower.end(), lower.begin(), ::tolower);
+    if (lower.size() >= 5 && lower.compare(lower.size() - 5, 5, ".json") == 0) {
+        return unique_ptr<TraceSource>(new JsonTraceSource(path));
+    }
+    return unique_ptr<TraceSource>(new CsvTraceSource(path));
+}
+
+long long convertTrace(TraceSource& source, const string& binaryPath) {
+    BinaryTraceWriter writer(binaryPath);
+    if (!writer.good()) {
+        throw runtime_error("cannot write trace: " + binaryPath);
+    }
+    TraceRecord r;
+    long long count = 0;
+    while (source.next(r)) {
+        writer.write(r);
+        count = count + 1;
+    }
+    writer.close();
+    return count;
+}
+
+
+// ---------------- replay ----------------
+
+TraceReplayer::TraceReplayer(Scheduler* scheduler, MemoryManager* memory, long long window) {
+    this->scheduler = scheduler;
+    this->memory = memory;
+    this->window = window > 0 ? window : 1;
+    endTime = 0;
+    reclaimAt = 1024;
+}
+
+void TraceReplayer::setEndTime(long long time) {
+    endTime = time;
+}
+
+// give PCBs of finished processes back to the pool
+void TraceReplayer::reclaim() {
+    size_t kept = 0;
+    for (size_t i = 0; i < live.size(); i++) {
+        if (live[i]->state == ProcessState::TERMINATED) {
+            pool.release(live[i]);
+        } else {
+            live[kept] = live[i];
+            kept = kept + 1;
+        }
+    }
+    live.resize(kept);
+    reclaimAt = max((size_t)1024, kept * 2);
+}
+
+ReplayResult TraceReplayer::replay(TraceSource& source) {
+    return replayInto(*scheduler, source);
+}
@@ -0,0 +1,568 @@
+#include "virtual_memory.h"
+#include "snapshot.h"
+#include <deque>
+
+using namespace std;
+
+// ---------------- replacement strategies ----------------
+
+// First In First Out - evict the page that was loaded first
+class FIFOStrategy : public ReplacementStrategy {
+private:
+    deque<pair<int, uint64_t>> order;   // (frame, load_seq) in load order
+
+public:
+    void onLoad(int frame, const vector<FrameInfo>& frames) override {
+        order.push_back(make_pair(frame, frames[frame].load_seq));
+    }
+    void onAccess(int frame, const vector<FrameInfo>& frames) override {}
+    void onFree(int frame, const vector<FrameInfo>& frames) override {}  // stale entries are skipped later
+
+    int chooseVictim(vector<FrameInfo>& frames, long long now) override {
+        while (!order.empty()) {
+            pair<int, uint64_t> oldest = order.front();
+            order.pop_front();
+            // entry is still valid only if the frame holds the same load
+            if (frames[oldest.first].pid >= 0 && frames[oldest.first].load_seq == oldest.second) {
+                return oldest.first;
+            }
+        }
+        return 0;
+    }
+    string name() const override { return "FIFO"; }
+
+    void saveState(SnapshotWriter& out) const override {
+        out.put((uint64_t)order.size());
+        for (size_t i = 0; i < order.size(); i++) out.put(order[i]);
+    }
+    void loadState(SnapshotReader& in) override {
+        order.resize(in.get<uint64_t>());
+        for (size_t i = 0; i < order.size(); i++) in.get(order[i]);
+    }
+};
+
+// Least Recently Used - intrusive doubly linked list over the frames, all operations O(1)
+class LRUStrategy : public ReplacementStrategy {
+private:
+    vector<int> prev, next;
+    vector<bool> linked;
+    int head;   // most recently used
+    int tail;   // least recently used
+
+    void unlink(int f) {
+        if (!linked[f]) return;
+        if (prev[f] >= 0) next[prev[f]] = next[f]; else head = next[f];
+        if (next[f] >= 0) prev[next[f]] = prev[f]; else tail = prev[f];
+        linked[f] = false;
+    }
+    void pushFront(int f) {
+        prev[f] = -1;
+        next[f] = head;
+        if (head >= 0) prev[head] = f;
+        head = f;
+        if (tail < 0) tail = f;
+        linked[f] = true;
+    }
+
+public:
+    LRUStrategy(int frames) : prev(frames, -1), next(frames, -1), linked(frames, false), head(-1), tail(-1) {}
+
+    void onLoad(int frame, const vector<FrameInfo>& frames) override { pushFront(frame); }
+    void onAccess(int frame, const vector<FrameInfo>& frames) override {
+        unlink(frame);
+        pushFront(frame);
+    }
+    void onFree(int frame, const vector<FrameInfo>& frames) override { unlink(frame); }
+
+    int chooseVictim(vector<FrameInfo>& frames, long long now) override {
+        int victim = tail;
+        unlink(victim);
+        return victim;
+    }
+    string name() const override { return "LRU"; }
+
+    void saveState(SnapshotWriter& out) const override {
+        out.putVector(prev);
+        out.putVector(next);
+        for (size_t f = 0; f < linked.size(); f++) out.put((bool)linked[f]);
+        out.put(head);
+        out.put(tail);
+    }
+    void loadState(SnapshotReader& in) override {
+        in.getVector(prev);
+        in.getVector(next);
+        linked.assign(prev.size(), false);
+        for (size_t f = 0; f < linked.size(); f++) linked[f] = in.get<bool>();
+        in.get(head);
+        in.get(tail);
+    }
+};
+
+// Least Frequently Used - ordered set on (use count, last use), ties go to the older page
+class LFUStrategy : public ReplacementStrategy {
+private:
+    set<tuple<uint64_t, long long, int>> order;
+    vector<tuple<uint64_t, long long, int>> keys;   // current key of every frame
+    vector<bool> present;
+
+public:
+    LFUStrategy(int frames) : keys(frames), present(frames, false) {}
+
+    void onLoad(int frame, const vector<FrameInfo>& frames) override {
+        keys[frame] = make_tuple(frames[frame].use_count, frames[frame].last_use, frame);
+        order.insert(keys[frame]);
+        present[frame] = true;
+    }
+    void onAccess(int frame, const vector<FrameInfo>& frames) override {
+        if (present[frame]) order.erase(keys[frame]);
+        onLoad(frame, frames);
+    }
+    void onFree(int frame, const vector<FrameInfo>& frames) override {
+        if (!present[frame]) return;
+        order.erase(keys[frame]);
+        present[frame] = false;
+    }
+
+    int chooseVictim(vector<FrameInfo>& frames, long long now) override {
+        int victim = get<2>(*order.begin());
+        order.erase(order.begin());
+        present[victim] = false;
+        return victim;
+    }
+    string name() const override { return "LFU"; }
+
+    // the order set is rebuilt from the keys of the frames that are in it
+    void saveState(SnapshotWriter& out) const override {
+        out.put((uint64_t)keys.size());
+        for (size_t f = 0; f < keys.size(); f++) {
+            out.put(get<0>(keys[f]));
+            out.put(get<1>(keys[f]));
+            out.put(get<2>(keys[f]));
+            out.put((bool)present[f]);
+        }
+    }
+    void loadState(SnapshotReader& in) override {
+        keys.resize(in.get<uint64_t>());
+        present.assign(keys.size(), false);
+        order.clear();
+        for (size_t f = 0; f < keys.size(); f++) {
+            uint64_t count = in.get<uint64_t>();
+            long long lastUse = in.get<long long>();
+            int frame = in.get<int>();
+            keys[f] = make_tuple(count, lastUse, frame);
+            present[f] = in.get<bool>();
+            if (present[f]) order.insert(keys[f]);
+        }
+    }
+};
+
+// Clock (second chance) - hand sweeps frames, referenced pages get another round
+class ClockStrategy : public ReplacementStrategy {
+private:
+    int hand;
+
+public:
+    ClockStrategy() : hand(0) {}
+
+    void onLoad(int frame, const vector<FrameInfo>& frames) override {}
+    void onAccess(int frame, const vector<FrameInfo>& frames) override {}
+    void onFree(int frame, const vector<FrameInfo>& frames) override {}
+
+    int chooseVictim(vector<FrameInfo>& frames, long long now) override {
+        int n = (int)frames.size();
+        while (true) {
+            int f = hand;
+            hand = (hand + 1) % n;
+            if (frames[f].referenced) {
+                frames[f].referenced = false;  // second chance
+            } else {
+                return f;
+            }
+        }
+    }
+    string name() const override { return "Clock"; }
+
+    void saveState(SnapshotWriter& out) const override { out.put(hand); }
+    void loadState(SnapshotReader& in) override { in.get(hand); }
+};
+
+// Working set (WSClock) - evict a page that was not used within the window,
+// if every page is in some working set fall back to the least recently used one seen
+class WorkingSetStrategy : public ReplacementStrategy {
+private:
+    int hand;
+    long long window;
+
+public:
+    WorkingSetStrategy(long long window) : hand(0), window(window) {}
+
+    void onLoad(int frame, const vector<FrameInfo>& frames) override {}
+    void onAccess(int frame, const vector<FrameInfo>& frames) override {}
+    void onFree(int frame, const vector<FrameInfo>& frames) override {}
+
+    int chooseVictim(vector<FrameInfo>& frames, long long now) override {
+        int n = (int)frames.size();
+        int oldest = hand;
+        for (int i = 0; i < n; i++) {
+            int f = hand;
+            hand = (hand + 1) % n;
+            if (frames[f].referenced) {
+                frames[f].referenced = false;
+                frames[f].last_use = now;
+            } else if (now - frames[f].last_use > window) {
+                return f;  // outside the working set
+            }
+            if (frames[f].last_use < frames[oldest].last_use) {
+                oldest = f;
+            }
+        }
+        return oldest;
+    }
+    string name() const override { return "Working-Set"; }
+
+    void saveState(SnapshotWriter& out) const override {
+        out.put(hand);
+        out.put(window);
+    }
+    void loadState(SnapshotReader& in) override {
+        in.get(hand);
+        in.get(window);
+    }
+};
+
+unique_ptr<ReplacementStrategy> createReplacementStrategy(ReplacementPolicy policy, int frames, int wsWindow) {
+    switch (policy) {
+        case ReplacementPolicy::FIFO: return unique_ptr<ReplacementStrategy>(new FIFOStrategy());
+        case ReplacementPolicy::LRU: return unique_ptr<ReplacementStrategy>(new LRUStrategy(frames));
+        case ReplacementPolicy::LFU: return unique_ptr<ReplacementStrategy>(new LFUStrategy(frames));
+        case ReplacementPolicy::CLOCK: return unique_ptr<ReplacementStrategy>(new ClockStrategy());
+        case ReplacementPolicy::WORKING_SET: return unique_ptr<ReplacementStrategy>(new WorkingSetStrategy(wsWindow));
+    }
+    return nullptr;
+}
+
+// ---------------- VirtualMemory ----------------
+
+VirtualMemory::VirtualMemory(int frames, int swapSlots, ReplacementPolicy policy, int wsWindow) {
+    if (frames < 1) frames = 1;
+    if (swapSlots < 0) swapSlots = 0;
+    this->frames.resize(frames);
+    // hand out low frame numbers first
+    for (int i = frames - 1; i >= 0; i--) {
+        freeFrames.push_back(i);
+    }
+    for (int i = swapSlots - 1; i >= 0; i--) {
+        freeSwapSlots.push_back(i);
+    }
+    this->swapSlots = swapSlots;
+    committedPages = 0;
+    nextLoadSeq = 0;
+    strategy = createReplacementStrategy(policy, frames, wsWindow);
+}
+
+// a process can be admitted as long as its pages fit in RAM + swap together
+bool VirtualMemory::createProcess(int pid, int pages) {
+    if (pages < 1) pages = 1;
+    if (processes.count(pid) > 0) return false;
+    if (committedPages + pages > (int)frames.size() + swapSlots) return false;
+
+    ProcessPages& proc = processes[pid];
+    proc.table.resize(pages);
+    proc.rng = 0x9E3779B97F4A7C15ULL ^ ((uint64_t)pid * 0xBF58476D1CE4E5B9ULL);
+    committedPages = committedPages + pages;
+    return true;
+}
+
+// give every frame and swap slot of the process back
+void VirtualMemory::destroyProcess(int pid) {
+    auto it = processes.find(pid);
+    if (it == processes.end()) return;
+
+    vector<PageTableEntry>& table = it->second.table;
+    for (size_t i = 0; i < table.size(); i++) {
+        if (table[i].present) {
+            int f = table[i].frame;
+            chargeFrame(it->second.group, f, -1);
+            strategy->onFree(f, frames);
+            frames[f] = FrameInfo();
+            freeFrames.push_back(f);
+        }
+        if (table[i].swap_slot >= 0) {
+            freeSwapSlots.push_back(table[i].swap_slot);
+        }
+    }
+    committedPages = committedPages - (int)table.size();
+    processes.erase(it);
+}
+
+// free frame if there is one, otherwise ask the policy for a victim
+int VirtualMemory::takeFrame(long long now) {
+    if (!freeFrames.empty()) {
+        int f = freeFrames.back();
+        freeFrames.pop_back();
+        return f;
+    }
+    int victim = strategy->chooseVictim(frames, now);
+    evict(victim);
+    return victim;
+}
+
+// push the page in frame f out, dirty pages are written to swap
+// a page that was never written can simply be dropped, it comes back zero filled
+void VirtualMemory::evict(int f) {
+    FrameInfo& info = frames[f];
+    ProcessPages& owner = processes[info.pid];
+    chargeFrame(owner.group, f, -1);
+    PageTableEntry& pte = owner.table[info.page];
+    if (info.dirty && !freeSwapSlots.empty()) {
+        pte.swap_slot = freeSwapSlots.back();
+        freeSwapSlots.pop_back();
+        stats.swap_outs = stats.swap_outs + 1;
+    }
+    pte.present = false;
+    pte.frame = -1;
+    info = FrameInfo();
+    stats.evictions = stats.evictions + 1;
+}
+
+// reference a page, loads it on a fault
+bool VirtualMemory::access(int pid, int page, bool write, long long now) {
+    auto it = processes.find(pid);
+    if (it == processes.end()) return false;
+    ProcessPages& proc = it->second;
+    if (page < 0 || page >= (int)proc.table.size()) return false;
+
+    PageTableEntry& pte = proc.table[page];
+    stats.accesses = stats.accesses + 1;
+    proc.stats.accesses = proc.stats.accesses + 1;
+
+    if (pte.present) {
+        FrameInfo& info = frames[pte.frame];
+        info.last_use = now;
+        info.use_count = info.use_count + 1;
+        info.referenced = true;
+        if (write) info.dirty = true;
+        strategy->onAccess(pte.frame, frames);
+        return false;
+    }
+
+    // page fault
+    stats.faults = stats.faults + 1;
+    proc.stats.faults = proc.stats.faults + 1;
+
+    // read the page back first so its swap slot is free for the victim
+    bool fromSwap = false;
+    if (pte.swap_slot >= 0) {
+        freeSwapSlots.push_back(pte.swap_slot);
+        pte.swap_slot = -1;
+        stats.swap_ins = stats.swap_ins + 1;
+        fromSwap = true;
+    }
+    int f = proc.group >= 0 ? reclaimFrame(proc.group) : -1;
+    if (f < 0) {
+        f = takeFrame(now);
+    }
+
+    FrameInfo& info = frames[f];
+    info.pid = pid;
+    info.page = page;
+    info.loaded_at = now;
+    info.last_use = now;
+    info.use_count = 1;
+    info.load_seq = nextLoadSeq;
+    nextLoadSeq = nextLoadSeq + 1;
+    info.referenced = true;
+    info.dirty = write || fromSwap;  // swap copy was released, so the frame is the only copy
+
+    pte.frame = f;
+    pte.present = true;
+    strategy->onLoad(f, frames);
+    chargeFrame(proc.group, f, 1);
+    return true;
+}
+
+// count a frame for group and everything above it, limited groups remember the load
+void VirtualMemory::chargeFrame(int group, int frame, int delta) {
+    for (int g = group; g >= 0; g = groups[g].parent) {
+        groups[g].resident = groups[g].resident + delta;
+        if (delta > 0 && groups[g].limit > 0) {
+            deque<pair<int, uint64_t>>& loads = groupLoads[g];
+            loads.push_back(make_pair(frame, frames[frame].load_seq));
+            // drop the entries of pages that are gone before they pile up
+            if (loads.size() > 2 * (size_t)groups[g].resident + 64) {
+                deque<pair<int, uint64_t>> live;
+                for (size_t i = 0; i < loads.size(); i++) {
+                    const FrameInfo& info = frames[loads[i].first];
+                    if (info.pid >= 0 && info.load_seq == loads[i].second) live.push_back(loads[i]);
+                }
+                loads.swap(live);
+            }
+        }
+    }
+}
+
+// the lowest group on the way up that is at its limit gives up its oldest page, -1 when
+// none is full. a page pushed out of a child counts against every group above it too
+int VirtualMemory::reclaimFrame(int group) {
+    int full = -1;
+    for (int g = group; g >= 0 && full < 0; g = groups[g].parent) {
+        if (groups[g].limit > 0 && groups[g].resident >= groups[g].limit) full = g;
+    }
+    if (full < 0) return -1;
+    deque<pair<int, uint64_t>>& loads = groupLoads[full];
+    while (!loads.empty()) {
+        pair<int, uint64_t> oldest = loads.front();
+        loads.pop_front();
+        const FrameInfo& info = frames[oldest.first];
+        if (info.pid < 0 || info.load_seq != oldest.second) continue;   // freed or loaded again since
+        strategy->onFree(oldest.first, frames);
+        evict(oldest.first);
+        groups[full].reclaims = groups[full].reclaims + 1;
+        return oldest.first;
+    }
+    return -1;
+}
+
+// 80% of references hit the hottest 20% of pages, 30% of references are writes
+int VirtualMemory::touchWorkingSet(int pid, int count, long long now) {
+    auto it = processes.find(pid);
+    if (it == processes.end()) return 0;
+    ProcessPages& proc = it->second;
+    int pages = (int)proc.table.size();
+    int hot = pages / 5 > 0 ? pages / 5 : 1;
+
+    int faults = 0;
+    for (int i = 0; i < count; i++) {
+        // xorshift64*
+        proc.rng ^= proc.rng >> 12;
+        proc.rng ^= proc.rng << 25;
+        proc.rng ^= proc.rng >> 27;
+        uint64_t r = proc.rng * 0x2545F4914F6CDD1DULL;
+
+        int page;
+        if (r % 10 < 8) {
+            page = (int)((r >> 16) % (uint64_t)hot);
+        } else {
+            page = (int)((r >> 16) % (uint64_t)pages);
+        }
+        bool write = ((r >> 8) % 10) < 3;
+        if (access(pid, page, write, now)) {
+            faults = faults + 1;
+        }
+    }
+    return faults;
+}
+
+const PageStats* VirtualMemory::processStats(int pid) const {
+    auto it = processes.find(pid);
+    if (it == processes.end()) return nullptr;
+    return &it->second.stats;
+}
+
+const VirtualMemoryStats& VirtualMemory::totals() const {
+    return stats;
+}
+
+int VirtualMemory::frameCount() const {
+    return (int)frames.size();
+}
+
+int VirtualMemory::freeFrameCount() const {
+    return (int)freeFrames.size();
+}
+
+int VirtualMemory::uncommittedPages() const {
+    return (int)frames.size() + swapSlots - committedPages;
+}
+
+int VirtualMemory::residentPages(int pid) const {
+    auto it = processes.find(pid);
+    if (it == processes.end()) return 0;
+    int count = 0;
+    for (size_t i = 0; i < it->second.table.size(); i++) {
+        if (it->second.table[i].present) count = count + 1;
+    }
+    return count;
+}
+
+void VirtualMemory::setChargeGroup(int group, int parent, int limit) {
+    if (group < 0) return;
+    if (group >= (int)groups.size()) {
+        groups.resize(group + 1);
+        groupLoads.resize(group + 1);
+    }
+    groups[group].parent = parent >= 0 && parent < group ? parent : -1;
+    groups[group].limit = limit > 0 ? limit : 0;
+}
+
+void VirtualMemory::setProcessGroup(int pid, int group) {
+    auto it = processes.find(pid);
+    if (it == processes.end() || group >= (int)groups.size()) return;
+    it->second.group = group;
+}
+
+int VirtualMemory::groupResident(int group) const {
+    return group >= 0 && group < (int)groups.size() ? groups[group].resident : 0;
+}
+
+uint64_t VirtualMemory::groupReclaims(int group) const {
+    return group >= 0 && group < (int)groups.size() ? groups[group].reclaims : 0;
+}
+
+string VirtualMemory::policyName() const {
+    return strategy->name();
+}
+
+void VirtualMemory::saveState(SnapshotWriter& out) const {
+    out.putVector(frames);
+    out.putVector(freeFrames);
+    out.putVector(freeSwapSlots);
+    out.put(swapSlots);
+    out.put(committedPages);
+    out.put(nextLoadSeq);
+    out.put((uint64_t)processes.size());
+    for (auto it = processes.begin(); it != processes.end(); it++) {
+        out.put(it->first);
+        out.putVector(it->second.table);
+        out.put(it->second.stats);
+        out.put(it->second.rng);
+        out.put(it->second.group);
+    }
+    out.put(stats);
+    strategy->saveState(out);
+    out.putVector(groups);
+    for (size_t g = 0; g < groupLoads.size(); g++) {
+        out.putAll(groupLoads[g]);
+    }
+}
+
+void VirtualMemory::loadState(SnapshotReader& in) {
+    in.getVector(frames);
+    in.getVector(freeFrames);
+    in.getVector(freeSwapSlots);
+    in.get(swapSlots);
+    in.get(committedPages);
+    in.get(nextLoadSeq);
+    processes.clear();
+    uint64_t n = in.get<uint64_t>();
+    for (uint64_t i = 0; i < n; i++) {
+        int pid = in.get<int>();
+        ProcessPages& proc = processes[pid];
+        in.getVector(proc.table);
+        in.get(proc.stats);
+        in.get(proc.rng);
+        in.get(proc.group);
+    }
+    in.get(stats);
+    strategy->loadState(in);
+    in.getVector(groups);
+    groupLoads.assign(groups.size(), deque<pair<int, uint64_t>>());
+    for (size_t g = 0; g < groupLoads.size(); g++) {
+        uint64_t n = in.get<uint64_t>();
+        for (uint64_t i = 0; i < n; i++) {
+            pair<int, uint64_t> load;
+            in.get(load);
+            groupLoads[g].push_back(load);
+        }
+    }
+}
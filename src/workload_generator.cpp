@@ -0,0 +1,334 @@
+#include "workload_generator.h"
+#include "experiment.h"
+#include "snapshot.h"
+#include <cmath>
+#include <algorithm>
+
+using namespace std;
+
+// arrival times are summed as integers in 1/65536 ticks, integer addition is associative
+// so the result does not depend on how the records were split up
+static const int ARRIVAL_SHIFT = 16;
+
+// ---------------- Philox ----------------
+
+static const uint32_t PHILOX_M0 = 0xD2511F53;
+static const uint32_t PHILOX_M1 = 0xCD9E8D57;
+static const uint32_t PHILOX_W0 = 0x9E3779B9;
+static const uint32_t PHILOX_W1 = 0xBB67AE85;
+
+void Philox4x32::generate(const uint32_t counter[4], const uint32_t key[2], uint32_t out[4]) {
+    uint32_t c0 = counter[0], c1 = counter[1], c2 = counter[2], c3 = counter[3];
+    uint32_t k0 = key[0], k1 = key[1];
+    for (int round = 0; round < 10; round++) {
+        uint64_t p0 = (uint64_t)PHILOX_M0 * c0;
+        uint64_t p1 = (uint64_t)PHILOX_M1 * c2;
+        uint32_t n0 = (uint32_t)(p1 >> 32) ^ c1 ^ k0;
+        uint32_t n2 = (uint32_t)(p0 >> 32) ^ c3 ^ k1;
+        c1 = (uint32_t)p1;
+        c3 = (uint32_t)p0;
+        c0 = n0;
+        c2 = n2;
+        k0 = k0 + PHILOX_W0;
+        k1 = k1 + PHILOX_W1;
+    }
+    out[0] = c0;
+    out[1] = c1;
+    out[2] = c2;
+    out[3] = c3;
+}
+
+// block of 4 random words for (record, stream)
+static inline void philoxBlock(const uint32_t key[2], uint64_t index, uint32_t stream, uint32_t out[4]) {
+    uint32_t counter[4] = {(uint32_t)index, (uint32_t)(index >> 32), stream, 0};
+    Philox4x32::generate(counter, key, out);
+}
+
+// 53 bit uniform in (0, 1] from two words, never 0 so log() is safe
+static inline double unitDouble(uint32_t a, uint32_t b) {
+    uint64_t bits = ((uint64_t)(a >> 5) << 26) | (b >> 6);
+    return (bits + 1) * (1.0 / 9007199254740992.0);
+}
+
+// uniform in [low, high] without modulo bias worth caring about
+static inline int uniformInt(uint32_t w, int low, int high) {
+    if (high <= low) return low;
+    uint64_t range = (uint64_t)(high - low) + 1;
+    return low + (int)(((uint64_t)w * range) >> 32);
+}
+
+// ---------------- CounterRng ----------------
+
+CounterRng::CounterRng(uint64_t seed, uint32_t stream) {
+    key[0] = (uint32_t)seed;
+    key[1] = (uint32_t)(seed >> 32);
+    this->stream = stream;
+    seek(0);
+}
+
+void CounterRng::seek(uint64_t block) {
+    position = block;
+    used = 4;   // buffer is refilled on the next call
+}
+
+void CounterRng::saveState(SnapshotWriter& out) const {
+    out.put(key[0]);
+    out.put(key[1]);
+    out.put(stream);
+    out.put(position);
+    out.bytes(buffer, sizeof(buffer));
+    out.put(used);
+}
+
+void CounterRng::loadState(SnapshotReader& in) {
+    in.get(key[0]);
+    in.get(key[1]);
+    in.get(stream);
+    in.get(position);
+    in.bytes(buffer, sizeof(buffer));
+    in.get(used);
+}
+
+uint32_t CounterRng::nextU32() {
+    if (used == 4) {
+        philoxBlock(key, position, stream, buffer);
+        position = position + 1;
+        used = 0;
+    }
+    uint32_t value = buffer[used];
+    used = used + 1;
+    return value;
+}
+
+double CounterRng::nextDouble() {
+    uint32_t a = nextU32();
+    uint32_t b = nextU32();
+    return unitDouble(a, b);
+}
+
+int CounterRng::nextInt(int low, int high) {
+    return uniformInt(nextU32(), low, high);
+}
+
+// ---------------- ZipfTable ----------------
+
+ZipfTable::ZipfTable(int n, double s) {
+    if (n < 1) n = 1;
+    cdf.resize(n);
+    double total = 0;
+    for (int k = 0; k < n; k++) {
+        total = total + 1.0 / pow((double)(k + 1), s);
+        cdf[k] = total;
+    }
+    for (int k = 0; k < n; k++) {
+        cdf[k] = cdf[k] / total;
+    }
+    cdf[n - 1] = 1.0;
+}
+
+// binary search in the cumulative weights
+int ZipfTable::sample(double u) const {
+    int k = (int)(lower_bound(cdf.begin(), cdf.end(), u) - cdf.begin());
+    return k < (int)cdf.size() ? k : (int)cdf.size() - 1;
+}
+
+int ZipfTable::size() const {
+    return (int)cdf.size();
+}
+
+// ---------------- WorkloadBatch ----------------
+
+void WorkloadBatch::resize(size_t n) {
+    pid.resize(n);
+    arrival.resize(n);
+    burst.resize(n);
+    priority.resize(n);
+    memory.resize(n);
+    resource.resize(n);
+    io.resize(n);
+    cpu_before_io.resize(n);
+}
+
+size_t WorkloadBatch::size() const {
+    return pid.size();
+}
+
+// ---------------- WorkloadGenerator ----------------
+
+WorkloadGenerator::WorkloadGenerator(const WorkloadConfig& config)
+    : zipf(max(1, (int)config.resources.size()), config.zipf_s) {
+    this->config = config;
+    if (this->config.resources.empty()) {
+        this->config.resources.push_back("");
+    }
+    key[0] = (uint32_t)config.seed;
+    key[1] = (uint32_t)(config.seed >> 32);
+}
+
+void WorkloadGenerator::fill(uint64_t first, size_t n, WorkloadBatch& out, size_t offset) const {
+    const WorkloadConfig& c = config;
+    double gapMean = c.arrival_rate > 0 ? (1 << ARRIVAL_SHIFT) / c.arrival_rate : 0;
+    double inverseShape = c.pareto_shape > 0 ? 1.0 / c.pareto_shape : 1.0;
+    long long arrivalFixed = 0;
+
+    for (size_t k = 0; k < n; k++) {
+        uint64_t index = first + k;
+        size_t at = offset + k;
+        uint32_t a[4], b[4];
+        philoxBlock(key, index, 0, a);   // arrival, burst
+        philoxBlock(key, index, 1, b);   // priority, memory, resource
+
+        out.pid[at] = (int)(index + 1);
+
+        // exponential gaps between arrivals = Poisson arrival process
+        if (gapMean > 0) {
+            arrivalFixed = arrivalFixed + (long long)(-gapMean * log(unitDouble(a[0], a[1])));
+        }
+        out.arrival[at] = arrivalFixed;
+
+        int burst;
+        if (c.burst == BurstDistribution::UNIFORM) {
+            burst = uniformInt(a[2], c.burst_min, c.burst_max);
+        } else {
+            double u = unitDouble(a[2], a[3]);
+            double value;
+            if (c.burst == BurstDistribution::EXPONENTIAL) {
+                value = -c.burst_mean * log(u);
+            } else {
+                value = c.burst_min / pow(u, inverseShape);   // heavy tail
+            }
+            value = ceil(value);
+            if (value < c.burst_min) value = c.burst_min;
+            if (value > c.burst_max) value = c.burst_max;
+            burst = (int)value;
+        }
+        out.burst[at] = burst;
+
+        out.priority[at] = uniformInt(b[0], 0, c.priority_levels - 1);
+        if ((b[1] >> 8) * (1.0 / 16777216.0) < c.small_fraction) {
+            out.memory[at] = uniformInt(b[2], c.small_min, c.small_max);
+        } else {
+            out.memory[at] = uniformInt(b[2], c.large_min, c.large_max);
+        }
+        out.resource[at] = zipf.sample((b[3] + 1.0) * (1.0 / 4294967296.0));
+
+        out.io[at] = 0;
+        out.cpu_before_io[at] = burst;
+        if (c.io_probability > 0 && burst >= 2) {
+            uint32_t d[4];
+            philoxBlock(key, index, 2, d);   // I/O
+            if ((d[0] >> 8) * (1.0 / 16777216.0) < c.io_probability) {
+                int io = (int)ceil(-c.io_mean * log(unitDouble(d[1], d[2])));
+                out.io[at] = io < 1 ? 1 : io;
+                out.cpu_before_io[at] = uniformInt(d[3], 1, burst - 1);
+            }
+        }
+    }
+}
+
+long long WorkloadGenerator::generateBatch(uint64_t first, size_t n, long long arrivalBase, WorkloadBatch& out) const {
+    out.resize(n);
+    fill(first, n, out, 0);
+    long long last = arrivalBase;
+    for (size_t k = 0; k < n; k++) {
+        last = arrivalBase + out.arrival[k];
+        out.arrival[k] = last >> ARRIVAL_SHIFT;
+    }
+    return last;
+}
+
+// every chunk is filled on its own, then chunk arrival sums are chained in order
+WorkloadBatch WorkloadGenerator::generate(int threads) const {
+    WorkloadBatch out;
+    size_t total = config.count > 0 ? (size_t)config.count : 0;
+    out.resize(total);
+    if (total == 0) return out;
+
+    ThreadPool pool(threads);
+    size_t chunks = min(total, (size_t)pool.size() * 4);
+    size_t chunkSize = (total + chunks - 1) / chunks;
+    chunks = (total + chunkSize - 1) / chunkSize;
+
+    for (size_t j = 0; j < chunks; j++) {
+        size_t begin = j * chunkSize;
+        size_t n = min(chunkSize, total - begin);
+        pool.submit([this, &out, begin, n] { fill(begin, n, out, begin); });
+    }
+    pool.wait();
+
+    // arrival offset of every chunk = sum of all gaps before it
+    vector<long long> base(chunks, 0);
+    for (size_t j = 1; j < chunks; j++) {
+        size_t lastOfPrevious = j * chunkSize - 1;
+        base[j] = base[j - 1] + out.arrival[lastOfPrevious];
+    }
+
+    for (size_t j = 0; j < chunks; j++) {
+        size_t begin = j * chunkSize;
+        size_t n = min(chunkSize, total - begin);
+        long long offset = base[j];
+        pool.submit([&out, begin, n, offset] {
+            for (size_t k = begin; k < begin + n; k++) {
+                out.arrival[k] = (offset + out.arrival[k]) >> ARRIVAL_SHIFT;
+            }
+        });
+    }
+    pool.wait();
+    return out;
+}
+
+void WorkloadGenerator::toRecord(const WorkloadBatch& batch, size_t i, TraceRecord& r) const {
+    r.pid = batch.pid[i];
+    r.arrival = batch.arrival[i];
+    r.priority = batch.priority[i];
+    r.memory = batch.memory[i];
+    r.resource = config.resources[batch.resource[i]];
+    r.phases.clear();
+    if (batch.io[i] > 0) {
+        r.phases.push_back(batch.cpu_before_io[i]);
+        r.phases.push_back(batch.io[i]);
+        r.phases.push_back(batch.burst[i] - batch.cpu_before_io[i]);
+    } else {
+        r.phases.push_back(batch.burst[i]);
+    }
+}
+
+void WorkloadGenerator::toPCB(const WorkloadBatch& batch, size_t i, PCB* p) const {
+    TraceRecord r;
+    toRecord(batch, i, r);
+    traceRecordToPCB(r, p);
+}
+
+const WorkloadConfig& WorkloadGenerator::getConfig() const {
+    return config;
+}
+
+// ---------------- GeneratedTraceSource ----------------
+
+GeneratedTraceSource::GeneratedTraceSource(const WorkloadConfig& config) : generator(config) {
+    batchPosition = 0;
+    nextRecord = 0;
+    arrivalFixed = 0;
+}
+
+bool GeneratedTraceSource::next(TraceRecord& r) {
+    if (batchPosition >= batch.size()) {
+        long long total = generator.getConfig().count;
+        if ((long long)nextRecord >= total) return false;
+        size_t n = (size_t)min((long long)TRACE_BLOCK_RECORDS, total - (long long)nextRecord);
+        arrivalFixed = generator.generateBatch(nextRecord, n, arrivalFixed, batch);
+        nextRecord = nextRecord + n;
+        batchPosition = 0;
+    }
+    generator.toRecord(batch, batchPosition, r);
+    batchPosition = batchPosition + 1;
+    return true;
+}
+
+long long GeneratedTraceSource::size() const {
+    return generator.getConfig().count;
+}
+
+string GeneratedTraceSource::format() const {
+    return "generated";
+}
@@ -0,0 +1,583 @@
+#include <iostream>
+#include <fstream>
+#include <sstream>
+#include <string>
+#include <vector>
+#include <chrono>
+#include <cstdint>
+#include <cstdlib>
+#include "scheduler.h"
+#include "process_queues.h"
+#include "resource_manager.h"
+#include "contiguous_allocator.h"
+#include "event_queue.h"
+#include "scheduling_policy.h"
+#include "trace_loader.h"
+#include "workload_generator.h"
+#include "telemetry.h"
+#include "static_scheduler.h"
+#include "batch_scheduler.h"
+#include "cgroup.h"
+#include "multicore.h"
+
+#ifndef _WIN32
+#include <sys/resource.h>
+#include <sys/wait.h>
+#include <unistd.h>
+#endif
+
+using namespace std;
+
+// simulator benchmarks, one JSON object per line so scripts can diff runs
+//   os_bench [--micro] [--macro] [--ops n] [--policy name] [-o output] [processes ...]
+// without --micro / --macro both parts run. every macro scale runs in its own child
+// process, so the peak RSS reported for it is the peak of that run alone. policies with a
+// pinned StaticScheduler configuration run a second time through it (simulate_static.*)
+
+static volatile uint64_t sink;   // keeps the optimizer from dropping benchmark loops
+
+static double secondsSince(chrono::steady_clock::time_point start) {
+    return chrono::duration<double>(chrono::steady_clock::now() - start).count();
+}
+
+static long long peakRssKb() {
+#ifndef _WIN32
+    struct rusage usage;
+    if (getrusage(RUSAGE_SELF, &usage) == 0) return usage.ru_maxrss;   // KB on Linux
+#endif
+    return -1;
+}
+
+static void report(ostream& out, const string& name, uint64_t ops, double seconds) {
+    out << "{\"suite\":\"micro\",\"name\":\"" << name << "\",\"ops\":" << ops
+        << ",\"seconds\":" << seconds << ",\"ns_per_op\":" << (ops > 0 ? seconds * 1e9 / ops : 0) << "}" << endl;
+}
+
+// ---------------- micro ----------------
+
+// steady state with `resident` processes queued: pick one, charge it a slice, requeue it
+// with a new priority, remaining time and deadline. one op = pickNext + enqueue
+// (every process has a period, so edf and rm keep all of them in their real-time heap)
+static void benchPolicy(ostream& out, const string& name, uint64_t ops) {
+    const size_t resident = 1024;
+    vector<PCB> processes(resident);
+    unique_ptr<SchedulingPolicy> policy = createPolicy(name);
+    CounterRng rng(1, 0);
+    long long now = 0;
+    for (size_t i = 0; i < resident; i++) {
+        processes[i].pid = (int)i + 1;
+        processes[i].priority = rng.nextInt(0, 9);
+        processes[i].burst_time = rng.nextInt(1, 100);
+        processes[i].remaining_time = processes[i].burst_time;
+        processes[i].period = rng.nextInt(10, 100);
+        processes[i].deadline = processes[i].period;
+        policy->enqueue(&processes[i], now);
+    }
+    vector<int> draws(4096);
+    for (size_t i = 0; i < draws.size(); i++) draws[i] = rng.nextInt(1, 100);
+
+    auto start = chrono::steady_clock::now();
+    for (uint64_t i = 0; i < ops; i++) {
+        PCB* p = policy->pickNext(now);
+        int d = draws[i & 4095];
+        policy->onDescheduled(p, 1 + (d & 3), true);
+        p->priority = d % 10;
+        p->remaining_time = d;
+        p->period = 10 + d;
+        p->deadline = now + p->period;
+        now = now + 1;
+        policy->enqueue(p, now);
+    }
+    report(out, "ready_queue." + name, ops, secondsSince(start));
+    sink = sink + policy->size();
+}
+
+// the same loop through CGroupPolicy: 8 tenants of 8 groups each, the processes spread over
+// the 64 leaves with random shares, so every pick walks down three levels
+static void benchCGroupPolicy(ostream& out, uint64_t ops) {
+    const size_t resident = 1024;
+    vector<PCB> processes(resident);
+    ControlGroups groups;
+    CounterRng rng(6, 0);
+    vector<int> leaves;
+    for (int t = 0; t < 8; t++) {
+        CGroupConfig tenant;
+        tenant.shares = rng.nextInt(256, 4096);
+        int parent = groups.create("t" + to_string(t), 0, tenant);
+        for (int g = 0; g < 8; g++) {
+            CGroupConfig leaf;
+            leaf.shares = rng.nextInt(256, 4096);
+            leaves.push_back(groups.create("g" + to_string(g), parent, leaf));
+        }
+    }
+    CGroupPolicy policy(&groups);
+    long long now = 0;
+    for (size_t i = 0; i < resident; i++) {
+        processes[i].pid = (int)i + 1;
+        processes[i].priority = rng.nextInt(0, 9);
+        processes[i].cgroup = leaves[i % leaves.size()];
+        policy.enqueue(&processes[i], now);
+    }
+    vector<int> draws(4096);
+    for (size_t i = 0; i < draws.size(); i++) draws[i] = rng.nextInt(1, 100);
+
+    auto start = chrono::steady_clock::now();
+    for (uint64_t i = 0; i < ops; i++) {
+        PCB* p = policy.pickNext(now);
+        int d = draws[i & 4095];
+        now = now + 1 + (d & 3);
+        policy.onDescheduled(p, 1 + (d & 3), true);
+        p->priority = d % 10;
+        policy.enqueue(p, now);
+    }
+    report(out, "ready_queue.cgroup", ops, secondsSince(start));
+    sink = sink + policy.size();
+}
+
+// the plain FIFO ready queue of ProcessQueues
+static void benchProcessQueues(ostream& out, uint64_t ops) {
+    const size_t resident = 1024;
+    vector<PCB> processes(resident);
+    ProcessQueues queues;
+    for (size_t i = 0; i < resident; i++) {
+        processes[i].pid = (int)i + 1;
+        queues.add_to_ready(&processes[i]);
+    }
+    auto start = chrono::steady_clock::now();
+    for (uint64_t i = 0; i < ops; i++) {
+        queues.add_to_ready(queues.pop_ready());
+    }
+    report(out, "ready_queue.process_queues", ops, secondsSince(start));
+}
+
+// one op = acquire + release. uncontended: each resource has one user,
+// contended: two processes per resource, every release hands it over to the waiter
+static void benchResources(ostream& out, WakePolicy wake, bool contended, uint64_t ops) {
+    const int count = 16;
+    ResourceManager manager(wake);
+    vector<string> names;
+    vector<PCB> processes(count * 2);
+    for (int i = 0; i < count; i++) {
+        names.push_back("r" + to_string(i));
+        manager.add_resource(names[i], wake);
+    }
+    for (size_t i = 0; i < processes.size(); i++) {
+        processes[i].pid = (int)i + 1;
+        processes[i].priority = (int)(i % 10);
+        processes[i].has_resource = false;
+    }
+    vector<PCB*> woken;
+    long long now = 0;
+    if (contended) {
+        // every resource starts with one holder and one waiter
+        for (int i = 0; i < count; i++) {
+            manager.acquire(&processes[i * 2], names[i], AccessMode::EXCLUSIVE, now);
+            manager.acquire(&processes[i * 2 + 1], names[i], AccessMode::EXCLUSIVE, now);
+        }
+    }
+
+    auto start = chrono::steady_clock::now();
+    for (uint64_t i = 0; i < ops; i++) {
+        int r = (int)(i % count);
+        now = now + 1;
+        if (contended) {
+            // the holder lets go, the waiter gets it and the old holder queues up again
+            PCB* holder = processes[r * 2].has_resource ? &processes[r * 2] : &processes[r * 2 + 1];
+            woken.clear();
+            manager.release(holder, names[r], now, woken);
+            manager.acquire(holder, names[r], AccessMode::EXCLUSIVE, now);
+        } else {
+            manager.acquire(&processes[r], names[r], AccessMode::EXCLUSIVE, now);
+            woken.clear();
+            manager.release(&processes[r], names[r], now, woken);
+        }
+    }
+    string name = string("resource.") + (contended ? "contended." : "uncontended.") + wakePolicyName(wake);
+    for (size_t i = 0; i < name.size(); i++) {
+        if (name[i] == ' ') name[i] = '_';
+    }
+    report(out, name, ops, secondsSince(start));
+}
+
+// 4096 live blocks of random sizes, one op = free a random live block + allocate a new one
+static void benchAllocator(ostream& out, ContiguousAllocator* allocator, const string& name, uint64_t ops) {
+    const size_t live = 4096;
+    CounterRng rng(2, 0);
+    vector<long long> addresses(live, -1);
+    vector<long long> sizes(8192);
+    for (size_t i = 0; i < sizes.size(); i++) sizes[i] = rng.nextInt(1, 256);
+    for (size_t i = 0; i < live; i++) addresses[i] = allocator->allocate(sizes[i]);
+    vector<size_t> victims(8192);
+    for (size_t i = 0; i < victims.size(); i++) victims[i] = (size_t)rng.nextInt(0, (int)live - 1);
+
+    uint64_t failed = 0;
+    auto start = chrono::steady_clock::now();
+    for (uint64_t i = 0; i < ops; i++) {
+        size_t v = victims[i & 8191];
+        if (addresses[v] >= 0) allocator->release(addresses[v]);
+        addresses[v] = allocator->allocate(sizes[(i * 7) & 8191]);
+        if (addresses[v] < 0) failed = failed + 1;
+    }
+    report(out, "allocator." + name, ops, secondsSince(start));
+    sink = sink + failed;
+}
+
+// 4096 pending events, one op = pop the earliest + push a new one a little later
+static void benchEventQueue(ostream& out, uint64_t ops) {
+    const size_t pending = 4096;
+    EventQueue events;
+    CounterRng rng(3, 0);
+    vector<int> gaps(4096);
+    for (size_t i = 0; i < gaps.size(); i++) gaps[i] = rng.nextInt(0, 100);
+    for (size_t i = 0; i < pending; i++) events.push(gaps[i], EventType::ARRIVAL, nullptr);
+
+    auto start = chrono::steady_clock::now();
+    for (uint64_t i = 0; i < ops; i++) {
+        Event e = events.pop();
+        events.push(e.time + gaps[i & 4095], EventType::ARRIVAL, nullptr);
+    }
+    report(out, "event_queue.push_pop", ops, secondsSince(start));
+}
+
+// one op = a counter increment plus a histogram record, what a dispatch costs with telemetry on
+static void benchTelemetry(ostream& out, uint64_t ops) {
+    MetricsRegistry registry;
+    TelemetryCounter& counter = registry.counter("bench_total", "bench");
+    TelemetryHistogram& histogram = registry.histogram("bench_latency", "bench");
+    CounterRng rng(4, 0);
+    vector<int> values(4096);
+    for (size_t i = 0; i < values.size(); i++) values[i] = rng.nextInt(0, 100000);
+
+    auto start = chrono::steady_clock::now();
+    for (uint64_t i = 0; i < ops; i++) {
+        counter.add();
+        histogram.record(values[i & 4095]);
+    }
+    report(out, "telemetry.record", ops, secondsSince(start));
+}
+
+// a timeline with about 2000 reservations on 256 cores. one op = earliestStart for a random
+// job, reserve it there and give back the oldest reservation
+static void benchTimeline(ostream& out, uint64_t ops) {
+    const size_t resident = 2048;
+    ReservationTimeline timeline(256);
+    CounterRng rng(5, 0);
+    vector<long long> starts(resident), lengths(resident);
+    vector<int> widths(resident);
+    for (size_t i = 0; i < resident; i++) {
+        widths[i] = 1 << rng.nextInt(0, 7);
+        lengths[i] = rng.nextInt(1, 2000);
+        starts[i] = timeline.earliestStart(rng.nextInt(0, 1000000), widths[i], lengths[i]);
+        timeline.reserve(starts[i], lengths[i], widths[i]);
+    }
+
+    auto start = chrono::steady_clock::now();
+    for (uint64_t i = 0; i < ops; i++) {
+        size_t slot = i % resident;
+        timeline.release(starts[slot], lengths[slot], widths[slot]);
+        starts[slot] = timeline.earliestStart(rng.nextInt(0, 1000000), widths[slot], lengths[slot]);
+        timeline.reserve(starts[slot], lengths[slot], widths[slot]);
+    }
+    sink = timeline.size();
+    report(out, "timeline.reserve", ops, secondsSince(start));
+}
+
+static void runMicro(ostream& out, uint64_t ops) {
+    const char* policies[] = {"fcfs", "priority", "sjf", "rr", "mlfq", "cfs", "edf", "rm"};
+    for (size_t i = 0; i < sizeof(policies) / sizeof(policies[0]); i++) {
+        benchPolicy(out, policies[i], ops);
+    }
+    benchCGroupPolicy(out, ops);
+    benchProcessQueues(out, ops);
+
+    benchResources(out, WakePolicy::FIFO, false, ops);
+    benchResources(out, WakePolicy::FIFO, true, ops);
+    benchResources(out, WakePolicy::PRIORITY, true, ops);
+
+    const long long arena = 1LL << 24;
+    FreeListAllocator firstFit(arena, FitStrategy::FIRST_FIT);
+    benchAllocator(out, &firstFit, "first_fit", ops);
+    FreeListAllocator bestFit(arena, FitStrategy::BEST_FIT);
+    benchAllocator(out, &bestFit, "best_fit", ops);
+    FreeListAllocator worstFit(arena, FitStrategy::WORST_FIT);
+    benchAllocator(out, &worstFit, "worst_fit", ops);
+    FreeListAllocator nextFit(arena, FitStrategy::NEXT_FIT);
+    benchAllocator(out, &nextFit, "next_fit", ops);
+    BuddyAllocator buddy(arena);
+    benchAllocator(out, &buddy, "buddy", ops);
+    SlabAllocator slab(arena, {8, 16, 32, 64, 128, 256});
+    benchAllocator(out, &slab, "slab", ops);
+
+    benchEventQueue(out, ops);
+    benchTelemetry(out, ops);
+    benchTimeline(out, ops);
+}
+
+// ---------------- macro ----------------
+
+struct MacroResult {
+    long long submitted;
+    long long rejected;
+    long long peakLive;
+    uint64_t events;
+    uint64_t decisions;
+    uint64_t completed;
+    uint64_t contextSwitches;
+    double meanWaiting;
+    double seconds;
+    long long peakRssKb;
+};
+
+// a generated workload at ~80% CPU load, streamed through the trace replayer so only the
+// processes alive at once take memory
+static WorkloadConfig macroWorkload(long long processes) {
+    WorkloadConfig config;
+    config.seed = 42;
+    config.count = processes;
+    config.arrival_rate = 0.15;
+    config.burst_min = 1;
+    config.burst_max = 10;
+    config.small_min = 1;
+    config.small_max = 8;
+    config.zipf_s = 1.0;
+    config.io_probability = 0.2;
+    config.io_mean = 6;
+    return config;
+}
+
+template <class Simulation>
+static MacroResult replayMacro(Simulation& simulation, MemoryManager& memory, long long processes) {
+    GeneratedTraceSource source(macroWorkload(processes));
+    TraceReplayer replayer(nullptr, &memory, 1024);
+
+    auto start = chrono::steady_clock::now();
+    ReplayResult replayed = replayer.replayInto(simulation, source);
+    MacroResult result;
+    result.seconds = secondsSince(start);
+    result.submitted = replayed.submitted;
+    result.rejected = replayed.rejected;
+    result.peakLive = replayed.peak_live;
+    result.events = simulation.getEventsHandled();
+    result.decisions = simulation.getDecisions();
+    result.completed = replayed.summary.completed;
+    result.contextSwitches = replayed.summary.context_switches;
+    result.meanWaiting = replayed.summary.mean_waiting;
+    result.peakRssKb = peakRssKb();
+    return result;
+}
+
+// policies with a compile time configuration in static_scheduler.h
+static bool hasPinned(const string& policyName) {
+    return policyName == "fcfs" || policyName == "rr" || policyName == "priority"
+        || policyName == "sjf" || policyName == "srtf" || policyName == "mlfq";
+}
+
+// pinned = the StaticScheduler configuration of the policy instead of Scheduler
+static MacroResult simulate(long long processes, const string& policyName, bool pinned) {
+    MemoryManager memory(1 << 20);
+    ProcessQueues queues;
+    if (pinned && policyName == "fcfs") {
+        StaticFCFSScheduler simulation(&memory, &queues);
+        return replayMacro(simulation, memory, processes);
+    }
+    if (pinned && policyName == "rr") {
+        StaticRoundRobinScheduler simulation(&memory, &queues);
+        return replayMacro(simulation, memory, processes);
+    }
+    if (pinned && policyName == "priority") {
+        StaticPriorityScheduler simulation(&memory, &queues);
+        return replayMacro(simulation, memory, processes);
+    }
+    if (pinned && policyName == "sjf") {
+        StaticSJFScheduler simulation(&memory, &queues);
+        return replayMacro(simulation, memory, processes);
+    }
+    if (pinned && policyName == "srtf") {
+        StaticSRTFScheduler simulation(&memory, &queues);
+        return replayMacro(simulation, memory, processes);
+    }
+    if (pinned && policyName == "mlfq") {
+        StaticMLFQScheduler simulation(&memory, &queues);
+        return replayMacro(simulation, memory, processes);
+    }
+    Scheduler scheduler(&memory, &queues);
+    scheduler.setVerbose(false);
+    scheduler.setPolicy(createPolicy(policyName));
+    return replayMacro(scheduler, memory, processes);
+}
+
+static bool measureMacro(long long processes, const string& policyName, bool pinned, MacroResult& r) {
+#ifndef _WIN32
+    // child process per scale, the result comes back through a pipe
+    int fds[2];
+    if (pipe(fds) != 0) return false;
+    cout.flush();
+    pid_t child = fork();
+    if (child < 0) return false;
+    if (child == 0) {
+        close(fds[0]);
+        MacroResult mine = simulate(processes, policyName, pinned);
+        ssize_t written = write(fds[1], &mine, sizeof(mine));
+        _exit(written == (ssize_t)sizeof(mine) ? 0 : 1);
+    }
+    close(fds[1]);
+    size_t got = 0;
+    while (got < sizeof(r)) {
+        ssize_t n = read(fds[0], (char*)&r + got, sizeof(r) - got);
+        if (n <= 0) break;
+        got = got + n;
+    }
+    close(fds[0]);
+    int status = 0;
+    waitpid(child, &status, 0);
+    if (got != sizeof(r) || !WIFEXITED(status) || WEXITSTATUS(status) != 0) return false;
+#else
+    r = simulate(processes, policyName, pinned);
+#endif
+    return true;
+}
+
+static void reportMacro(ostream& out, const string& name, long long processes, const MacroResult& r) {
+    out << "{\"suite\":\"macro\",\"name\":\"" << name << "\",\"processes\":" << processes
+        << ",\"submitted\":" << r.submitted << ",\"rejected\":" << r.rejected << ",\"peak_live\":" << r.peakLive
+        << ",\"events\":" << r.events << ",\"decisions\":" << r.decisions << ",\"seconds\":" << r.seconds
+        << ",\"events_per_sec\":" << (r.seconds > 0 ? r.events / r.seconds : 0)
+        << ",\"ns_per_decision\":" << (r.decisions > 0 ? r.seconds * 1e9 / r.decisions : 0)
+        << ",\"peak_rss_kb\":" << r.peakRssKb;
+}
+
+// runtime Scheduler, then the pinned configuration (when there is one) on the same workload.
+// the pinned run has to end with the same metrics, otherwise the two engines disagree
+static bool runMacro(ostream& out, long long processes, const string& policyName) {
+    MacroResult runtime;
+    if (!measureMacro(processes, policyName, false, runtime)) return false;
+    reportMacro(out, "simulate." + policyName, processes, runtime);
+    out << "}" << endl;
+    if (!hasPinned(policyName)) return true;
+
+    MacroResult pinned;
+    if (!measureMacro(processes, policyName, true, pinned)) return false;
+    bool same = pinned.completed == runtime.completed && pinned.contextSwitches == runtime.contextSwitches
+             && pinned.events == runtime.events && pinned.meanWaiting == runtime.meanWaiting;
+    reportMacro(out, "simulate_static." + policyName, processes, pinned);
+    out << ",\"speedup\":" << (pinned.seconds > 0 ? runtime.seconds / pinned.seconds : 0)
+        << ",\"same_metrics\":" << (same ? "true" : "false") << "}" << endl;
+    if (!same) {
+        cerr << "static " << policyName << " scheduler disagrees with the runtime one" << endl;
+    }
+    return same;
+}
+
+// the macro workload on 8 work stealing cores, simulated with 1, 2 and 4 real threads.
+// threads only split the work, every count has to end with the same metrics
+static bool runMulticore(ostream& out, long long processes) {
+    vector<PCB> workload;
+    GeneratedTraceSource source(macroWorkload(processes));
+    TraceRecord r;
+    while (source.next(r)) {
+        PCB p;
+        traceRecordToPCB(r, &p);
+        workload.push_back(p);
+    }
+
+    bool same = true;
+    MetricsSummary first = {};
+    long long firstEnd = 0;
+    long long firstSteals = 0;
+    const int threadCounts[] = {1, 2, 4};
+    for (int t = 0; t < 3; t++) {
+        MultiCoreConfig config;
+        config.cores = 8;
+        config.threads = threadCounts[t];
+        config.migration_cost = 1;
+        MultiCoreSimulator simulator(config);
+        for (size_t i = 0; i < workload.size(); i++) simulator.addProcess(workload[i]);
+        auto start = chrono::steady_clock::now();
+        simulator.run();
+        double seconds = secondsSince(start);
+        MetricsSummary m = simulator.combinedMetrics().summary();
+        if (t == 0) {
+            first = m;
+            firstEnd = simulator.finishTime();
+            firstSteals = simulator.totalSteals();
+        } else if (m.completed != first.completed || m.context_switches != first.context_switches
+                   || m.mean_turnaround != first.mean_turnaround || m.mean_waiting != first.mean_waiting
+                   || simulator.finishTime() != firstEnd || simulator.totalSteals() != firstSteals) {
+            same = false;
+        }
+        out << "{\"suite\":\"macro\",\"name\":\"simulate_multicore.threads_" << threadCounts[t]
+            << "\",\"processes\":" << processes << ",\"completed\":" << m.completed
+            << ",\"steals\":" << simulator.totalSteals() << ",\"end_time\":" << simulator.finishTime()
+            << ",\"seconds\":" << seconds << ",\"same_metrics\":" << (same ? "true" : "false") << "}" << endl;
+    }
+    if (!same) {
+        cerr << "multicore metrics differ between thread counts" << endl;
+    }
+    return same;
+}
+
+int main(int argc, char** argv) {
+    bool micro = false;
+    bool macro = false;
+    uint64_t ops = 1000000;
+    string policyName = "rr";
+    string output;
+    vector<long long> scales;
+
+    for (int i = 1; i < argc; i++) {
+        string arg = argv[i];
+        if (arg == "--micro") {
+            micro = true;
+        } else if (arg == "--macro") {
+            macro = true;
+        } else if (arg == "--ops" && i + 1 < argc) {
+            ops = strtoull(argv[++i], nullptr, 10);
+        } else if (arg == "--policy" && i + 1 < argc) {
+            policyName = argv[++i];
+        } else if (arg == "-o" && i + 1 < argc) {
+            output = argv[++i];
+        } else if (!arg.empty() && arg[0] != '-' && atoll(arg.c_str()) > 0) {
+            scales.push_back(atoll(arg.c_str()));
+        } else {
+            cerr << "usage: os_bench [--micro] [--macro] [--ops n] [--policy name] [-o output] [processes ...]" << endl;
+            return 2;
+        }
+    }
+    if (!micro && !macro) {
+        micro = true;
+        macro = true;
+    }
+    if (scales.empty()) {
+        scales.push_back(1000);
+        scales.push_back(1000000);
+    }
+    try {
+        createPolicy(policyName);
+    } catch (const invalid_argument& e) {
+        cerr << e.what() << endl;
+        return 2;
+    }
+
+    ofstream file;
+    if (!output.empty()) {
+        file.open(output);
+        if (!file) {
+            cerr << "cannot write " << output << endl;
+            return 1;
+        }
+    }
+    ostream& out = output.empty() ? cout : file;
+    out.precision(4);
+
+    if (micro) runMicro(out, ops);
+    if (macro) {
+        for (size_t i = 0; i < scales.size(); i++) {
+            if (!runMacro(out, scales[i], policyName)) {
+                cerr << "macro run with " << scales[i] << " processes failed" << endl;
+                return 1;
+            }
+        }
+        if (!runMulticore(out, scales[0])) return 1;
+    }
+    return 0;
+}
@@ -0,0 +1,51 @@
+#include <iostream>
+#include <fstream>
+#include <string>
+#include "event_trace.h"
+
+using namespace std;
+
+// turns a binary event log into text or Chrome trace JSON
+//   trace_decode <log> [--chrome] [-o output]
+int main(int argc, char** argv) {
+    string input;
+    string output;
+    TraceOutput format = TraceOutput::TEXT;
+
+    for (int i = 1; i < argc; i++) {
+        string arg = argv[i];
+        if (arg == "--chrome") {
+            format = TraceOutput::CHROME_JSON;
+        } else if (arg == "--text") {
+            format = TraceOutput::TEXT;
+        } else if (arg == "-o" && i + 1 < argc) {
+            output = argv[++i];
+        } else if (input.empty()) {
+            input = arg;
+        } else {
+            input.clear();
+            break;
+        }
+    }
+    if (input.empty()) {
+        cerr << "usage: trace_decode <log> [--text | --chrome] [-o output]" << endl;
+        return 2;
+    }
+
+    bool ok;
+    if (output.empty()) {
+        ok = decodeEventLog(input, cout, format);
+    } else {
+        ofstream out(output);
+        if (!out) {
+            cerr << "cannot write " << output << endl;
+            return 1;
+        }
+        ok = decodeEventLog(input, out, format);
+    }
+    if (!ok) {
+        cerr << input << " is not an event log" << endl;
+        return 1;
+    }
+    return 0;
+}